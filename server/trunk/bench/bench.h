@@ -0,0 +1,39 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace caspar { namespace bench {
+
+// Each benchmark prints its results to std::wcout and returns a process exit code.
+// args holds whatever followed the benchmark name on the command line.
+
+int run_channel_bench(const std::vector<std::wstring>& args);
+int run_decode_bench(const std::vector<std::wstring>& args);
+int run_simd_bench(const std::vector<std::wstring>& args);
+int run_parity_bench(const std::vector<std::wstring>& args);
+int run_executor_bench(const std::vector<std::wstring>& args);
+
+}}
@@ -0,0 +1,262 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "bench.h"
+
+#include <core/video_channel.h>
+#include <core/video_format.h>
+#include <core/consumer/frame_consumer.h>
+#include <core/consumer/output.h>
+#include <core/mixer/mixer.h>
+#include <core/mixer/read_frame.h>
+#include <core/mixer/write_frame.h>
+#include <core/producer/stage.h>
+#include <core/producer/frame_producer.h>
+#include <core/producer/frame/basic_frame.h>
+#include <core/producer/frame/frame_factory.h>
+#include <core/producer/frame/frame_transform.h>
+#include <core/producer/frame/pixel_format.h>
+
+#include <common/memory/safe_ptr.h>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/timer.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace caspar { namespace bench {
+
+namespace {
+
+// Writes a full frame of new pixels every tick so that neither the upload nor the
+// mix can be skipped as unchanged.
+class synthetic_producer : public core::frame_producer
+{
+	const safe_ptr<core::frame_factory>	frame_factory_;
+	const int							index_;
+	uint8_t								value_;
+	safe_ptr<core::basic_frame>			last_frame_;
+public:
+	synthetic_producer(const safe_ptr<core::frame_factory>& frame_factory, int index)
+		: frame_factory_(frame_factory)
+		, index_(index)
+		, value_(static_cast<uint8_t>(index*16))
+		, last_frame_(core::basic_frame::empty())
+	{
+	}
+
+	// frame_producer
+			
+	virtual safe_ptr<core::basic_frame> receive(int) override
+	{
+		const auto format_desc = frame_factory_->get_video_format_desc();
+
+		core::pixel_format_desc desc;
+		desc.pix_fmt = core::pixel_format::bgra;
+		desc.planes.push_back(core::pixel_format_desc::plane(format_desc.width, format_desc.height, 4));
+		auto frame = frame_factory_->create_frame(this, desc);
+
+		std::fill(frame->image_data().begin(), frame->image_data().end(), value_++);
+		frame->commit();
+
+		last_frame_ = frame;
+		return frame;
+	}	
+
+	virtual safe_ptr<core::basic_frame> last_frame() const override
+	{
+		return last_frame_; 
+	}	
+
+	virtual std::wstring print() const override
+	{
+		return L"synthetic[" + boost::lexical_cast<std::wstring>(index_) + L"]";
+	}
+
+	boost::property_tree::wptree info() const override
+	{
+		boost::property_tree::wptree info;
+		info.add(L"type", L"synthetic-producer");
+		return info;
+	}
+};
+
+// Accepts frames as soon as they are sent and lets the benchmark wait for a frame count.
+class null_consumer : public core::frame_consumer
+{
+	boost::mutex				mutex_;
+	boost::condition_variable	cond_;
+	int							frames_;
+public:
+	null_consumer()
+		: frames_(0)
+	{
+	}
+
+	void wait_for(int frames)
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		while(frames_ < frames)
+			cond_.wait(lock);
+	}
+
+	// frame_consumer
+
+	virtual boost::unique_future<bool> send(const safe_ptr<core::read_frame>& frame) override
+	{
+		frame->image_data(); // Forces the readback.
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			++frames_;
+		}
+		cond_.notify_all();
+
+		boost::promise<bool> promise;
+		promise.set_value(true);
+		return promise.get_future();
+	}
+
+	virtual void initialize(const core::video_format_desc&, int) override
+	{
+	}
+
+	virtual std::wstring print() const override
+	{
+		return L"null[]";
+	}
+
+	virtual boost::property_tree::wptree info() const override
+	{
+		boost::property_tree::wptree info;
+		info.add(L"type", L"null-consumer");
+		return info;
+	}
+
+	virtual bool has_synchronization_clock() const override
+	{
+		return false;
+	}
+
+	virtual size_t buffer_depth() const override
+	{
+		return 1;
+	}
+
+	virtual int index() const override
+	{
+		return 1000;
+	}
+};
+
+void print_statistic(const boost::property_tree::wptree& statistics, const std::wstring& name)
+{
+	std::wcout << std::setw(8) << statistics.get(name + L".p50", 0.0)
+			   << std::setw(8) << statistics.get(name + L".p99", 0.0)
+			   << std::setw(8) << statistics.get(name + L".max", 0.0);
+}
+
+void run(const core::video_format_desc& format_desc, int layers, const std::wstring& blend, int frames)
+{
+	auto consumer = make_safe<null_consumer>();
+	
+	double elapsed = 0.0;
+	boost::property_tree::wptree statistics;
+	{
+		// No ogl device, frames are mixed on the cpu.
+		core::video_channel channel(1, format_desc, nullptr);
+		channel.set_offline(true);
+		channel.output()->add(consumer);
+
+		for(int n = 1; n <= layers; ++n)
+		{
+			channel.stage()->load(n, make_safe<synthetic_producer>(channel.mixer(), n));
+			channel.stage()->play(n);
+			if(n > 1) // Keep every layer visible so that all of them are blended.
+			{
+				channel.stage()->apply_transform(n, [](core::frame_transform transform) -> core::frame_transform
+				{
+					transform.opacity = 0.5;
+					return transform;
+				});
+				channel.mixer()->set_blend_mode(n, core::get_blend_mode(blend));
+			}
+		}
+
+		// The statistics keep the last 1024 samples, running at least that many frames after
+		// the warmup keeps the warmup out of them.
+		const int warmup = 25;
+		consumer->wait_for(warmup);
+		boost::timer timer;
+		consumer->wait_for(warmup + frames);
+		elapsed = timer.elapsed();
+
+		statistics = channel.info().get_child(L"statistics");
+	}
+
+	std::wcout << std::setw(12) << format_desc.name
+			   << std::setw(8)  << layers
+			   << std::setw(12) << blend
+			   << std::setw(10) << static_cast<double>(frames)/std::max(elapsed, 0.001);
+	print_statistic(statistics, L"tick-time");
+	print_statistic(statistics, L"produce-time");
+	print_statistic(statistics, L"mix-time");
+	print_statistic(statistics, L"consume-time");
+	std::wcout << std::endl;
+}
+
+}
+
+int run_channel_bench(const std::vector<std::wstring>& args)
+{
+	const int frames = args.size() > 0 ? boost::lexical_cast<int>(args[0]) : 1024;
+
+	const core::video_format::type formats[] = {core::video_format::x720p5000, core::video_format::x1080i5000, core::video_format::x1080p5000};
+	const int layers[] = {1, 2, 4, 8, 16};
+	const wchar_t* blends[] = {L"normal", L"add", L"multiply", L"overlay", L"soft_light"}; // Increasingly expensive per pixel.
+
+	std::wcout << std::fixed << std::setprecision(2);
+	std::wcout << L"Times in ms as p50/p99/max." << std::endl
+			   << std::setw(12) << L"format" << std::setw(8) << L"layers" << std::setw(12) << L"blend" << std::setw(10) << L"fps"
+			   << std::setw(24) << L"tick" << std::setw(24) << L"produce" << std::setw(24) << L"mix" << std::setw(24) << L"consume" << std::endl;
+
+	for(size_t f = 0; f < sizeof(formats)/sizeof(formats[0]); ++f)
+	{
+		for(size_t l = 0; l < sizeof(layers)/sizeof(layers[0]); ++l)
+		{
+			for(size_t b = 0; b < sizeof(blends)/sizeof(blends[0]); ++b)
+			{
+				if(layers[l] == 1 && b > 0) // The bottom layer is never blended.
+					break;
+				run(core::video_format_desc::get(formats[f]), layers[l], blends[b], frames);
+			}
+		}
+	}
+
+	return 0;
+}
+
+}}
@@ -0,0 +1,129 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "bench.h"
+
+#include <modules/ffmpeg/ffmpeg.h>
+#include <modules/ffmpeg/producer/input/input.h>
+#include <modules/ffmpeg/producer/util/util.h>
+#include <modules/ffmpeg/producer/video/video_decoder.h>
+
+#include <common/diagnostics/graph.h>
+#include <common/exception/exceptions.h>
+#include <common/log/log.h>
+#include <common/memory/safe_ptr.h>
+
+#include <tbb/atomic.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+namespace caspar { namespace bench {
+
+namespace {
+
+// Decodes video as fast as it can, looping the file, until stop is set.
+void decode(const std::wstring& filename, tbb::atomic<int>& frames, const tbb::atomic<bool>& stop)
+{
+	try
+	{
+		ffmpeg::input input(make_safe<diagnostics::graph>(), filename, true, 0, std::numeric_limits<uint32_t>::max());
+		ffmpeg::video_decoder decoder(input.context());
+
+		std::shared_ptr<AVPacket> packet;
+		while(!stop)
+		{
+			while(!decoder.ready() && input.try_pop(packet))
+				decoder.push(packet);
+
+			auto frame = decoder.poll();
+			if(frame && frame != ffmpeg::flush_video())
+				++frames;
+			else if(!frame && !decoder.ready())
+				input.wait(100);
+		}
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+	}
+}
+
+}
+
+int run_decode_bench(const std::vector<std::wstring>& args)
+{
+	if(args.empty())
+	{
+		std::wcout << L"usage: bench decode <file> [streams] [seconds]" << std::endl;
+		return 1;
+	}
+
+	const auto filename	= args[0];
+	const int  streams	= args.size() > 1 ? boost::lexical_cast<int>(args[1]) : 1;
+	const int  seconds	= args.size() > 2 ? boost::lexical_cast<int>(args[2]) : 10;
+	const int  warmup	= 1; // Seconds, opening the files and filling the frame threads isn't measured.
+
+	ffmpeg::init();
+
+	std::vector<tbb::atomic<int>> frames(streams);
+	tbb::atomic<bool> stop;
+	stop = false;
+
+	boost::thread_group threads;
+	for(int n = 0; n < streams; ++n)
+	{
+		auto count = &frames[n];
+		*count = 0;
+		threads.create_thread([=, &stop]{decode(filename, *count, stop);});
+	}
+
+	boost::this_thread::sleep(boost::posix_time::seconds(warmup));
+	std::vector<int> start_frames;
+	for(int n = 0; n < streams; ++n)
+		start_frames.push_back(frames[n]);
+
+	boost::this_thread::sleep(boost::posix_time::seconds(seconds));
+	stop = true;
+	
+	int total = 0;
+	std::wcout << std::fixed << std::setprecision(1);
+	for(int n = 0; n < streams; ++n)
+	{
+		const int decoded = frames[n] - start_frames[n];
+		total += decoded;
+		std::wcout << L"stream " << n << L": " << static_cast<double>(decoded)/seconds << L" fps" << std::endl;
+	}
+	std::wcout << L"total: " << static_cast<double>(total)/seconds << L" fps over " << streams << L" streams" << std::endl;
+
+	threads.join_all();
+
+	ffmpeg::uninit();
+
+	return 0;
+}
+
+}}
@@ -0,0 +1,239 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+
+#include "bench.h"
+
+#include <common/concurrency/executor.h>
+#include <common/diagnostics/trace.h>
+#include <common/utility/move_on_copy.h>
+
+#include <tbb/atomic.h>
+#include <tbb/concurrent_queue.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+
+namespace {
+
+tbb::atomic<long> g_allocations;
+
+}
+
+// Counts every allocation made by code compiled into the bench, which includes the executor templates.
+void* operator new(size_t size)
+{
+	++g_allocations;
+	auto result = malloc(size > 0 ? size : 1);
+	if(!result)
+		throw std::bad_alloc();
+	return result;
+}
+
+void operator delete(void* ptr)
+{
+	free(ptr);
+}
+
+namespace caspar { namespace bench {
+
+namespace {
+
+// The executor as it was before tasks were stored inline and post() existed, kept as a baseline: 
+// every begin_invoke allocates a packaged_task, its wait callback and a std::function.
+class legacy_executor : boost::noncopyable
+{
+	tbb::atomic<bool>									is_running_;
+	tbb::concurrent_bounded_queue<std::function<void()>>	queue_;
+	boost::thread										thread_;
+public:
+	legacy_executor()
+	{
+		is_running_ = true;
+		thread_ = boost::thread([this]{run();});
+	}
+
+	~legacy_executor()
+	{
+		is_running_ = false;
+		queue_.push(nullptr);
+		thread_.join();
+	}
+
+	template<typename Func>
+	auto begin_invoke(Func&& func) -> boost::unique_future<decltype(func())>
+	{
+		typedef boost::packaged_task<decltype(func())> task_type;
+				
+		auto task = task_type(std::forward<Func>(func));
+		task.set_wait_callback(std::function<void(task_type&)>([=](task_type& my_task)
+		{
+			try
+			{
+				if(boost::this_thread::get_id() == thread_.get_id())
+					my_task();
+			}
+			catch(boost::task_already_started&){}
+		}));
+
+		auto task_adaptor = make_move_on_copy(std::move(task));
+		auto future = task_adaptor.value.get_future();
+
+		queue_.push([=]
+		{
+			try
+			{
+				task_adaptor.value();
+			}
+			catch(...)
+			{
+			}
+		});
+
+		return std::move(future);
+	}
+
+	template<typename Func>
+	auto invoke(Func&& func) -> decltype(func())
+	{
+		return begin_invoke(std::forward<Func>(func)).get();
+	}
+
+private:
+	void run()
+	{
+		while(is_running_)
+		{
+			std::function<void()> func;
+			queue_.pop(func);
+			if(func)
+				func();
+		}
+	}
+};
+
+// Tasks capture about as much as the per-frame tasks do, a shared pointer and two words.
+struct payload
+{
+	std::shared_ptr<int>	data;
+	tbb::atomic<int>*		counter;
+	int						value;
+
+	void operator()() const
+	{
+		*counter += value;
+	}
+};
+
+void measure(const std::wstring& name, int tasks, const std::function<void()>& run)
+{
+	const long allocations = g_allocations;
+	const auto begin = diagnostics::trace_now();
+
+	run();
+
+	const auto elapsed = diagnostics::trace_now() - begin;
+
+	std::wcout << std::setw(28) << name
+			   << std::setw(12) << static_cast<double>(elapsed)*1000.0/tasks
+			   << std::setw(16) << static_cast<double>(g_allocations - allocations)/tasks << std::endl;
+}
+
+}
+
+int run_executor_bench(const std::vector<std::wstring>& args)
+{
+	const int tasks = args.size() > 0 ? boost::lexical_cast<int>(args[0]) : 1000000;
+	const int calls = std::max(tasks/10, 1); // invoke waits for every task, fewer of them are enough.
+
+	tbb::atomic<int> counter;
+	counter = 0;
+
+	payload task;
+	task.data		= std::make_shared<int>(1);
+	task.counter	= &counter;
+	task.value		= 1;
+
+	std::wcout << std::fixed << std::setprecision(2)
+			   << L"Executors on " << (executor_pool_size() > 0 ? L"a pool of " + boost::lexical_cast<std::wstring>(executor_pool_size()) + L" threads" : L"dedicated threads") << L"." << std::endl
+			   << std::setw(28) << L"" << std::setw(12) << L"ns/task" << std::setw(16) << L"allocs/task" << std::endl;
+
+	{
+		legacy_executor legacy;
+
+		measure(L"legacy begin_invoke", tasks, [&]
+		{
+			for(int n = 0; n < tasks; ++n)
+				legacy.begin_invoke(task);
+			legacy.invoke([]{});
+		});
+		
+		measure(L"legacy invoke", calls, [&]
+		{
+			for(int n = 0; n < calls; ++n)
+				legacy.invoke(task);
+		});
+	}
+
+	{
+		executor strand(L"bench");
+
+		measure(L"begin_invoke", tasks, [&]
+		{
+			for(int n = 0; n < tasks; ++n)
+				strand.begin_invoke(task);
+			strand.wait();
+		});
+
+		measure(L"begin_invoke high priority", tasks, [&]
+		{
+			for(int n = 0; n < tasks; ++n)
+				strand.begin_invoke(task, high_priority);
+			strand.wait();
+		});
+
+		measure(L"post", tasks, [&]
+		{
+			for(int n = 0; n < tasks; ++n)
+				strand.post(task);
+			strand.wait();
+		});
+
+		measure(L"invoke", calls, [&]
+		{
+			for(int n = 0; n < calls; ++n)
+				strand.invoke(task);
+		});
+	}
+
+	return 0;
+}
+
+}}
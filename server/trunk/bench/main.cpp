@@ -0,0 +1,79 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+// Headless benchmarks and self-checks. Nothing here opens a window or touches
+// video output hardware so the results can be compared between machines and builds.
+//
+//	bench channel [frames]					mixer/stage/output sweep over layer counts and formats.
+//	bench decode <file> [streams] [seconds]	video decoding of several concurrent copies of a clip.
+//	bench simd [megabytes] [repeats]		memory kernels of every simd level checked against scalar, then timed.
+//	bench parity [tolerance] [format]		gpu and cpu image mixers compared on the same scenes.
+//	bench executor [tasks]					per task cost and allocations of the executor against the old one.
+
+#include "bench.h"
+
+#include <common/env.h>
+#include <common/log/log.h>
+#include <common/concurrency/executor.h>
+#include <common/exception/exceptions.h>
+
+#include <tbb/task_scheduler_init.h>
+
+#include <boost/foreach.hpp>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+int wmain(int argc, wchar_t* argv[])
+{
+	tbb::task_scheduler_init init;
+
+	try
+	{
+		caspar::env::configure(L"casparcg.config");
+		caspar::log::set_log_level(caspar::env::properties().get(L"configuration.log-level", L"warning"));
+		caspar::set_executor_pool_size(caspar::env::properties().get(L"configuration.executor-threads", 0u));
+
+		const std::wstring name = argc > 1 ? argv[1] : L"";
+		const std::vector<std::wstring> args(argc > 2 ? argv + 2 : argv + argc, argv + argc);
+
+		if(name == L"channel")
+			return caspar::bench::run_channel_bench(args);
+		if(name == L"decode")
+			return caspar::bench::run_decode_bench(args);
+		if(name == L"simd")
+			return caspar::bench::run_simd_bench(args);
+		if(name == L"parity")
+			return caspar::bench::run_parity_bench(args);
+		if(name == L"executor")
+			return caspar::bench::run_executor_bench(args);
+		
+		std::wcout << L"usage: bench channel|decode|simd|parity|executor [args]" << std::endl;
+		return 1;
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		return 1;
+	}
+}
@@ -0,0 +1,321 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+
+#include "bench.h"
+
+#include <core/video_format.h>
+#include <core/mixer/mixer.h>
+#include <core/mixer/read_frame.h>
+#include <core/mixer/write_frame.h>
+#include <core/mixer/gpu/ogl_device.h>
+#include <core/mixer/image/blend_modes.h>
+#include <core/producer/frame/basic_frame.h>
+#include <core/producer/frame/frame_transform.h>
+#include <core/producer/frame/pixel_format.h>
+
+#include <common/diagnostics/graph.h>
+#include <common/memory/safe_ptr.h>
+#include <common/utility/string.h>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+namespace caspar { namespace bench {
+
+namespace {
+
+typedef std::map<int, safe_ptr<core::basic_frame>> layer_map;
+
+// Hands the mixed frames back to the benchmark.
+class capture_target : public core::mixer::target_t
+{
+	boost::mutex					mutex_;
+	boost::condition_variable		cond_;
+	std::shared_ptr<core::read_frame>	frame_;
+public:
+	virtual void send(const std::pair<safe_ptr<core::read_frame>, std::shared_ptr<void>>& packet) override
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			frame_ = packet.first;
+		}
+		cond_.notify_all();
+	}
+
+	safe_ptr<core::read_frame> receive()
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		while(!frame_)
+			cond_.wait(lock);
+
+		auto frame = make_safe_ptr(frame_);
+		frame_.reset();
+		return frame;
+	}
+};
+
+// Deterministic premultiplied bgra with an opaque left half and an alpha ramp on the right half.
+safe_ptr<core::basic_frame> make_bgra_frame(core::mixer& mixer, int seed)
+{
+	const auto format_desc = mixer.get_video_format_desc();
+
+	core::pixel_format_desc desc;
+	desc.pix_fmt = core::pixel_format::bgra;
+	desc.planes.push_back(core::pixel_format_desc::plane(format_desc.width, format_desc.height, 4));
+	auto frame = mixer.create_frame(&mixer, desc);
+
+	auto data = frame->image_data().begin();
+	for(size_t y = 0; y < format_desc.height; ++y)
+	{
+		for(size_t x = 0; x < format_desc.width; ++x)
+		{
+			const int alpha = x < format_desc.width/2 ? 255 : static_cast<int>((x*2 + y + seed) % 256);
+			auto pixel = data + (y*format_desc.width + x)*4;
+			pixel[0] = static_cast<uint8_t>(((x + seed*13) % 256) * alpha / 255);
+			pixel[1] = static_cast<uint8_t>(((y + seed*29) % 256) * alpha / 255);
+			pixel[2] = static_cast<uint8_t>(((x + y + seed*47) % 256) * alpha / 255);
+			pixel[3] = static_cast<uint8_t>(alpha);
+		}
+	}
+	frame->commit();
+
+	return frame;
+}
+
+// Deterministic 4:2:0 ycbcr within the legal video ranges.
+safe_ptr<core::basic_frame> make_ycbcr_frame(core::mixer& mixer, int seed)
+{
+	const auto format_desc = mixer.get_video_format_desc();
+
+	core::pixel_format_desc desc;
+	desc.pix_fmt = core::pixel_format::ycbcr;
+	desc.planes.push_back(core::pixel_format_desc::plane(format_desc.width,	  format_desc.height,	1));
+	desc.planes.push_back(core::pixel_format_desc::plane(format_desc.width/2, format_desc.height/2, 1));
+	desc.planes.push_back(core::pixel_format_desc::plane(format_desc.width/2, format_desc.height/2, 1));
+	auto frame = mixer.create_frame(&mixer, desc);
+
+	for(size_t n = 0; n < desc.planes.size(); ++n)
+	{
+		const auto& plane = desc.planes[n];
+		auto data = frame->image_data(n).begin();
+		for(size_t y = 0; y < plane.height; ++y)
+		{
+			for(size_t x = 0; x < plane.width; ++x)
+				data[y*plane.linesize + x] = static_cast<uint8_t>(n == 0 ? 16 + (x + y + seed) % 220 : 16 + (x*3 + y*(n+1) + seed) % 225);
+		}
+	}
+	frame->commit();
+
+	return frame;
+}
+
+struct scene
+{
+	std::wstring							name;
+	std::function<layer_map(core::mixer&)>	create;
+};
+
+std::vector<scene> create_scenes()
+{
+	std::vector<scene> scenes;
+
+	scene s;
+
+	s.name	 = L"bgra";
+	s.create = [](core::mixer& mixer) -> layer_map
+	{
+		layer_map layers;
+		layers.insert(std::make_pair(1, make_bgra_frame(mixer, 1)));
+		return layers;
+	};
+	scenes.push_back(s);
+
+	s.name	 = L"ycbcr";
+	s.create = [](core::mixer& mixer) -> layer_map
+	{
+		layer_map layers;
+		layers.insert(std::make_pair(1, make_ycbcr_frame(mixer, 1)));
+		return layers;
+	};
+	scenes.push_back(s);
+
+	s.name	 = L"opacity";
+	s.create = [](core::mixer& mixer) -> layer_map
+	{
+		auto top = make_safe<core::basic_frame>(make_bgra_frame(mixer, 2));
+		top->get_frame_transform().opacity = 0.37;
+
+		layer_map layers;
+		layers.insert(std::make_pair(1, make_bgra_frame(mixer, 1)));
+		layers.insert(std::make_pair(2, top));
+		return layers;
+	};
+	scenes.push_back(s);
+
+	s.name	 = L"fill and clip";
+	s.create = [](core::mixer& mixer) -> layer_map
+	{
+		auto top = make_safe<core::basic_frame>(make_bgra_frame(mixer, 2));
+		top->get_frame_transform().fill_translation[0] = 0.25;
+		top->get_frame_transform().fill_translation[1] = 0.125;
+		top->get_frame_transform().fill_scale[0]	   = 0.5;
+		top->get_frame_transform().fill_scale[1]	   = 0.5;
+		top->get_frame_transform().clip_translation[0] = 0.3;
+		top->get_frame_transform().clip_scale[0]	   = 0.4;
+
+		layer_map layers;
+		layers.insert(std::make_pair(1, make_ycbcr_frame(mixer, 1)));
+		layers.insert(std::make_pair(2, top));
+		return layers;
+	};
+	scenes.push_back(s);
+
+	s.name	 = L"color adjust";
+	s.create = [](core::mixer& mixer) -> layer_map
+	{
+		auto frame = make_safe<core::basic_frame>(make_bgra_frame(mixer, 3));
+		auto& transform = frame->get_frame_transform();
+		transform.brightness		= 1.2;
+		transform.contrast			= 0.8;
+		transform.saturation		= 0.6;
+		transform.levels.min_input	= 0.1;
+		transform.levels.max_input	= 0.9;
+		transform.levels.gamma		= 1.3;
+		transform.levels.min_output	= 0.05;
+		transform.levels.max_output	= 0.95;
+
+		layer_map layers;
+		layers.insert(std::make_pair(1, frame));
+		return layers;
+	};
+	scenes.push_back(s);
+
+	s.name	 = L"key";
+	s.create = [](core::mixer& mixer) -> layer_map
+	{
+		layer_map layers;
+		layers.insert(std::make_pair(1, make_ycbcr_frame(mixer, 1)));
+		layers.insert(std::make_pair(2, core::basic_frame::fill_and_key(make_bgra_frame(mixer, 2), make_bgra_frame(mixer, 5))));
+		return layers;
+	};
+	scenes.push_back(s);
+
+	for(int mode = core::blend_mode::lighten; mode < core::blend_mode::blend_mode_count; ++mode)
+	{
+		s.name	 = L"blend mode " + boost::lexical_cast<std::wstring>(mode);
+		s.create = [mode](core::mixer& mixer) -> layer_map
+		{
+			mixer.set_blend_mode(2, static_cast<core::blend_mode::type>(mode));
+
+			layer_map layers;
+			layers.insert(std::make_pair(1, make_bgra_frame(mixer, 1)));
+			layers.insert(std::make_pair(2, make_bgra_frame(mixer, 2)));
+			return layers;
+		};
+		scenes.push_back(s);
+	}
+
+	return scenes;
+}
+
+safe_ptr<core::read_frame> mix(core::mixer& mixer, capture_target& target, const scene& s)
+{
+	mixer.clear_blend_modes();
+	mixer.send(std::make_pair(s.create(mixer), std::shared_ptr<void>()));
+	return target.receive();
+}
+
+}
+
+int run_parity_bench(const std::vector<std::wstring>& args)
+{
+	const int  tolerance = args.size() > 0 ? boost::lexical_cast<int>(args[0]) : 2;
+	const auto format	 = args.size() > 1 ? core::video_format_desc::get(args[1]) : core::video_format_desc::get(core::video_format::x720p5000);
+
+	if(format.format == core::video_format::invalid)
+	{
+		std::wcout << L"usage: bench parity [tolerance] [format]" << std::endl;
+		return 1;
+	}
+
+	auto gpu_target = make_safe<capture_target>();
+	auto cpu_target = make_safe<capture_target>();
+
+	core::mixer gpu_mixer(make_safe<diagnostics::graph>(), gpu_target, format, core::ogl_device::create());
+	core::mixer cpu_mixer(make_safe<diagnostics::graph>(), cpu_target, format, nullptr);
+
+	std::wcout << L"Per channel differences between the gpu and cpu image mixers, tolerance " << tolerance << L"." << std::endl
+			   << std::setw(16) << L"scene" << std::setw(8) << L"max" << std::setw(10) << L"mean" << std::setw(12) << L"over" << std::endl;
+
+	bool ok = true;
+
+	auto scenes = create_scenes();
+	for(size_t n = 0; n < scenes.size(); ++n)
+	{
+		auto gpu_frame = mix(gpu_mixer, *gpu_target, scenes[n]);
+		auto cpu_frame = mix(cpu_mixer, *cpu_target, scenes[n]);
+
+		auto gpu_image = gpu_frame->image_data();
+		auto cpu_image = cpu_frame->image_data();
+
+		if(gpu_image.size() != cpu_image.size())
+		{
+			std::wcout << std::setw(16) << scenes[n].name << L" FAILED size " << gpu_image.size() << L" != " << cpu_image.size() << std::endl;
+			ok = false;
+			continue;
+		}
+
+		int		max_difference	= 0;
+		int64_t	sum				= 0;
+		size_t	over			= 0;
+		for(size_t i = 0; i < gpu_image.size(); ++i)
+		{
+			const int difference = std::abs(static_cast<int>(gpu_image[i]) - static_cast<int>(cpu_image[i]));
+			max_difference = std::max(max_difference, difference);
+			sum += difference;
+			if(difference > tolerance)
+				++over;
+		}
+
+		std::wcout << std::setw(16) << scenes[n].name 
+				   << std::setw(8)  << max_difference 
+				   << std::setw(10) << std::fixed << std::setprecision(3) << static_cast<double>(sum)/std::max<size_t>(gpu_image.size(), 1)
+				   << std::setw(12) << over
+				   << (over > 0 ? L" FAILED" : L"") << std::endl;
+
+		ok &= over == 0;
+	}
+
+	return ok ? 0 : 1;
+}
+
+}}
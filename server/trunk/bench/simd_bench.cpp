@@ -0,0 +1,213 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+
+#include "bench.h"
+
+#include <common/diagnostics/trace.h>
+#include <common/memory/memclr.h>
+#include <common/memory/memcpy.h>
+#include <common/memory/memshfl.h>
+#include <common/memory/simd.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace caspar { namespace bench {
+
+namespace {
+
+const uint8_t guard_byte = 0xCD;
+
+struct shuffle_mask
+{
+	const wchar_t*	name;
+	int				m1, m2, m3, m4;
+};
+
+const shuffle_mask masks[] = 
+{
+	{L"key",	 0x0F0F0F0F, 0x0B0B0B0B, 0x07070707, 0x03030303},
+	{L"swap_rb", 0x0F0C0D0E, 0x0B08090A, 0x07040506, 0x03000102}
+};
+
+// Sizes around every head, block and tail boundary of the kernels, plus a few that take the parallel path.
+std::vector<size_t> verification_sizes()
+{
+	std::vector<size_t> sizes;
+	for(size_t size = 0; size <= 300; ++size)
+		sizes.push_back(size);
+	sizes.push_back(4095);
+	sizes.push_back(4096);
+	sizes.push_back(65535);
+	sizes.push_back(65536+17);
+	sizes.push_back(1920*1080*4);
+	return sizes;
+}
+
+// Runs kernel and reference on identically guarded buffers at every size, alignment and store mode, the 
+// guard bytes around the destination catch writes outside of it.
+bool verify(const std::wstring& name, const std::function<void(simd::level, uint8_t*, const uint8_t*, size_t, bool)>& kernel)
+{
+	static const size_t padding = 64;
+	static const size_t offsets[] = {0, 1, 3, 4, 8, 15};
+	static const size_t offset_count = sizeof(offsets)/sizeof(offsets[0]);
+
+	const auto sizes = verification_sizes();
+
+	std::vector<uint8_t> source(sizes.back() + 2*padding);
+	for(size_t n = 0; n < source.size(); ++n)
+		source[n] = static_cast<uint8_t>(n*7 + n/251);
+
+	std::vector<uint8_t> expected(source.size());
+	std::vector<uint8_t> actual(source.size());
+
+	for(int simd_level = simd::sse2_level; simd_level <= simd::get_level(); ++simd_level)
+	{
+		for(size_t s = 0; s < sizes.size(); ++s)
+		{
+			for(size_t d = 0; d < offset_count; ++d)
+			{
+				for(int non_temporal = 0; non_temporal < 2; ++non_temporal)
+				{
+					const auto size		= sizes[s];
+					const auto offset	= padding + offsets[d];
+					const auto input	= source.data() + padding + offsets[(d+1) % offset_count]; // Varies the source alignment against the destination.
+
+					std::fill(expected.begin(), expected.end(), guard_byte);
+					std::fill(actual.begin(), actual.end(), guard_byte);
+
+					kernel(simd::scalar_level, expected.data() + offset, input, size, non_temporal != 0);
+					kernel(static_cast<simd::level>(simd_level), actual.data() + offset, input, size, non_temporal != 0);
+
+					if(expected != actual)
+					{
+						std::wcout << L"FAILED " << name << L" " << simd::get_level_name(static_cast<simd::level>(simd_level)) 
+								   << L" size: " << size << L" offset: " << offsets[d] << L" non-temporal: " << non_temporal << std::endl;
+						return false;
+					}
+				}
+			}
+		}
+	}
+
+	std::wcout << L"ok " << name << std::endl;
+	return true;
+}
+
+// Bytes processed per second by the fastest of repeats runs, in GB/s.
+double measure(size_t size, int repeats, const std::function<void()>& func)
+{
+	func(); // Touches the pages.
+
+	int64_t best = std::numeric_limits<int64_t>::max();
+	for(int n = 0; n < repeats; ++n)
+	{
+		auto begin = diagnostics::trace_now();
+		func();
+		best = std::min(best, diagnostics::trace_now() - begin);
+	}
+
+	return static_cast<double>(size) / static_cast<double>(std::max<int64_t>(best, 1)) / 1000.0;
+}
+
+}
+
+int run_simd_bench(const std::vector<std::wstring>& args)
+{
+	const size_t megabytes	= args.size() > 0 ? boost::lexical_cast<size_t>(args[0]) : 32;
+	const int	 repeats	= args.size() > 1 ? boost::lexical_cast<int>(args[1]) : 10;
+	const size_t size		= megabytes*1024*1024;
+
+	std::wcout << L"detected level: " << simd::get_level_name() << L", non-temporal threshold: " << simd::non_temporal_threshold()/1024 << L" KB" << std::endl;
+
+	// Equivalence of every level against the scalar kernels.
+
+	bool ok = true;
+
+	ok &= verify(L"copy", [](simd::level simd_level, uint8_t* dest, const uint8_t* source, size_t count, bool non_temporal)
+	{
+		simd::copy(simd_level, dest, source, count, non_temporal);
+	});
+
+	ok &= verify(L"clear", [](simd::level simd_level, uint8_t* dest, const uint8_t*, size_t count, bool non_temporal)
+	{
+		simd::clear(simd_level, dest, count, non_temporal);
+	});
+
+	for(size_t m = 0; m < sizeof(masks)/sizeof(masks[0]); ++m)
+	{
+		auto mask = masks[m];
+		ok &= verify(std::wstring(L"shuffle ") + mask.name, [=](simd::level simd_level, uint8_t* dest, const uint8_t* source, size_t count, bool non_temporal)
+		{
+			simd::shuffle(simd_level, dest, source, count, mask.m1, mask.m2, mask.m3, mask.m4, non_temporal);
+		});
+	}
+
+	if(!ok)
+		return 1;
+
+	// Throughput of every level on one thread, and of the parallel fast_* functions.
+
+	std::vector<uint8_t> source(size, 1);
+	std::vector<uint8_t> dest(size, 0);
+
+	std::wcout << std::endl << std::fixed << std::setprecision(2)
+			   << std::setw(22) << L"GB/s" << std::setw(10) << L"copy" << std::setw(10) << L"clear" << std::setw(10) << L"shuffle" << std::endl;
+
+	for(int simd_level = simd::scalar_level; simd_level <= simd::get_level(); ++simd_level)
+	{
+		for(int non_temporal = 0; non_temporal < 2; ++non_temporal)
+		{
+			auto l  = static_cast<simd::level>(simd_level);
+			auto nt = non_temporal != 0;
+
+			std::wcout << std::setw(8) << simd::get_level_name(l) << std::setw(14) << (nt ? L"non-temporal" : L"cached")
+					   << std::setw(10) << measure(size, repeats, [&]{simd::copy(l, dest.data(), source.data(), size, nt);})
+					   << std::setw(10) << measure(size, repeats, [&]{simd::clear(l, dest.data(), size, nt);})
+					   << std::setw(10) << measure(size, repeats, [&]{simd::shuffle(l, dest.data(), source.data(), size, masks[0].m1, masks[0].m2, masks[0].m3, masks[0].m4, nt);})
+					   << std::endl;
+		}
+	}
+
+	std::wcout << std::setw(22) << L"fast_*"
+			   << std::setw(10) << measure(size, repeats, [&]{fast_memcpy(dest.data(), source.data(), size);})
+			   << std::setw(10) << measure(size, repeats, [&]{fast_memclr(dest.data(), size);})
+			   << std::setw(10) << measure(size, repeats, [&]{fast_memshfl_key(dest.data(), source.data(), size);})
+			   << std::endl;
+
+	std::wcout << std::setw(22) << L"crt"
+			   << std::setw(10) << measure(size, repeats, [&]{memcpy(dest.data(), source.data(), size);})
+			   << std::setw(10) << measure(size, repeats, [&]{memset(dest.data(), 0, size);})
+			   << std::endl;
+
+	return 0;
+}
+
+}}
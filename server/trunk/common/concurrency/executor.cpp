@@ -0,0 +1,171 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../stdafx.h"
+
+#include "executor.h"
+
+#include <tbb/atomic.h>
+#include <tbb/concurrent_queue.h>
+
+#include <boost/thread.hpp>
+
+namespace caspar {
+
+namespace detail {
+
+__declspec(thread) bool g_pool_thread = false;
+
+// Shared worker threads which run executors as serial strands. Each scheduled strand runs a bounded 
+// batch of tasks and reschedules itself if more work is pending. Strands are kept in one FIFO per 
+// thread_priority, the highest non-empty one is served first.
+class executor_pool : boost::noncopyable
+{
+	const size_t								size_;
+	boost::thread_group							threads_;
+	tbb::concurrent_queue<executor*>			lanes_[below_normal_priority_class+1];
+	tbb::concurrent_bounded_queue<int>			signals_;
+
+	boost::mutex								blocking_mutex_;
+	size_t										blocked_;
+	size_t										spare_;
+public:
+	explicit executor_pool(size_t threads)
+		: size_(threads)
+		, blocked_(0)
+		, spare_(0)
+	{
+		for(size_t n = 0; n < threads; ++n)
+			threads_.create_thread([this]{run();});
+	}
+
+	size_t size() const
+	{
+		return size_;
+	}
+
+	// Keeps at least size_ workers runnable. Spare workers are kept for later blocking waits.
+	void begin_blocking()
+	{
+		boost::lock_guard<boost::mutex> lock(blocking_mutex_);
+		if(++blocked_ > spare_)
+		{
+			threads_.create_thread([this]{run();});
+			++spare_;
+			CASPAR_LOG(debug) << L"Executor pool grown to " << size_ + spare_ << L" threads.";
+		}
+	}
+
+	void end_blocking()
+	{
+		boost::lock_guard<boost::mutex> lock(blocking_mutex_);
+		--blocked_;
+	}
+
+	void schedule(executor* strand, int lane)
+	{
+		lanes_[lane].push(strand);
+		signals_.push(lane);
+	}
+
+private:
+	void run() // noexcept
+	{
+		win32_exception::install_handler();		
+		SetThreadName(GetCurrentThreadId(), "executor_pool");
+		g_pool_thread = true;
+
+		while(true)
+		{
+			int signal;
+			signals_.pop(signal);
+
+			for(int lane = 0; lane <= below_normal_priority_class; ++lane)
+			{
+				executor* strand = nullptr;
+				if(lanes_[lane].try_pop(strand))
+				{
+					strand->run_strand();
+					break;
+				}
+			}
+		}
+	}
+};
+
+tbb::atomic<executor_pool*>	g_pool;
+__declspec(thread) executor* g_current_executor = nullptr;
+
+executor_pool* get_executor_pool()
+{
+	return g_pool;
+}
+
+void schedule(executor_pool* pool, executor* strand, int lane)
+{
+	pool->schedule(strand, lane);
+}
+
+executor* current_executor()
+{
+	return g_current_executor;
+}
+
+void set_current_executor(executor* strand)
+{
+	g_current_executor = strand;
+}
+
+}
+
+void set_executor_pool_size(size_t threads)
+{
+	if(threads == 0)
+		return;
+
+	if(detail::g_pool)
+		BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("executor pool already created."));
+
+	// The pool lives for the duration of the process since strands might still be scheduled during shutdown.
+	detail::g_pool = new detail::executor_pool(threads);
+
+	CASPAR_LOG(info) << L"Executors running on a shared pool of " << threads << L" threads.";
+}
+
+size_t executor_pool_size()
+{
+	return detail::g_pool ? detail::g_pool->size() : 0;
+}
+
+blocking_scope::blocking_scope()
+	: pool_(detail::g_pool_thread ? static_cast<detail::executor_pool*>(detail::g_pool) : nullptr)
+{
+	if(pool_)
+		pool_->begin_blocking();
+}
+
+blocking_scope::~blocking_scope()
+{
+	if(pool_)
+		pool_->end_blocking();
+}
+
+}
@@ -35,9 +35,13 @@
 #include <boost/noncopyable.hpp>
 
 #include <functional>
+#include <new>
+#include <type_traits>
 
 namespace caspar {
 
+class executor;
+
 namespace detail {
 
 typedef struct tagTHREADNAME_INFO
@@ -64,8 +68,144 @@ inline void SetThreadName(DWORD dwThreadID, LPCSTR szThreadName)
 	__except (EXCEPTION_CONTINUE_EXECUTION){}	
 }
 
+// Type erased void() functor which stores small functors inline instead of on the heap.
+// tbb::concurrent_bounded_queue only copies its elements, so copying a task transfers ownership (see move_on_copy).
+class task
+{
+	union storage
+	{
+		void*		ptr;
+		double		align;
+		char		data[64];
+	};
+
+	struct vtable
+	{
+		void (*invoke)(storage&);
+		void (*move)(storage& dest, storage& source);
+		void (*destroy)(storage&);
+	};
+
+	template<typename F>
+	struct inline_vtable
+	{
+		static void invoke(storage& s)					{(*reinterpret_cast<F*>(s.data))();}
+		static void move(storage& dest, storage& source){new(dest.data) F(std::move(*reinterpret_cast<F*>(source.data))); destroy(source);}
+		static void destroy(storage& s)					{reinterpret_cast<F*>(s.data)->~F();}
+		static const vtable* get()						{static const vtable table = {invoke, move, destroy}; return &table;}
+	};
+
+	template<typename F>
+	struct heap_vtable
+	{
+		static void invoke(storage& s)					{(*static_cast<F*>(s.ptr))();}
+		static void move(storage& dest, storage& source){dest.ptr = source.ptr;}
+		static void destroy(storage& s)					{delete static_cast<F*>(s.ptr);}
+		static const vtable* get()						{static const vtable table = {invoke, move, destroy}; return &table;}
+	};
+
+	mutable const vtable*	vtable_;
+	mutable storage			storage_;
+public:
+	task() 
+		: vtable_(nullptr)
+	{
+	}
+
+	template<typename Func>
+	task(Func&& func, typename std::enable_if<!std::is_same<typename std::decay<Func>::type, task>::value>::type* = nullptr)
+		: vtable_(nullptr)
+	{
+		typedef typename std::decay<Func>::type func_type;
+
+		if(sizeof(func_type) <= sizeof(storage_.data) && std::alignment_of<func_type>::value <= std::alignment_of<storage>::value)
+		{
+			new(storage_.data) func_type(std::forward<Func>(func));
+			vtable_ = inline_vtable<func_type>::get();
+		}
+		else
+		{
+			storage_.ptr = new func_type(std::forward<Func>(func));
+			vtable_ = heap_vtable<func_type>::get();
+		}
+	}
+
+	task(const task& other) 
+		: vtable_(nullptr)
+	{
+		other.move_to(*this);
+	}
+
+	task& operator=(const task& other)
+	{
+		if(this != &other)
+		{
+			reset();
+			other.move_to(*this);
+		}
+		return *this;
+	}
+
+	~task()
+	{
+		reset();
+	}
+
+	void operator()()
+	{
+		vtable_->invoke(storage_);
+	}
+
+	bool empty() const
+	{
+		return vtable_ == nullptr;
+	}
+
+	void reset()
+	{
+		if(vtable_)
+			vtable_->destroy(storage_);
+		vtable_ = nullptr;
+	}
+private:
+	void move_to(const task& dest) const
+	{
+		if(!vtable_)
+			return;
+
+		vtable_->move(dest.storage_, storage_);
+		dest.vtable_ = vtable_;
+		vtable_		 = nullptr;
+	}
+};
+
+class executor_pool;
+
+executor_pool*	get_executor_pool();
+void			schedule(executor_pool* pool, executor* strand, int lane);
+executor*		current_executor();
+void			set_current_executor(executor* strand);
+
 }
 
+// Wrap every wait on other threads, e.g. futures, condition variables and full queues, which can happen inside 
+// an executor task. On a pool thread the pool lends an extra worker for the duration of the wait, so that 
+// blocked strands can not starve the pool. Elsewhere it does nothing.
+class blocking_scope : boost::noncopyable
+{
+	detail::executor_pool* pool_;
+public:
+	blocking_scope();
+	~blocking_scope();
+};
+
+// Runs executors created after this call as serial strands on a shared pool of "threads" workers
+// instead of on one dedicated thread each. 0 (the default) keeps dedicated threads.
+void set_executor_pool_size(size_t threads);
+
+// Number of shared pool threads, 0 when executors run on dedicated threads.
+size_t executor_pool_size();
+
 enum task_priority
 {
 	high_priority,
@@ -81,13 +221,27 @@ enum thread_priority
 	below_normal_priority_class
 };
 
+enum thread_affinity
+{
+	any_thread,
+	dedicated_thread	// Required by executors which use thread affine resources, e.g. OpenGL contexts and COM apartments.
+};
+
 class executor : boost::noncopyable
 {
+	friend class detail::executor_pool;
+
 	const std::string name_;
 	boost::thread thread_;
 	tbb::atomic<bool> is_running_;
+
+	detail::executor_pool* const pool_;
+	tbb::atomic<int> pending_;
+	tbb::atomic<int> lane_;
+	boost::mutex pending_mutex_;
+	boost::condition_variable pending_cond_;
 	
-	typedef tbb::concurrent_bounded_queue<std::function<void()>> function_queue;
+	typedef tbb::concurrent_bounded_queue<detail::task> function_queue;
 	function_queue execution_queue_[priority_count];
 		
 	template<typename Func>
@@ -101,7 +255,7 @@ class executor : boost::noncopyable
 		{
 			try
 			{
-				if(boost::this_thread::get_id() == thread_.get_id())  // Avoids potential deadlock.
+				if(is_current())  // Avoids potential deadlock.
 					my_task();
 			}
 			catch(boost::task_already_started&){}
@@ -112,10 +266,15 @@ class executor : boost::noncopyable
 
 public:
 		
-	explicit executor(const std::wstring& name) : name_(narrow(name)) // noexcept
+	explicit executor(const std::wstring& name, thread_affinity affinity = any_thread) // noexcept
+		: name_(narrow(name))
+		, pool_(affinity == any_thread ? detail::get_executor_pool() : nullptr)
 	{
 		is_running_ = true;
-		thread_ = boost::thread([this]{run();});
+		pending_	= 0;
+		lane_		= normal_priority_class;
+		if(!pool_)
+			thread_ = boost::thread([this]{run();});
 	}
 	
 	virtual ~executor() // noexcept
@@ -131,6 +290,12 @@ public:
 
 	void set_priority_class(thread_priority p)
 	{
+		if(pool_)
+		{
+			lane_ = p;
+			return;
+		}
+
 		begin_invoke([=]
 		{
 			if(p == high_priority_class)
@@ -146,7 +311,7 @@ public:
 	
 	void clear()
 	{		
-		std::function<void()> func;
+		detail::task func;
 		while(execution_queue_[normal_priority].try_pop(func));
 		while(execution_queue_[high_priority].try_pop(func));
 	}
@@ -154,7 +319,8 @@ public:
 	void stop() // noexcept
 	{
 		is_running_ = false;	
-		execution_queue_[normal_priority].try_push([]{}); // Wake the execution thread.
+		if(execution_queue_[normal_priority].try_push(detail::task())) // Wake the execution thread.
+			notify();
 	}
 
 	void wait() // noexcept
@@ -164,7 +330,16 @@ public:
 
 	void join()
 	{
-		if(boost::this_thread::get_id() != thread_.get_id())
+		if(is_current())
+			return;
+
+		if(pool_)
+		{
+			boost::unique_lock<boost::mutex> lock(pending_mutex_);
+			while(pending_ > 0)
+				pending_cond_.wait(lock);
+		}
+		else
 			thread_.join();
 	}
 
@@ -210,12 +385,13 @@ public:
 
 		if (priority != normal_priority)
 		{
-			was_enqueued = execution_queue_[normal_priority].try_push(nullptr);
+			was_enqueued = execution_queue_[normal_priority].try_push(detail::task());
 
 			if (was_enqueued)
 			{
 				// Now we know that both enqueue operations has succeeded.
 				cancelled_promise.set_value(false);
+				notify();
 			}
 			else
 			{
@@ -228,11 +404,14 @@ public:
 		else
 		{
 			cancelled_promise.set_value(false);
+			notify();
 		}
 
 		return caspar::make_move_on_copy(std::move(future));
 	}
 				
+	// The packaged_task's shared state is allocated by boost for every call, boost 1.47 futures take no allocator 
+	// and can therefore not be pooled. Use post() where no result is needed.
 	template<typename Func>
 	auto begin_invoke(Func&& func, task_priority priority = normal_priority) -> boost::unique_future<decltype(func())> // noexcept
 	{	
@@ -244,7 +423,7 @@ public:
 
 		auto future = task_adaptor.value.get_future();
 
-		execution_queue_[priority].push([=]
+		push(priority, detail::task([=]
 		{
 			try
 			{
@@ -257,32 +436,64 @@ public:
 			{
 				CASPAR_LOG_CURRENT_EXCEPTION();
 			}
-		});
+		}));
 
 		if(priority != normal_priority)
-			execution_queue_[normal_priority].push(nullptr);
+			push(normal_priority, detail::task());
+
+		notify();
 					
 		return std::move(future);		
 	}
+
+	// Fire and forget version of begin_invoke, no packaged_task or future is created.
+	template<typename Func>
+	void post(Func&& func, task_priority priority = normal_priority) // noexcept
+	{	
+		if(!is_running_)
+			BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("executor not running."));
+
+		auto func2 = std::forward<Func>(func);
+
+		push(priority, detail::task([=]() mutable
+		{
+			try
+			{
+				func2();
+			}
+			catch(...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+			}
+		}));
+
+		if(priority != normal_priority)
+			push(normal_priority, detail::task());
+
+		notify();
+	}
 	
 	template<typename Func>
 	auto invoke(Func&& func, task_priority prioriy = normal_priority) -> decltype(func()) // noexcept
 	{
-		if(boost::this_thread::get_id() == thread_.get_id())  // Avoids potential deadlock.
+		if(is_current())  // Avoids potential deadlock.
 			return func();
 		
-		return begin_invoke(std::forward<Func>(func), prioriy).get();
+		auto future = begin_invoke(std::forward<Func>(func), prioriy);
+
+		blocking_scope blocking;
+		return future.get();
 	}
 	
 	void yield() // noexcept
 	{
-		if(boost::this_thread::get_id() != thread_.get_id())  // Only yield when calling from execution thread.
+		if(!is_current())  // Only yield when calling from execution thread.
 			return;
 
-		std::function<void()> func;
+		detail::task func;
 		while(execution_queue_[high_priority].try_pop(func))
 		{
-			if(func)
+			if(!func.empty())
 				func();
 		}	
 	}
@@ -291,17 +502,84 @@ public:
 	function_queue::size_type size() const /*noexcept*/ { return execution_queue_[normal_priority].size();	}
 	bool empty() const /*noexcept*/	{ return execution_queue_[normal_priority].empty();	}
 	bool is_running() const /*noexcept*/ { return is_running_; }	
+	bool is_current() const /*noexcept*/ { return detail::current_executor() == this; }
 		
 private:
+
+	void push(task_priority priority, const detail::task& task) // noexcept
+	{
+		if(execution_queue_[priority].try_push(task)) // Copying a task transfers it, a failed try_push leaves it here.
+			return;
+
+		blocking_scope blocking; // Bounded by set_capacity and full.
+		execution_queue_[priority].push(task);
+	}
+
+	void notify() // noexcept
+	{
+		// Every task in the normal queue is counted, the first one schedules the strand on the pool.
+		if(pool_ && ++pending_ == 1)
+			detail::schedule(pool_, this, lane_);
+	}
+
+	bool release_pending() // noexcept
+	{
+		// Only the last task takes the lock, join() must not observe zero before the waiters are notified.
+		for(int pending = pending_; pending > 1; pending = pending_)
+		{
+			if(pending_.compare_and_swap(pending - 1, pending) == pending)
+				return false;
+		}
+
+		boost::lock_guard<boost::mutex> lock(pending_mutex_);
+		if(--pending_ > 0)
+			return false;
+
+		pending_cond_.notify_all();
+		return true;
+	}
+
+	void run_strand() // noexcept
+	{
+		auto parent = detail::current_executor();
+		detail::set_current_executor(this);
+
+		for(int n = 0; n < 32; ++n) // Yield the pool thread to other strands after a while.
+		{
+			try
+			{
+				detail::task func;
+				execution_queue_[normal_priority].try_pop(func);
+
+				yield();
+
+				if(is_running_ && !func.empty())
+					func();
+			}
+			catch(...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+			}
+
+			if(release_pending()) // The executor might be destroyed as soon as pending_ reaches zero.
+			{
+				detail::set_current_executor(parent);
+				return;
+			}
+		}
+
+		detail::set_current_executor(parent);
+		detail::schedule(pool_, this, lane_);
+	}
 	
 	void execute() // noexcept
 	{
-		std::function<void()> func;
+		detail::task func;
 		execution_queue_[normal_priority].pop(func);	
 
 		yield();
 
-		if(func)
+		if(!func.empty())
 			func();
 	}
 
@@ -309,6 +587,7 @@ private:
 	{
 		win32_exception::install_handler();		
 		detail::SetThreadName(GetCurrentThreadId(), name_.c_str());
+		detail::set_current_executor(this);
 		while(is_running_)
 		{
 			try
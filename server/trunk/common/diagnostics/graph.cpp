@@ -28,6 +28,7 @@
 #include "../concurrency/executor.h"
 #include "../concurrency/lock.h"
 #include "../env.h"
+#include "../utility/string.h"
 
 #include <SFML/Graphics.hpp>
 
@@ -35,14 +36,18 @@
 #include <boost/optional.hpp>
 #include <boost/circular_buffer.hpp>
 #include <boost/range/algorithm_ext/erase.hpp>
+#include <boost/property_tree/ptree.hpp>
 
 #include <tbb/concurrent_unordered_map.h>
 #include <tbb/atomic.h>
 #include <tbb/spin_mutex.h>
 
+#include <algorithm>
 #include <array>
+#include <map>
 #include <numeric>
 #include <tuple>
+#include <vector>
 
 namespace caspar { namespace diagnostics {
 		
@@ -101,7 +106,7 @@ public:
 	}
 				
 private:
-	context() : executor_(L"diagnostics")
+	context() : executor_(L"diagnostics", dedicated_thread)
 	{
 		executor_.set_priority_class(below_normal_priority_class);
 	}
@@ -190,6 +195,29 @@ private:
 	}
 };
 
+class history
+{
+	tbb::spin_mutex					mutex_;
+	boost::circular_buffer<double>	values_;
+public:
+	history(size_t capacity = 1024)
+		: values_(capacity)
+	{
+	}
+
+	void push(double value)
+	{
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		values_.push_back(value);
+	}
+
+	std::vector<double> values()
+	{
+		tbb::spin_mutex::scoped_lock lock(mutex_);
+		return std::vector<double>(values_.begin(), values_.end());
+	}
+};
+
 class line : public drawable
 {
 	boost::circular_buffer<std::pair<float, bool>> line_data_;
@@ -264,6 +292,9 @@ struct graph::impl : public drawable
 {
 	tbb::concurrent_unordered_map<std::string, diagnostics::line> lines_;
 
+	tbb::spin_mutex										samples_mutex_;
+	std::map<std::string, std::shared_ptr<history>>		samples_;
+
 	tbb::spin_mutex mutex_;
 	std::wstring text_;
 
@@ -294,6 +325,51 @@ struct graph::impl : public drawable
 	{
 		lines_[name].set_color(color);
 	}
+
+	void add_sample(const std::string& name, double milliseconds)
+	{
+		std::shared_ptr<history> samples;
+		lock(samples_mutex_, [&]
+		{
+			auto& entry = samples_[name];
+			if(!entry)
+				entry.reset(new history());
+			samples = entry;
+		});
+		samples->push(milliseconds);
+	}
+
+	boost::property_tree::wptree statistics()
+	{
+		std::map<std::string, std::shared_ptr<history>> samples;
+		lock(samples_mutex_, [&]
+		{
+			samples = samples_;
+		});
+
+		boost::property_tree::wptree info;
+		for(auto it = samples.begin(); it != samples.end(); ++it)
+		{
+			auto values = it->second->values();
+			if(values.empty())
+				continue;
+
+			std::sort(values.begin(), values.end());
+
+			auto percentile = [&](double p)
+			{
+				return values[std::min(values.size()-1, static_cast<size_t>(p*static_cast<double>(values.size())))];
+			};
+
+			boost::property_tree::wptree line_info;
+			line_info.add(L"p50",		percentile(0.50));
+			line_info.add(L"p99",		percentile(0.99));
+			line_info.add(L"max",		values.back());
+			line_info.add(L"samples",	values.size());
+			info.add_child(widen(it->first), line_info);
+		}
+		return info;
+	}
 		
 private:
 	void render(sf::RenderTarget& target)
@@ -379,6 +455,8 @@ void graph::set_text(const std::wstring& value){impl_->set_text(value);}
 void graph::set_value(const std::string& name, double value){impl_->set_value(name, value);}
 void graph::set_color(const std::string& name, int color){impl_->set_color(name, color);}
 void graph::set_tag(const std::string& name){impl_->set_tag(name);}
+void graph::add_sample(const std::string& name, double milliseconds){impl_->add_sample(name, milliseconds);}
+boost::property_tree::wptree graph::statistics() const{return impl_->statistics();}
 
 void register_graph(const safe_ptr<graph>& graph)
 {
@@ -23,6 +23,8 @@
 
 #include "../memory/safe_ptr.h"
 
+#include <boost/property_tree/ptree_fwd.hpp>
+
 #include <string>
 #include <tuple>
 
@@ -40,6 +42,12 @@ public:
 	void set_value(const std::string& name, double value);
 	void set_color(const std::string& name, int color);
 	void set_tag(const std::string& name);
+
+	// Raw durations for statistics(), kept apart from the frame normalised values drawn by set_value.
+	void add_sample(const std::string& name, double milliseconds);
+
+	// p50/p99/max in milliseconds over the most recent 1024 samples of every name passed to add_sample.
+	boost::property_tree::wptree statistics() const;
 private:
 	struct impl;
 	std::shared_ptr<impl> impl_;
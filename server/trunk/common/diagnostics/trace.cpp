@@ -0,0 +1,213 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "../stdafx.h"
+
+#include "trace.h"
+
+#include "../exception/exceptions.h"
+
+#include <boost/foreach.hpp>
+
+#include <tbb/atomic.h>
+#include <tbb/tbb_machine.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace caspar { namespace diagnostics {
+
+struct trace_event
+{
+	char		name[48];
+	int64_t		id;
+	int64_t		begin;
+	int64_t		end;
+	uint32_t	thread_id;
+};
+
+// Writers claim slots with a single atomic increment and publish them through a per slot sequence (a seqlock), 
+// so neither writers nor an export ever wait on each other. The sequence is odd while the event is being 
+// written. An export copies the event and discards it if the sequence changed in the meantime. A writer which 
+// finds its slot busy or already taken by a writer that lapped the buffer drops its event.
+class trace_buffer
+{
+	enum { capacity = 1 << 16 };
+
+	struct slot
+	{
+		tbb::atomic<uint64_t>	sequence; // 0 while empty, 2*index+1 while writing, 2*index+2 when published.
+		trace_event				event;
+	};
+
+	std::vector<slot>		slots_;
+	tbb::atomic<uint64_t>	write_index_;
+public:
+	trace_buffer()
+		: slots_(capacity)
+	{
+		write_index_ = 0;
+		BOOST_FOREACH(auto& slot, slots_)
+			slot.sequence = 0;
+	}
+
+	void push(const trace_event& event)
+	{
+		auto index = write_index_.fetch_and_increment();
+		auto& slot = slots_[index & (capacity-1)];
+
+		const uint64_t previous = slot.sequence;
+		if(previous % 2 == 1 || previous > 2*index)
+			return;
+
+		if(slot.sequence.compare_and_swap(2*index+1, previous) != previous)
+			return;
+
+		slot.event		= event;
+		slot.sequence	= 2*index+2; // Release, publishes the event.
+	}
+
+	std::vector<trace_event> events() const
+	{
+		std::vector<trace_event> result;
+		result.reserve(capacity);
+
+		BOOST_FOREACH(auto& slot, slots_)
+		{
+			const uint64_t before = slot.sequence; // Acquire.
+			if(before == 0 || before % 2 == 1)
+				continue;
+
+			const trace_event event = slot.event;
+
+			tbb::atomic_fence(); // The copy above must complete before the sequence is read again.
+			if(slot.sequence == before)
+				result.push_back(event);
+		}
+
+		std::sort(result.begin(), result.end(), [](const trace_event& lhs, const trace_event& rhs)
+		{
+			return lhs.begin < rhs.begin;
+		});
+
+		return result;
+	}
+
+	static trace_buffer& get_instance()
+	{
+		static trace_buffer instance;
+		return instance;
+	}
+};
+
+int64_t trace_now()
+{
+	static const int64_t frequency = []() -> int64_t
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return frequency.QuadPart;
+	}();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (counter.QuadPart / frequency) * 1000000 + ((counter.QuadPart % frequency) * 1000000) / frequency;
+}
+
+int64_t next_trace_id()
+{
+	static tbb::atomic<int64_t> id;
+	return ++id;
+}
+
+void trace(const std::string& name, int64_t id, int64_t begin, int64_t end)
+{
+	trace_event event;
+	auto length = std::min(name.size(), sizeof(event.name)-1);
+	std::copy(name.begin(), name.begin() + length, event.name);
+	event.name[length]	= 0;
+	event.id			= id;
+	event.begin			= begin;
+	event.end			= end;
+	event.thread_id		= GetCurrentThreadId();
+
+	trace_buffer::get_instance().push(event);
+}
+
+std::shared_ptr<void> make_trace_ticket(int64_t id, const std::function<void()>& on_release)
+{
+	return std::shared_ptr<void>(new int64_t(id), [=](int64_t* p)
+	{
+		delete p;
+		if(on_release)
+			on_release();
+	});
+}
+
+int64_t get_trace_id(const std::shared_ptr<void>& ticket)
+{
+	return ticket ? *static_cast<const int64_t*>(ticket.get()) : 0;
+}
+
+std::string trace_json()
+{
+	auto events = trace_buffer::get_instance().events();
+
+	std::stringstream str;
+	str << "{\"traceEvents\":[";
+	for(size_t n = 0; n < events.size(); ++n)
+	{
+		auto& event = events[n];
+
+		std::string name;
+		for(auto it = event.name; *it != 0; ++it)
+		{
+			if(*it == '"' || *it == '\\')
+				name += '\\';
+			name += *it;
+		}
+
+		str << (n > 0 ? "," : "") << "\n"
+			<< "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":0"
+			<< ",\"tid\":" << event.thread_id 
+			<< ",\"ts\":" << event.begin 
+			<< ",\"dur\":" << std::max<int64_t>(0, event.end - event.begin)
+			<< ",\"args\":{\"frame\":" << event.id << "}}";
+	}
+	str << "\n]}";
+
+	return str.str();
+}
+
+void write_trace(const std::wstring& filename)
+{
+	std::ofstream file(filename.c_str(), std::ios::out | std::ios::trunc);
+	if(!file)
+		BOOST_THROW_EXCEPTION(io_error() << msg_info("Could not open trace file."));
+
+	file << trace_json();
+}
+
+}}
\ No newline at end of file
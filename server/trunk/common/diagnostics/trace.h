@@ -0,0 +1,47 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace caspar { namespace diagnostics {
+
+// Per frame latency tracing. Events are recorded into a fixed size lock-free ring buffer, 
+// the most recent events can be written as Chrome trace-event JSON (chrome://tracing).
+
+int64_t trace_now(); // Monotonic, microseconds.
+int64_t next_trace_id();
+
+void trace(const std::string& name, int64_t id, int64_t begin, int64_t end); // nothrow
+
+// Frame packets carry their trace id in the pipeline ticket, on_release is invoked when the last copy is released.
+std::shared_ptr<void> make_trace_ticket(int64_t id, const std::function<void()>& on_release);
+int64_t get_trace_id(const std::shared_ptr<void>& ticket); // 0 for null tickets.
+
+std::string trace_json();
+void write_trace(const std::wstring& filename);
+
+}}
\ No newline at end of file
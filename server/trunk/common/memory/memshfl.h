@@ -21,53 +21,34 @@
 
 #pragma once
 
-#include <intrin.h>
-
-#include <assert.h>
-
-#include <tbb/parallel_for.h>
+#include "memcpy.h"
+#include "simd.h"
 
 namespace caspar {
 
-namespace internal {
-
+// Shuffles the bytes of every 16 byte block with a pshufb style mask, see simd::shuffle. Any size is handled.
 static void* fast_memshfl(void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4)
-{
-	__m128i*	   dest128 = reinterpret_cast<__m128i*>(dest);	
-	const __m128i* source128 = reinterpret_cast<const __m128i*>(source);
-
-	count /= 16; // 128 bit
-
-	__m128i xmm0, xmm1, xmm2, xmm3;
+{   
+	const bool non_temporal = count >= simd::non_temporal_threshold();
 
-	const __m128i mask128 = _mm_set_epi32(m1, m2, m3, m4);
-	for(size_t n = 0; n < count/4; ++n)
+	detail::parallel_chunks(count, [&](size_t offset, size_t size)
 	{
-		xmm0 = _mm_load_si128(source128++);	
-		xmm1 = _mm_load_si128(source128++);	
-		xmm2 = _mm_load_si128(source128++);	
-		xmm3 = _mm_load_si128(source128++);	
+		simd::shuffle(reinterpret_cast<char*>(dest) + offset, reinterpret_cast<const char*>(source) + offset, size, m1, m2, m3, m4, non_temporal);
+	});
 
-		_mm_stream_si128(dest128++, _mm_shuffle_epi8(xmm0, mask128));
-		_mm_stream_si128(dest128++, _mm_shuffle_epi8(xmm1, mask128));
-		_mm_stream_si128(dest128++, _mm_shuffle_epi8(xmm2, mask128));
-		_mm_stream_si128(dest128++, _mm_shuffle_epi8(xmm3, mask128));
-	}
 	return dest;
 }
 
+// Replaces every bgra pixel with its alpha, i.e. a key signal.
+static void* fast_memshfl_key(void* dest, const void* source, size_t count)
+{
+	return fast_memshfl(dest, source, count, 0x0F0F0F0F, 0x0B0B0B0B, 0x07070707, 0x03030303);
 }
 
-static void* fast_memshfl(void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4)
-{   
-	tbb::affinity_partitioner ap;
-	tbb::parallel_for(tbb::blocked_range<size_t>(0, count/128), [&](const tbb::blocked_range<size_t>& r)
-	{       
-		internal::fast_memshfl(reinterpret_cast<char*>(dest) + r.begin()*128, reinterpret_cast<const char*>(source) + r.begin()*128, r.size()*128, m1, m2, m3, m4);   
-	}, ap);
-
-	return dest;
+// Swaps the first and third byte of every pixel, i.e. bgra <-> rgba.
+static void* fast_memshfl_swap_rb(void* dest, const void* source, size_t count)
+{
+	return fast_memshfl(dest, source, count, 0x0F0C0D0E, 0x0B08090A, 0x07040506, 0x03000102);
 }
 
-
 }
\ No newline at end of file
@@ -0,0 +1,474 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../stdafx.h"
+
+#include "simd.h"
+
+#include "../log/log.h"
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+
+#include <windows.h>
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#include <tbb/atomic.h>
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace caspar { namespace simd {
+
+namespace {
+
+level detect_level()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 1)
+		return scalar_level;
+
+	__cpuid(info, 1);
+	const bool sse2		= (info[3] & (1 << 26)) != 0;
+	const bool ssse3	= (info[2] & (1 << 9))  != 0;
+	const bool osxsave	= (info[2] & (1 << 27)) != 0;
+	const bool avx		= (info[2] & (1 << 28)) != 0 && osxsave && (_xgetbv(0) & 6) == 6; // The os must also save the ymm registers.
+
+	if(avx && ssse3)
+		return avx_level;
+	if(ssse3)
+		return ssse3_level;
+	if(sse2)
+		return sse2_level;
+	return scalar_level;
+}
+
+size_t detect_cache_size()
+{
+	size_t result = 0;
+
+	DWORD size = 0;
+	::GetLogicalProcessorInformation(nullptr, &size);
+
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> infos(size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if(!infos.empty() && ::GetLogicalProcessorInformation(infos.data(), &size))
+	{
+		BOOST_FOREACH(auto& info, infos)
+		{
+			if(info.Relationship == RelationCache)
+				result = std::max<size_t>(result, info.Cache.Size);
+		}
+	}
+
+	return result > 0 ? result : 2*1024*1024;
+}
+
+size_t align_head(const void* ptr, size_t alignment, size_t count)
+{
+	return std::min(count, (alignment - (reinterpret_cast<uintptr_t>(ptr) & (alignment-1))) & (alignment-1));
+}
+
+void get_mask(uint8_t* mask, int m1, int m2, int m3, int m4)
+{
+	const int m[] = {m4, m3, m2, m1};
+	for(int n = 0; n < 16; ++n)
+		mask[n] = static_cast<uint8_t>(m[n/4] >> ((n%4)*8));
+}
+
+// Same semantics as pshufb for the last count % 16 bytes, only the bytes that exist are read and written.
+void shuffle_tail(uint8_t* dest, const uint8_t* source, size_t count, const uint8_t* mask)
+{
+	uint8_t block[16] = {0};
+	memcpy(block, source, count);
+	for(size_t n = 0; n < count; ++n)
+		dest[n] = mask[n] & 0x80 ? 0 : block[mask[n] & 0x0F];
+}
+
+// scalar
+
+void copy_scalar(void* dest, const void* source, size_t count, bool)
+{
+	memcpy(dest, source, count);
+}
+
+void clear_scalar(void* dest, size_t count, bool)
+{
+	memset(dest, 0, count);
+}
+
+void shuffle_scalar(void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4, bool)
+{
+	auto dest8	 = static_cast<uint8_t*>(dest);
+	auto source8 = static_cast<const uint8_t*>(source);
+
+	uint8_t mask[16];
+	get_mask(mask, m1, m2, m3, m4);
+
+	for(size_t n = 0; n < count; n += 16)
+		shuffle_tail(dest8 + n, source8 + n, std::min<size_t>(16, count - n), mask);
+}
+
+// sse2
+
+void copy_sse2(void* dest, const void* source, size_t count, bool non_temporal)
+{
+	auto dest8	 = static_cast<uint8_t*>(dest);
+	auto source8 = static_cast<const uint8_t*>(source);
+
+	const size_t head = align_head(dest8, 16, count);
+	memcpy(dest8, source8, head);
+	dest8	+= head;
+	source8 += head;
+	count	-= head;
+
+	auto dest128	= reinterpret_cast<__m128i*>(dest8);
+	auto source128	= reinterpret_cast<const __m128i*>(source8);
+
+	const size_t blocks = count / 64;
+	if(non_temporal)
+	{
+		for(size_t n = 0; n < blocks; ++n, dest128 += 4, source128 += 4)
+		{
+			__m128i xmm0 = _mm_loadu_si128(source128+0);
+			__m128i xmm1 = _mm_loadu_si128(source128+1);
+			__m128i xmm2 = _mm_loadu_si128(source128+2);
+			__m128i xmm3 = _mm_loadu_si128(source128+3);
+			_mm_stream_si128(dest128+0, xmm0);
+			_mm_stream_si128(dest128+1, xmm1);
+			_mm_stream_si128(dest128+2, xmm2);
+			_mm_stream_si128(dest128+3, xmm3);
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for(size_t n = 0; n < blocks; ++n, dest128 += 4, source128 += 4)
+		{
+			__m128i xmm0 = _mm_loadu_si128(source128+0);
+			__m128i xmm1 = _mm_loadu_si128(source128+1);
+			__m128i xmm2 = _mm_loadu_si128(source128+2);
+			__m128i xmm3 = _mm_loadu_si128(source128+3);
+			_mm_store_si128(dest128+0, xmm0);
+			_mm_store_si128(dest128+1, xmm1);
+			_mm_store_si128(dest128+2, xmm2);
+			_mm_store_si128(dest128+3, xmm3);
+		}
+	}
+
+	memcpy(dest128, source128, count % 64);
+}
+
+void clear_sse2(void* dest, size_t count, bool non_temporal)
+{
+	auto dest8 = static_cast<uint8_t*>(dest);
+
+	const size_t head = align_head(dest8, 16, count);
+	memset(dest8, 0, head);
+	dest8 += head;
+	count -= head;
+
+	auto dest128 = reinterpret_cast<__m128i*>(dest8);
+
+	const __m128i zero = _mm_setzero_si128();
+	const size_t blocks = count / 64;
+	if(non_temporal)
+	{
+		for(size_t n = 0; n < blocks; ++n, dest128 += 4)
+		{
+			_mm_stream_si128(dest128+0, zero);
+			_mm_stream_si128(dest128+1, zero);
+			_mm_stream_si128(dest128+2, zero);
+			_mm_stream_si128(dest128+3, zero);
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for(size_t n = 0; n < blocks; ++n, dest128 += 4)
+		{
+			_mm_store_si128(dest128+0, zero);
+			_mm_store_si128(dest128+1, zero);
+			_mm_store_si128(dest128+2, zero);
+			_mm_store_si128(dest128+3, zero);
+		}
+	}
+
+	memset(dest128, 0, count % 64);
+}
+
+// ssse3
+
+void shuffle_ssse3(void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4, bool non_temporal)
+{
+	auto dest128	= static_cast<__m128i*>(dest);
+	auto source128	= static_cast<const __m128i*>(source);
+
+	// The mask works on 16 byte blocks counted from the start of source, so dest can't be aligned by splitting off a head.
+	const __m128i mask128 = _mm_set_epi32(m1, m2, m3, m4);
+
+	non_temporal = non_temporal && reinterpret_cast<uintptr_t>(dest) % 16 == 0;
+
+	const size_t blocks = count / 64;
+	for(size_t n = 0; n < blocks; ++n, dest128 += 4, source128 += 4)
+	{
+		__m128i xmm0 = _mm_shuffle_epi8(_mm_loadu_si128(source128+0), mask128);
+		__m128i xmm1 = _mm_shuffle_epi8(_mm_loadu_si128(source128+1), mask128);
+		__m128i xmm2 = _mm_shuffle_epi8(_mm_loadu_si128(source128+2), mask128);
+		__m128i xmm3 = _mm_shuffle_epi8(_mm_loadu_si128(source128+3), mask128);
+
+		if(non_temporal)
+		{
+			_mm_stream_si128(dest128+0, xmm0);
+			_mm_stream_si128(dest128+1, xmm1);
+			_mm_stream_si128(dest128+2, xmm2);
+			_mm_stream_si128(dest128+3, xmm3);
+		}
+		else
+		{
+			_mm_storeu_si128(dest128+0, xmm0);
+			_mm_storeu_si128(dest128+1, xmm1);
+			_mm_storeu_si128(dest128+2, xmm2);
+			_mm_storeu_si128(dest128+3, xmm3);
+		}
+	}
+	
+	if(non_temporal)
+		_mm_sfence();
+
+	for(count %= 64; count >= 16; count -= 16)
+		_mm_storeu_si128(dest128++, _mm_shuffle_epi8(_mm_loadu_si128(source128++), mask128));
+
+	if(count > 0)
+	{
+		uint8_t mask[16];
+		get_mask(mask, m1, m2, m3, m4);
+		shuffle_tail(reinterpret_cast<uint8_t*>(dest128), reinterpret_cast<const uint8_t*>(source128), count, mask);
+	}
+}
+
+// avx
+
+void copy_avx(void* dest, const void* source, size_t count, bool non_temporal)
+{
+	auto dest8	 = static_cast<uint8_t*>(dest);
+	auto source8 = static_cast<const uint8_t*>(source);
+
+	const size_t head = align_head(dest8, 32, count);
+	memcpy(dest8, source8, head);
+	dest8	+= head;
+	source8 += head;
+	count	-= head;
+
+	auto dest256	= reinterpret_cast<__m256i*>(dest8);
+	auto source256	= reinterpret_cast<const __m256i*>(source8);
+
+	const size_t blocks = count / 128;
+	if(non_temporal)
+	{
+		for(size_t n = 0; n < blocks; ++n, dest256 += 4, source256 += 4)
+		{
+			__m256i ymm0 = _mm256_loadu_si256(source256+0);
+			__m256i ymm1 = _mm256_loadu_si256(source256+1);
+			__m256i ymm2 = _mm256_loadu_si256(source256+2);
+			__m256i ymm3 = _mm256_loadu_si256(source256+3);
+			_mm256_stream_si256(dest256+0, ymm0);
+			_mm256_stream_si256(dest256+1, ymm1);
+			_mm256_stream_si256(dest256+2, ymm2);
+			_mm256_stream_si256(dest256+3, ymm3);
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for(size_t n = 0; n < blocks; ++n, dest256 += 4, source256 += 4)
+		{
+			__m256i ymm0 = _mm256_loadu_si256(source256+0);
+			__m256i ymm1 = _mm256_loadu_si256(source256+1);
+			__m256i ymm2 = _mm256_loadu_si256(source256+2);
+			__m256i ymm3 = _mm256_loadu_si256(source256+3);
+			_mm256_store_si256(dest256+0, ymm0);
+			_mm256_store_si256(dest256+1, ymm1);
+			_mm256_store_si256(dest256+2, ymm2);
+			_mm256_store_si256(dest256+3, ymm3);
+		}
+	}
+
+	_mm256_zeroupper(); // Avoids the avx to sse transition penalty in the surrounding non-vex code.
+
+	memcpy(dest256, source256, count % 128);
+}
+
+void clear_avx(void* dest, size_t count, bool non_temporal)
+{
+	auto dest8 = static_cast<uint8_t*>(dest);
+
+	const size_t head = align_head(dest8, 32, count);
+	memset(dest8, 0, head);
+	dest8 += head;
+	count -= head;
+
+	auto dest256 = reinterpret_cast<__m256i*>(dest8);
+
+	const __m256i zero = _mm256_setzero_si256();
+	const size_t blocks = count / 128;
+	if(non_temporal)
+	{
+		for(size_t n = 0; n < blocks; ++n, dest256 += 4)
+		{
+			_mm256_stream_si256(dest256+0, zero);
+			_mm256_stream_si256(dest256+1, zero);
+			_mm256_stream_si256(dest256+2, zero);
+			_mm256_stream_si256(dest256+3, zero);
+		}
+		_mm_sfence();
+	}
+	else
+	{
+		for(size_t n = 0; n < blocks; ++n, dest256 += 4)
+		{
+			_mm256_store_si256(dest256+0, zero);
+			_mm256_store_si256(dest256+1, zero);
+			_mm256_store_si256(dest256+2, zero);
+			_mm256_store_si256(dest256+3, zero);
+		}
+	}
+
+	_mm256_zeroupper();
+
+	memset(dest256, 0, count % 128);
+}
+
+struct kernels
+{
+	level	simd_level;
+	size_t	non_temporal_threshold;
+	void	(*copy)(void* dest, const void* source, size_t count, bool non_temporal);
+	void	(*clear)(void* dest, size_t count, bool non_temporal);
+	void	(*shuffle)(void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4, bool non_temporal);
+};
+
+void select_kernels(kernels& result, level simd_level)
+{
+	result.simd_level	= simd_level;
+	result.copy			= simd_level >= avx_level   ? copy_avx		: simd_level >= sse2_level ? copy_sse2  : copy_scalar;
+	result.clear		= simd_level >= avx_level   ? clear_avx		: simd_level >= sse2_level ? clear_sse2 : clear_scalar;
+	result.shuffle		= simd_level >= ssse3_level ? shuffle_ssse3 : shuffle_scalar;
+}
+
+kernels* create_kernels()
+{
+	auto result = new kernels();
+	select_kernels(*result, detect_level());
+	result->non_temporal_threshold	= detect_cache_size() / 2; // Both source and destination pass through the cache.
+	return result;
+}
+
+const char* level_name(level simd_level)
+{
+	static const char* names[] = {"scalar", "sse2", "ssse3", "avx"};
+	return names[simd_level];
+}
+
+tbb::atomic<kernels*> g_kernels;
+
+const kernels& get_kernels()
+{
+	kernels* result = g_kernels;
+	if(!result)
+	{
+		result = create_kernels();
+		if(g_kernels.compare_and_swap(result, nullptr) != nullptr)
+		{
+			delete result;
+			result = g_kernels;
+		}
+		else
+			CASPAR_LOG(info) << L"Memory kernels: " << level_name(result->simd_level) << L". Non-temporal threshold: " << result->non_temporal_threshold/1024 << L" KB.";
+	}
+	return *result;
+}
+
+}
+
+level get_level()
+{
+	return get_kernels().simd_level;
+}
+
+const char* get_level_name()
+{
+	return level_name(get_level());
+}
+
+size_t non_temporal_threshold()
+{
+	return get_kernels().non_temporal_threshold;
+}
+
+const char* get_level_name(level simd_level)
+{
+	return level_name(std::min(simd_level, get_level()));
+}
+
+void copy(void* dest, const void* source, size_t count, bool non_temporal)
+{
+	get_kernels().copy(dest, source, count, non_temporal);
+}
+
+void clear(void* dest, size_t count, bool non_temporal)
+{
+	get_kernels().clear(dest, count, non_temporal);
+}
+
+void shuffle(void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4, bool non_temporal)
+{
+	get_kernels().shuffle(dest, source, count, m1, m2, m3, m4, non_temporal);
+}
+
+void copy(level simd_level, void* dest, const void* source, size_t count, bool non_temporal)
+{
+	kernels result;
+	select_kernels(result, std::min(simd_level, get_level()));
+	result.copy(dest, source, count, non_temporal);
+}
+
+void clear(level simd_level, void* dest, size_t count, bool non_temporal)
+{
+	kernels result;
+	select_kernels(result, std::min(simd_level, get_level()));
+	result.clear(dest, count, non_temporal);
+}
+
+void shuffle(level simd_level, void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4, bool non_temporal)
+{
+	kernels result;
+	select_kernels(result, std::min(simd_level, get_level()));
+	result.shuffle(dest, source, count, m1, m2, m3, m4, non_temporal);
+}
+
+}}
@@ -0,0 +1,57 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+
+namespace caspar { namespace simd {
+
+enum level
+{
+	scalar_level,
+	sse2_level,
+	ssse3_level,
+	avx_level
+};
+
+// Highest instruction set supported by both the cpu and the os. Kernels are selected once from this.
+level get_level();
+const char* get_level_name();
+
+// Copies and clears larger than this bypass the cache with non-temporal stores.
+size_t non_temporal_threshold();
+
+// Single threaded kernels. Any alignment and size is handled, non_temporal only affects the stores.
+void copy(void* dest, const void* source, size_t count, bool non_temporal);
+void clear(void* dest, size_t count, bool non_temporal);
+
+// Shuffles every 16 bytes of source with the pshufb style mask _mm_set_epi32(m1, m2, m3, m4).
+void shuffle(void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4, bool non_temporal);
+
+// The kernels of a specific level, e.g. to verify and time every level against the scalar one. 
+// Levels above get_level() run the kernels of get_level().
+const char* get_level_name(level simd_level);
+void copy(level simd_level, void* dest, const void* source, size_t count, bool non_temporal);
+void clear(level simd_level, void* dest, size_t count, bool non_temporal);
+void shuffle(level simd_level, void* dest, const void* source, size_t count, int m1, int m2, int m3, int m4, bool non_temporal);
+
+}}
@@ -0,0 +1,599 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "../stdafx.h"
+
+#include "file_index.h"
+
+#include "string.h"
+
+#include "../exception/exceptions.h"
+#include "../exception/win32_exception.h"
+#include "../concurrency/executor.h"
+#include "../log/log.h"
+
+#include <tbb/atomic.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace caspar {
+
+namespace {
+
+const char* const INDEX_VERSION	  = "casparcg-file-index 2";
+const DWORD		  SETTLE_TIME	  = 1000;	// Milliseconds without change notifications before a rescan.
+const size_t	  PROBES_PER_SAVE = 100;
+
+std::wstring make_key(std::wstring name)
+{
+	boost::replace_all(name, L"/", L"\\");
+	boost::trim_if(name, boost::is_any_of(L"\\"));
+	return boost::to_upper_copy(name);
+}
+
+// Immutable once published, readers keep the snapshot they got while the next one is built.
+struct snapshot
+{
+	std::map<std::wstring, file_index::entry>				files;			// By path, including the files which are not listed.
+	std::vector<file_index::entry>							listed;			// Sorted by name.
+	std::unordered_map<std::wstring, std::vector<size_t>>	by_name;		// Indices into listed.
+	std::unordered_map<std::wstring, std::vector<size_t>>	by_file_name;
+	std::unordered_map<std::wstring, size_t>				by_path;
+
+	explicit snapshot(std::map<std::wstring, file_index::entry>&& other_files) 
+		: files(std::move(other_files))
+	{
+		for(auto it = files.begin(); it != files.end(); ++it)
+		{
+			if(!it->second.type.empty())
+				listed.push_back(it->second);
+		}
+
+		std::stable_sort(listed.begin(), listed.end(), [](const file_index::entry& lhs, const file_index::entry& rhs)
+		{
+			return boost::ilexicographical_compare(lhs.name, rhs.name);
+		});
+
+		for(size_t n = 0; n < listed.size(); ++n)
+		{
+			by_name[make_key(listed[n].name)].push_back(n);
+			by_file_name[make_key(boost::filesystem::wpath(listed[n].name).filename())].push_back(n);
+			by_path[make_key(listed[n].path)] = n;
+		}
+	}
+};
+
+struct probe_result
+{
+	uint64_t								size;
+	std::time_t								write_time;
+	std::map<std::wstring, std::wstring>	metadata;
+};
+
+std::string sanitize(const std::wstring& str)
+{
+	auto result = narrow(str);
+	std::replace_if(result.begin(), result.end(), [](char c){return c == '\t' || c == '\r' || c == '\n';}, ' ');
+	return result;
+}
+
+}
+
+struct file_index::implementation : boost::noncopyable
+{
+	const std::wstring					folder_;
+	const std::wstring					index_file_;
+	const classifier					classify_;
+	const DWORD							rescan_interval_; // Milliseconds.
+
+	const prober						probe_;
+
+	mutable boost::mutex				mutex_;
+	mutable boost::condition_variable	ready_cond_;
+	std::shared_ptr<snapshot>			snapshot_; // nullptr until loaded or scanned.
+	std::map<std::wstring, probe_result> probed_;	// By path.
+
+	boost::mutex						probe_mutex_;
+	std::deque<entry>					probe_queue_;
+	std::set<std::wstring>				probe_pending_;	// Queued or being probed.
+	size_t								active_probers_;
+	size_t								probes_since_save_;
+
+	boost::mutex						save_mutex_;
+
+	HANDLE								wake_event_;
+	tbb::atomic<bool>					is_running_;
+	std::vector<safe_ptr<executor>>		probers_;
+	boost::thread						thread_;
+
+	implementation(const std::wstring& folder, const std::wstring& index_file, const classifier& classify, double rescan_interval, const prober& probe, size_t probe_threads)
+		: folder_(folder)
+		, index_file_(index_file)
+		, classify_(classify)
+		, rescan_interval_(static_cast<DWORD>(std::max(1.0, rescan_interval)*1000.0))
+		, probe_(probe)
+		, active_probers_(0)
+		, probes_since_save_(0)
+		, wake_event_(CreateEvent(nullptr, FALSE, FALSE, nullptr))
+	{
+		is_running_ = true;
+
+		for(size_t n = 0; probe_ && n < std::max<size_t>(1, probe_threads); ++n)
+		{
+			auto probe_executor = make_safe<executor>(L"file_index_probe");
+			probe_executor->set_priority_class(below_normal_priority_class);
+			probers_.push_back(probe_executor);
+		}
+
+		load();
+
+		thread_ = boost::thread([this]{run();});
+	}
+
+	~implementation()
+	{
+		is_running_ = false;
+		SetEvent(wake_event_);
+		thread_.join();
+		probers_.clear(); // Joins once the current probes are done.
+		CloseHandle(wake_event_);
+	}
+
+	std::vector<entry> entries() const
+	{
+		return wait_for_snapshot()->listed;
+	}
+
+	std::vector<entry> find(const std::wstring& name, bool by_file_name) const
+	{
+		auto current = wait_for_snapshot();
+		auto& lookup = by_file_name ? current->by_file_name : current->by_name;
+
+		std::vector<entry> result;
+
+		auto it = lookup.find(make_key(name));
+		if(it != lookup.end())
+		{
+			for(size_t n = 0; n < it->second.size(); ++n)
+				result.push_back(with_metadata(current->listed[it->second[n]]));
+		}
+
+		return result;
+	}
+
+	boost::optional<entry> find_path(const std::wstring& path) const
+	{
+		auto current = wait_for_snapshot();
+
+		auto it = current->by_path.find(make_key(path));
+		if(it == current->by_path.end())
+			return boost::none;
+
+		return with_metadata(current->listed[it->second]);
+	}
+
+	bool is_ready() const
+	{
+		return get_snapshot() != nullptr;
+	}
+
+	void rescan()
+	{
+		SetEvent(wake_event_);
+	}
+
+	std::wstring print() const
+	{
+		return L"[file_index] [" + folder_ + L"]";
+	}
+
+private:
+	entry with_metadata(entry file) const
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		auto it = probed_.find(file.path);
+		if(it != probed_.end() && it->second.size == file.size && it->second.write_time == file.write_time)
+		{
+			file.is_probed = true;
+			file.metadata  = it->second.metadata;
+		}
+
+		return file;
+	}
+
+	std::shared_ptr<snapshot> wait_for_snapshot() const
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+		while(!snapshot_)
+			ready_cond_.wait(lock);
+		return snapshot_;
+	}
+
+	std::shared_ptr<snapshot> get_snapshot() const
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		return snapshot_;
+	}
+
+	void publish(const std::shared_ptr<snapshot>& value)
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			snapshot_ = value;
+		}
+		ready_cond_.notify_all();
+	}
+
+	void run()
+	{
+		win32_exception::install_handler();
+
+		auto change = FindFirstChangeNotificationW(folder_.c_str(), TRUE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE);
+		if(change == INVALID_HANDLE_VALUE)
+			CASPAR_LOG(warning) << print() << L" Change notifications are not available, rescanning every " << rescan_interval_/1000 << L" seconds.";
+
+		while(is_running_)
+		{
+			scan();
+			wait_for_change(change);
+		}
+
+		if(change != INVALID_HANDLE_VALUE)
+			FindCloseChangeNotification(change);
+	}
+
+	void wait_for_change(HANDLE change)
+	{
+		if(change == INVALID_HANDLE_VALUE)
+		{
+			WaitForSingleObject(wake_event_, rescan_interval_);
+			return;
+		}
+
+		HANDLE handles[] = {wake_event_, change};
+		if(WaitForMultipleObjects(2, handles, FALSE, rescan_interval_) != WAIT_OBJECT_0 + 1)
+			return;
+
+		// Let copies and bursts of changes settle.
+		do
+		{
+			FindNextChangeNotification(change);
+		}
+		while(is_running_ && WaitForMultipleObjects(2, handles, FALSE, SETTLE_TIME) == WAIT_OBJECT_0 + 1);
+	}
+
+	std::wstring relative_name(const boost::filesystem::wpath& path) const
+	{
+		auto str  = path.file_string();
+		auto name = boost::filesystem::wpath(str.substr(std::min(folder_.size(), str.size()))).replace_extension(L"").file_string();
+		boost::trim_left_if(name, boost::is_any_of(L"\\/"));
+		return name;
+	}
+
+	void scan()
+	{
+		const std::map<std::wstring, entry> no_files;
+
+		auto		previous	   = get_snapshot();
+		const auto& previous_files = previous ? previous->files : no_files;
+		
+		std::map<std::wstring, entry> files;
+		bool changed = !previous;
+
+		try
+		{
+			for(boost::filesystem::wrecursive_directory_iterator it(folder_), end; it != end && is_running_; ++it)
+			{
+				try
+				{
+					if(!boost::filesystem::is_regular_file(it->status()))
+						continue;
+
+					entry file;
+					file.path		= it->path().file_string();
+					file.size		= boost::filesystem::file_size(it->path());
+					file.write_time = boost::filesystem::last_write_time(it->path());
+
+					auto old = previous_files.find(file.path);
+					if(old != previous_files.end() && old->second.size == file.size && old->second.write_time == file.write_time)
+						files.insert(*old);
+					else
+					{
+						file.name = relative_name(it->path());
+						file.type = classify_(it->path());
+						files.insert(std::make_pair(file.path, file));
+						changed = true;
+					}
+				}
+				catch(...)
+				{
+					// Removed or locked while scanning, retried on the next scan.
+				}
+			}
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(warning) << print() << L" Scan failed, keeping the previous index.";
+
+			if(!previous)
+				publish(std::make_shared<snapshot>(std::map<std::wstring, entry>()));
+
+			return;
+		}
+
+		if(!is_running_)
+			return;
+
+		if(changed || files.size() != previous_files.size())
+		{
+			auto next = std::make_shared<snapshot>(std::move(files));
+			publish(next);
+			save();
+
+			CASPAR_LOG(info) << print() << L" Indexed " << next->listed.size() << L" files.";
+		}
+
+		queue_probes();
+	}
+
+	void queue_probes()
+	{
+		if(probers_.empty())
+			return;
+
+		auto current = get_snapshot();
+
+		std::vector<entry> unprobed;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+			for(auto it = current->listed.begin(); it != current->listed.end(); ++it)
+			{
+				auto probed = probed_.find(it->path);
+				if(probed == probed_.end() || probed->second.size != it->size || probed->second.write_time != it->write_time)
+					unprobed.push_back(*it);
+			}
+		}
+
+		boost::lock_guard<boost::mutex> lock(probe_mutex_);
+
+		for(auto it = unprobed.begin(); it != unprobed.end(); ++it)
+		{
+			if(probe_pending_.insert(it->path).second)
+				probe_queue_.push_back(*it);
+		}
+
+		while(active_probers_ < probers_.size() && active_probers_ < probe_queue_.size())
+			probers_[active_probers_++]->post([this]{probe_files();});
+	}
+
+	void probe_files()
+	{
+		while(is_running_)
+		{
+			entry file;
+			{
+				boost::lock_guard<boost::mutex> lock(probe_mutex_);
+				if(probe_queue_.empty())
+					break;
+				file = probe_queue_.front();
+				probe_queue_.pop_front();
+			}
+
+			probe_result result;
+			result.size		  = file.size;
+			result.write_time = file.write_time;
+
+			try
+			{
+				result.metadata = probe_(file.path);
+			}
+			catch(...)
+			{
+				// Not retried until the file changes.
+				CASPAR_LOG_CURRENT_EXCEPTION();
+				CASPAR_LOG(warning) << print() << L" Failed to probe " << file.path << L".";
+			}
+
+			{
+				boost::lock_guard<boost::mutex> lock(mutex_);
+				probed_[file.path] = result;
+			}
+
+			bool should_save = false;
+			{
+				boost::lock_guard<boost::mutex> lock(probe_mutex_);
+				probe_pending_.erase(file.path);
+				should_save = ++probes_since_save_ >= PROBES_PER_SAVE;
+				if(should_save)
+					probes_since_save_ = 0;
+			}
+
+			if(should_save)
+				save();
+		}
+
+		bool is_last = false;
+		{
+			boost::lock_guard<boost::mutex> lock(probe_mutex_);
+			is_last = --active_probers_ == 0 && probes_since_save_ > 0;
+			if(is_last)
+				probes_since_save_ = 0;
+		}
+
+		if(is_last)
+		{
+			save();
+			CASPAR_LOG(info) << print() << L" Probed new and changed files.";
+		}
+	}
+
+	void load()
+	{
+		try
+		{
+			std::ifstream file(index_file_);
+			if(!file)
+				return;
+
+			std::string line;
+			if(!std::getline(file, line) || line != INDEX_VERSION)
+			{
+				CASPAR_LOG(info) << print() << L" Ignoring index of another version: " << index_file_;
+				return;
+			}
+
+			std::map<std::wstring, entry> files;
+			while(std::getline(file, line))
+			{
+				std::vector<std::string> fields;
+				boost::split(fields, line, boost::is_any_of("\t"));
+				if(fields.size() < 5)
+					continue;
+
+				entry value;
+				value.path		 = widen(fields[0]);
+				value.name		 = widen(fields[1]);
+				value.type		 = widen(fields[2]);
+				value.size		 = boost::lexical_cast<uint64_t>(fields[3]);
+				value.write_time = boost::lexical_cast<std::time_t>(fields[4]);
+
+				// Entries of a previously configured folder are left for the scan to drop.
+				if(!boost::istarts_with(value.path, folder_))
+					continue;
+
+				files.insert(std::make_pair(value.path, value));
+
+				if(fields.size() > 5 && fields[5] == "1")
+				{
+					probe_result result;
+					result.size		  = value.size;
+					result.write_time = value.write_time;
+
+					for(size_t n = 6; n < fields.size(); ++n)
+					{
+						auto separator = fields[n].find('=');
+						if(separator != std::string::npos)
+							result.metadata[widen(fields[n].substr(0, separator))] = widen(fields[n].substr(separator+1));
+					}
+
+					boost::lock_guard<boost::mutex> lock(mutex_);
+					probed_[value.path] = result;
+				}
+			}
+
+			auto loaded = std::make_shared<snapshot>(std::move(files));
+			publish(loaded);
+
+			CASPAR_LOG(info) << print() << L" Loaded " << loaded->listed.size() << L" files from " << index_file_ << L".";
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+	}
+
+	void save()
+	{
+		boost::lock_guard<boost::mutex> save_lock(save_mutex_);
+
+		auto current = get_snapshot();
+		if(!current)
+			return;
+
+		std::map<std::wstring, probe_result> probed;
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			for(auto it = probed_.begin(); it != probed_.end();)
+			{
+				if(current->files.find(it->first) == current->files.end())
+					it = probed_.erase(it);
+				else
+					++it;
+			}
+
+			probed = probed_;
+		}
+
+		try
+		{
+			auto temp_file = index_file_ + L".tmp";
+
+			boost::filesystem::create_directories(boost::filesystem::wpath(index_file_).parent_path());
+			{
+				std::ofstream file(temp_file, std::ios::trunc);
+				file << INDEX_VERSION << "\n";
+				for(auto it = current->files.begin(); it != current->files.end(); ++it)
+				{
+					file << sanitize(it->second.path) << "\t" << sanitize(it->second.name) << "\t" << sanitize(it->second.type) << "\t" 
+						 << it->second.size << "\t" << it->second.write_time;
+
+					auto result = probed.find(it->first);
+					if(result != probed.end() && result->second.size == it->second.size && result->second.write_time == it->second.write_time)
+					{
+						file << "\t1";
+						for(auto value = result->second.metadata.begin(); value != result->second.metadata.end(); ++value)
+							file << "\t" << sanitize(value->first) << "=" << sanitize(value->second);
+					}
+					else
+						file << "\t0";
+
+					file << "\n";
+				}
+
+				if(!file)
+					BOOST_THROW_EXCEPTION(io_error() << msg_info("Failed to write index.") << boost::errinfo_file_name(narrow(temp_file)));
+			}
+
+			if(!MoveFileExW(temp_file.c_str(), index_file_.c_str(), MOVEFILE_REPLACE_EXISTING))
+				BOOST_THROW_EXCEPTION(io_error() << msg_info("Failed to replace index.") << boost::errinfo_file_name(narrow(index_file_)));
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+	}
+};
+
+file_index::file_index(const std::wstring& folder, const std::wstring& index_file, const classifier& classify, double rescan_interval, const prober& probe, size_t probe_threads) 
+	: impl_(new implementation(folder, index_file, classify, rescan_interval, probe, probe_threads)){}
+file_index::~file_index(){}
+std::vector<file_index::entry> file_index::entries() const{return impl_->entries();}
+std::vector<file_index::entry> file_index::find(const std::wstring& name) const{return impl_->find(name, false);}
+std::vector<file_index::entry> file_index::find_file_name(const std::wstring& name) const{return impl_->find(name, true);}
+boost::optional<file_index::entry> file_index::find_path(const std::wstring& path) const{return impl_->find_path(path);}
+bool file_index::is_ready() const{return impl_->is_ready();}
+void file_index::rescan(){impl_->rescan();}
+std::wstring file_index::print() const{return impl_->print();}
+
+}
@@ -0,0 +1,87 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include "../memory/safe_ptr.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace caspar {
+
+// An in-memory index of the files below a folder. It is saved to index_file and rescanned in the background whenever 
+// Windows reports a change in the folder, or every rescan_interval seconds, so listings and lookups never walk the folder.
+// Only new or changed files, by size and write time, are passed to the classifier, and then to the prober on a pool of 
+// probe_threads background threads. Probe results are saved with the index.
+class file_index : boost::noncopyable
+{
+public:
+	struct entry
+	{
+		std::wstring	name;		// Relative to the folder, without extension.
+		std::wstring	path;		// Full path.
+		std::wstring	type;		// From the classifier, empty if the file is not listed.
+		uint64_t		size;
+		std::time_t		write_time;
+		bool			is_probed;
+		std::map<std::wstring, std::wstring> metadata; // From the prober, only filled in by the find functions.
+
+		entry() 
+			: size(0)
+			, write_time(0)
+			, is_probed(false)
+		{
+		}
+	};
+
+	typedef std::function<std::wstring(const boost::filesystem::wpath& path)>							classifier;
+	typedef std::function<std::map<std::wstring, std::wstring>(const boost::filesystem::wpath& path)>	prober;
+
+	file_index(const std::wstring& folder, const std::wstring& index_file, const classifier& classify, double rescan_interval, 
+			   const prober& probe = prober(), size_t probe_threads = 1);
+	~file_index(); // Waits for running scans and probes to stop.
+
+	// These wait for the first scan unless a saved index was loaded.
+	std::vector<entry> entries() const;									// Sorted by name.
+	std::vector<entry> find(const std::wstring& name) const;				// By relative name, case insensitive.
+	std::vector<entry> find_file_name(const std::wstring& name) const;	// By name without folder, case insensitive.
+	boost::optional<entry> find_path(const std::wstring& path) const;	// Listed files only.
+
+	bool is_ready() const;
+	void rescan();															// Asynchronous.
+
+	std::wstring print() const;
+private:
+	struct implementation;
+	safe_ptr<implementation> impl_;
+};
+
+}
@@ -32,16 +32,21 @@
 #include "../mixer/read_frame.h"
 
 #include <common/concurrency/executor.h>
+#include <common/diagnostics/trace.h>
 #include <common/utility/assert.h>
 #include <common/utility/timer.h>
 #include <common/memory/memshfl.h>
 #include <common/env.h>
+#include <common/utility/string.h>
 
 #include <boost/circular_buffer.hpp>
 #include <boost/timer.hpp>
 #include <boost/range/algorithm.hpp>
 #include <boost/range/adaptors.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <boost/iterator/indirect_iterator.hpp>
+#include <boost/thread/future.hpp>
+
 
 namespace caspar { namespace core {
 	
@@ -56,6 +61,7 @@ struct output::implementation
 	std::map<int, safe_ptr<frame_consumer>>			consumers_;
 	
 	high_prec_timer									sync_timer_;
+	bool											offline_;
 
 	boost::circular_buffer<safe_ptr<read_frame>>	frames_;
 
@@ -66,8 +72,11 @@ public:
 		: channel_index_(channel_index)
 		, graph_(graph)
 		, format_desc_(format_desc)
+		, offline_(false)
 		, executor_(L"output")
 	{
+		if(executor_pool_size() > 0) // Only strands are ordered by priority class, dedicated threads keep their priority.
+			executor_.set_priority_class(above_normal_priority_class);
 		graph_->set_color("consume-time", diagnostics::color(1.0f, 0.4f, 0.0f, 0.8));
 	}	
 	
@@ -143,6 +152,14 @@ public:
 		});
 	}
 
+	void set_offline(bool offline)
+	{
+		executor_.invoke([&]
+		{
+			offline_ = offline;
+		}, high_priority);
+	}
+
 	std::pair<size_t, size_t> minmax_buffer_depth() const
 	{		
 		if(consumers_.empty())
@@ -163,7 +180,7 @@ public:
 
 	void send(const std::pair<safe_ptr<read_frame>, std::shared_ptr<void>>& packet)
 	{
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{
 			try
 			{
@@ -171,12 +188,13 @@ public:
 
 				auto input_frame = packet.first;
 
-				if(!has_synchronization_clock())
+				if(!offline_ && !has_synchronization_clock())
 					sync_timer_.tick(1.0/format_desc_.fps);
 
 				if(input_frame->image_size() != format_desc_.size)
 				{
-					sync_timer_.tick(1.0/format_desc_.fps);
+					if(!offline_)
+						sync_timer_.tick(1.0/format_desc_.fps);
 					return;
 				}
 					
@@ -188,7 +206,11 @@ public:
 				if(!frames_.full())
 					return;
 
+				auto trace_id = diagnostics::get_trace_id(packet.second);
+
 				std::map<int, boost::unique_future<bool>> send_results;
+				std::map<int, int64_t> send_begins;
+				std::map<int, int64_t> send_ends;
 
 				// Start invocations
 				for (auto it = consumers_.begin(); it != consumers_.end(); ++it)
@@ -196,6 +218,9 @@ public:
 					auto consumer	= it->second;
 					auto frame		= frames_.at(consumer->buffer_depth()-minmax.first);
 						
+					send_begins[it->first] = diagnostics::trace_now();
+					send_ends[it->first]   = 0;
+
 					try
 					{
 						send_results.insert(std::make_pair(it->first, consumer->send(frame)));
@@ -216,6 +241,34 @@ public:
 					}
 				}
 
+				// Timestamp every consumer as soon as it completes, rather than when the loop below gets to it. 
+				// send_ends already holds every key, so this only assigns.
+				{
+					std::vector<int>							pending_keys;
+					std::vector<boost::unique_future<bool>*>	pending_results;
+					pending_keys.reserve(send_results.size());
+					pending_results.reserve(send_results.size());
+					for(auto it = send_results.begin(); it != send_results.end(); ++it)
+					{
+						pending_keys.push_back(it->first);
+						pending_results.push_back(&it->second);
+					}
+
+					blocking_scope blocking;
+					while(!pending_results.empty())
+					{
+						auto ready = boost::wait_for_any(boost::make_indirect_iterator(pending_results.begin()), boost::make_indirect_iterator(pending_results.end())).base();
+						auto n = ready - pending_results.begin();
+
+						send_ends[pending_keys[n]] = diagnostics::trace_now();
+
+						pending_keys[n] = pending_keys.back();
+						pending_keys.pop_back();
+						pending_results[n] = pending_results.back();
+						pending_results.pop_back();
+					}
+				}
+
 				// Retrieve results
 				for (auto result_it = send_results.begin(); result_it != send_results.end(); ++result_it)
 				{
@@ -225,7 +278,11 @@ public:
 						
 					try
 					{
-						if(!result_future.get())
+						auto result = result_future.get(); // Ready, see above.
+
+						diagnostics::trace(narrow(consumer->print()), trace_id, send_begins[result_it->first], send_ends[result_it->first]);
+
+						if(!result)
 						{
 							CASPAR_LOG(info) << print() << L" " << consumer->print() << L" Removed.";
 							consumers_.erase(result_it->first);
@@ -237,6 +294,7 @@ public:
 						try
 						{
 							consumer->initialize(format_desc_, channel_index_);
+							blocking_scope blocking;
 							if(!consumer->send(frame).get())
 							{
 								CASPAR_LOG(info) << print() << L" " << consumer->print() << L" Removed.";
@@ -253,6 +311,7 @@ public:
 				}
 						
 				graph_->set_value("consume-time", consume_timer_.elapsed()*format_desc_.fps*0.5);
+				graph_->add_sample("consume-time", consume_timer_.elapsed()*1000.0);
 			}
 			catch(...)
 			{
@@ -271,6 +330,7 @@ public:
 		return std::move(executor_.begin_invoke([&]() -> boost::property_tree::wptree
 		{			
 			boost::property_tree::wptree info;
+			info.add(L"clock", offline_ ? L"offline" : L"realtime");
 			BOOST_FOREACH(auto& consumer, consumers_)
 			{
 				info.add_child(L"consumers.consumer", consumer.second->info())
@@ -296,6 +356,7 @@ void output::remove(int index){impl_->remove(index);}
 void output::remove(const safe_ptr<frame_consumer>& consumer){impl_->remove(consumer);}
 void output::send(const std::pair<safe_ptr<read_frame>, std::shared_ptr<void>>& frame) {impl_->send(frame); }
 void output::set_video_format_desc(const video_format_desc& format_desc){impl_->set_video_format_desc(format_desc);}
+void output::set_offline(bool offline){impl_->set_offline(offline);}
 boost::unique_future<boost::property_tree::wptree> output::info() const{return impl_->info();}
 bool output::empty() const{return impl_->empty();}
 }}
\ No newline at end of file
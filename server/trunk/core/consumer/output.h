@@ -51,6 +51,7 @@ public:
 	void remove(int index);
 	
 	void set_video_format_desc(const video_format_desc& format_desc);
+	void set_offline(bool offline); // Run as fast as the consumers accept frames instead of at frame rate.
 
 	boost::unique_future<boost::property_tree::wptree> info() const;
 
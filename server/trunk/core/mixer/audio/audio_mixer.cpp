@@ -29,11 +29,14 @@
 
 #include <tbb/cache_aligned_allocator.h>
 
-#include <boost/range/adaptors.hpp>
-#include <boost/range/distance.hpp>
+#include <boost/foreach.hpp>
 
-#include <map>
-#include <stack>
+#include <intrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 #include <vector>
 
 namespace caspar { namespace core {
@@ -60,17 +63,165 @@ typedef std::vector<float, tbb::cache_aligned_allocator<float>> audio_buffer_ps;
 	
 struct audio_stream
 {
+	const void*			tag;
+	bool				is_used;
+	bool				is_active;
 	frame_transform		prev_transform;
-	audio_buffer_ps		audio_data;
+	audio_buffer_ps		audio_data;		// Grows to the largest backlog and is then reused, only the first size samples are valid.
+	size_t				size;
+
+	audio_stream()
+		: tag(nullptr)
+		, is_used(false)
+		, is_active(false)
+		, size(0)
+	{
+	}
 };
 
+namespace {
+
+// dest[n] = source[n] * (prev_volume + (n/channels)*alpha)
+void apply_gain(float* dest, const int32_t* source, size_t count, size_t channels, float prev_volume, float alpha)
+{
+	size_t n = 0;
+
+	if(channels == 1 || channels == 2 || channels == 4)
+	{
+		// Every block of 4 samples starts on a new sample frame, the gain within a block only depends on the position in it.
+		const size_t shift  = channels == 1 ? 0 : channels == 2 ? 1 : 2;
+		const __m128 offset = channels == 1 ? _mm_set_ps(3.0f*alpha, 2.0f*alpha, alpha, 0.0f) :
+							  channels == 2 ? _mm_set_ps(alpha, alpha, 0.0f, 0.0f) : _mm_setzero_ps();
+
+		for(; n + 4 <= count; n += 4)
+		{
+			const __m128 gain	= _mm_add_ps(_mm_set1_ps(prev_volume + static_cast<float>(n >> shift)*alpha), offset);
+			const __m128 sample = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n)));
+			_mm_storeu_ps(dest + n, _mm_mul_ps(sample, gain));
+		}
+	}
+	else if(channels % 4 == 0)
+	{
+		for(size_t frame = 0; n + channels <= count; ++frame)
+		{
+			const __m128 gain = _mm_set1_ps(prev_volume + static_cast<float>(frame)*alpha);
+			for(size_t end = n + channels; n < end; n += 4)
+			{
+				const __m128 sample = _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n)));
+				_mm_storeu_ps(dest + n, _mm_mul_ps(sample, gain));
+			}
+		}
+	}
+
+	size_t frame	= n / channels;
+	size_t channel	= n % channels;
+	for(; n < count; ++n)
+	{
+		dest[n] = static_cast<float>(source[n]) * (prev_volume + static_cast<float>(frame)*alpha);
+		if(++channel == channels)
+		{
+			channel = 0;
+			++frame;
+		}
+	}
+}
+
+// Same as apply_gain but every sample frame is also multiplied by the routing matrix. Scales with channels^2 so it's only used for non-identity routings.
+void apply_routed_gain(float* dest, const int32_t* source, size_t count, size_t channels, const audio_matrix& routing, float prev_volume, float alpha)
+{
+	const size_t width = (channels + 3) & ~3; // Outputs are computed 4 at a time.
+
+	// Matrix columns of the sources which are routed anywhere, columns[n*width + output].
+	float	columns[max_audio_channels*max_audio_channels];
+	size_t	sources[max_audio_channels];
+	size_t	nb_sources = 0;
+	for(size_t source_channel = 0; source_channel < channels; ++source_channel)
+	{
+		float* column = columns + nb_sources*width;
+		bool   is_used = false;
+		for(size_t output = 0; output < width; ++output)
+		{
+			column[output] = output < channels ? routing.gains[output*max_audio_channels + source_channel] : 0.0f;
+			is_used |= column[output] != 0.0f;
+		}
+		if(is_used)
+			sources[nb_sources++] = source_channel;
+	}
+
+	float frame_result[max_audio_channels];
+
+	size_t n = 0;
+	for(size_t frame = 0; n + channels <= count; ++frame, n += channels)
+	{
+		const __m128 gain = _mm_set1_ps(prev_volume + static_cast<float>(frame)*alpha);
+		for(size_t output = 0; output < width; output += 4)
+		{
+			__m128 result = _mm_setzero_ps();
+			for(size_t k = 0; k < nb_sources; ++k)
+				result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(static_cast<float>(source[n + sources[k]])), _mm_loadu_ps(columns + k*width + output)));
+			_mm_storeu_ps(frame_result + output, _mm_mul_ps(result, gain));
+		}
+		memcpy(dest + n, frame_result, channels*sizeof(float));
+	}
+
+	std::fill(dest + n, dest + count, 0.0f); // Incomplete sample frame.
+}
+
+// dest[n] += source[n]
+void accumulate(float* dest, const float* source, size_t count)
+{
+	size_t n = 0;
+	for(; n + 8 <= count; n += 8)
+	{
+		_mm_storeu_ps(dest + n + 0, _mm_add_ps(_mm_loadu_ps(dest + n + 0), _mm_loadu_ps(source + n + 0)));
+		_mm_storeu_ps(dest + n + 4, _mm_add_ps(_mm_loadu_ps(dest + n + 4), _mm_loadu_ps(source + n + 4)));
+	}
+	for(; n < count; ++n)
+		dest[n] += source[n];
+}
+
+// Saturating, truncating float to int32 conversion. Returns the peak absolute sample value.
+float convert(int32_t* dest, const float* source, size_t count)
+{
+	const float  min_sample = -2147483648.0f;
+	const float  max_sample =  2147483520.0f; // Largest float below 2^31.
+	const __m128 abs_mask	= _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+	__m128 peak = _mm_setzero_ps();
+
+	size_t n = 0;
+	for(; n + 4 <= count; n += 4)
+	{
+		__m128 sample = _mm_loadu_ps(source + n);
+		sample = _mm_min_ps(_mm_max_ps(sample, _mm_set1_ps(min_sample)), _mm_set1_ps(max_sample));
+		peak   = _mm_max_ps(peak, _mm_and_ps(sample, abs_mask));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_cvttps_epi32(sample));
+	}
+
+	float peaks[4];
+	_mm_storeu_ps(peaks, peak);
+	float result = std::max(std::max(peaks[0], peaks[1]), std::max(peaks[2], peaks[3]));
+
+	for(; n < count; ++n)
+	{
+		const float sample = std::min(std::max(source[n], min_sample), max_sample);
+		result	= std::max(result, std::abs(sample));
+		dest[n] = static_cast<int32_t>(sample);
+	}
+
+	return result;
+}
+
+}
+
 struct audio_mixer::implementation
 {
 	safe_ptr<diagnostics::graph>		graph_;
-	std::stack<core::frame_transform>	transform_stack_;
-	std::map<const void*, audio_stream>	audio_streams_;
+	std::vector<core::frame_transform>	transform_stack_;
+	std::vector<audio_stream>			audio_streams_;	// Flat tag -> stream table, a channel rarely has more than a few dozen streams.
 	std::vector<audio_item>				items_;
 	std::vector<size_t>					audio_cadence_;
+	audio_buffer_ps						result_ps_;
 	video_format_desc					format_desc_;
 	
 public:
@@ -79,22 +230,22 @@ public:
 		, format_desc_(video_format_desc::get(video_format::invalid))
 	{
 		graph_->set_color("volume", diagnostics::color(1.0f, 0.8f, 0.1f));
-		transform_stack_.push(core::frame_transform());
+		transform_stack_.push_back(core::frame_transform());
 	}
 	
 	void begin(core::basic_frame& frame)
 	{
-		transform_stack_.push(transform_stack_.top()*frame.get_frame_transform());
+		transform_stack_.push_back(transform_stack_.back()*frame.get_frame_transform());
 	}
 
 	void visit(core::write_frame& frame)
 	{
-		if(transform_stack_.top().volume < 0.002 || frame.audio_data().empty())
+		if(transform_stack_.back().volume < 0.002 || frame.audio_data().empty())
 			return;
 
 		audio_item item;
 		item.tag		= frame.tag();
-		item.transform	= transform_stack_.top();
+		item.transform	= transform_stack_.back();
 		item.audio_data = std::move(frame.audio_data()); // Note: We don't need to care about upper/lower since audio_data is removed/moved from the last field.
 		
 		items_.push_back(std::move(item));		
@@ -102,12 +253,36 @@ public:
 
 	void begin(const core::frame_transform& transform)
 	{
-		transform_stack_.push(transform_stack_.top()*transform);
+		transform_stack_.push_back(transform_stack_.back()*transform);
 	}
 		
 	void end()
 	{
-		transform_stack_.pop();
+		transform_stack_.pop_back();
+	}
+
+	audio_stream& get_stream(const void* tag, const frame_transform& transform)
+	{
+		audio_stream* unused = nullptr;
+		BOOST_FOREACH(auto& stream, audio_streams_)
+		{
+			if(stream.is_used && stream.tag == tag)
+				return stream;
+			if(!stream.is_used && !unused)
+				unused = &stream;
+		}
+
+		if(!unused)
+		{
+			audio_streams_.push_back(audio_stream());
+			unused = &audio_streams_.back();
+		}
+
+		unused->tag				= tag;
+		unused->is_used			= true;
+		unused->prev_transform	= transform;
+		unused->size			= 0;
+		return *unused;
 	}
 	
 	audio_buffer mix(const video_format_desc& format_desc)
@@ -118,80 +293,83 @@ public:
 			audio_cadence_ = format_desc.audio_cadence;
 			format_desc_ = format_desc;
 		}		
-		
-		std::map<const void*, audio_stream>	next_audio_streams;
 
+		BOOST_FOREACH(auto& stream, audio_streams_)
+			stream.is_active = false;
+		
 		BOOST_FOREACH(auto& item, items_)
 		{			
-			audio_buffer_ps next_audio;
-
-			auto next_transform = item.transform;
-			auto prev_transform = next_transform;
-
-			const auto it = audio_streams_.find(item.tag);
-			if(it != audio_streams_.end())
-			{	
-				prev_transform	= it->second.prev_transform;
-				next_audio		= std::move(it->second.audio_data);
-			}
+			auto& stream = get_stream(item.tag, item.transform);
 
+			const auto next_transform = item.transform;
+			const auto prev_transform = stream.prev_transform;
+			
 			if(prev_transform.volume < 0.001 && next_transform.volume < 0.001)
 				continue;
 			
 			const float prev_volume = static_cast<float>(prev_transform.volume);
 			const float next_volume = static_cast<float>(next_transform.volume);
 									
-			auto alpha = (next_volume-prev_volume)/static_cast<float>(item.audio_data.size()/format_desc.audio_channels);
+			const auto alpha = (next_volume-prev_volume)/static_cast<float>(item.audio_data.size()/format_desc.audio_channels);
 			
-			for(size_t n = 0; n < item.audio_data.size(); ++n)
-				next_audio.push_back(item.audio_data[n] * (prev_volume + (n/format_desc_.audio_channels) * alpha));
-										
-			next_audio_streams[item.tag].prev_transform  = std::move(next_transform); // Store all active tags, inactive tags will be removed at the end.
-			next_audio_streams[item.tag].audio_data		 = std::move(next_audio);			
+			if(stream.audio_data.size() < stream.size + item.audio_data.size())
+				stream.audio_data.resize(stream.size + item.audio_data.size());
+
+			if(!next_transform.audio_routing)
+				apply_gain(stream.audio_data.data() + stream.size, item.audio_data.data(), item.audio_data.size(), format_desc.audio_channels, prev_volume, alpha);
+			else
+				apply_routed_gain(stream.audio_data.data() + stream.size, item.audio_data.data(), item.audio_data.size(), format_desc.audio_channels, *next_transform.audio_routing, prev_volume, alpha);
+			
+			stream.size			  += item.audio_data.size();
+			stream.prev_transform  = next_transform; 
+			stream.is_active	   = true; // Inactive streams are released below.
 		}				
 
 		items_.clear();
-
-		audio_streams_ = std::move(next_audio_streams);
 		
-		if(audio_streams_.empty())		
-			audio_streams_[nullptr].audio_data = audio_buffer_ps(audio_cadence_.front(), 0.0f);
-				
-		{ // sanity check
-
-			auto nb_invalid_streams = boost::count_if(audio_streams_ | boost::adaptors::map_values, [&](const audio_stream& x)
+		BOOST_FOREACH(auto& stream, audio_streams_)
+		{
+			if(!stream.is_active)
 			{
-				return x.audio_data.size() < audio_cadence_.front();
-			});
-
-			if(nb_invalid_streams > 0)		
-				CASPAR_LOG(trace) << "[audio_mixer] Incorrect frame audio cadence detected.";			
+				stream.is_used	= false;
+				stream.size		= 0;
+			}
 		}
 
-		std::vector<float> result_ps(audio_cadence_.front(), 0.0f);
-		BOOST_FOREACH(auto& stream, audio_streams_ | boost::adaptors::map_values)
+		const size_t nb_samples = audio_cadence_.front();
+
+		result_ps_.resize(nb_samples);
+		std::fill(result_ps_.begin(), result_ps_.end(), 0.0f);
+		
+		bool has_invalid_streams = false;
+		BOOST_FOREACH(auto& stream, audio_streams_)
 		{
-			//CASPAR_LOG(debug) << stream.audio_data.size() << L" : " << result_ps.size();
+			if(!stream.is_used)
+				continue;
 
-			if(stream.audio_data.size() < result_ps.size())
+			if(stream.size < nb_samples)
 			{
-				stream.audio_data.resize(result_ps.size(), 0.0f);
+				has_invalid_streams = true;
 				CASPAR_LOG(trace) << L"[audio_mixer] Appended zero samples";
 			}
 
-			auto out = boost::range::transform(result_ps, stream.audio_data, std::begin(result_ps), std::plus<float>());
-			stream.audio_data.erase(std::begin(stream.audio_data), std::begin(stream.audio_data) + std::distance(std::begin(result_ps), out));
+			const size_t count = std::min(stream.size, nb_samples);
+			accumulate(result_ps_.data(), stream.audio_data.data(), count);
+
+			// Keep the samples which didn't fit in this frame.
+			memmove(stream.audio_data.data(), stream.audio_data.data() + count, (stream.size - count)*sizeof(float));
+			stream.size -= count;
 		}		
+
+		if(has_invalid_streams)		
+			CASPAR_LOG(trace) << "[audio_mixer] Incorrect frame audio cadence detected.";			
 		
-		boost::range::rotate(audio_cadence_, std::begin(audio_cadence_)+1);
+		std::rotate(audio_cadence_.begin(), audio_cadence_.begin()+1, audio_cadence_.end());
 		
-		audio_buffer result;
-		result.reserve(result_ps.size());
-		boost::range::transform(result_ps, std::back_inserter(result), [](float sample){return static_cast<int32_t>(sample);});		
-
-		auto max = boost::range::max_element(result);
+		audio_buffer result(nb_samples);
+		const float peak = convert(result.data(), result_ps_.data(), nb_samples);
 
-		graph_->set_value("volume", static_cast<double>(std::abs(*max))/std::numeric_limits<int32_t>::max());
+		graph_->set_value("volume", static_cast<double>(peak)/std::numeric_limits<int32_t>::max());
 
 		return result;
 	}
@@ -203,4 +381,4 @@ void audio_mixer::visit(core::write_frame& frame){impl_->visit(frame);}
 void audio_mixer::end(){impl_->end();}
 audio_buffer audio_mixer::operator()(const video_format_desc& format_desc){return impl_->mix(format_desc);}
 
-}}
\ No newline at end of file
+}}
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <algorithm>
+#include <cstring>
 #include <vector>
 
 #include <stdint.h>
@@ -62,4 +63,37 @@ static std::vector<int16_t, tbb::cache_aligned_allocator<int16_t>> audio_32_to_1
 	return output16;
 }
 
+// Copies the first min(in_channels, out_channels) channels of every interleaved frame and silences the rest.
+// Mono is duplicated into the second channel.
+static void audio_remap_channels(void* dest, const void* source, size_t frames, size_t in_channels, size_t out_channels, size_t sample_size)
+{
+	auto dest8		= reinterpret_cast<int8_t*>(dest);
+	auto source8	= reinterpret_cast<const int8_t*>(source);
+	auto copied		= std::min(in_channels, out_channels);
+
+	for(size_t n = 0; n < frames; ++n)
+	{
+		auto out = dest8 + n*out_channels*sample_size;
+		auto in  = source8 + n*in_channels*sample_size;
+
+		std::memcpy(out, in, copied*sample_size);
+		std::memset(out + copied*sample_size, 0, (out_channels-copied)*sample_size);
+		if(in_channels == 1 && out_channels > 1)
+			std::memcpy(out + sample_size, in, sample_size);
+	}
+}
+
+template<typename T>
+static std::vector<int32_t, tbb::cache_aligned_allocator<int32_t>> audio_remap_channels(const T& audio_data, size_t in_channels, size_t out_channels)
+{
+	auto size		= std::distance(std::begin(audio_data), std::end(audio_data));
+	auto frames		= size / in_channels;
+	auto output32	= std::vector<int32_t, tbb::cache_aligned_allocator<int32_t>>(frames*out_channels);
+
+	if(frames > 0)
+		audio_remap_channels(output32.data(), &(*std::begin(audio_data)), frames, in_channels, out_channels, sizeof(int32_t));
+
+	return output32;
+}
+
 }}
\ No newline at end of file
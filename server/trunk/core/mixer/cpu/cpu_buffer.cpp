@@ -0,0 +1,91 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "cpu_buffer.h"
+
+#include <common/utility/assert.h>
+
+#include <tbb/atomic.h>
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/concurrent_queue.h>
+#include <tbb/concurrent_unordered_map.h>
+
+#include <vector>
+
+namespace caspar { namespace core {
+
+typedef tbb::concurrent_bounded_queue<std::shared_ptr<cpu_buffer>> cpu_buffer_pool;
+
+static tbb::concurrent_unordered_map<size_t, safe_ptr<cpu_buffer_pool>> g_pools;
+static tbb::atomic<int> g_total_count;
+
+struct cpu_buffer::implementation : boost::noncopyable
+{
+	std::vector<uint8_t, tbb::cache_aligned_allocator<uint8_t>> data_;
+	uint8_t*													ptr_;
+	size_t														size_;
+	std::shared_ptr<void>										owner_;
+
+	implementation(size_t size) 
+		: data_(size, 0)
+		, ptr_(data_.data())
+		, size_(size)
+	{
+		CASPAR_LOG(trace) << "[cpu_buffer] [" << ++g_total_count << L"] allocated size:" << size;
+	}
+
+	implementation(uint8_t* data, size_t size, const std::shared_ptr<void>& owner) 
+		: ptr_(data)
+		, size_(size)
+		, owner_(owner)
+	{
+	}
+};
+
+cpu_buffer::cpu_buffer(size_t size) : impl_(new implementation(size)){}
+cpu_buffer::cpu_buffer(uint8_t* data, size_t size, const std::shared_ptr<void>& owner) : impl_(new implementation(data, size, owner)){}
+const uint8_t* cpu_buffer::data() const {return impl_->ptr_;}
+uint8_t* cpu_buffer::data() {return impl_->ptr_;}
+size_t cpu_buffer::size() const { return impl_->size_; }
+
+safe_ptr<cpu_buffer> cpu_buffer::create(size_t size)
+{
+	CASPAR_VERIFY(size > 0);
+	auto& pool = g_pools[size];
+	std::shared_ptr<cpu_buffer> buffer;
+	if(!pool->try_pop(buffer))	
+		buffer.reset(new cpu_buffer(size));
+	
+	return safe_ptr<cpu_buffer>(buffer.get(), [=](cpu_buffer*) mutable
+	{
+		pool->push(buffer);
+	});
+}
+
+safe_ptr<cpu_buffer> cpu_buffer::wrap(uint8_t* data, size_t size, const std::shared_ptr<void>& owner)
+{
+	CASPAR_VERIFY(data && owner);
+	return safe_ptr<cpu_buffer>(new cpu_buffer(data, size, owner));
+}
+
+}}
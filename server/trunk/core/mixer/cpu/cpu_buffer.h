@@ -0,0 +1,51 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdint>
+#include <memory>
+
+namespace caspar { namespace core {
+
+// Host memory image plane used by the cpu image_mixer in place of host_buffer/device_buffer.
+class cpu_buffer : boost::noncopyable
+{
+public:
+	static safe_ptr<cpu_buffer> create(size_t size); // Pooled, returned to the pool on release.
+	static safe_ptr<cpu_buffer> wrap(uint8_t* data, size_t size, const std::shared_ptr<void>& owner); // Memory of someone else, owner is held until release.
+
+	const uint8_t* data() const;
+	uint8_t* data();
+	size_t size() const;
+private:
+	explicit cpu_buffer(size_t size);
+	cpu_buffer(uint8_t* data, size_t size, const std::shared_ptr<void>& owner);
+
+	struct implementation;
+	safe_ptr<implementation> impl_;
+};
+
+}}
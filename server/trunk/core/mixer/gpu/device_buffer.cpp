@@ -36,12 +36,18 @@ namespace caspar { namespace core {
 	
 static GLenum FORMAT[] = {0, GL_RED, GL_RG, GL_BGR, GL_BGRA};
 static GLenum INTERNAL_FORMAT[] = {0, GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};	
+static GLenum INTERNAL_FORMAT16[] = {0, GL_R16, GL_RG16, GL_RGB16, GL_RGBA16};	
 
 unsigned int format(size_t stride)
 {
 	return FORMAT[stride];
 }
 
+unsigned int type(size_t depth)
+{
+	return depth > 8 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+}
+
 static tbb::atomic<int> g_total_count;
 
 struct device_buffer::implementation : boost::noncopyable
@@ -51,14 +57,16 @@ struct device_buffer::implementation : boost::noncopyable
 	const size_t width_;
 	const size_t height_;
 	const size_t stride_;
+	const size_t depth_;
 
 	fence		 fence_;
 
 public:
-	implementation(size_t width, size_t height, size_t stride) 
+	implementation(size_t width, size_t height, size_t stride, size_t depth) 
 		: width_(width)
 		, height_(height)
 		, stride_(stride)
+		, depth_(depth)
 	{	
 		GL(glGenTextures(1, &id_));
 		GL(glBindTexture(GL_TEXTURE_2D, id_));
@@ -66,9 +74,9 @@ public:
 		GL(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
 		GL(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
 		GL(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-		GL(glTexImage2D(GL_TEXTURE_2D, 0, INTERNAL_FORMAT[stride_], width_, height_, 0, FORMAT[stride_], GL_UNSIGNED_BYTE, NULL));
+		GL(glTexImage2D(GL_TEXTURE_2D, 0, depth_ > 8 ? INTERNAL_FORMAT16[stride_] : INTERNAL_FORMAT[stride_], width_, height_, 0, FORMAT[stride_], type(depth_), NULL));
 		GL(glBindTexture(GL_TEXTURE_2D, 0));
-		CASPAR_LOG(trace) << "[device_buffer] [" << ++g_total_count << L"] allocated size:" << width*height*stride;	
+		CASPAR_LOG(trace) << "[device_buffer] [" << ++g_total_count << L"] allocated size:" << width*height*stride*(depth_/8);	
 	}	
 
 	~implementation()
@@ -103,7 +111,7 @@ public:
 	void begin_read()
 	{
 		bind();
-		GL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, FORMAT[stride_], GL_UNSIGNED_BYTE, NULL));
+		GL(glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_, height_, FORMAT[stride_], type(depth_), NULL));
 		unbind();
 		fence_.set();
 	}
@@ -114,8 +122,9 @@ public:
 	}
 };
 
-device_buffer::device_buffer(size_t width, size_t height, size_t stride) : impl_(new implementation(width, height, stride)){}
+device_buffer::device_buffer(size_t width, size_t height, size_t stride, size_t depth) : impl_(new implementation(width, height, stride, depth)){}
 size_t device_buffer::stride() const { return impl_->stride_; }
+size_t device_buffer::depth() const { return impl_->depth_; }
 size_t device_buffer::width() const { return impl_->width_; }
 size_t device_buffer::height() const { return impl_->height_; }
 void device_buffer::bind(int index){impl_->bind(index);}
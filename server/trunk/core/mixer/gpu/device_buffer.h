@@ -34,6 +34,7 @@ class device_buffer : boost::noncopyable
 public:
 	
 	size_t stride() const;	
+	size_t depth() const; // 8 or 16 bits per channel.
 	size_t width() const;
 	size_t height() const;
 		
@@ -44,7 +45,7 @@ public:
 	bool ready() const;
 private:
 	friend class ogl_device;
-	device_buffer(size_t width, size_t height, size_t stride);
+	device_buffer(size_t width, size_t height, size_t stride, size_t depth);
 
 	int id() const;
 
@@ -53,5 +54,6 @@ private:
 };
 	
 unsigned int format(size_t stride);
+unsigned int type(size_t depth);
 
 }}
\ No newline at end of file
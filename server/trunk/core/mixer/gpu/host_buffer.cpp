@@ -122,11 +122,11 @@ public:
 		GL(glBindBuffer(target_, 0));
 	}
 
-	void begin_read(size_t width, size_t height, GLuint format)
+	void begin_read(size_t width, size_t height, GLuint format, GLuint type)
 	{
 		unmap();
 		bind();
-		GL(glReadPixels(0, 0, width, height, format, GL_UNSIGNED_BYTE, NULL));
+		GL(glReadPixels(0, 0, width, height, format, type, NULL));
 		unbind();
 		fence_.set();
 	}
@@ -144,7 +144,7 @@ void host_buffer::map(){impl_->map();}
 void host_buffer::unmap(){impl_->unmap();}
 void host_buffer::bind(){impl_->bind();}
 void host_buffer::unbind(){impl_->unbind();}
-void host_buffer::begin_read(size_t width, size_t height, GLuint format){impl_->begin_read(width, height, format);}
+void host_buffer::begin_read(size_t width, size_t height, GLuint format, GLuint type){impl_->begin_read(width, height, format, type);}
 size_t host_buffer::size() const { return impl_->size_; }
 bool host_buffer::ready() const{return impl_->ready();}
 void host_buffer::wait(ogl_device& ogl){impl_->wait(ogl);}
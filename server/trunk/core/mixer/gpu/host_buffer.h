@@ -48,7 +48,7 @@ public:
 	void map();
 	void unmap();
 	
-	void begin_read(size_t width, size_t height, unsigned int format);
+	void begin_read(size_t width, size_t height, unsigned int format, unsigned int type);
 	bool ready() const;
 	void wait(ogl_device& ogl);
 private:
@@ -38,7 +38,7 @@
 namespace caspar { namespace core {
 
 ogl_device::ogl_device() 
-	: executor_(L"ogl_device")
+	: executor_(L"ogl_device", dedicated_thread)
 	, pattern_(nullptr)
 	, attached_texture_(0)
 	, attached_fbo_(0)
@@ -83,12 +83,12 @@ ogl_device::~ogl_device()
 	});
 }
 
-safe_ptr<device_buffer> ogl_device::allocate_device_buffer(size_t width, size_t height, size_t stride)
+safe_ptr<device_buffer> ogl_device::allocate_device_buffer(size_t width, size_t height, size_t stride, size_t depth)
 {
 	std::shared_ptr<device_buffer> buffer;
 	try
 	{
-		buffer.reset(new device_buffer(width, height, stride));
+		buffer.reset(new device_buffer(width, height, stride, depth));
 	}
 	catch(...)
 	{
@@ -98,7 +98,7 @@ safe_ptr<device_buffer> ogl_device::allocate_device_buffer(size_t width, size_t
 			gc().wait();
 					
 			// Try again
-			buffer.reset(new device_buffer(width, height, stride));
+			buffer.reset(new device_buffer(width, height, stride, depth));
 		}
 		catch(...)
 		{
@@ -109,14 +109,15 @@ safe_ptr<device_buffer> ogl_device::allocate_device_buffer(size_t width, size_t
 	return make_safe_ptr(buffer);
 }
 				
-safe_ptr<device_buffer> ogl_device::create_device_buffer(size_t width, size_t height, size_t stride)
+safe_ptr<device_buffer> ogl_device::create_device_buffer(size_t width, size_t height, size_t stride, size_t depth)
 {
 	CASPAR_VERIFY(stride > 0 && stride < 5);
+	CASPAR_VERIFY(depth == 8 || depth == 16);
 	CASPAR_VERIFY(width > 0 && height > 0);
-	auto& pool = device_pools_[stride-1][((width << 16) & 0xFFFF0000) | (height & 0x0000FFFF)];
+	auto& pool = device_pools_[depth/16*4 + stride-1][((width << 16) & 0xFFFF0000) | (height & 0x0000FFFF)];
 	std::shared_ptr<device_buffer> buffer;
 	if(!pool->items.try_pop(buffer))		
-		buffer = executor_.invoke([&]{return allocate_device_buffer(width, height, stride);}, high_priority);			
+		buffer = executor_.invoke([&]{return allocate_device_buffer(width, height, stride, depth);}, high_priority);			
 	
 	//++pool->usage_count;
 
@@ -73,7 +73,7 @@ class ogl_device : public std::enable_shared_from_this<ogl_device>, boost::nonco
 
 	std::unique_ptr<sf::Context> context_;
 	
-	std::array<tbb::concurrent_unordered_map<size_t, safe_ptr<buffer_pool<device_buffer>>>, 4> device_pools_;
+	std::array<tbb::concurrent_unordered_map<size_t, safe_ptr<buffer_pool<device_buffer>>>, 8> device_pools_; // [depth/16*4 + stride-1]
 	std::array<tbb::concurrent_unordered_map<size_t, safe_ptr<buffer_pool<host_buffer>>>, 2> host_pools_;
 	
 	GLuint fbo_;
@@ -110,6 +110,12 @@ public:
 	{			
 		return executor_.begin_invoke(std::forward<Func>(func), priority);
 	}
+
+	template<typename Func>
+	void post(Func&& func, task_priority priority = normal_priority) // noexcept
+	{			
+		executor_.post(std::forward<Func>(func), priority);
+	}
 	
 	template<typename Func>
 	auto invoke(Func&& func, task_priority priority = normal_priority) -> decltype(func())
@@ -117,7 +123,7 @@ public:
 		return executor_.invoke(std::forward<Func>(func), priority);
 	}
 		
-	safe_ptr<device_buffer> create_device_buffer(size_t width, size_t height, size_t stride);
+	safe_ptr<device_buffer> create_device_buffer(size_t width, size_t height, size_t stride, size_t depth = 8);
 	safe_ptr<host_buffer> create_host_buffer(size_t size, host_buffer::usage_t usage);
 	
 	void yield();
@@ -126,7 +132,7 @@ public:
 	std::wstring version();
 
 private:
-	safe_ptr<device_buffer> allocate_device_buffer(size_t width, size_t height, size_t stride);
+	safe_ptr<device_buffer> allocate_device_buffer(size_t width, size_t height, size_t stride, size_t depth);
 	safe_ptr<host_buffer> allocate_host_buffer(size_t size, host_buffer::usage_t usage);
 };
 
@@ -0,0 +1,872 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+// The cpu renderer follows the GL path (image_mixer.cpp, image_kernel.cpp, image_shader.cpp) step by step,
+// including rounding to 8 bits after every draw, aiming at the same output within +-2/255 per channel, 
+// see "bench parity". Blend-modes are always available on the cpu.
+// The kernels are SSE2. The pixel math is 8 and 16 bit integer, which AVX only widens with AVX2, and AVX2 is 
+// beyond the VS2010 toolset.
+
+#include "../../stdafx.h"
+
+#include "cpu_image_renderer.h"
+
+#include "../cpu/cpu_buffer.h"
+
+#include <common/utility/assert.h>
+
+#include <core/producer/frame/frame_transform.h>
+#include <core/producer/frame/pixel_format.h>
+#include <core/video_format.h>
+
+#include <boost/foreach.hpp>
+#include <boost/range/algorithm_ext/erase.hpp>
+
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/parallel_for.h>
+
+#include <intrin.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace caspar { namespace core {
+
+namespace {
+
+static const double epsilon = 0.001;
+
+typedef std::vector<uint8_t, tbb::cache_aligned_allocator<uint8_t>>	byte_row;
+typedef std::vector<float, tbb::cache_aligned_allocator<float>>		float_row; // 4 floats per pixel, b g r a.
+
+struct keyer
+{
+	enum type
+	{
+		linear = 0,
+		additive
+	};
+};
+
+// Pixels are kept in memory order (b, g, r, a) as normalized floats, one pixel per __m128.
+
+inline __m128 load_pixel(const uint8_t* ptr)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i xmm0 = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(ptr));
+	xmm0 = _mm_unpacklo_epi8(xmm0, zero);
+	xmm0 = _mm_unpacklo_epi16(xmm0, zero);
+	return _mm_cvtepi32_ps(xmm0);
+}
+
+inline void store_pixel(uint8_t* ptr, __m128 color)
+{
+	color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	__m128i xmm0 = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f)));
+	xmm0 = _mm_packs_epi32(xmm0, xmm0);
+	xmm0 = _mm_packus_epi16(xmm0, xmm0);
+	*reinterpret_cast<int*>(ptr) = _mm_cvtsi128_si32(xmm0);
+}
+
+inline __m128 lerp(__m128 a, __m128 b, __m128 w)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), w));
+}
+
+inline float lerp(float a, float b, float w)
+{
+	return a + (b - a)*w;
+}
+
+// dest = source + dest*(255-source.a)/255, exact rounding. Premultiplied "over", the common case.
+
+inline __m128i over_epi16(__m128i s, __m128i d)
+{
+	const __m128i mask255 = _mm_set1_epi16(255);
+	const __m128i round   = _mm_set1_epi16(128);
+
+	__m128i a = _mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3));
+	a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+
+	__m128i t = _mm_mullo_epi16(d, _mm_sub_epi16(mask255, a));
+	t = _mm_add_epi16(t, round);
+	t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+
+	return t;
+}
+
+void over_row(uint8_t* dest, const uint8_t* source, int count)
+{
+	const __m128i zero = _mm_setzero_si128();
+
+	int n = 0;
+	for(; n+4 <= count; n += 4)
+	{
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n*4));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dest + n*4));
+
+		__m128i lo = over_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+		__m128i hi = over_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n*4), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+	}
+
+	for(; n < count; ++n)
+	{
+		__m128i s = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(source + n*4));
+		__m128i d = _mm_cvtsi32_si128(*reinterpret_cast<const int*>(dest + n*4));
+
+		__m128i lo = over_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+
+		*reinterpret_cast<int*>(dest + n*4) = _mm_cvtsi128_si32(_mm_adds_epu8(s, _mm_packus_epi16(lo, lo)));
+	}
+}
+
+// Blend-modes, see shader/blending_glsl.h. Operates on straight (not premultiplied) r, g, b.
+
+float blend_overlay(float base, float blend)	{return base < 0.5f ? (2.0f * base * blend) : (1.0f - 2.0f * (1.0f - base) * (1.0f - blend));}
+float blend_soft_light(float base, float blend)	{return blend < 0.5f ? (2.0f * base * blend + base * base * (1.0f - 2.0f * blend)) : (std::sqrt(base) * (2.0f * blend - 1.0f) + 2.0f * base * (1.0f - blend));}
+float blend_color_dodge(float base, float blend){return blend == 1.0f ? blend : std::min(base / (1.0f - blend), 1.0f);}
+float blend_color_burn(float base, float blend)	{return blend == 0.0f ? blend : std::max(1.0f - ((1.0f - base) / blend), 0.0f);}
+float blend_linear_dodge(float base, float blend){return std::min(base + blend, 1.0f);}
+float blend_linear_burn(float base, float blend){return std::max(base + blend - 1.0f, 0.0f);}
+float blend_linear_light(float base, float blend){return blend < 0.5f ? blend_linear_burn(base, 2.0f * blend) : blend_linear_dodge(base, 2.0f * (blend - 0.5f));}
+float blend_vivid_light(float base, float blend){return blend < 0.5f ? blend_color_burn(base, 2.0f * blend) : blend_color_dodge(base, 2.0f * (blend - 0.5f));}
+float blend_pin_light(float base, float blend)	{return blend < 0.5f ? std::min(base, 2.0f * blend) : std::max(base, 2.0f * (blend - 0.5f));}
+float blend_hard_mix(float base, float blend)	{return blend_vivid_light(base, blend) < 0.5f ? 0.0f : 1.0f;}
+float blend_reflect(float base, float blend)	{return blend == 1.0f ? blend : std::min(base * base / (1.0f - blend), 1.0f);}
+
+void rgb_to_hsl(const float* c, float* hsl)
+{
+	float fmin  = std::min(std::min(c[0], c[1]), c[2]);
+	float fmax  = std::max(std::max(c[0], c[1]), c[2]);
+	float delta = fmax - fmin;
+
+	hsl[2] = (fmax + fmin) / 2.0f;
+
+	if(delta == 0.0f)
+	{
+		hsl[0] = 0.0f;
+		hsl[1] = 0.0f;
+		return;
+	}
+
+	hsl[1] = hsl[2] < 0.5f ? delta / (fmax + fmin) : delta / (2.0f - fmax - fmin);
+
+	float delta_r = (((fmax - c[0]) / 6.0f) + (delta / 2.0f)) / delta;
+	float delta_g = (((fmax - c[1]) / 6.0f) + (delta / 2.0f)) / delta;
+	float delta_b = (((fmax - c[2]) / 6.0f) + (delta / 2.0f)) / delta;
+
+	if(c[0] == fmax)
+		hsl[0] = delta_b - delta_g;
+	else if(c[1] == fmax)
+		hsl[0] = (1.0f / 3.0f) + delta_r - delta_b;
+	else
+		hsl[0] = (2.0f / 3.0f) + delta_g - delta_r;
+
+	if(hsl[0] < 0.0f)
+		hsl[0] += 1.0f;
+	else if(hsl[0] > 1.0f)
+		hsl[0] -= 1.0f;
+}
+
+float hue_to_rgb(float f1, float f2, float hue)
+{
+	if(hue < 0.0f)
+		hue += 1.0f;
+	else if(hue > 1.0f)
+		hue -= 1.0f;
+
+	if((6.0f * hue) < 1.0f)
+		return f1 + (f2 - f1) * 6.0f * hue;
+	else if((2.0f * hue) < 1.0f)
+		return f2;
+	else if((3.0f * hue) < 2.0f)
+		return f1 + (f2 - f1) * ((2.0f / 3.0f) - hue) * 6.0f;
+	return f1;
+}
+
+void hsl_to_rgb(const float* hsl, float* c)
+{
+	if(hsl[1] == 0.0f)
+	{
+		c[0] = c[1] = c[2] = hsl[2];
+		return;
+	}
+
+	float f2 = hsl[2] < 0.5f ? hsl[2] * (1.0f + hsl[1]) : (hsl[2] + hsl[1]) - (hsl[1] * hsl[2]);
+	float f1 = 2.0f * hsl[2] - f2;
+
+	c[0] = hue_to_rgb(f1, f2, hsl[0] + (1.0f/3.0f));
+	c[1] = hue_to_rgb(f1, f2, hsl[0]);
+	c[2] = hue_to_rgb(f1, f2, hsl[0] - (1.0f/3.0f));
+}
+
+// Indices follow get_blend_color in shader/image_shader.cpp.
+void blend_color(blend_mode::type mode, const float* base, const float* blend, float* result)
+{
+	float base_hsl[3];
+	float blend_hsl[3];
+	float hsl[3];
+
+	switch(mode)
+	{
+	case blend_mode::hard_light:
+		for(int n = 0; n < 3; ++n)
+			result[n] = blend_overlay(blend[n], base[n]);
+		return;
+	case blend_mode::glow:
+		for(int n = 0; n < 3; ++n)
+			result[n] = blend_reflect(blend[n], base[n]);
+		return;
+	case blend_mode::contrast: // Hue
+		rgb_to_hsl(base, base_hsl);
+		rgb_to_hsl(blend, blend_hsl);
+		hsl[0] = blend_hsl[0]; hsl[1] = base_hsl[1]; hsl[2] = base_hsl[2];
+		hsl_to_rgb(hsl, result);
+		return;
+	case blend_mode::saturation:
+		rgb_to_hsl(base, base_hsl);
+		rgb_to_hsl(blend, blend_hsl);
+		hsl[0] = base_hsl[0]; hsl[1] = blend_hsl[1]; hsl[2] = base_hsl[2];
+		hsl_to_rgb(hsl, result);
+		return;
+	case blend_mode::color:
+		rgb_to_hsl(base, base_hsl);
+		rgb_to_hsl(blend, blend_hsl);
+		hsl[0] = blend_hsl[0]; hsl[1] = blend_hsl[1]; hsl[2] = base_hsl[2];
+		hsl_to_rgb(hsl, result);
+		return;
+	case blend_mode::luminosity:
+		rgb_to_hsl(base, base_hsl);
+		rgb_to_hsl(blend, blend_hsl);
+		hsl[0] = base_hsl[0]; hsl[1] = base_hsl[1]; hsl[2] = blend_hsl[2];
+		hsl_to_rgb(hsl, result);
+		return;
+	}
+
+	for(int n = 0; n < 3; ++n)
+	{
+		const float a = base[n];
+		const float b = blend[n];
+		switch(mode)
+		{
+		case blend_mode::lighten:		result[n] = std::max(b, a);								break;
+		case blend_mode::darken:		result[n] = std::min(b, a);								break;
+		case blend_mode::multiply:		result[n] = a * b;										break;
+		case blend_mode::average:		result[n] = (a + b) / 2.0f;								break;
+		case blend_mode::add:
+		case blend_mode::linear_dodge:	result[n] = blend_linear_dodge(a, b);					break;
+		case blend_mode::subtract:
+		case blend_mode::linear_burn:	result[n] = blend_linear_burn(a, b);					break;
+		case blend_mode::difference:	result[n] = std::abs(a - b);							break;
+		case blend_mode::negation:		result[n] = 1.0f - std::abs(1.0f - a - b);				break;
+		case blend_mode::exclusion:		result[n] = a + b - 2.0f * a * b;						break;
+		case blend_mode::screen:		result[n] = 1.0f - ((1.0f - a) * (1.0f - b));			break;
+		case blend_mode::overlay:		result[n] = blend_overlay(a, b);						break;
+		case blend_mode::soft_light:	result[n] = blend_soft_light(a, b);						break;
+		case blend_mode::color_dodge:	result[n] = blend_color_dodge(a, b);					break;
+		case blend_mode::color_burn:	result[n] = blend_color_burn(a, b);						break;
+		case blend_mode::linear_light:	result[n] = blend_linear_light(a, b);					break;
+		case blend_mode::vivid_light:	result[n] = blend_vivid_light(a, b);					break;
+		case blend_mode::pin_light:		result[n] = blend_pin_light(a, b);						break;
+		case blend_mode::hard_mix:		result[n] = blend_hard_mix(a, b);						break;
+		case blend_mode::reflect:		result[n] = blend_reflect(a, b);						break;
+		case blend_mode::phoenix:		result[n] = std::min(a, b) - std::max(a, b) + 1.0f;		break;
+		default:						result[n] = b;											break;
+		}
+	}
+}
+
+// Composites "count" premultiplied pixels from "fore" onto the bgra row "dest".
+void blend_row(uint8_t* dest, const float* fore, int count, blend_mode::type mode, keyer::type keyer)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 inv = _mm_set1_ps(1.0f/255.0f);
+
+	for(int n = 0; n < count; ++n)
+	{
+		__m128 f = _mm_load_ps(fore + n*4);
+		__m128 b = _mm_mul_ps(load_pixel(dest + n*4), inv);
+
+		if(mode != blend_mode::normal)
+		{
+			__declspec(align(16)) float fv[4];
+			__declspec(align(16)) float bv[4];
+			_mm_store_ps(fv, f);
+			_mm_store_ps(bv, b);
+
+			const float fa = fv[3] + 0.0000001f;
+			const float ba = bv[3] + 0.0000001f;
+
+			float base[3]	= {bv[2]/ba, bv[1]/ba, bv[0]/ba};
+			float blend[3]	= {fv[2]/fa, fv[1]/fa, fv[0]/fa};
+			float result[3];
+
+			blend_color(mode, base, blend, result);
+
+			fv[0] = result[2]*fv[3];
+			fv[1] = result[1]*fv[3];
+			fv[2] = result[0]*fv[3];
+
+			f = _mm_load_ps(fv);
+		}
+
+		if(keyer == keyer::additive)
+			f = _mm_add_ps(f, b);
+		else
+			f = _mm_add_ps(f, _mm_mul_ps(b, _mm_sub_ps(one, _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3)))));
+
+		store_pixel(dest + n*4, f);
+	}
+}
+
+// Composites into a single channel key buffer, the GL path renders into GL_R8 which keeps the red channel.
+void blend_key_row(uint8_t* dest, const float* fore, int count)
+{
+	for(int n = 0; n < count; ++n)
+	{
+		float value = fore[n*4+2] + (1.0f - fore[n*4+3]) * (static_cast<float>(dest[n]) / 255.0f);
+		dest[n] = static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+}
+
+void multiply_row(float* fore, const uint8_t* key, int count)
+{
+	const __m128 inv = _mm_set1_ps(1.0f/255.0f);
+
+	for(int n = 0; n < count; ++n)
+		_mm_store_ps(fore + n*4, _mm_mul_ps(_mm_load_ps(fore + n*4), _mm_mul_ps(_mm_set1_ps(static_cast<float>(key[n])), inv)));
+}
+
+// Sampling, equivalent of GL_LINEAR with GL_CLAMP_TO_EDGE.
+
+struct plane_sampler
+{
+	const uint8_t*		data;
+	int					linesize;
+	int					width;
+	int					height;
+	int					channels;
+
+	std::vector<int>	x0;
+	std::vector<int>	x1;
+	std::vector<float>	wx;
+
+	double				y_scale;
+	double				y_offset;
+
+	bool				exact;
+
+	struct row
+	{
+		const uint8_t*	row0;
+		const uint8_t*	row1;
+		float			wy;
+	};
+
+	row get_row(int y) const
+	{
+		double t  = (static_cast<double>(y) + 0.5)*y_scale + y_offset - 0.5;
+		double ft = std::floor(t);
+
+		int y0 = std::min(std::max(static_cast<int>(ft), 0), height-1);
+		int y1 = std::min(std::max(static_cast<int>(ft)+1, 0), height-1);
+
+		row r;
+		r.row0 = data + y0*linesize;
+		r.row1 = data + y1*linesize;
+		r.wy   = exact ? 0.0f : static_cast<float>(t - ft);
+		return r;
+	}
+
+	float sample(const row& r, int n) const
+	{
+		const float top = lerp(r.row0[x0[n]], r.row0[x1[n]], wx[n]);
+		const float bot = lerp(r.row1[x0[n]], r.row1[x1[n]], wx[n]);
+		return lerp(top, bot, r.wy) / 255.0f;
+	}
+
+	__m128 sample4(const row& r, int n) const
+	{
+		const __m128 w = _mm_set1_ps(wx[n]);
+		__m128 top = lerp(load_pixel(r.row0 + x0[n]*4), load_pixel(r.row0 + x1[n]*4), w);
+		__m128 bot = lerp(load_pixel(r.row1 + x0[n]*4), load_pixel(r.row1 + x1[n]*4), w);
+		return _mm_mul_ps(lerp(top, bot, _mm_set1_ps(r.wy)), _mm_set1_ps(1.0f/255.0f));
+	}
+};
+
+struct draw_item
+{
+	const cpu_item*					item;
+	int								x0;
+	int								x1;
+	int								y0;
+	int								y1;
+	std::array<plane_sampler, 4>	planes;
+	size_t							plane_count;
+	float							opacity;
+	bool							levels;
+	bool							csb;
+	bool							is_hd;
+	bool							fast; // bgra with 1:1 mapping, i.e. unscaled, and no adjustments.
+
+	draw_item(const cpu_item& item, int width, int height)
+		: item(&item)
+		, plane_count(std::min<size_t>(4, item.pix_desc.planes.size()))
+	{
+		const auto& transform = item.transform;
+
+		const double w = static_cast<double>(width);
+		const double h = static_cast<double>(height);
+
+		auto f_p = transform.fill_translation;
+		auto f_s = transform.fill_scale;
+
+		// Pixel centers inside of the quad, see glBegin(GL_QUADS) in image_kernel.cpp.
+		x0 = static_cast<int>(std::ceil(std::min(f_p[0], f_p[0]+f_s[0])*w - 0.5));
+		x1 = static_cast<int>(std::ceil(std::max(f_p[0], f_p[0]+f_s[0])*w - 0.5));
+		y0 = static_cast<int>(std::ceil(std::min(f_p[1], f_p[1]+f_s[1])*h - 0.5));
+		y1 = static_cast<int>(std::ceil(std::max(f_p[1], f_p[1]+f_s[1])*h - 0.5));
+
+		auto m_p = transform.clip_translation;
+		auto m_s = transform.clip_scale;
+
+		bool scissor = m_p[0] > std::numeric_limits<double>::epsilon()			|| m_p[1] > std::numeric_limits<double>::epsilon() ||
+					   m_s[0] < (1.0 - std::numeric_limits<double>::epsilon())	|| m_s[1] < (1.0 - std::numeric_limits<double>::epsilon());
+
+		if(scissor)
+		{
+			int sx = static_cast<int>(m_p[0]*w);
+			int sy = static_cast<int>(m_p[1]*h);
+			x0 = std::max(x0, sx);
+			y0 = std::max(y0, sy);
+			x1 = std::min(x1, sx + static_cast<int>(m_s[0]*w));
+			y1 = std::min(y1, sy + static_cast<int>(m_s[1]*h));
+		}
+
+		x0 = std::max(x0, 0);
+		y0 = std::max(y0, 0);
+		x1 = std::max(std::min(x1, width),  x0);
+		y1 = std::max(std::min(y1, height), y0);
+
+		bool exact		= true;
+		bool unscaled	= true;
+
+		for(size_t p = 0; p < plane_count; ++p)
+		{
+			const auto& desc	= item.pix_desc.planes[p];
+			auto& plane			= planes[p];
+
+			plane.data		= item.buffers[p]->data();
+			plane.linesize	= static_cast<int>(desc.linesize);
+			plane.width		= static_cast<int>(desc.width);
+			plane.height	= static_cast<int>(desc.height);
+			plane.channels	= static_cast<int>(desc.channels);
+			plane.exact		= true;
+
+			const double x_scale  = desc.width/(f_s[0]*w);
+			const double x_offset = -f_p[0]*w*x_scale;
+
+			plane.y_scale	= desc.height/(f_s[1]*h);
+			plane.y_offset	= -f_p[1]*h*plane.y_scale;
+
+			plane.x0.resize(x1-x0);
+			plane.x1.resize(x1-x0);
+			plane.wx.resize(x1-x0);
+
+			for(int x = x0; x < x1; ++x)
+			{
+				double s  = (static_cast<double>(x) + 0.5)*x_scale + x_offset - 0.5;
+				double fs = std::floor(s);
+				plane.x0[x-x0] = std::min(std::max(static_cast<int>(fs), 0), plane.width-1);
+				plane.x1[x-x0] = std::min(std::max(static_cast<int>(fs)+1, 0), plane.width-1);
+				plane.wx[x-x0] = static_cast<float>(s - fs);
+				if(plane.wx[x-x0] > 0.0001f)
+					plane.exact = false;
+			}
+
+			for(int y = y0; y < y1 && plane.exact; ++y)
+			{
+				double t = (static_cast<double>(y) + 0.5)*plane.y_scale + plane.y_offset - 0.5;
+				if(t - std::floor(t) > 0.0001)
+					plane.exact = false;
+			}
+
+			exact	 = exact && plane.exact;
+			unscaled = unscaled && std::abs(x_scale - 1.0) < 0.000001 && std::abs(plane.y_scale - 1.0) < 0.000001; // Integer downscales are exact too.
+		}
+
+		opacity = transform.is_key ? 1.0f : static_cast<float>(transform.opacity);
+
+		levels = transform.levels.min_input  > epsilon		||
+				 transform.levels.max_input  < 1.0-epsilon	||
+				 transform.levels.min_output > epsilon		||
+				 transform.levels.max_output < 1.0-epsilon	||
+				 std::abs(transform.levels.gamma - 1.0) > epsilon;
+
+		csb = std::abs(transform.brightness - 1.0) > epsilon ||
+			  std::abs(transform.saturation - 1.0) > epsilon ||
+			  std::abs(transform.contrast - 1.0)   > epsilon;
+
+		is_hd = plane_count > 0 && item.pix_desc.planes[0].height > 700;
+
+		fast = exact && unscaled && !levels && !csb && opacity > 1.0f-static_cast<float>(epsilon) &&
+			   item.pix_desc.pix_fmt == pixel_format::bgra && plane_count == 1 && planes[0].channels == 4;
+	}
+
+	bool covers(int y, field_mode::type row_field) const
+	{
+		return (item->transform.field_mode & row_field) != 0 && y >= y0 && y < y1 && x1 > x0;
+	}
+
+	// Fills "fore" with the premultiplied pixels of the span [x0, x1) on row "y", image_shader.cpp: get_rgba_color, levels and csb.
+	void fetch(float* fore, int y) const
+	{
+		const int count = x1 - x0;
+
+		plane_sampler::row rows[4];
+		for(size_t p = 0; p < plane_count; ++p)
+			rows[p] = planes[p].get_row(y);
+
+		const auto& p0 = planes[0];
+
+		switch(item->pix_desc.pix_fmt)
+		{
+		case pixel_format::bgra:
+			for(int n = 0; n < count; ++n)
+				_mm_store_ps(fore + n*4, p0.sample4(rows[0], n));
+			break;
+		case pixel_format::rgba:
+			for(int n = 0; n < count; ++n)
+			{
+				__m128 c = p0.sample4(rows[0], n);
+				_mm_store_ps(fore + n*4, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 1, 2)));
+			}
+			break;
+		case pixel_format::argb:
+			for(int n = 0; n < count; ++n)
+			{
+				__m128 c = p0.sample4(rows[0], n);
+				_mm_store_ps(fore + n*4, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 1, 2, 3)));
+			}
+			break;
+		case pixel_format::abgr:
+			for(int n = 0; n < count; ++n)
+			{
+				__m128 c = p0.sample4(rows[0], n);
+				_mm_store_ps(fore + n*4, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 3, 2, 1)));
+			}
+			break;
+		case pixel_format::gray:
+			for(int n = 0; n < count; ++n)
+			{
+				float v = p0.sample(rows[0], n);
+				_mm_store_ps(fore + n*4, _mm_set_ps(1.0f, v, v, v));
+			}
+			break;
+		case pixel_format::luma:
+			for(int n = 0; n < count; ++n)
+			{
+				float v = (p0.sample(rows[0], n) - 0.065f)/0.859f;
+				_mm_store_ps(fore + n*4, _mm_set_ps(1.0f, v, v, v));
+			}
+			break;
+		case pixel_format::ycbcr:
+		case pixel_format::ycbcra:
+			if(plane_count > 2)
+			{
+				const bool has_alpha = item->pix_desc.pix_fmt == pixel_format::ycbcra && plane_count > 3;
+
+				// ycbcra_to_rgba_sd / ycbcra_to_rgba_hd
+				const float cr_r = is_hd ? 1.793f : 1.596f;
+				const float cr_g = is_hd ? 0.534f : 0.813f;
+				const float cb_g = is_hd ? 0.213f : 0.391f;
+				const float cb_b = is_hd ? 2.115f : 2.018f;
+
+				for(int n = 0; n < count; ++n)
+				{
+					float y_  = 1.164f*(planes[0].sample(rows[0], n)*255.0f - 16.0f);
+					float cb  = planes[1].sample(rows[1], n)*255.0f - 128.0f;
+					float cr  = planes[2].sample(rows[2], n)*255.0f - 128.0f;
+					float a	  = has_alpha ? planes[3].sample(rows[3], n) : 1.0f;
+
+					_mm_store_ps(fore + n*4, _mm_set_ps(a, (y_ + cr_r*cr)/255.0f, (y_ - cr_g*cr - cb_g*cb)/255.0f, (y_ + cb_b*cb)/255.0f));
+				}
+				break;
+			}
+		default:
+			std::fill(fore, fore + count*4, 0.0f);
+		}
+
+		if(levels)
+			apply_levels(fore, count);
+
+		if(csb)
+			apply_csb(fore, count);
+	}
+
+	void apply_levels(float* fore, int count) const
+	{
+		const auto& l = item->transform.levels;
+
+		const float min_input	= static_cast<float>(l.min_input);
+		const float input_range = static_cast<float>(l.max_input - l.min_input);
+		const float inv_gamma	= static_cast<float>(1.0 / l.gamma);
+		const float min_output	= static_cast<float>(l.min_output);
+		const float max_output	= static_cast<float>(l.max_output);
+
+		for(int n = 0; n < count*4; ++n)
+		{
+			if(n % 4 == 3)
+				continue;
+
+			float c = std::min(std::max(fore[n] - min_input, 0.0f) / input_range, 1.0f);
+			c = std::pow(c, inv_gamma);
+			fore[n] = lerp(min_output, max_output, c);
+		}
+	}
+
+	void apply_csb(float* fore, int count) const
+	{
+		const auto& t = item->transform;
+
+		const __m128 brt		= _mm_set_ps(1.0f, static_cast<float>(t.brightness), static_cast<float>(t.brightness), static_cast<float>(t.brightness));
+		const __m128 sat		= _mm_set_ps(1.0f, static_cast<float>(t.saturation), static_cast<float>(t.saturation), static_cast<float>(t.saturation));
+		const __m128 con		= _mm_set_ps(1.0f, static_cast<float>(t.contrast), static_cast<float>(t.contrast), static_cast<float>(t.contrast));
+
+		for(int n = 0; n < count; ++n)
+		{
+			__m128 c = _mm_mul_ps(_mm_load_ps(fore + n*4), brt);
+
+			__declspec(align(16)) float v[4];
+			_mm_store_ps(v, c);
+			const float intensity = v[2]*0.2125f + v[1]*0.7154f + v[0]*0.0721f;
+
+			c = lerp(_mm_set_ps(v[3], intensity, intensity, intensity), c, sat);
+			c = lerp(_mm_set_ps(v[3], 0.5f, 0.5f, 0.5f), c, con);
+
+			_mm_store_ps(fore + n*4, c);
+		}
+	}
+};
+
+typedef std::pair<blend_mode::type, std::vector<draw_item>> draw_layer;
+
+struct scratch
+{
+	byte_row	local_key;
+	byte_row	layer_key;
+	byte_row	mix;
+	byte_row	layer;
+	float_row	fore;
+
+	scratch(int width)
+		: local_key(width)
+		, layer_key(width)
+		, mix(width*4)
+		, layer(width*4)
+		, fore(width*4)
+	{
+	}
+};
+
+}
+
+struct cpu_image_renderer::implementation : boost::noncopyable
+{
+	safe_ptr<cpu_buffer> render(std::vector<cpu_layer>&& layers, const video_format_desc& format_desc)
+	{
+		const int width  = static_cast<int>(format_desc.width);
+		const int height = static_cast<int>(format_desc.height);
+
+		auto result = cpu_buffer::create(format_desc.size);
+
+		std::vector<draw_layer> draw_layers;
+		BOOST_FOREACH(auto& layer, layers)
+		{
+			boost::remove_erase_if(layer.second, [](const cpu_item& item){return item.transform.field_mode == field_mode::empty;});
+
+			draw_layers.push_back(std::make_pair(layer.first, std::vector<draw_item>()));
+			BOOST_FOREACH(auto& item, layer.second)
+				draw_layers.back().second.push_back(draw_item(item, width, height));
+		}
+
+		const bool interlaced = format_desc.field_mode != field_mode::progressive;
+
+		tbb::parallel_for(tbb::blocked_range<int>(0, height, 8), [&](const tbb::blocked_range<int>& r)
+		{
+			scratch s(width);
+			for(int y = r.begin(); y != r.end(); ++y)
+				draw_row(result->data() + y*width*4, y, draw_layers, interlaced, s, width);
+		});
+
+		return result;
+	}
+
+	// Mirrors image_renderer::draw/draw_layer/draw_item for a single row. Upper field is the even rows.
+	void draw_row(uint8_t*						dest,
+				  int							y,
+				  const std::vector<draw_layer>&	layers,
+				  bool							interlaced,
+				  scratch&						s,
+				  int							width)
+	{
+		const auto row_field  = (y % 2) == 0 ? field_mode::upper : field_mode::lower;
+		const auto pass_field = interlaced ? row_field : field_mode::progressive;
+
+		std::memset(dest, 0, width*4);
+
+		bool has_layer_key = false;
+
+		BOOST_FOREACH(auto& layer, layers)
+		{
+			auto in_pass = [&](const draw_item& item){return (item.item->transform.field_mode & pass_field) != 0;};
+
+			if(std::none_of(layer.second.begin(), layer.second.end(), in_pass))
+				continue;
+
+			bool has_local_key = false;
+			bool has_mix	   = false;
+
+			uint8_t* target = dest;
+			if(layer.first != blend_mode::normal)
+			{
+				target = s.layer.data();
+				std::memset(target, 0, width*4);
+			}
+
+			BOOST_FOREACH(auto& item, layer.second)
+			{
+				if(!in_pass(item))
+					continue;
+
+				const auto& transform = item.item->transform;
+				const bool visible = item.plane_count > 0 && transform.opacity >= epsilon && item.covers(y, row_field);
+
+				if(transform.is_key)
+				{
+					if(!has_local_key)
+					{
+						std::memset(s.local_key.data(), 0, width);
+						has_local_key = true;
+					}
+
+					if(visible)
+					{
+						item.fetch(s.fore.data(), y);
+						blend_key_row(s.local_key.data() + item.x0, s.fore.data(), item.x1-item.x0);
+					}
+				}
+				else if(transform.is_mix)
+				{
+					if(!has_mix)
+					{
+						std::memset(s.mix.data(), 0, width*4);
+						has_mix = true;
+					}
+
+					if(visible)
+						draw(item, y, s.mix.data(), has_local_key ? s.local_key.data() : nullptr, has_layer_key ? s.layer_key.data() : nullptr, keyer::additive, s);
+
+					has_local_key = false;
+				}
+				else
+				{
+					if(has_mix)
+					{
+						over_row(target, s.mix.data(), width);
+						has_mix = false;
+					}
+
+					if(visible)
+						draw(item, y, target, has_local_key ? s.local_key.data() : nullptr, has_layer_key ? s.layer_key.data() : nullptr, keyer::linear, s);
+
+					has_local_key = false;
+				}
+			}
+
+			if(has_mix)
+				over_row(target, s.mix.data(), width);
+
+			if(layer.first != blend_mode::normal)
+				draw_mixer_row(dest, target, width, layer.first, s);
+
+			std::swap(s.local_key, s.layer_key);
+			has_layer_key = has_local_key;
+		}
+	}
+
+	void draw(const draw_item& item, int y, uint8_t* target, const uint8_t* local_key, const uint8_t* layer_key, keyer::type keyer, scratch& s)
+	{
+		const int count = item.x1 - item.x0;
+
+		if(item.fast && !local_key && !layer_key && keyer == keyer::linear)
+		{
+			auto row = item.planes[0].get_row(y);
+			over_row(target + item.x0*4, row.row0 + item.planes[0].x0[0]*4, count);
+			return;
+		}
+
+		float* fore = s.fore.data();
+
+		item.fetch(fore, y);
+
+		if(local_key)
+			multiply_row(fore, local_key + item.x0, count);
+
+		if(layer_key)
+			multiply_row(fore, layer_key + item.x0, count);
+
+		if(item.opacity < 1.0f)
+		{
+			const __m128 opacity = _mm_set1_ps(item.opacity);
+			for(int n = 0; n < count; ++n)
+				_mm_store_ps(fore + n*4, _mm_mul_ps(_mm_load_ps(fore + n*4), opacity));
+		}
+
+		blend_row(target + item.x0*4, fore, count, blend_mode::normal, keyer);
+	}
+
+	void draw_mixer_row(uint8_t* dest, const uint8_t* source, int width, blend_mode::type mode, scratch& s)
+	{
+		if(mode == blend_mode::normal)
+		{
+			over_row(dest, source, width);
+			return;
+		}
+
+		float* fore = s.fore.data();
+		const __m128 inv = _mm_set1_ps(1.0f/255.0f);
+		for(int n = 0; n < width; ++n)
+			_mm_store_ps(fore + n*4, _mm_mul_ps(load_pixel(source + n*4), inv));
+
+		blend_row(dest, fore, width, mode, keyer::linear);
+	}
+};
+
+cpu_image_renderer::cpu_image_renderer() : impl_(new implementation()){}
+safe_ptr<cpu_buffer> cpu_image_renderer::operator()(std::vector<cpu_layer>&& layers, const video_format_desc& format_desc){return impl_->render(std::move(layers), format_desc);}
+
+}}
@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include "blend_modes.h"
+
+#include <common/memory/safe_ptr.h>
+
+#include <core/producer/frame/frame_transform.h>
+#include <core/producer/frame/pixel_format.h>
+
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+namespace caspar { namespace core {
+
+class cpu_buffer;
+struct video_format_desc;
+
+struct cpu_item
+{
+	pixel_format_desc					pix_desc;
+	std::vector<safe_ptr<cpu_buffer>>	buffers;
+	frame_transform						transform;
+};
+
+typedef std::pair<blend_mode::type, std::vector<cpu_item>> cpu_layer;
+
+// Software counterpart of image_renderer/image_kernel. Every destination row is composited 
+// independently (all keys and mix buffers are pixel local), rows are distributed with tbb::parallel_for.
+class cpu_image_renderer : boost::noncopyable
+{
+public:
+	cpu_image_renderer();
+
+	safe_ptr<cpu_buffer> operator()(std::vector<cpu_layer>&& layers, const video_format_desc& format_desc);
+private:
+	struct implementation;
+	safe_ptr<implementation> impl_;
+};
+
+}}
@@ -54,6 +54,12 @@ GLubyte lower_pattern[] = {
 	0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff,	0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff,
 	0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff,	0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00,	0xff, 0xff, 0xff, 0xff};
 
+// Deep planes are uploaded as normalized 16-bit words, rescale so that the maximum value at their bit depth is 1.0.
+static double get_plane_scale(size_t depth)
+{
+	return depth > 8 ? 65535.0/static_cast<double>((1 << depth) - 1) : 1.0;
+}
+
 struct image_kernel::implementation : boost::noncopyable
 {	
 	safe_ptr<ogl_device>	ogl_;
@@ -109,6 +115,7 @@ struct image_kernel::implementation : boost::noncopyable
 		shader_->set("has_local_key",	params.local_key);
 		shader_->set("has_layer_key",	params.layer_key);
 		shader_->set("pixel_format",	params.pix_desc.pix_fmt);	
+		shader_->set("plane_scale",		get_plane_scale(params.pix_desc.planes.at(0).depth));
 		shader_->set("opacity",			params.transform.is_key ? 1.0 : params.transform.opacity);	
 		
 		// Setup blend_func
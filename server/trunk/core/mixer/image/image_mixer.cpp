@@ -24,10 +24,14 @@
 #include "image_mixer.h"
 
 #include "image_kernel.h"
+#include "cpu_image_renderer.h"
+#include "pixel_packer.h"
 #include "../write_frame.h"
+#include "../read_frame.h"
 #include "../gpu/ogl_device.h"
 #include "../gpu/host_buffer.h"
 #include "../gpu/device_buffer.h"
+#include "../cpu/cpu_buffer.h"
 
 #include <common/exception/exceptions.h>
 #include <common/gl/gl_check.h>
@@ -63,19 +67,23 @@ class image_renderer
 	safe_ptr<ogl_device>			ogl_;
 	image_kernel					kernel_;	
 	std::shared_ptr<device_buffer>	transferring_buffer_;
+	size_t							depth_;
 public:
 	image_renderer(const safe_ptr<ogl_device>& ogl)
 		: ogl_(ogl)
 		, kernel_(ogl_)
+		, depth_(8)
 	{
 	}
 	
-	boost::unique_future<safe_ptr<host_buffer>> operator()(std::vector<layer>&& layers, const video_format_desc& format_desc)
+	boost::unique_future<safe_ptr<read_frame>> operator()(std::vector<layer>&& layers, const video_format_desc& format_desc, audio_buffer&& audio, size_t depth)
 	{		
 		auto layers2 = make_move_on_copy(std::move(layers));
+		auto audio2	 = make_move_on_copy(std::move(audio));
 		return ogl_->begin_invoke([=]
 		{
-			return do_render(std::move(layers2.value), format_desc);
+			depth_ = depth;
+			return make_safe<read_frame>(ogl_, format_desc.size, do_render(std::move(layers2.value), format_desc), std::move(audio2.value), depth);
 		});
 	}
 
@@ -109,10 +117,10 @@ private:
 			draw(std::move(layers), draw_buffer, format_desc);
 		}
 
-		auto host_buffer = ogl_->create_host_buffer(format_desc.size, host_buffer::read_only);
+		auto host_buffer = ogl_->create_host_buffer(format_desc.size*depth_/8, host_buffer::read_only);
 		ogl_->attach(*draw_buffer);
 		ogl_->read_buffer(*draw_buffer);
-		host_buffer->begin_read(draw_buffer->width(), draw_buffer->height(), format(draw_buffer->stride()));
+		host_buffer->begin_read(draw_buffer->width(), draw_buffer->height(), format(draw_buffer->stride()), type(draw_buffer->depth()));
 		
 		transferring_buffer_ = std::move(draw_buffer);
 
@@ -220,7 +228,7 @@ private:
 
 		draw_params draw_params;
 		draw_params.pix_desc.pix_fmt	= pixel_format::bgra;
-		draw_params.pix_desc.planes		= list_of(pixel_format_desc::plane(source_buffer->width(), source_buffer->height(), 4));
+		draw_params.pix_desc.planes		= list_of(pixel_format_desc::plane(source_buffer->width(), source_buffer->height(), 4, source_buffer->depth()));
 		draw_params.textures			= list_of(source_buffer);
 		draw_params.transform			= frame_transform();
 		draw_params.blend_mode			= blend_mode;
@@ -231,7 +239,7 @@ private:
 			
 	safe_ptr<device_buffer> create_mixer_buffer(size_t stride, const video_format_desc& format_desc)
 	{
-		auto buffer = ogl_->create_device_buffer(format_desc.width, format_desc.height, stride);
+		auto buffer = ogl_->create_device_buffer(format_desc.width, format_desc.height, stride, depth_);
 		ogl_->clear(*buffer);
 		return buffer;
 	}
@@ -239,21 +247,31 @@ private:
 		
 struct image_mixer::implementation : boost::noncopyable
 {	
-	safe_ptr<ogl_device>			ogl_;
-	image_renderer					renderer_;
-	std::vector<frame_transform>	transform_stack_;
-	std::vector<layer>				layers_; // layer/stream/items
+	std::shared_ptr<ogl_device>			ogl_;
+	std::unique_ptr<image_renderer>		renderer_;
+	std::unique_ptr<cpu_image_renderer>	cpu_renderer_;
+	std::vector<frame_transform>		transform_stack_;
+	std::vector<layer>					layers_; // layer/stream/items
+	std::vector<cpu_layer>				cpu_layers_;
+	size_t								depth_;
 public:
-	implementation(const safe_ptr<ogl_device>& ogl) 
+	implementation(const std::shared_ptr<ogl_device>& ogl) 
 		: ogl_(ogl)
-		, renderer_(ogl)
 		, transform_stack_(1)	
+		, depth_(8)
 	{
+		if(ogl_)
+			renderer_.reset(new image_renderer(make_safe_ptr(ogl_)));
+		else
+			cpu_renderer_.reset(new cpu_image_renderer());
 	}
 
 	void begin_layer(blend_mode::type blend_mode)
 	{
-		layers_.push_back(std::make_pair(blend_mode, std::vector<item>()));
+		if(ogl_)
+			layers_.push_back(std::make_pair(blend_mode, std::vector<item>()));
+		else
+			cpu_layers_.push_back(std::make_pair(blend_mode, std::vector<cpu_item>()));
 	}
 		
 	void begin(basic_frame& frame)
@@ -263,6 +281,34 @@ public:
 		
 	void visit(write_frame& frame)
 	{			
+		if(!ogl_)
+		{
+			cpu_item item;
+			item.pix_desc	= frame.get_pixel_format_desc();
+			item.buffers	= frame.get_buffers();
+			item.transform	= transform_stack_.back();
+
+			// The cpu renderer composites 8-bit planes.
+			for(size_t n = 0; n < item.pix_desc.planes.size(); ++n)
+			{
+				auto& plane = item.pix_desc.planes[n];
+				if(plane.depth <= 8)
+					continue;
+
+				auto buffer = cpu_buffer::create(plane.size/2);
+				narrow_samples(buffer->data(), reinterpret_cast<const uint16_t*>(item.buffers[n]->data()), plane.size/2, plane.depth);
+				item.buffers[n] = buffer;
+
+				const auto linesize = plane.linesize/2; // Wrapped planes may have padded lines.
+				plane = pixel_format_desc::plane(plane.width, plane.height, plane.channels);
+				plane.linesize	= linesize;
+				plane.size		= linesize*plane.height;
+			}
+
+			cpu_layers_.back().second.push_back(item);
+			return;
+		}
+
 		item item;
 		item.pix_desc	= frame.get_pixel_format_desc();
 		item.textures	= frame.get_textures();
@@ -279,19 +325,38 @@ public:
 	void end_layer()
 	{		
 	}
+
+	void set_depth(size_t depth)
+	{
+		if(depth != 8 && depth != 16)
+			BOOST_THROW_EXCEPTION(invalid_argument() << arg_name_info("depth") << msg_info("Expected 8 or 16 bits."));
+
+		if(!ogl_ && depth != 8)
+			BOOST_THROW_EXCEPTION(invalid_argument() << arg_name_info("depth") << msg_info("The cpu image mixer only renders 8 bits."));
+
+		depth_ = depth;
+	}
 	
-	boost::unique_future<safe_ptr<host_buffer>> render(const video_format_desc& format_desc)
+	boost::unique_future<safe_ptr<read_frame>> render(const video_format_desc& format_desc, audio_buffer&& audio)
 	{
-		return renderer_(std::move(layers_), format_desc);
+		if(ogl_)
+			return (*renderer_)(std::move(layers_), format_desc, std::move(audio), depth_);
+
+		// The cpu renderer runs on the calling (mixer) thread, the result is ready once it returns.
+		boost::promise<safe_ptr<read_frame>> promise;
+		promise.set_value(make_safe<read_frame>(format_desc.size, (*cpu_renderer_)(std::move(cpu_layers_), format_desc), std::move(audio)));
+		return promise.get_future();
 	}
 };
 
-image_mixer::image_mixer(const safe_ptr<ogl_device>& ogl) : impl_(new implementation(ogl)){}
+image_mixer::image_mixer(const std::shared_ptr<ogl_device>& ogl) : impl_(new implementation(ogl)){}
 void image_mixer::begin(basic_frame& frame){impl_->begin(frame);}
 void image_mixer::visit(write_frame& frame){impl_->visit(frame);}
 void image_mixer::end(){impl_->end();}
-boost::unique_future<safe_ptr<host_buffer>> image_mixer::operator()(const video_format_desc& format_desc){return impl_->render(format_desc);}
+boost::unique_future<safe_ptr<read_frame>> image_mixer::operator()(const video_format_desc& format_desc, audio_buffer&& audio){return impl_->render(format_desc, std::move(audio));}
 void image_mixer::begin_layer(blend_mode::type blend_mode){impl_->begin_layer(blend_mode);}
 void image_mixer::end_layer(){impl_->end_layer();}
+void image_mixer::set_depth(size_t depth){impl_->set_depth(depth);}
+size_t image_mixer::get_depth() const{return impl_->depth_;}
 
 }}
\ No newline at end of file
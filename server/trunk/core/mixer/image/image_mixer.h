@@ -26,6 +26,7 @@
 #include <common/memory/safe_ptr.h>
 
 #include <core/producer/frame/frame_visitor.h>
+#include <core/mixer/audio/audio_mixer.h>
 
 #include <boost/noncopyable.hpp>
 
@@ -34,7 +35,7 @@
 namespace caspar { namespace core {
 
 class write_frame;
-class host_buffer;
+class read_frame;
 class ogl_device;
 struct video_format_desc;
 struct pixel_format_desc;
@@ -42,7 +43,7 @@ struct pixel_format_desc;
 class image_mixer : public core::frame_visitor, boost::noncopyable
 {
 public:
-	image_mixer(const safe_ptr<ogl_device>& ogl);
+	image_mixer(const std::shared_ptr<ogl_device>& ogl); // null ogl => cpu renderer
 	
 	virtual void begin(core::basic_frame& frame);
 	virtual void visit(core::write_frame& frame);
@@ -50,8 +51,11 @@ public:
 
 	void begin_layer(blend_mode::type blend_mode);
 	void end_layer();
+
+	void set_depth(size_t depth); // Bits per channel of the mixed image, 8 or 16 (gpu only).
+	size_t get_depth() const;
 		
-	boost::unique_future<safe_ptr<host_buffer>> operator()(const video_format_desc& format_desc);
+	boost::unique_future<safe_ptr<read_frame>> operator()(const video_format_desc& format_desc, audio_buffer&& audio);
 		
 private:
 	struct implementation;
@@ -0,0 +1,240 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "pixel_packer.h"
+
+#include <tbb/cache_aligned_allocator.h>
+#include <tbb/parallel_for.h>
+
+#include <intrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace caspar { namespace core {
+
+namespace {
+
+typedef std::vector<uint16_t, tbb::cache_aligned_allocator<uint16_t>> sample_row;
+
+static const int fraction_bits	= 21;
+static const int min_code		= 4;	// 0-3 and 1020-1023 are reserved for sdi timing references.
+static const int max_code		= 1019;
+
+struct ycbcr_coefficients
+{
+	int yr, yg, yb;
+	int cbr, cbg, cbb;
+	int crr, crg, crb;
+};
+
+int to_fixed(double value)
+{
+	return static_cast<int>(std::floor(value*static_cast<double>(1 << fraction_bits) + 0.5));
+}
+
+ycbcr_coefficients get_coefficients(size_t height)
+{
+	const double kr = height > 700 ? 0.2126 : 0.299;
+	const double kb = height > 700 ? 0.0722 : 0.114;
+	const double kg = 1.0 - kr - kb;
+
+	// From full range 16-bit to the 876 (luma) and 896 (chroma) code range of 10-bit studio swing.
+	const double y_scale = 876.0/65535.0;
+	const double c_scale = 896.0/65535.0;
+
+	ycbcr_coefficients c;
+	c.yr  = to_fixed(kr*y_scale);
+	c.yg  = to_fixed(kg*y_scale);
+	c.yb  = to_fixed(kb*y_scale);
+	c.cbr = to_fixed(-kr/(2.0*(1.0-kb))*c_scale);
+	c.cbg = to_fixed(-kg/(2.0*(1.0-kb))*c_scale);
+	c.cbb = to_fixed(0.5*c_scale);
+	c.crr = to_fixed(0.5*c_scale);
+	c.crg = to_fixed(-kg/(2.0*(1.0-kr))*c_scale);
+	c.crb = to_fixed(-kb/(2.0*(1.0-kr))*c_scale);
+	return c;
+}
+
+uint16_t to_code(int offset, int value)
+{
+	return static_cast<uint16_t>(std::min(std::max(offset + ((value + (1 << (fraction_bits-1))) >> fraction_bits), min_code), max_code));
+}
+
+int widen(uint8_t value)
+{
+	return value*257;
+}
+
+int widen(uint16_t value)
+{
+	return value;
+}
+
+// Converts one line of bgra to 4:2:2, chroma is the average of each pixel pair.
+template<typename T>
+void convert_row(uint16_t* y, uint16_t* cb, uint16_t* cr, const T* bgra, size_t width, const ycbcr_coefficients& c)
+{
+	for(size_t x = 0; x < width; x += 2)
+	{
+		const T* p0 = bgra + x*4;
+		const T* p1 = x+1 < width ? p0 + 4 : p0;
+
+		y[x] = to_code(64, c.yr*widen(p0[2]) + c.yg*widen(p0[1]) + c.yb*widen(p0[0]));
+		if(x+1 < width)
+			y[x+1] = to_code(64, c.yr*widen(p1[2]) + c.yg*widen(p1[1]) + c.yb*widen(p1[0]));
+
+		const int r = (widen(p0[2]) + widen(p1[2]) + 1) >> 1;
+		const int g = (widen(p0[1]) + widen(p1[1]) + 1) >> 1;
+		const int b = (widen(p0[0]) + widen(p1[0]) + 1) >> 1;
+
+		cb[x/2] = to_code(512, c.cbr*r + c.cbg*g + c.cbb*b);
+		cr[x/2] = to_code(512, c.crr*r + c.crg*g + c.crb*b);
+	}
+}
+
+void narrow_range(uint8_t* dest, const uint16_t* source, size_t count, size_t depth)
+{
+	// Replicate the top bits so that the maximum code becomes 65535, then divide by 257 with rounding.
+	const auto left  = _mm_cvtsi32_si128(static_cast<int>(16 - depth));
+	const auto right = _mm_cvtsi32_si128(static_cast<int>(2*depth - 16));
+	const auto half	 = _mm_set1_epi16(128);
+
+	size_t n = 0;
+	for(; n + 16 <= count; n += 16)
+	{
+		__m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n));
+		__m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + n + 8));
+
+		v0 = _mm_or_si128(_mm_sll_epi16(v0, left), _mm_srl_epi16(v0, right));
+		v1 = _mm_or_si128(_mm_sll_epi16(v1, left), _mm_srl_epi16(v1, right));
+
+		v0 = _mm_adds_epu16(v0, half);
+		v1 = _mm_adds_epu16(v1, half);
+
+		v0 = _mm_srli_epi16(_mm_sub_epi16(v0, _mm_srli_epi16(v0, 8)), 8);
+		v1 = _mm_srli_epi16(_mm_sub_epi16(v1, _mm_srli_epi16(v1, 8)), 8);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + n), _mm_packus_epi16(v0, v1));
+	}
+
+	for(; n < count; ++n)
+	{
+		int v = ((source[n] << (16 - depth)) | (source[n] >> (2*depth - 16))) & 0xFFFF;
+		v = std::min(v + 128, 65535);
+		dest[n] = static_cast<uint8_t>((v - (v >> 8)) >> 8);
+	}
+}
+
+template<typename T>
+void do_pack_v210(uint8_t* dest, const T* bgra, size_t width, size_t height)
+{
+	const auto c		= get_coefficients(height);
+	const auto linesize	= get_v210_linesize(width);
+	const auto width6	= (width + 5) / 6 * 6;
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, height), [&](const tbb::blocked_range<size_t>& r)
+	{
+		sample_row y(width6, 64);
+		sample_row cb(width6/2, 512);
+		sample_row cr(width6/2, 512);
+
+		for(auto line = r.begin(); line != r.end(); ++line)
+		{
+			convert_row(y.data(), cb.data(), cr.data(), bgra + line*width*4, width, c);
+
+			auto out = reinterpret_cast<uint32_t*>(dest + line*linesize);
+			for(size_t x = 0; x < width6; x += 6)
+			{
+				const size_t x2 = x/2;
+				*out++ = cb[x2+0] | (y[x+0]  << 10) | (cr[x2+0] << 20);
+				*out++ = y[x+1]   | (cb[x2+1] << 10) | (y[x+2]  << 20);
+				*out++ = cr[x2+1] | (y[x+3]  << 10) | (cb[x2+2] << 20);
+				*out++ = y[x+4]   | (cr[x2+2] << 10) | (y[x+5]  << 20);
+			}
+
+			std::fill(reinterpret_cast<uint8_t*>(out), dest + (line+1)*linesize, 0);
+		}
+	});
+}
+
+template<typename T>
+void do_pack_yuv422p10(uint16_t* y, uint16_t* cb, uint16_t* cr, size_t y_linesize, size_t c_linesize, const T* bgra, size_t width, size_t height)
+{
+	const auto c = get_coefficients(height);
+
+	tbb::parallel_for<size_t>(0, height, [&](size_t line)
+	{
+		convert_row(reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(y) + line*y_linesize),
+					reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(cb) + line*c_linesize),
+					reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(cr) + line*c_linesize),
+					bgra + line*width*4, width, c);
+	});
+}
+
+}
+
+void narrow_samples(uint8_t* dest, const uint16_t* source, size_t count, size_t depth)
+{
+	static const size_t chunk_size = 65536;
+
+	if(count < 4*chunk_size)
+	{
+		narrow_range(dest, source, count, depth);
+		return;
+	}
+
+	tbb::parallel_for<size_t>(0, (count + chunk_size - 1) / chunk_size, [&](size_t n)
+	{
+		const auto begin = n*chunk_size;
+		narrow_range(dest + begin, source + begin, std::min(chunk_size, count - begin), depth);
+	});
+}
+
+size_t get_v210_linesize(size_t width)
+{
+	return (width + 47) / 48 * 128;
+}
+
+void pack_v210(uint8_t* dest, const uint8_t* bgra8, size_t width, size_t height)
+{
+	do_pack_v210(dest, bgra8, width, height);
+}
+
+void pack_v210(uint8_t* dest, const uint16_t* bgra16, size_t width, size_t height)
+{
+	do_pack_v210(dest, bgra16, width, height);
+}
+
+void pack_yuv422p10(uint16_t* y, uint16_t* cb, uint16_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* bgra8, size_t width, size_t height)
+{
+	do_pack_yuv422p10(y, cb, cr, y_linesize, c_linesize, bgra8, width, height);
+}
+
+void pack_yuv422p10(uint16_t* y, uint16_t* cb, uint16_t* cr, size_t y_linesize, size_t c_linesize, const uint16_t* bgra16, size_t width, size_t height)
+{
+	do_pack_yuv422p10(y, cb, cr, y_linesize, c_linesize, bgra16, width, height);
+}
+
+}}
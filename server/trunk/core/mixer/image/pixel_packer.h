@@ -0,0 +1,43 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace caspar { namespace core {
+
+// Rounds deep samples (9-16 significant bits stored in 16-bit words) to 8 bits.
+void narrow_samples(uint8_t* dest, const uint16_t* source, size_t count, size_t depth);
+
+// Packers from mixed bgra images (read_frame::image_data/image_data16) to 10-bit 4:2:2 studio range ycbcr.
+// Rec. 709 is used above 700 lines and Rec. 601 below, like the image mixer.
+
+size_t get_v210_linesize(size_t width); // Bytes per line, lines are padded to 48 pixels (128 bytes).
+void pack_v210(uint8_t* dest, const uint8_t* bgra8, size_t width, size_t height);
+void pack_v210(uint8_t* dest, const uint16_t* bgra16, size_t width, size_t height);
+
+// Line sizes are in bytes, chroma planes are (width+1)/2 samples wide.
+void pack_yuv422p10(uint16_t* y, uint16_t* cb, uint16_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* bgra8, size_t width, size_t height);
+void pack_yuv422p10(uint16_t* y, uint16_t* cb, uint16_t* cr, size_t y_linesize, size_t c_linesize, const uint16_t* bgra16, size_t width, size_t height);
+
+}}
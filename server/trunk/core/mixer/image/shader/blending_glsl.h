@@ -36,7 +36,7 @@ static std::string get_adjustement_glsl()
 		"\n		const float AvgLumG = 0.5;																																													   "
 		"\n		const float AvgLumB = 0.5;																																													   "
 		"\n																																																					   "
-		"\n		const vec3 LumCoeff = vec3(0.2125, 0.7154, 0.0721);																																							   "
+		"\n		const vec3 LumCoeff = vec3(0.0721, 0.7154, 0.2125); // color is b, g, r.																																							   "
 		"\n																																																					   "
 		"\n		vec3 AvgLumin = vec3(AvgLumR, AvgLumG, AvgLumB);																																							   "
 		"\n		vec3 brtColor = color * brt;																																												   "
@@ -143,6 +143,7 @@ std::string get_fragment(bool blend_modes)
 	"uniform int		blend_mode;														\n"
 	"uniform int		keyer;															\n"
 	"uniform int		pixel_format;													\n"
+	"uniform float		plane_scale;													\n"
 	"																					\n"
 	"uniform float		opacity;														\n"
 	"uniform bool		levels;															\n"
@@ -193,38 +194,43 @@ std::string get_fragment(bool blend_modes)
 	"		return ycbcra_to_rgba_sd(y, cb, cr, a);										\n"
 	"}																					\n"
 	"																					\n"
+	"vec4 sample_plane(sampler2D s)														\n"
+	"{																					\n"
+	"	return texture2D(s, gl_TexCoord[0].st)*plane_scale;							\n"
+	"}																					\n"
+	"																					\n"
 	"vec4 get_rgba_color()																\n"
 	"{																					\n"
 	"	switch(pixel_format)															\n"
 	"	{																				\n"
 	"	case 0:		//gray																\n"
-	"		return vec4(texture2D(plane[0], gl_TexCoord[0].st).rrr, 1.0);				\n"
+	"		return vec4(sample_plane(plane[0]).rrr, 1.0);								\n"
 	"	case 1:		//bgra,																\n"
-	"		return texture2D(plane[0], gl_TexCoord[0].st).bgra;							\n"
+	"		return sample_plane(plane[0]).bgra;											\n"
 	"	case 2:		//rgba,																\n"
-	"		return texture2D(plane[0], gl_TexCoord[0].st).rgba;							\n"
+	"		return sample_plane(plane[0]).rgba;											\n"
 	"	case 3:		//argb,																\n"
-	"		return texture2D(plane[0], gl_TexCoord[0].st).argb;							\n"
+	"		return sample_plane(plane[0]).argb;											\n"
 	"	case 4:		//abgr,																\n"
-	"		return texture2D(plane[0], gl_TexCoord[0].st).gbar;							\n"
+	"		return sample_plane(plane[0]).grab;											\n"
 	"	case 5:		//ycbcr,															\n"
 	"		{																			\n"
-	"			float y  = texture2D(plane[0], gl_TexCoord[0].st).r;					\n"
-	"			float cb = texture2D(plane[1], gl_TexCoord[0].st).r;					\n"
-	"			float cr = texture2D(plane[2], gl_TexCoord[0].st).r;					\n"
+	"			float y  = sample_plane(plane[0]).r;									\n"
+	"			float cb = sample_plane(plane[1]).r;									\n"
+	"			float cr = sample_plane(plane[2]).r;									\n"
 	"			return ycbcra_to_rgba(y, cb, cr, 1.0);									\n"
 	"		}																			\n"
 	"	case 6:		//ycbcra															\n"
 	"		{																			\n"
-	"			float y  = texture2D(plane[0], gl_TexCoord[0].st).r;					\n"
-	"			float cb = texture2D(plane[1], gl_TexCoord[0].st).r;					\n"
-	"			float cr = texture2D(plane[2], gl_TexCoord[0].st).r;					\n"
-	"			float a  = texture2D(plane[3], gl_TexCoord[0].st).r;					\n"
+	"			float y  = sample_plane(plane[0]).r;									\n"
+	"			float cb = sample_plane(plane[1]).r;									\n"
+	"			float cr = sample_plane(plane[2]).r;									\n"
+	"			float a  = sample_plane(plane[3]).r;									\n"
 	"			return ycbcra_to_rgba(y, cb, cr, a);									\n"
 	"		}																			\n"
 	"	case 7:		//luma																\n"
 	"		{																			\n"
-	"			vec3 y3 = texture2D(plane[0], gl_TexCoord[0].st).rrr;					\n"
+	"			vec3 y3 = sample_plane(plane[0]).rrr;									\n"
 	"			return vec4((y3-0.065)/0.859, 1.0);										\n"
 	"		}																			\n"
 	"	}																				\n"
@@ -235,7 +241,7 @@ std::string get_fragment(bool blend_modes)
 	"{																					\n"
 	"	vec4 color = get_rgba_color();													\n"
 	"   if(levels)																		\n"
-	"		color.rgb = LevelsControl(color.rgb, min_input, max_input, gamma, min_output, max_output); \n"
+	"		color.rgb = LevelsControl(color.rgb, min_input, gamma, max_input, min_output, max_output); \n"
 	"	if(csb)																			\n"
 	"		color.rgb = ContrastSaturationBrightness(color.rgb, brt, sat, con);			\n"
 	"	if(has_local_key)																\n"
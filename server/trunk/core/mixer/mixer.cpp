@@ -28,9 +28,11 @@
 
 #include "audio/audio_mixer.h"
 #include "image/image_mixer.h"
+#include "cpu/cpu_buffer.h"
 
 #include <common/env.h>
 #include <common/concurrency/executor.h>
+#include <common/diagnostics/trace.h>
 #include <common/exception/exceptions.h>
 #include <common/gl/gl_check.h>
 #include <common/utility/tweener.h>
@@ -52,8 +54,106 @@
 #include <tbb/spin_mutex.h>
 
 #include <unordered_map>
+#include <vector>
 
 namespace caspar { namespace core {
+
+// Records which write_frames a layer draws and with what accumulated transform. Two equal
+// fingerprints (with the frames kept alive) produce the same image.
+class frame_fingerprint : public frame_visitor
+{
+	struct item
+	{
+		int					layer;
+		const write_frame*	frame;
+		field_mode::type	type;
+		frame_transform		transform;
+
+		bool operator==(const item& other) const
+		{
+			return layer == other.layer && frame == other.frame && type == other.type && equal(transform, other.transform);
+		}
+
+		// Field by field, frame_transform's operator== compares the raw bytes which includes padding and the 
+		// audio_routing shared_ptr. volume is left out since it only affects audio, which is mixed every frame anyway.
+		static bool equal(const frame_transform& lhs, const frame_transform& rhs)
+		{
+			return	lhs.opacity				== rhs.opacity				&&
+					lhs.contrast			== rhs.contrast				&&
+					lhs.brightness			== rhs.brightness			&&
+					lhs.saturation			== rhs.saturation			&&
+					lhs.fill_translation	== rhs.fill_translation		&&
+					lhs.fill_scale			== rhs.fill_scale			&&
+					lhs.clip_translation	== rhs.clip_translation		&&
+					lhs.clip_scale			== rhs.clip_scale			&&
+					lhs.levels.min_input	== rhs.levels.min_input		&&
+					lhs.levels.max_input	== rhs.levels.max_input		&&
+					lhs.levels.gamma		== rhs.levels.gamma			&&
+					lhs.levels.min_output	== rhs.levels.min_output	&&
+					lhs.levels.max_output	== rhs.levels.max_output	&&
+					equal(lhs.audio_routing, rhs.audio_routing)			&&
+					lhs.field_mode			== rhs.field_mode			&&
+					lhs.is_key				== rhs.is_key				&&
+					lhs.is_mix				== rhs.is_mix;
+		}
+
+		// Nested routings are combined into a new matrix every frame, so equal pointers are only the fast case.
+		static bool equal(const audio_routing& lhs, const audio_routing& rhs)
+		{
+			return lhs == rhs || (lhs && rhs && *lhs == *rhs);
+		}
+	};
+
+	std::vector<frame_transform>	transform_stack_;
+	std::vector<item>				items_;
+	int								layer_;
+public:
+	frame_fingerprint()
+		: layer_(0)
+	{
+		transform_stack_.push_back(frame_transform());
+	}
+
+	virtual void begin(basic_frame& frame)
+	{
+		transform_stack_.push_back(transform_stack_.back()*frame.get_frame_transform());
+	}
+
+	virtual void visit(write_frame& frame)
+	{
+		item new_item;
+		new_item.layer		= layer_;
+		new_item.frame		= &frame;
+		new_item.type		= frame.get_type();
+		new_item.transform	= transform_stack_.back();
+		items_.push_back(new_item);
+	}
+
+	virtual void end()
+	{
+		transform_stack_.pop_back();
+	}
+
+	void begin_layer(int index)
+	{
+		layer_ = index;
+	}
+
+	void clear()
+	{
+		items_.clear();
+	}
+
+	void swap(frame_fingerprint& other)
+	{
+		items_.swap(other.items_);
+	}
+
+	bool operator==(const frame_fingerprint& other) const
+	{
+		return items_ == other.items_;
+	}
+};
 		
 struct mixer::implementation : boost::noncopyable
 {		
@@ -63,17 +163,22 @@ struct mixer::implementation : boost::noncopyable
 	safe_ptr<mixer::target_t>		target_;
 	mutable tbb::spin_mutex			format_desc_mutex_;
 	video_format_desc				format_desc_;
-	safe_ptr<ogl_device>			ogl_;
+	std::shared_ptr<ogl_device>		ogl_;
 	
 	audio_mixer	audio_mixer_;
 	image_mixer image_mixer_;
 	
 	std::unordered_map<int, blend_mode::type> blend_modes_;
+
+	frame_fingerprint								fingerprint_;
+	frame_fingerprint								last_fingerprint_;
+	std::map<int, safe_ptr<core::basic_frame>>		last_frames_; // Keeps the fingerprinted write_frames alive so their addresses can't be reused.
+	std::shared_ptr<read_frame>						last_frame_;
 			
 	executor executor_;
 
 public:
-	implementation(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<mixer::target_t>& target, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl) 
+	implementation(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<mixer::target_t>& target, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl) 
 		: graph_(graph)
 		, target_(target)
 		, format_desc_(format_desc)
@@ -82,37 +187,78 @@ public:
 		, audio_mixer_(graph_)
 		, executor_(L"mixer")
 	{			
+		if(executor_pool_size() > 0) // Only strands are ordered by priority class, dedicated threads keep their priority.
+			executor_.set_priority_class(above_normal_priority_class);
 		graph_->set_color("mix-time", diagnostics::color(1.0f, 0.0f, 0.9f, 0.8));
 	}
 	
 	void send(const std::pair<std::map<int, safe_ptr<core::basic_frame>>, std::shared_ptr<void>>& packet)
 	{			
-		executor_.begin_invoke([=]
+		executor_.post([=]
 		{		
 			try
 			{
 				mix_timer_.restart();
 
+				auto trace_id	 = diagnostics::get_trace_id(packet.second);
+				auto trace_begin = diagnostics::trace_now();
+
 				auto frames = packet.first;
 				
+				fingerprint_.clear();
+				BOOST_FOREACH(auto& frame, frames)
+				{
+					frame.second->accept(audio_mixer_);					
+
+					fingerprint_.begin_layer(frame.first);
+					frame.second->accept(fingerprint_);
+				}
+
+				auto audio = audio_mixer_(format_desc_);
+
+				// Static layers (stills, colors, paused clips) return the same frames every tick, reuse the last mixed image.
+				if(last_frame_ && fingerprint_ == last_fingerprint_)
+				{
+					diagnostics::trace("mix", trace_id, trace_begin, diagnostics::trace_now());
+					
+					graph_->set_value("mix-time", mix_timer_.elapsed()*format_desc_.fps*0.5);
+					graph_->add_sample("mix-time", mix_timer_.elapsed()*1000.0);
+
+					target_->send(std::make_pair(make_safe<read_frame>(*last_frame_, std::move(audio)), packet.second));
+					return;
+				}
+
 				BOOST_FOREACH(auto& frame, frames)
 				{
 					auto blend_it = blend_modes_.find(frame.first);
 					image_mixer_.begin_layer(blend_it != blend_modes_.end() ? blend_it->second : blend_mode::normal);
 													
-					frame.second->accept(audio_mixer_);					
 					frame.second->accept(image_mixer_);
 
 					image_mixer_.end_layer();
 				}
 
-				auto image = image_mixer_(format_desc_);
-				auto audio = audio_mixer_(format_desc_);
-				image.wait();
+				auto frame = image_mixer_(format_desc_, std::move(audio));
+
+				auto readback_begin = diagnostics::trace_now();
+
+				{
+					blocking_scope blocking;
+					frame.wait();
+				}
+
+				auto readback_end = diagnostics::trace_now();
+				diagnostics::trace("readback", trace_id, readback_begin, readback_end);
+				diagnostics::trace("mix", trace_id, trace_begin, readback_end);
 
 				graph_->set_value("mix-time", mix_timer_.elapsed()*format_desc_.fps*0.5);
+				graph_->add_sample("mix-time", mix_timer_.elapsed()*1000.0);
 
-				target_->send(std::make_pair(make_safe<read_frame>(ogl_, format_desc_.size, std::move(image.get()), std::move(audio)), packet.second));					
+				last_fingerprint_.swap(fingerprint_);
+				last_frames_	= std::move(frames);
+				last_frame_		= frame.get();
+
+				target_->send(std::make_pair(frame.get(), packet.second));					
 			}
 			catch(...)
 			{
@@ -125,12 +271,30 @@ public:
 	{		
 		return make_safe<write_frame>(ogl_, tag, desc);
 	}
+
+	std::shared_ptr<core::write_frame> wrap_frame(const void* tag, const core::pixel_format_desc& desc, const std::vector<uint8_t*>& planes, const std::shared_ptr<void>& owner)
+	{
+		if(ogl_) // Planes are uploaded from host buffers.
+			return nullptr;
+
+		std::vector<safe_ptr<cpu_buffer>> buffers;
+		for(size_t n = 0; n < desc.planes.size(); ++n)
+			buffers.push_back(cpu_buffer::wrap(planes.at(n), desc.planes[n].size, owner));
+
+		return std::make_shared<write_frame>(tag, desc, buffers);
+	}
+
+	bool can_wrap_frames() const
+	{
+		return !ogl_;
+	}
 				
 	void set_blend_mode(int index, blend_mode::type value)
 	{
 		executor_.begin_invoke([=]
 		{
 			blend_modes_[index] = value;
+			last_frame_.reset();
 		}, high_priority);
 	}
 
@@ -139,6 +303,7 @@ public:
 		executor_.begin_invoke([=]
 		{
 			blend_modes_.erase(index);
+			last_frame_.reset();
 		}, high_priority);
 	}
 
@@ -147,15 +312,26 @@ public:
 		executor_.begin_invoke([=]
 		{
 			blend_modes_.clear();
+			last_frame_.reset();
 		}, high_priority);
 	}
 	
+	void set_image_depth(size_t depth)
+	{
+		executor_.invoke([=]
+		{
+			image_mixer_.set_depth(depth);
+			last_frame_.reset();
+		}, high_priority);
+	}
+
 	void set_video_format_desc(const video_format_desc& format_desc)
 	{
 		executor_.begin_invoke([=]
 		{
 			tbb::spin_mutex::scoped_lock lock(format_desc_mutex_);
 			format_desc_ = format_desc;
+			last_frame_.reset();
 		});
 	}
 
@@ -167,20 +343,27 @@ public:
 
 	boost::unique_future<boost::property_tree::wptree> info() const
 	{
+		boost::property_tree::wptree tree;
+		tree.add(L"image-mixer", ogl_ ? L"gpu" : L"cpu");
+		tree.add(L"image-depth", image_mixer_.get_depth());
+
 		boost::promise<boost::property_tree::wptree> info;
-		info.set_value(boost::property_tree::wptree());
+		info.set_value(tree);
 		return info.get_future();
 	}
 };
 	
-mixer::mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl) 
+mixer::mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl) 
 	: impl_(new implementation(graph, target, format_desc, ogl)){}
 void mixer::send(const std::pair<std::map<int, safe_ptr<core::basic_frame>>, std::shared_ptr<void>>& frames){ impl_->send(frames);}
 core::video_format_desc mixer::get_video_format_desc() const { return impl_->get_video_format_desc(); }
-safe_ptr<core::write_frame> mixer::create_frame(const void* tag, const core::pixel_format_desc& desc){ return impl_->create_frame(tag, desc); }		
+safe_ptr<core::write_frame> mixer::create_frame(const void* tag, const core::pixel_format_desc& desc){ return impl_->create_frame(tag, desc); }
+std::shared_ptr<core::write_frame> mixer::wrap_frame(const void* tag, const core::pixel_format_desc& desc, const std::vector<uint8_t*>& planes, const std::shared_ptr<void>& owner){ return impl_->wrap_frame(tag, desc, planes, owner); }
+bool mixer::can_wrap_frames() const { return impl_->can_wrap_frames(); }		
 void mixer::set_blend_mode(int index, blend_mode::type value){impl_->set_blend_mode(index, value);}
 void mixer::clear_blend_mode(int index) { impl_->clear_blend_mode(index); }
 void mixer::clear_blend_modes() { impl_->clear_blend_modes(); }
 void mixer::set_video_format_desc(const video_format_desc& format_desc){impl_->set_video_format_desc(format_desc);}
+void mixer::set_image_depth(size_t depth){impl_->set_image_depth(depth);}
 boost::unique_future<boost::property_tree::wptree> mixer::info() const{return impl_->info();}
 }}
\ No newline at end of file
@@ -53,7 +53,7 @@ class mixer : public target<std::pair<std::map<int, safe_ptr<core::basic_frame>>
 public:	
 	typedef target<std::pair<safe_ptr<read_frame>, std::shared_ptr<void>>> target_t;
 
-	explicit mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl);
+	explicit mixer(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<target_t>& target, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl); // null ogl => cpu image mixer
 		
 	// target
 
@@ -62,9 +62,12 @@ public:
 	// mixer
 
 	safe_ptr<core::write_frame> create_frame(const void* tag, const core::pixel_format_desc& desc);		
+	std::shared_ptr<core::write_frame> wrap_frame(const void* tag, const core::pixel_format_desc& desc, const std::vector<uint8_t*>& planes, const std::shared_ptr<void>& owner);
+	bool can_wrap_frames() const; // nothrow
 	
 	core::video_format_desc get_video_format_desc() const; // nothrow
 	void set_video_format_desc(const video_format_desc& format_desc);
+	void set_image_depth(size_t depth); // 8 or 16 bits per channel, 16 requires the gpu image mixer.
 	
 	void set_blend_mode(int index, blend_mode::type value);
 	void clear_blend_mode(int index);
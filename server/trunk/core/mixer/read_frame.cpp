@@ -26,6 +26,8 @@
 #include "gpu/fence.h"
 #include "gpu/host_buffer.h"	
 #include "gpu/ogl_device.h"
+#include "cpu/cpu_buffer.h"
+#include "image/pixel_packer.h"
 
 #include <tbb/mutex.h>
 
@@ -33,54 +35,120 @@ namespace caspar { namespace core {
 																																							
 struct read_frame::implementation : boost::noncopyable
 {
-	safe_ptr<ogl_device>		ogl_;
-	size_t						size_;
-	safe_ptr<host_buffer>		image_data_;
-	tbb::mutex					mutex_;
-	audio_buffer				audio_data_;
+	std::shared_ptr<ogl_device>		ogl_;
+	size_t							size_;
+	size_t							depth_;
+	std::shared_ptr<host_buffer>	image_data_;
+	std::shared_ptr<cpu_buffer>		cpu_image_data_;
+	std::shared_ptr<implementation>	image_source_;
+	tbb::mutex						mutex_;
+	audio_buffer					audio_data_;
 
 public:
-	implementation(const safe_ptr<ogl_device>& ogl, size_t size, safe_ptr<host_buffer>&& image_data, audio_buffer&& audio_data) 
+	implementation(const safe_ptr<ogl_device>& ogl, size_t size, safe_ptr<host_buffer>&& image_data, audio_buffer&& audio_data, size_t depth) 
 		: ogl_(ogl)
 		, size_(size)
+		, depth_(depth)
 		, image_data_(std::move(image_data))
 		, audio_data_(std::move(audio_data)){}	
+
+	implementation(size_t size, safe_ptr<cpu_buffer>&& image_data, audio_buffer&& audio_data) 
+		: size_(size)
+		, depth_(8)
+		, cpu_image_data_(std::move(image_data))
+		, audio_data_(std::move(audio_data)){}	
+
+	implementation(const std::shared_ptr<implementation>& image_source, audio_buffer&& audio_data) 
+		: size_(image_source->size_)
+		, depth_(image_source->depth_)
+		, image_source_(image_source)
+		, audio_data_(std::move(audio_data)){}	
 	
 	const boost::iterator_range<const uint8_t*> image_data()
 	{
+		if(image_source_)
+			return image_source_->image_data();
+
+		if(depth_ > 8)
 		{
+			auto data16 = image_data16();
+
 			tbb::mutex::scoped_lock lock(mutex_);
 
-			if(!image_data_->data())
+			if(!cpu_image_data_) // Deep images are narrowed for 8-bit consumers on first use.
 			{
-				image_data_.get()->wait(*ogl_);
-				ogl_->invoke([=]{image_data_.get()->map();}, high_priority);
+				auto data8 = cpu_buffer::create(data16.size());
+				narrow_samples(data8->data(), data16.begin(), data16.size(), 16);
+				cpu_image_data_ = data8;
 			}
 		}
 
+		if(cpu_image_data_)
+		{
+			auto ptr = static_cast<const uint8_t*>(cpu_image_data_->data());
+			return boost::iterator_range<const uint8_t*>(ptr, ptr + cpu_image_data_->size());
+		}
+
+		map();
+
 		auto ptr = static_cast<const uint8_t*>(image_data_->data());
 		return boost::iterator_range<const uint8_t*>(ptr, ptr + image_data_->size());
 	}
+
+	const boost::iterator_range<const uint16_t*> image_data16()
+	{
+		if(image_source_)
+			return image_source_->image_data16();
+
+		if(depth_ <= 8)
+			return boost::iterator_range<const uint16_t*>();
+
+		map();
+
+		auto ptr = static_cast<const uint16_t*>(image_data_->data());
+		return boost::iterator_range<const uint16_t*>(ptr, ptr + image_data_->size()/2);
+	}
+
+	void map()
+	{
+		tbb::mutex::scoped_lock lock(mutex_);
+
+		if(!image_data_->data())
+		{
+			image_data_->wait(*ogl_);
+			ogl_->invoke([=]{image_data_->map();}, high_priority);
+		}
+	}
 	const boost::iterator_range<const int32_t*> audio_data()
 	{
 		return boost::iterator_range<const int32_t*>(audio_data_.data(), audio_data_.data() + audio_data_.size());
 	}
 };
 
-read_frame::read_frame(const safe_ptr<ogl_device>& ogl, size_t size, safe_ptr<host_buffer>&& image_data, audio_buffer&& audio_data) 
-	: impl_(new implementation(ogl, size, std::move(image_data), std::move(audio_data))){}
+read_frame::read_frame(const safe_ptr<ogl_device>& ogl, size_t size, safe_ptr<host_buffer>&& image_data, audio_buffer&& audio_data, size_t depth) 
+	: impl_(new implementation(ogl, size, std::move(image_data), std::move(audio_data), depth)){}
+read_frame::read_frame(size_t size, safe_ptr<cpu_buffer>&& image_data, audio_buffer&& audio_data) 
+	: impl_(new implementation(size, std::move(image_data), std::move(audio_data))){}
+read_frame::read_frame(const read_frame& image, audio_buffer&& audio_data) 
+	: impl_(image.impl_ ? new implementation(image.impl_, std::move(audio_data)) : nullptr){}
 read_frame::read_frame(){}
 const boost::iterator_range<const uint8_t*> read_frame::image_data()
 {
 	return impl_ ? impl_->image_data() : boost::iterator_range<const uint8_t*>();
 }
 
+const boost::iterator_range<const uint16_t*> read_frame::image_data16()
+{
+	return impl_ ? impl_->image_data16() : boost::iterator_range<const uint16_t*>();
+}
+
 const boost::iterator_range<const int32_t*> read_frame::audio_data()
 {
 	return impl_ ? impl_->audio_data() : boost::iterator_range<const int32_t*>();
 }
 
 size_t read_frame::image_size() const{return impl_ ? impl_->size_ : 0;}
+size_t read_frame::image_depth() const{return impl_ ? impl_->depth_ : 8;}
 
 //#include <tbb/scalable_allocator.h>
 //#include <tbb/parallel_for.h>
@@ -35,18 +35,23 @@
 namespace caspar { namespace core {
 	
 class host_buffer;
+class cpu_buffer;
 class ogl_device;
 
 class read_frame : boost::noncopyable
 {
 public:
 	read_frame();
-	read_frame(const safe_ptr<ogl_device>& ogl, size_t size, safe_ptr<host_buffer>&& image_data, audio_buffer&& audio_data);
+	read_frame(const safe_ptr<ogl_device>& ogl, size_t size, safe_ptr<host_buffer>&& image_data, audio_buffer&& audio_data, size_t depth = 8);
+	read_frame(size_t size, safe_ptr<cpu_buffer>&& image_data, audio_buffer&& audio_data);
+	read_frame(const read_frame& image, audio_buffer&& audio_data); // Shares the image of an already mixed frame.
 
-	virtual const boost::iterator_range<const uint8_t*> image_data();
+	virtual const boost::iterator_range<const uint8_t*> image_data(); // bgra, 8 bits per channel.
+	virtual const boost::iterator_range<const uint16_t*> image_data16(); // bgra, 16 bits per channel. Empty unless image_depth() is 16.
 	virtual const boost::iterator_range<const int32_t*> audio_data();
 
-	virtual size_t image_size() const;
+	virtual size_t image_size() const; // Bytes of image_data().
+	virtual size_t image_depth() const;
 		
 private:
 	struct implementation;
@@ -26,6 +26,7 @@
 #include "gpu/ogl_device.h"
 #include "gpu/host_buffer.h"
 #include "gpu/device_buffer.h"
+#include "cpu/cpu_buffer.h"
 
 #include <core/producer/frame/frame_visitor.h>
 #include <core/producer/frame/pixel_format.h>
@@ -39,6 +40,7 @@ struct write_frame::implementation
 	std::shared_ptr<ogl_device>					ogl_;
 	std::vector<std::shared_ptr<host_buffer>>	buffers_;
 	std::vector<safe_ptr<device_buffer>>		textures_;
+	std::vector<safe_ptr<cpu_buffer>>			cpu_buffers_;
 	audio_buffer								audio_data_;
 	const core::pixel_format_desc				desc_;
 	const void*									tag_;
@@ -49,21 +51,38 @@ struct write_frame::implementation
 	{
 	}
 
-	implementation(const safe_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc) 
+	implementation(const std::shared_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc) 
 		: ogl_(ogl)
 		, desc_(desc)
 		, tag_(tag)
 		, mode_(core::field_mode::progressive)
 	{
+		if(!ogl_)
+		{
+			std::transform(desc.planes.begin(), desc.planes.end(), std::back_inserter(cpu_buffers_), [&](const core::pixel_format_desc::plane& plane)
+			{
+				return cpu_buffer::create(plane.size);
+			});
+			return;
+		}
+
 		std::transform(desc.planes.begin(), desc.planes.end(), std::back_inserter(buffers_), [&](const core::pixel_format_desc::plane& plane)
 		{
 			return ogl_->create_host_buffer(plane.size, host_buffer::write_only);
 		});
 		std::transform(desc.planes.begin(), desc.planes.end(), std::back_inserter(textures_), [&](const core::pixel_format_desc::plane& plane)
 		{
-			return ogl_->create_device_buffer(plane.width, plane.height, plane.channels);	
+			return ogl_->create_device_buffer(plane.width, plane.height, plane.channels, plane.depth > 8 ? 16 : 8);	
 		});
 	}
+
+	implementation(const void* tag, const core::pixel_format_desc& desc, const std::vector<safe_ptr<cpu_buffer>>& buffers) 
+		: cpu_buffers_(buffers)
+		, desc_(desc)
+		, tag_(tag)
+		, mode_(core::field_mode::progressive)
+	{
+	}
 			
 	void accept(write_frame& self, core::frame_visitor& visitor)
 	{
@@ -74,6 +93,14 @@ struct write_frame::implementation
 
 	boost::iterator_range<uint8_t*> image_data(size_t index)
 	{
+		if(!ogl_)
+		{
+			if(index >= cpu_buffers_.size())
+				return boost::iterator_range<uint8_t*>();
+			auto ptr = cpu_buffers_[index]->data();
+			return boost::iterator_range<uint8_t*>(ptr, ptr+cpu_buffers_[index]->size());
+		}
+
 		if(index >= buffers_.size() || !buffers_[index]->data())
 			return boost::iterator_range<uint8_t*>();
 		auto ptr = static_cast<uint8_t*>(buffers_[index]->data());
@@ -98,7 +125,7 @@ struct write_frame::implementation
 
 		auto texture = textures_.at(plane_index);
 		
-		ogl_->begin_invoke([=]
+		ogl_->post([=]
 		{			
 			buffer->unmap();
 			buffer->bind();
@@ -109,8 +136,10 @@ struct write_frame::implementation
 };
 	
 write_frame::write_frame(const void* tag) : impl_(new implementation(tag)){}
-write_frame::write_frame(const safe_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc) 
+write_frame::write_frame(const std::shared_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc) 
 	: impl_(new implementation(ogl, tag, desc)){}
+write_frame::write_frame(const void* tag, const core::pixel_format_desc& desc, const std::vector<safe_ptr<cpu_buffer>>& buffers) 
+	: impl_(new implementation(tag, desc, buffers)){}
 write_frame::write_frame(const write_frame& other) : impl_(new implementation(*other.impl_)){}
 write_frame::write_frame(write_frame&& other) : impl_(std::move(other.impl_)){}
 write_frame& write_frame::operator=(const write_frame& other)
@@ -132,6 +161,7 @@ audio_buffer& write_frame::audio_data() { return impl_->audio_data_; }
 const void* write_frame::tag() const {return impl_->tag_;}
 const core::pixel_format_desc& write_frame::get_pixel_format_desc() const{return impl_->desc_;}
 const std::vector<safe_ptr<device_buffer>>& write_frame::get_textures() const{return impl_->textures_;}
+const std::vector<safe_ptr<cpu_buffer>>& write_frame::get_buffers() const{return impl_->cpu_buffers_;}
 void write_frame::commit(size_t plane_index){impl_->commit(plane_index);}
 void write_frame::commit(){impl_->commit();}
 void write_frame::set_type(const field_mode::type& mode){impl_->mode_ = mode;}
@@ -36,6 +36,7 @@
 namespace caspar { namespace core {
 
 class device_buffer;
+class cpu_buffer;
 struct frame_visitor;
 struct pixel_format_desc;
 class ogl_device;	
@@ -44,7 +45,8 @@ class write_frame : public core::basic_frame, boost::noncopyable
 {
 public:	
 	explicit write_frame(const void* tag);
-	explicit write_frame(const safe_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc);
+	explicit write_frame(const std::shared_ptr<ogl_device>& ogl, const void* tag, const core::pixel_format_desc& desc); // null ogl => cpu memory
+	write_frame(const void* tag, const core::pixel_format_desc& desc, const std::vector<safe_ptr<cpu_buffer>>& buffers); // Wraps existing cpu memory.
 
 	write_frame(const write_frame& other);
 	write_frame(write_frame&& other);
@@ -77,6 +79,7 @@ private:
 	friend class image_mixer;
 	
 	const std::vector<safe_ptr<device_buffer>>& get_textures() const;
+	const std::vector<safe_ptr<cpu_buffer>>& get_buffers() const;
 
 	struct implementation;
 	safe_ptr<implementation> impl_;
@@ -27,6 +27,10 @@
 
 #include <boost/noncopyable.hpp>
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 namespace caspar { namespace core {
 	
 class write_frame;
@@ -37,6 +41,11 @@ struct frame_factory : boost::noncopyable
 {
 	virtual ~frame_factory(){}
 	virtual safe_ptr<write_frame> create_frame(const void* video_stream_tag, const pixel_format_desc& desc) = 0;	
+
+	// Wraps planes in memory of someone else without copying them, owner is held for as long as the frame lives. 
+	// Returns nullptr when the planes would have to be copied anyway (e.g. gpu upload), use create_frame then.
+	virtual std::shared_ptr<write_frame> wrap_frame(const void* /*video_stream_tag*/, const pixel_format_desc& /*desc*/, const std::vector<uint8_t*>& /*planes*/, const std::shared_ptr<void>& /*owner*/) {return nullptr;}
+	virtual bool can_wrap_frames() const {return false;} // nothrow, false if wrap_frame always returns nullptr.
 	
 	virtual video_format_desc get_video_format_desc() const = 0; // nothrow
 };
@@ -26,6 +26,69 @@
 #include <common/utility/assert.h>
 
 namespace caspar { namespace core {
+
+audio_matrix::audio_matrix()
+{
+	std::fill(gains.begin(), gains.end(), 0.0f);
+	for(int n = 0; n < max_audio_channels; ++n)
+		gains[n*max_audio_channels + n] = 1.0f;
+}
+
+static const audio_matrix identity_audio_matrix;
+
+bool audio_matrix::is_identity() const
+{
+	return *this == identity_audio_matrix;
+}
+
+audio_matrix operator*(const audio_matrix& lhs, const audio_matrix& rhs)
+{
+	if(rhs.is_identity())
+		return lhs;
+	if(lhs.is_identity())
+		return rhs;
+
+	audio_matrix result;
+	for(int output = 0; output < max_audio_channels; ++output)
+	{
+		for(int source = 0; source < max_audio_channels; ++source)
+		{
+			float gain = 0.0f;
+			for(int n = 0; n < max_audio_channels; ++n)
+				gain += lhs.gains[output*max_audio_channels + n] * rhs.gains[n*max_audio_channels + source];
+			result.gains[output*max_audio_channels + source] = gain;
+		}
+	}
+	return result;
+}
+
+bool operator==(const audio_matrix& lhs, const audio_matrix& rhs)
+{
+	return memcmp(lhs.gains.data(), rhs.gains.data(), sizeof(lhs.gains)) == 0;
+}
+
+bool operator!=(const audio_matrix& lhs, const audio_matrix& rhs)
+{
+	return !(lhs == rhs);
+}
+
+audio_routing make_audio_routing(const audio_matrix& matrix)
+{
+	if(matrix.is_identity())
+		return nullptr;
+
+	return std::make_shared<const audio_matrix>(matrix);
+}
+
+audio_routing combine_audio_routing(const audio_routing& lhs, const audio_routing& rhs)
+{
+	if(!rhs)
+		return lhs;
+	if(!lhs)
+		return rhs;
+
+	return make_audio_routing(*lhs * *rhs);
+}
 		
 frame_transform::frame_transform() 
 	: volume(1.0)
@@ -63,6 +126,7 @@ frame_transform& frame_transform::operator*=(const frame_transform &other)
 	levels.min_output		 = std::max(levels.min_output, other.levels.min_output);
 	levels.max_output		 = std::min(levels.max_output, other.levels.max_output);
 	levels.gamma			*= other.levels.gamma;
+	audio_routing			 = combine_audio_routing(audio_routing, other.audio_routing);
 	field_mode				 = static_cast<field_mode::type>(field_mode & other.field_mode);
 	is_key					|= other.is_key;
 	is_mix					|= other.is_mix;
@@ -100,6 +164,17 @@ frame_transform tween(double time, const frame_transform& source, const frame_tr
 	result.levels.max_output	= do_tween(time, source.levels.max_output,		dest.levels.max_output,		duration, tweener);
 	result.levels.min_output	= do_tween(time, source.levels.min_output,		dest.levels.min_output,		duration, tweener);
 	result.levels.gamma			= do_tween(time, source.levels.gamma,			dest.levels.gamma,			duration, tweener);
+	result.audio_routing		= dest.audio_routing;
+	if(source.audio_routing != dest.audio_routing)
+	{
+		const auto& source_routing	= source.audio_routing ? *source.audio_routing : identity_audio_matrix;
+		const auto& dest_routing	= dest.audio_routing   ? *dest.audio_routing   : identity_audio_matrix;
+
+		audio_matrix routing;
+		for(size_t n = 0; n < routing.gains.size(); ++n)
+			routing.gains[n] = static_cast<float>(do_tween(time, source_routing.gains[n], dest_routing.gains[n], duration, tweener));
+		result.audio_routing = make_audio_routing(routing);
+	}
 	result.field_mode			= static_cast<field_mode::type>(source.field_mode & dest.field_mode);
 	result.is_key				= source.is_key | dest.is_key;
 	result.is_mix				= source.is_mix | dest.is_mix;
@@ -25,6 +25,8 @@
 #include <core/video_format.h>
 
 #include <boost/array.hpp>
+
+#include <memory>
 #include <type_traits>
 
 namespace caspar { namespace core {
@@ -48,6 +50,26 @@ struct levels
 	double max_output;
 };
 
+// Mixes the audio channels of a layer, gains[output*max_audio_channels + source]. Identity by default.
+struct audio_matrix
+{
+	audio_matrix();
+
+	boost::array<float, max_audio_channels*max_audio_channels> gains;
+
+	bool is_identity() const;
+};
+
+audio_matrix operator*(const audio_matrix& lhs, const audio_matrix& rhs); // Applies rhs first.
+bool operator==(const audio_matrix& lhs, const audio_matrix& rhs);
+bool operator!=(const audio_matrix& lhs, const audio_matrix& rhs);
+
+// Transforms are copied for every layer and frame, so routings are shared and immutable. Null is identity.
+typedef std::shared_ptr<const audio_matrix> audio_routing;
+
+audio_routing make_audio_routing(const audio_matrix& matrix); // Null for identity.
+audio_routing combine_audio_routing(const audio_routing& lhs, const audio_routing& rhs); // Applies rhs first.
+
 struct frame_transform 
 {
 public:
@@ -64,6 +86,7 @@ public:
 	boost::array<double, 2>	clip_translation;  
 	boost::array<double, 2>	clip_scale;  
 	levels					levels;
+	core::audio_routing		audio_routing;
 
 	field_mode::type		field_mode;
 	bool					is_key;
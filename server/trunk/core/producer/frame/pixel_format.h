@@ -51,20 +51,23 @@ struct pixel_format_desc
 		size_t height;
 		size_t size;
 		size_t channels;
+		size_t depth; // Significant bits per sample. Samples deeper than 8 bits are stored as little-endian 16-bit words.
 
 		plane() 
 			: linesize(0)
 			, width(0)
 			, height(0)
 			, size(0)
-			, channels(0){}
+			, channels(0)
+			, depth(8){}
 
-		plane(size_t width, size_t height, size_t channels)
-			: linesize(width*channels)
+		plane(size_t width, size_t height, size_t channels, size_t depth = 8)
+			: linesize(width*channels*(depth > 8 ? 2 : 1))
 			, width(width)
 			, height(height)
-			, size(width*height*channels)
-			, channels(channels){}
+			, size(width*height*channels*(depth > 8 ? 2 : 1))
+			, channels(channels)
+			, depth(depth){}
 	};
 
 	pixel_format_desc() : pix_fmt(pixel_format::invalid){}
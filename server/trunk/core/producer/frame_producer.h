@@ -52,7 +52,8 @@ public:
 	{
 		NO_HINT = 0,
 		ALPHA_HINT = 1,
-		DEINTERLACE_HINT
+		DEINTERLACE_HINT = 2,
+		OFFLINE_HINT = 4 // No deadline, wait for input instead of returning a late frame.
 	};
 
 	virtual ~frame_producer(){}	
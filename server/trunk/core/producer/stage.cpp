@@ -29,6 +29,7 @@
 #include "frame/frame_factory.h"
 
 #include <common/concurrency/executor.h>
+#include <common/diagnostics/trace.h>
 
 #include <core/producer/frame/frame_transform.h>
 
@@ -92,6 +93,7 @@ struct stage::implementation : public std::enable_shared_from_this<implementatio
 	safe_ptr<diagnostics::graph>												 graph_;
 	safe_ptr<stage::target_t>													 target_;
 	video_format_desc															 format_desc_;
+	bool																		 offline_;
 																				 
 	boost::timer																 produce_timer_;
 	boost::timer																 tick_timer_;
@@ -105,8 +107,11 @@ public:
 		: graph_(graph)
 		, format_desc_(format_desc)
 		, target_(target)
+		, offline_(false)
 		, executor_(L"stage")
 	{
+		if(executor_pool_size() > 0) // Only strands are ordered by priority class, dedicated threads keep their priority.
+			executor_.set_priority_class(above_normal_priority_class);
 		graph_->set_color("tick-time", diagnostics::color(0.0f, 0.6f, 0.9f, 0.8));	
 		graph_->set_color("produce-time", diagnostics::color(0.0f, 1.0f, 0.0f));
 	}
@@ -114,7 +119,7 @@ public:
 	void spawn_token()
 	{
 		std::weak_ptr<implementation> self = shared_from_this();
-		executor_.begin_invoke([=]{tick(self);});
+		executor_.post([=]{tick(self);});
 	}
 							
 	void tick(const std::weak_ptr<implementation>& self)
@@ -123,6 +128,9 @@ public:
 		{
 			produce_timer_.restart();
 
+			auto trace_id	 = diagnostics::next_trace_id();
+			auto trace_begin = diagnostics::trace_now();
+
 			std::map<int, safe_ptr<basic_frame>> frames;
 		
 			BOOST_FOREACH(auto& layer, layers_)			
@@ -142,6 +150,9 @@ public:
 				if(transform.is_key)
 					hints |= frame_producer::ALPHA_HINT;
 
+				if(offline_)
+					hints |= frame_producer::OFFLINE_HINT;
+
 				auto frame = layer.second.receive(hints);	
 				
 				auto frame1 = make_safe<core::basic_frame>(frame);
@@ -158,17 +169,20 @@ public:
 			});
 			
 			graph_->set_value("produce-time", produce_timer_.elapsed()*format_desc_.fps*0.5);
+			graph_->add_sample("produce-time", produce_timer_.elapsed()*1000.0);
+			diagnostics::trace("produce", trace_id, trace_begin, diagnostics::trace_now());
 			
-			std::shared_ptr<void> ticket(nullptr, [self](void*)
+			auto ticket = diagnostics::make_trace_ticket(trace_id, [self]
 			{
 				auto self2 = self.lock();
 				if(self2)				
-					self2->executor_.begin_invoke([=]{tick(self);});				
+					self2->executor_.post([=]{tick(self);});				
 			});
 
 			target_->send(std::make_pair(frames, ticket));
 
 			graph_->set_value("tick-time", tick_timer_.elapsed()*format_desc_.fps*0.5);
+			graph_->add_sample("tick-time", tick_timer_.elapsed()*1000.0);
 			tick_timer_.restart();
 		}
 		catch(...)
@@ -348,6 +362,14 @@ public:
 		}, high_priority);
 	}
 
+	void set_offline(bool offline)
+	{
+		executor_.begin_invoke([=]
+		{
+			offline_ = offline;
+		}, high_priority);
+	}
+
 	boost::unique_future<boost::property_tree::wptree> info()
 	{
 		return std::move(executor_.begin_invoke([this]() -> boost::property_tree::wptree
@@ -388,6 +410,7 @@ boost::unique_future<safe_ptr<frame_producer>> stage::foreground(int index) {ret
 boost::unique_future<safe_ptr<frame_producer>> stage::background(int index) {return impl_->background(index);}
 boost::unique_future<std::wstring> stage::call(int index, bool foreground, const std::wstring& param){return impl_->call(index, foreground, param);}
 void stage::set_video_format_desc(const video_format_desc& format_desc){impl_->set_video_format_desc(format_desc);}
+void stage::set_offline(bool offline){impl_->set_offline(offline);}
 boost::unique_future<boost::property_tree::wptree> stage::info() const{return impl_->info();}
 boost::unique_future<boost::property_tree::wptree> stage::info(int index) const{return impl_->info(index);}
 }}
\ No newline at end of file
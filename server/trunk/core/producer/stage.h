@@ -74,6 +74,7 @@ public:
 	boost::unique_future<boost::property_tree::wptree> info(int layer) const;
 	
 	void set_video_format_desc(const video_format_desc& format_desc);
+	void set_offline(bool offline);
 
 private:
 	struct implementation;
@@ -43,7 +43,7 @@ struct video_channel::implementation : boost::noncopyable
 {
 	const int								index_;
 	video_format_desc						format_desc_;
-	const safe_ptr<ogl_device>				ogl_;
+	const std::shared_ptr<ogl_device>		ogl_;
 	const safe_ptr<diagnostics::graph>		graph_;
 
 	const safe_ptr<caspar::core::output>	output_;
@@ -51,7 +51,7 @@ struct video_channel::implementation : boost::noncopyable
 	const safe_ptr<caspar::core::stage>		stage_;
 	
 public:
-	implementation(int index, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl)  
+	implementation(int index, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl)  
 		: index_(index)
 		, format_desc_(format_desc)
 		, ogl_(ogl)
@@ -68,17 +68,20 @@ public:
 		CASPAR_LOG(info) << print() << " Successfully Initialized.";
 	}
 	
-	void set_video_format_desc(const video_format_desc& format_desc)
+	void set_video_format_desc(const video_format_desc& video_format)
 	{
-		if(format_desc.format == core::video_format::invalid)
+		if(video_format.format == core::video_format::invalid)
 			BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Invalid video-format"));
 
+		const auto format_desc = with_audio_channels(video_format, format_desc_.audio_channels); // The audio layout is fixed for the lifetime of the channel.
+
 		try
 		{
 			output_->set_video_format_desc(format_desc);
 			mixer_->set_video_format_desc(format_desc);
 			stage_->set_video_format_desc(format_desc);
-			ogl_->gc();
+			if(ogl_)
+				ogl_->gc();
 		}
 		catch(...)
 		{
@@ -89,6 +92,21 @@ public:
 		}
 		format_desc_ = format_desc;
 	}
+
+	void set_offline(bool offline)
+	{
+		output_->set_offline(offline);
+		stage_->set_offline(offline);
+
+		CASPAR_LOG(info) << print() << (offline ? L" Running on offline clock." : L" Running on realtime clock.");
+	}
+
+	void set_image_depth(size_t depth)
+	{
+		mixer_->set_image_depth(depth);
+
+		CASPAR_LOG(info) << print() << L" Mixing " << depth << L" bits per channel.";
+	}
 		
 	std::wstring print() const
 	{
@@ -108,20 +126,24 @@ public:
 		output_info.timed_wait(boost::posix_time::seconds(2));
 		
 		info.add(L"video-mode", format_desc_.name);
+		info.add(L"audio-channels", format_desc_.audio_channels);
 		info.add_child(L"stage", stage_info.get());
 		info.add_child(L"mixer", mixer_info.get());
 		info.add_child(L"output", output_info.get());
+		info.add_child(L"statistics", graph_->statistics());
    
 		return info;			   
 	}
 };
 
-video_channel::video_channel(int index, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl) : impl_(new implementation(index, format_desc, ogl)){}
+video_channel::video_channel(int index, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl) : impl_(new implementation(index, format_desc, ogl)){}
 safe_ptr<stage> video_channel::stage() { return impl_->stage_;} 
 safe_ptr<mixer> video_channel::mixer() { return impl_->mixer_;} 
 safe_ptr<output> video_channel::output() { return impl_->output_;} 
 video_format_desc video_channel::get_video_format_desc() const{return impl_->format_desc_;}
 void video_channel::set_video_format_desc(const video_format_desc& format_desc){impl_->set_video_format_desc(format_desc);}
+void video_channel::set_offline(bool offline){impl_->set_offline(offline);}
+void video_channel::set_image_depth(size_t depth){impl_->set_image_depth(depth);}
 boost::property_tree::wptree video_channel::info() const{return impl_->info();}
 int video_channel::index() const {return impl_->index_;}
 
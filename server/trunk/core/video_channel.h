@@ -38,7 +38,7 @@ struct video_format_desc;
 class video_channel : boost::noncopyable
 {
 public:
-	explicit video_channel(int index, const video_format_desc& format_desc, const safe_ptr<ogl_device>& ogl);
+	explicit video_channel(int index, const video_format_desc& format_desc, const std::shared_ptr<ogl_device>& ogl);
 
 	safe_ptr<stage> stage();
 	safe_ptr<mixer>	mixer();
@@ -46,6 +46,8 @@ public:
 	
 	video_format_desc get_video_format_desc() const;
 	void set_video_format_desc(const video_format_desc& format_desc);
+	void set_offline(bool offline); // Free-running clock, frames are rendered as fast as the pipeline allows.
+	void set_image_depth(size_t depth); // Bits per channel of the mixed image, 8 or 16.
 	
 	boost::property_tree::wptree info() const;
 
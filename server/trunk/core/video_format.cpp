@@ -23,8 +23,12 @@
 
 #include "video_format.h"
 
+#include <common/exception/exceptions.h>
+
 #include <boost/algorithm/string.hpp>
 #include <boost/assign.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 
 #define DEFINE_VIDEOFORMATDESC(fmt, w, h, sw, sh, m, scale, duration, audio_samples, name) \
 { \
@@ -90,5 +94,18 @@ const video_format_desc& video_format_desc::get(const std::wstring& name)
 	return format_descs[video_format::invalid];
 }
 
+video_format_desc with_audio_channels(const video_format_desc& format_desc, size_t audio_channels)
+{
+	if(audio_channels < 1 || audio_channels > max_audio_channels)
+		BOOST_THROW_EXCEPTION(out_of_range() << arg_name_info("audio_channels") << arg_value_info(boost::lexical_cast<std::string>(audio_channels)) << msg_info("Supports 1 to 16 audio channels."));
+
+	auto result = format_desc;
+	BOOST_FOREACH(auto& samples, result.audio_cadence)
+		samples = samples / format_desc.audio_channels * audio_channels;
+	result.audio_channels = audio_channels;
+
+	return result;
+}
+
 }}
 
@@ -25,6 +25,8 @@
 #include <string>
 
 namespace caspar { namespace core {
+
+enum { max_audio_channels = 16 };
 	
 struct video_format 
 { 
@@ -117,6 +119,9 @@ struct video_format_desc
 	}
 };
 
+// Returns format_desc with another number of interleaved audio channels, the audio cadence is scaled to match.
+video_format_desc with_audio_channels(const video_format_desc& format_desc, size_t audio_channels);
+
 inline std::wostream& operator<<(std::wostream& out, const video_format_desc& format_desc)
 {
 	out << format_desc.name.c_str();
@@ -84,7 +84,7 @@ public:
 		, vid_fmt_(get_video_mode(*blue_, format_desc))
 		, embedded_audio_(embedded_audio)
 		, key_only_(key_only)
-		, executor_(print())
+		, executor_(print(), dedicated_thread) // Blocks on the card's video sync.
 	{
 		executor_.set_capacity(1);
 
@@ -238,7 +238,7 @@ public:
 		if(!frame->image_data().empty())
 		{
 			if(key_only_)						
-				fast_memshfl(reserved_frames_.front()->image_data(), std::begin(frame->image_data()), frame->image_data().size(), 0x0F0F0F0F, 0x0B0B0B0B, 0x07070707, 0x03030303);
+				fast_memshfl_key(reserved_frames_.front()->image_data(), std::begin(frame->image_data()), frame->image_data().size());
 			else
 				fast_memcpy(reserved_frames_.front()->image_data(), std::begin(frame->image_data()), frame->image_data().size());
 		}
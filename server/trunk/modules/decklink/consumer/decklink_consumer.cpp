@@ -28,6 +28,7 @@
 #include "../interop/DeckLinkAPI_h.h"
 
 #include <core/mixer/read_frame.h>
+#include <core/mixer/image/pixel_packer.h>
 
 #include <common/concurrency/com_context.h>
 #include <common/concurrency/future_util.h>
@@ -38,6 +39,7 @@
 #include <common/memory/memshfl.h>
 
 #include <core/consumer/frame_consumer.h>
+#include <core/mixer/audio/audio_util.h>
 
 #include <tbb/concurrent_queue.h>
 #include <tbb/cache_aligned_allocator.h>
@@ -69,6 +71,7 @@ struct configuration
 	keyer_t		keyer;
 	latency_t	latency;
 	bool		key_only;
+	bool		ten_bit;
 	size_t		base_buffer_depth;
 	
 	configuration()
@@ -77,6 +80,7 @@ struct configuration
 		, keyer(default_keyer)
 		, latency(default_latency)
 		, key_only(false)
+		, ten_bit(false)
 		, base_buffer_depth(3)
 	{
 	}
@@ -94,12 +98,14 @@ class decklink_frame : public IDeckLinkVideoFrame
 	const core::video_format_desc								format_desc_;
 
 	const bool													key_only_;
+	const bool													ten_bit_;
 	std::vector<uint8_t, tbb::cache_aligned_allocator<uint8_t>> data_;
 public:
-	decklink_frame(const safe_ptr<core::read_frame>& frame, const core::video_format_desc& format_desc, bool key_only)
+	decklink_frame(const safe_ptr<core::read_frame>& frame, const core::video_format_desc& format_desc, bool key_only, bool ten_bit)
 		: frame_(frame)
 		, format_desc_(format_desc)
 		, key_only_(key_only)
+		, ten_bit_(ten_bit)
 	{
 		ref_count_ = 0;
 	}
@@ -127,15 +133,29 @@ public:
 
 	STDMETHOD_(long,			GetWidth())			{return format_desc_.width;}        
     STDMETHOD_(long,			GetHeight())		{return format_desc_.height;}        
-    STDMETHOD_(long,			GetRowBytes())		{return format_desc_.width*4;}        
-	STDMETHOD_(BMDPixelFormat,	GetPixelFormat())	{return bmdFormat8BitBGRA;}        
+    STDMETHOD_(long,			GetRowBytes())		{return ten_bit_ ? core::get_v210_linesize(format_desc_.width) : format_desc_.width*4;}        
+	STDMETHOD_(BMDPixelFormat,	GetPixelFormat())	{return ten_bit_ ? bmdFormat10BitYUV : bmdFormat8BitBGRA;}        
     STDMETHOD_(BMDFrameFlags,	GetFlags())			{return bmdFrameFlagDefault;}
         
     STDMETHOD(GetBytes(void** buffer))
 	{
 		try
 		{
-			if(static_cast<size_t>(frame_->image_data().size()) != format_desc_.size)
+			if(ten_bit_)
+			{
+				if(data_.empty())
+				{
+					data_.resize(core::get_v210_linesize(format_desc_.width)*format_desc_.height);
+					if(!frame_->image_data16().empty())
+						core::pack_v210(data_.data(), frame_->image_data16().begin(), format_desc_.width, format_desc_.height);
+					else if(static_cast<size_t>(frame_->image_data().size()) == format_desc_.size)
+						core::pack_v210(data_.data(), frame_->image_data().begin(), format_desc_.width, format_desc_.height);
+					else
+						core::pack_v210(data_.data(), std::vector<uint8_t>(format_desc_.size, 0).data(), format_desc_.width, format_desc_.height);
+				}
+				*buffer = data_.data();
+			}
+			else if(static_cast<size_t>(frame_->image_data().size()) != format_desc_.size)
 			{
 				data_.resize(format_desc_.size, 0);
 				*buffer = data_.data();
@@ -145,7 +165,7 @@ public:
 				if(data_.empty())
 				{
 					data_.resize(frame_->image_data().size());
-					fast_memshfl(data_.data(), frame_->image_data().begin(), frame_->image_data().size(), 0x0F0F0F0F, 0x0B0B0B0B, 0x07070707, 0x03030303);
+					fast_memshfl_key(data_.data(), frame_->image_data().begin(), frame_->image_data().size());
 				}
 				*buffer = data_.data();
 			}
@@ -190,6 +210,8 @@ struct decklink_consumer : public IDeckLinkVideoOutputCallback, public IDeckLink
 		
 	const std::wstring					model_name_;
 	const core::video_format_desc		format_desc_;
+	const size_t						audio_channels_;
+	const bool							ten_bit_;
 	const size_t						buffer_size_;
 
 	long long							video_scheduled_;
@@ -218,6 +240,8 @@ public:
 		, attributes_(decklink_)
 		, model_name_(get_model_name(decklink_))
 		, format_desc_(format_desc)
+		, audio_channels_(get_decklink_audio_channels(format_desc.audio_channels))
+		, ten_bit_(config.ten_bit && !config.key_only && config.keyer != configuration::external_keyer)
 		, buffer_size_(config.buffer_depth()) // Minimum buffer-size 3.
 		, video_scheduled_(0)
 		, audio_scheduled_(0)
@@ -239,7 +263,10 @@ public:
 		graph_->set_text(print());
 		diagnostics::register_graph(graph_);
 		
-		enable_video(get_display_mode(output_, format_desc_.format, bmdFormat8BitBGRA, bmdVideoOutputFlagDefault));
+		if(config.ten_bit && !ten_bit_)
+			CASPAR_LOG(warning) << print() << L" 10-bit output carries no alpha, using 8-bit for key-only and external keying.";
+
+		enable_video(get_display_mode(output_, format_desc_.format, ten_bit_ ? bmdFormat10BitYUV : bmdFormat8BitBGRA, bmdVideoOutputFlagDefault));
 				
 		if(config.embedded_audio)
 			enable_audio();
@@ -316,13 +343,13 @@ public:
 	
 	void enable_audio()
 	{
-		if(FAILED(output_->EnableAudioOutput(bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, 2, bmdAudioOutputStreamTimestamped)))
+		if(FAILED(output_->EnableAudioOutput(bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, audio_channels_, bmdAudioOutputStreamTimestamped)))
 				BOOST_THROW_EXCEPTION(caspar_exception() << msg_info(narrow(print()) + " Could not enable audio output."));
 				
 		if(FAILED(output_->SetAudioCallback(this)))
 			BOOST_THROW_EXCEPTION(caspar_exception() << msg_info(narrow(print()) + " Could not set audio callback."));
 
-		CASPAR_LOG(info) << print() << L" Enabled embedded-audio.";
+		CASPAR_LOG(info) << print() << L" Enabled embedded-audio with " << audio_channels_ << L" channels.";
 	}
 
 	void enable_video(BMDDisplayMode display_mode)
@@ -437,7 +464,13 @@ public:
 	{
 		const int sample_frame_count = audio_data.size()/format_desc_.audio_channels;
 
-		audio_container_.push_back(std::vector<int32_t>(audio_data.begin(), audio_data.end()));
+		if(audio_channels_ != format_desc_.audio_channels)
+		{
+			auto remapped = core::audio_remap_channels(audio_data, format_desc_.audio_channels, audio_channels_);
+			audio_container_.push_back(std::vector<int32_t>(remapped.begin(), remapped.end()));
+		}
+		else
+			audio_container_.push_back(std::vector<int32_t>(audio_data.begin(), audio_data.end()));
 
 		if(FAILED(output_->ScheduleAudioSamples(audio_container_.back().data(), sample_frame_count, audio_scheduled_, format_desc_.audio_sample_rate, nullptr)))
 			CASPAR_LOG(error) << print() << L" Failed to schedule audio.";
@@ -447,7 +480,7 @@ public:
 			
 	void schedule_next_video(const safe_ptr<core::read_frame>& frame)
 	{
-		CComPtr<IDeckLinkVideoFrame> frame2(new decklink_frame(frame, format_desc_, config_.key_only));
+		CComPtr<IDeckLinkVideoFrame> frame2(new decklink_frame(frame, format_desc_, config_.key_only, ten_bit_));
 		if(FAILED(output_->ScheduleVideoFrame(frame2, video_scheduled_, format_desc_.duration, format_desc_.time_scale)))
 			CASPAR_LOG(error) << print() << L" Failed to schedule video.";
 
@@ -576,6 +609,7 @@ public:
 		boost::property_tree::wptree info;
 		info.add(L"type", L"decklink-consumer");
 		info.add(L"key-only", config_.key_only);
+		info.add(L"ten-bit", config_.ten_bit);
 		info.add(L"device", config_.device_index);
 		info.add(L"low-latency", config_.low_latency);
 		info.add(L"embedded-audio", config_.embedded_audio);
@@ -638,6 +672,7 @@ safe_ptr<core::frame_consumer> create_consumer(const boost::property_tree::wptre
 		config.latency = configuration::normal_latency;
 
 	config.key_only				= ptree.get(L"key-only",		config.key_only);
+	config.ten_bit				= ptree.get(L"ten-bit",			config.ten_bit);
 	config.device_index			= ptree.get(L"device",			config.device_index);
 	config.embedded_audio		= ptree.get(L"embedded-audio",	config.embedded_audio);
 	config.base_buffer_depth	= ptree.get(L"buffer-depth",	config.base_buffer_depth);
@@ -39,6 +39,7 @@
 #include <common/utility/param.h>
 
 #include <core/mixer/write_frame.h>
+#include <core/mixer/audio/audio_util.h>
 #include <core/producer/frame/frame_transform.h>
 #include <core/producer/frame/frame_factory.h>
 
@@ -92,6 +93,7 @@ class decklink_producer : boost::noncopyable, public IDeckLinkInputCallback
 	const std::wstring											filter_;
 	
 	core::video_format_desc										format_desc_;
+	const size_t												audio_channels_;
 	std::vector<size_t>											audio_cadence_;
 	boost::circular_buffer<size_t>								sync_buffer_;
 	ffmpeg::frame_muxer											muxer_;
@@ -112,6 +114,7 @@ public:
 		, device_index_(device_index)
 		, filter_(filter)
 		, format_desc_(format_desc)
+		, audio_channels_(get_decklink_audio_channels(format_desc.audio_channels))
 		, audio_cadence_(format_desc.audio_cadence)
 		, muxer_(format_desc.fps, frame_factory, filter)
 		, sync_buffer_(format_desc.audio_cadence.size())
@@ -136,7 +139,7 @@ public:
 									<< msg_info(narrow(print()) + " Could not enable video input.")
 									<< boost::errinfo_api_function("EnableVideoInput"));
 
-		if(FAILED(input_->EnableAudioInput(bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, format_desc_.audio_channels))) 
+		if(FAILED(input_->EnableAudioInput(bmdAudioSampleRate48kHz, bmdAudioSampleType32bitInteger, audio_channels_))) 
 			BOOST_THROW_EXCEPTION(caspar_exception() 
 									<< msg_info(narrow(print()) + " Could not enable audio input.")
 									<< boost::errinfo_api_function("EnableAudioInput"));
@@ -206,7 +209,10 @@ public:
 			{
 				auto sample_frame_count = audio->GetSampleFrameCount();
 				auto audio_data = reinterpret_cast<int32_t*>(bytes);
-				audio_buffer = std::make_shared<core::audio_buffer>(audio_data, audio_data + sample_frame_count*format_desc_.audio_channels);
+				if(audio_channels_ != format_desc_.audio_channels)
+					audio_buffer = std::make_shared<core::audio_buffer>(core::audio_remap_channels(boost::make_iterator_range(audio_data, audio_data + sample_frame_count*audio_channels_), audio_channels_, format_desc_.audio_channels));
+				else
+					audio_buffer = std::make_shared<core::audio_buffer>(audio_data, audio_data + sample_frame_count*format_desc_.audio_channels);
 			}
 			else			
 				audio_buffer = std::make_shared<core::audio_buffer>(audio_cadence_.front(), 0);
@@ -34,6 +34,16 @@
 #include <string>
 
 namespace caspar { namespace decklink {
+
+// DeckLink devices embed 2, 8 or 16 channels. Surplus device channels are silent.
+static size_t get_decklink_audio_channels(size_t audio_channels)
+{
+	if(audio_channels <= 2)
+		return 2;
+	if(audio_channels <= 8)
+		return 8;
+	return 16;
+}
 	
 static BMDDisplayMode get_decklink_video_format(core::video_format::type fmt) 
 {
@@ -29,6 +29,7 @@
 
 #include <core/mixer/read_frame.h>
 #include <core/mixer/audio/audio_util.h>
+#include <core/mixer/image/pixel_packer.h>
 #include <core/consumer/frame_consumer.h>
 #include <core/video_format.h>
 
@@ -430,7 +431,7 @@ public:
 		c->codec_id			= output_format_.acodec;
 		c->codec_type		= AVMEDIA_TYPE_AUDIO;
 		c->sample_rate		= 48000;
-		c->channels			= 2;
+		c->channels			= static_cast<int>(format_desc_.audio_channels);
 		c->sample_fmt		= SAMPLE_FMT_S16;
 
 		if(output_format_.vcodec == CODEC_ID_FLV1)		
@@ -456,6 +457,25 @@ public:
 
 	std::shared_ptr<AVFrame> convert_video(core::read_frame& frame, AVCodecContext* c)
 	{
+		if(c->pix_fmt == PIX_FMT_YUV422P10 && c->width == format_desc_.width && c->height == format_desc_.height)
+		{
+			// Packed directly, keeps the precision of 16-bit channels.
+			std::shared_ptr<AVFrame> out_frame(avcodec_alloc_frame(), av_free);
+			picture_buf_.resize(avpicture_get_size(c->pix_fmt, c->width, c->height));
+			avpicture_fill(reinterpret_cast<AVPicture*>(out_frame.get()), picture_buf_.data(), c->pix_fmt, c->width, c->height);
+
+			auto y  = reinterpret_cast<uint16_t*>(out_frame->data[0]);
+			auto cb = reinterpret_cast<uint16_t*>(out_frame->data[1]);
+			auto cr = reinterpret_cast<uint16_t*>(out_frame->data[2]);
+
+			if(!frame.image_data16().empty())
+				core::pack_yuv422p10(y, cb, cr, out_frame->linesize[0], out_frame->linesize[1], frame.image_data16().begin(), c->width, c->height);
+			else
+				core::pack_yuv422p10(y, cb, cr, out_frame->linesize[0], out_frame->linesize[1], frame.image_data().begin(), c->width, c->height);
+
+			return out_frame;
+		}
+
 		if(!sws_) 
 		{
 			sws_.reset(sws_getContext(format_desc_.width, format_desc_.height, PIX_FMT_BGRA, c->width, c->height, c->pix_fmt, SWS_BICUBIC, nullptr, nullptr, nullptr), sws_freeContext);
@@ -23,6 +23,8 @@
 
 #include "consumer/ffmpeg_consumer.h"
 #include "producer/ffmpeg_producer.h"
+#include "producer/frame_cache.h"
+#include "producer/media_library.h"
 
 #include <common/log/log.h>
 
@@ -206,6 +208,8 @@ void init()
     avformat_network_init();
 	avcodec_init();
     avcodec_register_all();
+
+	init_media_library();
 	
 	core::register_consumer_factory([](const std::vector<std::wstring>& params){return create_consumer(params);});
 	core::register_producer_factory(create_producer);
@@ -213,6 +217,8 @@ void init()
 
 void uninit()
 {
+	uninit_media_library();
+	uninit_frame_cache();
 	avfilter_uninit();
     avformat_network_deinit();
 	av_lockmgr_register(nullptr);
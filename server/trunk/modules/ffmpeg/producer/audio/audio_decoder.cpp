@@ -63,6 +63,10 @@ struct audio_decoder::implementation : boost::noncopyable
 
 	const int64_t												nb_frames_;
 	tbb::atomic<size_t>											file_frame_number_;
+
+	const AVRational											time_base_;
+	double														skip_until_;	// Seconds, audio before this is dropped after an exact seek. Negative when not skipping.
+	double														audio_time_;	// Seconds, time of the next decoded sample. Negative when unknown.
 public:
 	explicit implementation(const safe_ptr<AVFormatContext>& context, const core::video_format_desc& format_desc) 
 		: format_desc_(format_desc)	
@@ -72,6 +76,9 @@ public:
 					 AV_SAMPLE_FMT_S32,				codec_context_->sample_fmt)
 		, buffer1_(AVCODEC_MAX_AUDIO_FRAME_SIZE*2)
 		, nb_frames_(0)//context->streams[index_]->nb_frames)
+		, time_base_(context->streams[index_]->time_base)
+		, skip_until_(-1.0)
+		, audio_time_(-1.0)
 	{		
 		file_frame_number_ = 0;   
 	}
@@ -96,6 +103,8 @@ public:
 		{
 			packets_.pop();
 			file_frame_number_ = static_cast<size_t>(packet->pos);
+			skip_until_		   = packet->pts != AV_NOPTS_VALUE ? static_cast<double>(packet->pts)/AV_TIME_BASE : -1.0;
+			audio_time_		   = -1.0;
 			avcodec_flush_buffers(codec_context_.get());
 			return flush_audio();
 		}
@@ -115,6 +124,11 @@ public:
 		
 		int ret = THROW_ON_ERROR2(avcodec_decode_audio3(codec_context_.get(), reinterpret_cast<int16_t*>(buffer1_.data()), &written_bytes, &pkt), "[audio_decoder]");
 
+		// The packet timestamp belongs to its first frame, later frames in the same packet follow on.
+		if(pkt.pts != AV_NOPTS_VALUE)
+			audio_time_ = pkt.pts*av_q2d(time_base_);
+		pkt.pts = AV_NOPTS_VALUE;
+
 		// There might be several frames in one packet.
 		pkt.size -= ret;
 		pkt.data += ret;
@@ -123,8 +137,31 @@ public:
 
 		buffer1_ = resampler_.resample(std::move(buffer1_));
 		
-		const auto n_samples = buffer1_.size() / av_get_bytes_per_sample(AV_SAMPLE_FMT_S32);
-		const auto samples = reinterpret_cast<int32_t*>(buffer1_.data());
+		auto n_samples = buffer1_.size() / av_get_bytes_per_sample(AV_SAMPLE_FMT_S32);
+		auto samples = reinterpret_cast<int32_t*>(buffer1_.data());
+
+		const auto duration = static_cast<double>(n_samples/format_desc_.audio_channels)/format_desc_.audio_sample_rate;
+
+		if(skip_until_ >= 0.0)
+		{
+			if(audio_time_ < 0.0)
+				skip_until_ = -1.0; // No timestamps to trim by.
+			else if(audio_time_ + duration <= skip_until_)
+			{
+				audio_time_ += duration;
+				return nullptr;
+			}
+			else
+			{
+				const auto skip = std::min(n_samples, static_cast<size_t>(std::max(0.0, (skip_until_ - audio_time_)*format_desc_.audio_sample_rate))*format_desc_.audio_channels);
+				samples   += skip;
+				n_samples -= skip;
+				skip_until_ = -1.0;
+			}
+		}
+
+		if(audio_time_ >= 0.0)
+			audio_time_ += duration;
 
 		++file_frame_number_;
 
@@ -25,6 +25,8 @@
 
 #include <common/exception/exceptions.h>
 
+#include <core/mixer/audio/audio_util.h>
+
 #if defined(_MSC_VER)
 #pragma warning (push)
 #pragma warning (disable : 4244)
@@ -39,12 +41,21 @@ extern "C"
 
 namespace caspar { namespace ffmpeg {
 
+// The ffmpeg resampler only mixes between mono and stereo and down from 5.1 to stereo.
+static bool is_native_layout_change(size_t output_channels, size_t input_channels)
+{
+	return input_channels == output_channels || 
+		  (input_channels <= 2 && output_channels <= 2) || 
+		  (input_channels == 6 && output_channels == 2);
+}
+
 struct audio_resampler::implementation
 {	
 	std::shared_ptr<ReSampleContext> resampler_;
 	
 	std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>> copy_buffer_;
 	std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>> buffer2_;
+	std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>> remap_buffer_;
 
 	const size_t			output_channels_;
 	const AVSampleFormat	output_sample_format_;
@@ -52,17 +63,23 @@ struct audio_resampler::implementation
 	const size_t			input_channels_;
 	const AVSampleFormat	input_sample_format_;
 
+	// Channel counts seen by the ffmpeg resampler. Layouts it cannot convert are remapped before (down) or after (up) resampling.
+	const size_t			resample_input_channels_;
+	const size_t			resample_output_channels_;
+
 	implementation(size_t output_channels, size_t input_channels, size_t output_sample_rate, size_t input_sample_rate, AVSampleFormat output_sample_format, AVSampleFormat input_sample_format)
 		: output_channels_(output_channels)
 		, output_sample_format_(output_sample_format)
 		, input_channels_(input_channels)
 		, input_sample_format_(input_sample_format)
+		, resample_input_channels_(is_native_layout_change(output_channels, input_channels) ? input_channels : std::min(output_channels, input_channels))
+		, resample_output_channels_(is_native_layout_change(output_channels, input_channels) ? output_channels : std::min(output_channels, input_channels))
 	{
-		if(input_channels		!= output_channels || 
-		   input_sample_rate	!= output_sample_rate ||
-		   input_sample_format	!= output_sample_format)
+		if(resample_input_channels_	!= resample_output_channels_ || 
+		   input_sample_rate		!= output_sample_rate ||
+		   input_sample_format		!= output_sample_format)
 		{	
-			auto resampler = av_audio_resample_init(output_channels,		input_channels,
+			auto resampler = av_audio_resample_init(resample_output_channels_,	resample_input_channels_,
 													output_sample_rate,		input_sample_rate,
 													output_sample_format,	input_sample_format,
 													16, 10, 0, 0.8);
@@ -86,19 +103,35 @@ struct audio_resampler::implementation
 
 	std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>> resample(std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>>&& data)
 	{
+		if(input_channels_ != resample_input_channels_)
+			remap(data, input_channels_, resample_input_channels_, av_get_bytes_per_sample(input_sample_format_));
+
 		if(resampler_ && !data.empty())
 		{
 			buffer2_.resize(AVCODEC_MAX_AUDIO_FRAME_SIZE*2);
 			auto ret = audio_resample(resampler_.get(),
 									  reinterpret_cast<short*>(buffer2_.data()), 
 									  reinterpret_cast<short*>(data.data()), 
-									  data.size() / (av_get_bytes_per_sample(input_sample_format_) * input_channels_)); 
-			buffer2_.resize(ret * av_get_bytes_per_sample(output_sample_format_) * output_channels_);
+									  data.size() / (av_get_bytes_per_sample(input_sample_format_) * resample_input_channels_)); 
+			buffer2_.resize(ret * av_get_bytes_per_sample(output_sample_format_) * resample_output_channels_);
 			std::swap(data, buffer2_);
 		}
 
+		if(output_channels_ != resample_output_channels_)
+			remap(data, resample_output_channels_, output_channels_, av_get_bytes_per_sample(output_sample_format_));
+
 		return std::move(data);
 	}
+
+	void remap(std::vector<int8_t, tbb::cache_aligned_allocator<int8_t>>& data, size_t in_channels, size_t out_channels, size_t sample_size)
+	{
+		const auto frames = data.size() / (in_channels * sample_size);
+
+		remap_buffer_.resize(frames * out_channels * sample_size);
+		if(frames > 0)
+			core::audio_remap_channels(remap_buffer_.data(), data.data(), frames, in_channels, out_channels, sample_size);
+		std::swap(data, remap_buffer_);
+	}
 };
 
 
@@ -22,6 +22,8 @@
 #include "../stdafx.h"
 
 #include "ffmpeg_producer.h"
+#include "frame_cache.h"
+#include "media_library.h"
 
 #include "../ffmpeg_error.h"
 
@@ -35,8 +37,10 @@
 #include <common/utility/assert.h>
 #include <common/utility/param.h>
 #include <common/diagnostics/graph.h>
+#include <common/concurrency/executor.h>
 
 #include <core/video_format.h>
+#include <core/mixer/write_frame.h>
 #include <core/producer/frame_producer.h>
 #include <core/producer/frame/frame_factory.h>
 #include <core/producer/frame/basic_frame.h>
@@ -50,6 +54,7 @@
 #include <boost/range/algorithm/find_if.hpp>
 #include <boost/range/algorithm/find.hpp>
 #include <boost/regex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <tbb/parallel_invoke.h>
 
@@ -59,52 +64,71 @@
 
 namespace caspar { namespace ffmpeg {
 				
-struct ffmpeg_producer : public core::frame_producer
+static const size_t PREROLL_FRAMES	= 4;	// Frames decoded ahead at the loop point.
+static const double PREROLL_TIMEOUT	= 2.0;	// Seconds.
+static const uint32_t INPUT_WAIT	= 100;	// Milliseconds, waits for input are re-checked at least this often.
+
+// Frames decoded ahead between LOADBG and PLAY, <ffmpeg><preroll-frames>.
+size_t get_preroll_frames()
 {
-	const std::wstring											filename_;
-	
-	const safe_ptr<diagnostics::graph>							graph_;
-	boost::timer												frame_timer_;
-					
-	const safe_ptr<core::frame_factory>							frame_factory_;
-	const core::video_format_desc								format_desc_;
+	return env::properties().get(L"configuration.ffmpeg.preroll-frames", 8u);
+}
+
+// Pre-rolls of every producer run on a few shared executors, rather than a thread per producer.
+executor& get_preroll_executor()
+{
+	static const size_t PREROLL_EXECUTORS = 4;
 
+	static std::vector<std::shared_ptr<executor>> executors = []() -> std::vector<std::shared_ptr<executor>>
+	{
+		std::vector<std::shared_ptr<executor>> result;
+		for(size_t n = 0; n < PREROLL_EXECUTORS; ++n)
+			result.push_back(std::make_shared<executor>(L"ffmpeg_producer preroll " + boost::lexical_cast<std::wstring>(n)));
+		return result;
+	}();
+	static tbb::atomic<size_t> next;
+
+	return *executors[next.fetch_and_increment() % executors.size()];
+}
+
+// Shared with a pre-roll task, which can outlive its producer.
+struct preroll_state
+{
+	tbb::atomic<bool>	aborted;
+	tbb::atomic<size_t>	fill;
+
+	preroll_state()
+	{
+		aborted	= false;
+		fill	= 0;
+	}
+};
+
+// An input with its decoders and muxer. While looping, the producer keeps a second chain pre-rolled at the loop point
+// and splices it in when the current one reaches the end.
+struct decoder_chain : boost::noncopyable
+{
+	const std::wstring											filename_;
 	input														input_;	
 	std::unique_ptr<video_decoder>								video_decoder_;
 	std::unique_ptr<audio_decoder>								audio_decoder_;	
 	std::unique_ptr<frame_muxer>								muxer_;
-
 	const double												fps_;
-	const uint32_t												start_;
-	const uint32_t												length_;
-
-	safe_ptr<core::basic_frame>									last_frame_;
+	int															decode_hints_;	// Hints of the first decoded frame, negative before it.
+	bool														mixed_hints_;	// Frames have been decoded with different hints.
 	
 	std::queue<std::pair<safe_ptr<core::basic_frame>, size_t>>	frame_buffer_;
 
-	int64_t														frame_number_;
-	uint32_t													file_frame_number_;
-	
-public:
-	explicit ffmpeg_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename, const std::wstring& filter, bool loop, uint32_t start, uint32_t length) 
+	decoder_chain(const safe_ptr<diagnostics::graph>& graph, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename, const std::wstring& filter, uint32_t start, uint32_t length, const void* tag) 
 		: filename_(filename)
-		, frame_factory_(frame_factory)		
-		, format_desc_(frame_factory->get_video_format_desc())
-		, input_(graph_, filename_, loop, start, length)
-		, fps_(read_fps(*input_.context(), format_desc_.fps))
-		, start_(start)
-		, length_(length)
-		, last_frame_(core::basic_frame::empty())
-		, frame_number_(0)
+		, input_(graph, filename, false, start, length)
+		, fps_(read_fps(*input_.context(), frame_factory->get_video_format_desc().fps))
+		, decode_hints_(-1)
+		, mixed_hints_(false)
 	{
-		graph_->set_color("frame-time", diagnostics::color(0.1f, 1.0f, 0.1f));
-		graph_->set_color("underflow", diagnostics::color(0.6f, 0.3f, 0.9f));	
-		diagnostics::register_graph(graph_);
-		
 		try
 		{
-			video_decoder_.reset(new video_decoder(input_.context()));
-			CASPAR_LOG(info) << print() << L" " << video_decoder_->print();
+			video_decoder_.reset(new video_decoder(input_.context(), frame_factory->can_wrap_frames()));
 		}
 		catch(averror_stream_not_found&)
 		{
@@ -119,7 +143,6 @@ public:
 		try
 		{
 			audio_decoder_.reset(new audio_decoder(input_.context(), frame_factory->get_video_format_desc()));
-			CASPAR_LOG(info) << print() << L" " << audio_decoder_->print();
 		}
 		catch(averror_stream_not_found&)
 		{
@@ -134,7 +157,169 @@ public:
 		if(!video_decoder_ && !audio_decoder_)
 			BOOST_THROW_EXCEPTION(averror_stream_not_found() << msg_info("No streams found"));
 
-		muxer_.reset(new frame_muxer(fps_, frame_factory, filter));
+		muxer_.reset(new frame_muxer(fps_, frame_factory, filter, tag)); // One tag for every chain of a producer keeps its audio one stream.
+	}
+
+	bool eof() const
+	{
+		return frame_buffer_.empty() && input_.eof();
+	}
+
+	void try_decode_frame(int hints)
+	{
+		const int decode_hints = hints & ~core::frame_producer::OFFLINE_HINT;
+		if(decode_hints_ < 0)
+			decode_hints_ = decode_hints;
+		else if(decode_hints_ != decode_hints)
+			mixed_hints_ = true;
+
+		std::shared_ptr<AVPacket> pkt;
+
+		for(int n = 0; n < 32 && ((video_decoder_ && !video_decoder_->ready()) || (audio_decoder_ && !audio_decoder_->ready())) && input_.try_pop(pkt); ++n)
+		{
+			if(video_decoder_)
+				video_decoder_->push(pkt);
+			if(audio_decoder_)
+				audio_decoder_->push(pkt);
+		}
+		
+		std::shared_ptr<AVFrame>			video;
+		std::shared_ptr<core::audio_buffer> audio;
+
+		tbb::parallel_invoke(
+		[&]
+		{
+			if(!muxer_->video_ready() && video_decoder_)	
+				video = video_decoder_->poll();	
+		},
+		[&]
+		{		
+			if(!muxer_->audio_ready() && audio_decoder_)		
+				audio = audio_decoder_->poll();		
+		});
+		
+		muxer_->push(video, hints);
+		muxer_->push(audio);
+
+		if(!audio_decoder_)
+		{
+			if(video == flush_video())
+				muxer_->push(flush_audio());
+			else if(!muxer_->audio_ready())
+				muxer_->push(empty_audio());
+		}
+
+		if(!video_decoder_)
+		{
+			if(audio == flush_audio())
+				muxer_->push(flush_video(), 0);
+			else if(!muxer_->video_ready())
+				muxer_->push(empty_video(), 0);
+		}
+		
+		size_t file_frame_number = 0;
+		file_frame_number = std::max(file_frame_number, video_decoder_ ? video_decoder_->file_frame_number() : 0);
+		//file_frame_number = std::max(file_frame_number, audio_decoder_ ? audio_decoder_->file_frame_number() : 0);
+
+		for(auto frame = muxer_->poll(); frame; frame = muxer_->poll())
+			frame_buffer_.push(std::make_pair(make_safe_ptr(frame), file_frame_number));
+	}
+
+	std::wstring print() const
+	{
+		return L"decoder_chain[" + boost::filesystem::wpath(filename_).filename() + L"]";
+	}
+};
+				
+struct ffmpeg_producer : public core::frame_producer
+{
+	const std::wstring											filename_;
+	const std::wstring											filter_;
+	
+	const safe_ptr<diagnostics::graph>							graph_;
+	boost::timer												frame_timer_;
+					
+	const safe_ptr<core::frame_factory>							frame_factory_;
+	const core::video_format_desc								format_desc_;
+
+	const uint32_t												start_;
+	const uint32_t												length_;
+	tbb::atomic<bool>											loop_;
+	int															hints_;
+
+	std::shared_ptr<decoder_chain>								chain_;
+	boost::unique_future<std::shared_ptr<decoder_chain>>		next_chain_;		// Pre-rolled at the loop point while looping.
+	std::shared_ptr<preroll_state>								next_chain_state_;
+	int															next_chain_hints_;
+
+	const double												fps_;
+
+	safe_ptr<core::basic_frame>									last_frame_;
+
+	int64_t														frame_number_;
+	uint32_t													file_frame_number_;
+
+	const std::wstring											cache_key_;			// Empty unless the first pass is recorded.
+	const size_t												max_cached_frames_;
+	const size_t												max_cached_size_;
+	std::shared_ptr<cached_clip>								recording_;			// Handed to the frame cache at the end of the first pass.
+	tbb::atomic<bool>											recording_aborted_;
+
+	const size_t												preroll_target_;
+	const std::shared_ptr<preroll_state>						preroll_state_;		// fill is the frames decoded before the first receive.
+	boost::unique_future<void>									preroll_;			// Owns chain_ until the first receive.
+	
+public:
+	explicit ffmpeg_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename, const std::wstring& filter, bool loop, uint32_t start, uint32_t length) 
+		: filename_(filename)
+		, filter_(filter)
+		, frame_factory_(frame_factory)		
+		, format_desc_(frame_factory->get_video_format_desc())
+		, start_(start)
+		, length_(length)
+		, hints_(core::frame_producer::NO_HINT)
+		, next_chain_hints_(core::frame_producer::NO_HINT)
+		, chain_(std::make_shared<decoder_chain>(graph_, frame_factory, filename, filter, start, length, this))
+		, fps_(chain_->fps_)
+		, last_frame_(core::basic_frame::empty())
+		, frame_number_(0)
+		, cache_key_(is_frame_cache_enabled() && start == 0 && length == std::numeric_limits<uint32_t>::max() ? get_frame_cache_key(filename, frame_factory, filter) : L"")
+		, max_cached_frames_(get_frame_cache_max_frames(format_desc_.fps))
+		, max_cached_size_(get_frame_cache_budget())
+		, preroll_target_(get_preroll_frames())
+		, preroll_state_(std::make_shared<preroll_state>())
+	{
+		loop_				= loop;
+		recording_aborted_	= false;
+
+		if(!cache_key_.empty())
+		{
+			recording_ = std::make_shared<cached_clip>();
+			recording_->filename	= filename_;
+			recording_->fps			= fps_;
+			recording_->width		= chain_->video_decoder_ ? chain_->video_decoder_->width() : 0;
+			recording_->height		= chain_->video_decoder_ ? chain_->video_decoder_->height() : 0;
+			recording_->progressive	= chain_->video_decoder_ ? chain_->video_decoder_->is_progressive() : true;
+		}
+
+		graph_->set_color("frame-time", diagnostics::color(0.1f, 1.0f, 0.1f));
+		graph_->set_color("underflow", diagnostics::color(0.6f, 0.3f, 0.9f));	
+		graph_->set_color("seek", diagnostics::color(1.0f, 0.5f, 0.0f));	
+		diagnostics::register_graph(graph_);
+		
+		if(chain_->video_decoder_)
+			CASPAR_LOG(info) << print() << L" " << chain_->video_decoder_->print();
+		if(chain_->audio_decoder_)
+			CASPAR_LOG(info) << print() << L" " << chain_->audio_decoder_->print();
+
+		preroll_first_frames(); // The next loop is pre-rolled from the first receive, when the hints are known.
+	}
+
+	~ffmpeg_producer()
+	{
+		preroll_state_->aborted = true;
+		if(next_chain_state_)
+			next_chain_state_->aborted = true;
 	}
 
 	// frame_producer
@@ -142,27 +327,48 @@ public:
 	virtual safe_ptr<core::basic_frame> receive(int hints) override
 	{		
 		frame_timer_.restart();
+
+		hints_ = hints & ~core::frame_producer::OFFLINE_HINT;
+		finish_first_preroll(hints_);
+		update_preroll();
 				
-		for(int n = 0; n < 16 && frame_buffer_.size() < 2; ++n)
-			try_decode_frame(hints);
+		for(int n = 0; n < 16 && chain_->frame_buffer_.size() < 2; ++n)
+			chain_->try_decode_frame(hints);
+
+		// Offline channels have no deadline, wait for the input instead of underflowing.
+		while((hints & core::frame_producer::OFFLINE_HINT) && chain_->frame_buffer_.empty() && !chain_->input_.eof())
+		{
+			chain_->try_decode_frame(hints);
+			if(chain_->frame_buffer_.empty())
+				chain_->input_.wait(INPUT_WAIT);
+		}
+
+		if(chain_->eof())
+			finish_recording();
+
+		if(chain_->eof() && loop_)
+			splice_next_chain(hints);
 		
 		graph_->set_value("frame-time", frame_timer_.elapsed()*format_desc_.fps*0.5);
 				
-		if(frame_buffer_.empty() && input_.eof())
+		if(chain_->eof())
 			return last_frame();
 
-		if(frame_buffer_.empty())
+		if(chain_->frame_buffer_.empty())
 		{
 			graph_->set_tag("underflow");	
 			return core::basic_frame::late();			
 		}
 		
-		auto frame = frame_buffer_.front(); 
-		frame_buffer_.pop();
+		auto frame = chain_->frame_buffer_.front(); 
+		chain_->frame_buffer_.pop();
 		
 		++frame_number_;
 		file_frame_number_ = frame.second;
 
+		if(recording_)
+			record(frame.first, hints_);
+
 		graph_->set_text(print());
 
 		return last_frame_ = frame.first;
@@ -175,22 +381,25 @@ public:
 
 	virtual uint32_t nb_frames() const override
 	{
-		if(input_.loop())
+		if(loop_)
 			return std::numeric_limits<uint32_t>::max();
 
 		uint32_t nb_frames = file_nb_frames();
 
 		nb_frames = std::min(length_, nb_frames);
-		nb_frames = muxer_->calc_nb_frames(nb_frames);
+		nb_frames = chain_->muxer_->calc_nb_frames(nb_frames);
 		
 		return nb_frames > start_ ? nb_frames - start_ : 0;
 	}
 
 	uint32_t file_nb_frames() const
 	{
+		if(chain_->input_.nb_frames() > 0) // Exact once the file is indexed.
+			return chain_->input_.nb_frames();
+
 		uint32_t file_nb_frames = 0;
-		file_nb_frames = std::max(file_nb_frames, video_decoder_ ? video_decoder_->nb_frames() : 0);
-		file_nb_frames = std::max(file_nb_frames, audio_decoder_ ? audio_decoder_->nb_frames() : 0);
+		file_nb_frames = std::max(file_nb_frames, chain_->video_decoder_ ? chain_->video_decoder_->nb_frames() : 0);
+		file_nb_frames = std::max(file_nb_frames, chain_->audio_decoder_ ? chain_->audio_decoder_->nb_frames() : 0);
 		return file_nb_frames;
 	}
 	
@@ -213,16 +422,18 @@ public:
 		boost::property_tree::wptree info;
 		info.add(L"type",				L"ffmpeg-producer");
 		info.add(L"filename",			filename_);
-		info.add(L"width",				video_decoder_ ? video_decoder_->width() : 0);
-		info.add(L"height",				video_decoder_ ? video_decoder_->height() : 0);
-		info.add(L"progressive",		video_decoder_ ? video_decoder_->is_progressive() : false);
+		info.add(L"width",				chain_->video_decoder_ ? chain_->video_decoder_->width() : 0);
+		info.add(L"height",				chain_->video_decoder_ ? chain_->video_decoder_->height() : 0);
+		info.add(L"progressive",		chain_->video_decoder_ ? chain_->video_decoder_->is_progressive() : false);
 		info.add(L"fps",				fps_);
-		info.add(L"loop",				input_.loop());
+		info.add(L"loop",				static_cast<bool>(loop_));
 		info.add(L"frame-number",		frame_number_);
 		auto nb_frames2 = nb_frames();
 		info.add(L"nb-frames",			nb_frames2 == std::numeric_limits<int64_t>::max() ? -1 : nb_frames2);
 		info.add(L"file-frame-number",	file_frame_number_);
 		info.add(L"file-nb-frames",		file_nb_frames());
+		info.add(L"preroll-frames",		static_cast<size_t>(preroll_state_->fill));
+		info.add(L"preroll-target",		preroll_target_);
 		return info;
 	}
 
@@ -230,7 +441,7 @@ public:
 
 	std::wstring print_mode() const
 	{
-		return video_decoder_ ? ffmpeg::print_mode(video_decoder_->width(), video_decoder_->height(), fps_, !video_decoder_->is_progressive()) : L"";
+		return chain_->video_decoder_ ? ffmpeg::print_mode(chain_->video_decoder_->width(), chain_->video_decoder_->height(), fps_, !chain_->video_decoder_->is_progressive()) : L"";
 	}
 					
 	std::wstring do_call(const std::wstring& param)
@@ -242,76 +453,216 @@ public:
 		if(boost::regex_match(param, what, loop_exp))
 		{
 			if(!what["VALUE"].str().empty())
-				input_.loop(boost::lexical_cast<bool>(what["VALUE"].str()));
-			return boost::lexical_cast<std::wstring>(input_.loop());
+				loop_ = boost::lexical_cast<bool>(what["VALUE"].str());
+			return boost::lexical_cast<std::wstring>(static_cast<bool>(loop_));
 		}
 		if(boost::regex_match(param, what, seek_exp))
 		{
-			input_.seek(boost::lexical_cast<uint32_t>(what["VALUE"].str()));
+			recording_aborted_ = true; // The recording would have a gap.
+			chain_->input_.seek(boost::lexical_cast<uint32_t>(what["VALUE"].str()));
 			return L"";
 		}
 
 		BOOST_THROW_EXCEPTION(invalid_argument());
 	}
 
-	void try_decode_frame(int hints)
+	// Only a pass decoded and played with the same hints throughout is cached, see cached_clip::hints.
+	void record(const safe_ptr<core::basic_frame>& frame, int hints)
 	{
-		std::shared_ptr<AVPacket> pkt;
+		const auto frame_size = recording_->width*recording_->height*4 + static_cast<size_t>(format_desc_.audio_sample_rate/format_desc_.fps)*format_desc_.audio_channels*4;
 
-		for(int n = 0; n < 32 && ((video_decoder_ && !video_decoder_->ready()) || (audio_decoder_ && !audio_decoder_->ready())) && input_.try_pop(pkt); ++n)
+		if(recording_->frames.empty())
+			recording_->hints = hints;
+
+		if(recording_aborted_ || recording_->frames.size() >= max_cached_frames_ || recording_->size + frame_size > max_cached_size_ ||
+		   recording_->hints != hints || chain_->mixed_hints_ || chain_->decode_hints_ != hints)
 		{
-			if(video_decoder_)
-				video_decoder_->push(pkt);
-			if(audio_decoder_)
-				audio_decoder_->push(pkt);
+			recording_.reset();
+			return;
 		}
-		
-		std::shared_ptr<AVFrame>			video;
-		std::shared_ptr<core::audio_buffer> audio;
 
-		tbb::parallel_invoke(
-		[&]
+		recording_->frames.push_back(frame);
+		recording_->size += frame_size;
+	}
+
+	void finish_recording()
+	{
+		if(recording_ && !recording_aborted_ && !chain_->mixed_hints_)
+			insert_cached_clip(cache_key_, frame_factory_, recording_);
+		recording_.reset();
+	}
+
+	// Decodes the start of the clip while it waits in the background layer, so that PLAY only hands over buffered frames.
+	void preroll_first_frames()
+	{
+		if(preroll_target_ == 0)
+			return;
+
+		auto chain	= chain_;
+		auto state	= preroll_state_;
+		auto target	= preroll_target_;
+		preroll_ = get_preroll_executor().begin_invoke([=]
 		{
-			if(!muxer_->video_ready() && video_decoder_)	
-				video = video_decoder_->poll();	
-		},
-		[&]
-		{		
-			if(!muxer_->audio_ready() && audio_decoder_)		
-				audio = audio_decoder_->poll();		
+			while(!state->aborted && chain->frame_buffer_.size() < target && !chain->input_.eof())
+			{
+				const auto buffered = chain->frame_buffer_.size();
+				chain->try_decode_frame(core::frame_producer::NO_HINT);
+				state->fill = std::min(chain->frame_buffer_.size(), target);
+				if(chain->frame_buffer_.size() == buffered) // The decoders have run out of packets.
+					chain->input_.wait(INPUT_WAIT);
+			}
 		});
+	}
+
+	// The hints are unknown until the first receive, so the pre-roll decodes without them. Frames which need the
+	// hints (keying, deinterlacing) are decoded again from the start.
+	void finish_first_preroll(int hints)
+	{
+		if(preroll_.get_state() == boost::future_state::uninitialized)
+			return;
+
+		preroll_state_->aborted = true; // Returns after at most one frame when playing right after loading.
 		
-		muxer_->push(video, hints);
-		muxer_->push(audio);
+		try
+		{
+			blocking_scope blocking;
+			preroll_.get();
+		}
+		catch(...)
+		{
+			preroll_ = boost::unique_future<void>();
+			throw;
+		}
 
-		if(!audio_decoder_)
+		preroll_ = boost::unique_future<void>();
+
+		if(chain_->decode_hints_ >= 0 && chain_->decode_hints_ != hints)
 		{
-			if(video == flush_video())
-				muxer_->push(flush_audio());
-			else if(!muxer_->audio_ready())
-				muxer_->push(empty_audio());
+			CASPAR_LOG(debug) << print() << L" Discarding pre-rolled frames, they were decoded without the hints of the layer.";
+			chain_ = std::make_shared<decoder_chain>(graph_, frame_factory_, filename_, filter_, start_, length_, this);
+			preroll_state_->fill = 0;
 		}
+	}
 
-		if(!video_decoder_)
+	void update_preroll()
+	{
+		const bool has_next_chain = next_chain_.get_state() != boost::future_state::uninitialized;
+
+		if(!loop_ || (has_next_chain && next_chain_hints_ != hints_))
 		{
-			if(audio == flush_audio())
-				muxer_->push(flush_video(), 0);
-			else if(!muxer_->video_ready())
-				muxer_->push(empty_video(), 0);
+			if(has_next_chain)
+				discard_next_chain();
+			if(!loop_)
+				return;
 		}
+		else if(has_next_chain)
+			return;
+
+		auto graph			= graph_;
+		auto frame_factory	= frame_factory_;
+		auto filename		= filename_;
+		auto filter			= filter_;
+		auto start			= start_;
+		auto length			= length_;
+		auto hints			= hints_;
+		auto tag			= static_cast<const void*>(this);
+		auto state			= std::make_shared<preroll_state>();
 		
-		size_t file_frame_number = 0;
-		file_frame_number = std::max(file_frame_number, video_decoder_ ? video_decoder_->file_frame_number() : 0);
-		//file_frame_number = std::max(file_frame_number, audio_decoder_ ? audio_decoder_->file_frame_number() : 0);
+		// Open and decode the start of the next loop in the background, so that splicing it in costs nothing.
+		next_chain_hints_ = hints;
+		next_chain_state_ = state;
+		next_chain_ = get_preroll_executor().begin_invoke([=]() -> std::shared_ptr<decoder_chain>
+		{
+			if(state->aborted)
+				return nullptr;
 
-		for(auto frame = muxer_->poll(); frame; frame = muxer_->poll())
-			frame_buffer_.push(std::make_pair(make_safe_ptr(frame), file_frame_number));
+			auto chain = std::make_shared<decoder_chain>(graph, frame_factory, filename, filter, start, length, tag);
+
+			boost::timer timer;
+			while(!state->aborted && chain->frame_buffer_.size() < PREROLL_FRAMES && !chain->input_.eof() && timer.elapsed() < PREROLL_TIMEOUT)
+			{
+				const auto buffered = chain->frame_buffer_.size();
+				chain->try_decode_frame(hints);
+				if(chain->frame_buffer_.size() == buffered) // The decoders have run out of packets.
+					chain->input_.wait(INPUT_WAIT);
+			}
+
+			return chain;
+		});
+	}
+
+	void splice_next_chain(int hints)
+	{
+		if(next_chain_.get_state() == boost::future_state::uninitialized)
+			return;
+
+		if(!next_chain_.is_ready())
+		{
+			if(!(hints & core::frame_producer::OFFLINE_HINT))
+			{
+				graph_->set_tag("underflow"); // Holds the last frame until the next loop has been opened.
+				return;
+			}
+			blocking_scope blocking;
+			next_chain_.wait(); // Offline channels have no deadline.
+		}
+
+		try
+		{
+			auto leftover = chain_->muxer_->take_audio();
+			
+			chain_ = next_chain_.get();
+
+			// Samples at the end of the clip which didn't fill a frame go out with the first frame of the next loop. The
+			// frames share the tag of the producer, so the audio mixer plays them as one stream.
+			if(!leftover.empty() && !chain_->frame_buffer_.empty())
+			{
+				auto audio = make_safe<core::write_frame>(this);
+				audio->audio_data() = std::move(leftover);
+
+				auto& front = chain_->frame_buffer_.front().first;
+				std::vector<safe_ptr<core::basic_frame>> frames;
+				frames.push_back(audio);
+				frames.push_back(front);
+				front = make_safe<core::basic_frame>(std::move(frames));
+			}
+
+			graph_->set_tag("seek");
+			CASPAR_LOG(trace) << print() << " Looping.";
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(warning) << print() << " Failed to pre-roll loop.";
+			loop_ = false;
+		}
+
+		discard_next_chain();
+		update_preroll();
+	}
+
+	void discard_next_chain()
+	{
+		if(next_chain_state_)
+			next_chain_state_->aborted = true; // A pre-roll which is still running returns after at most one frame.
+		next_chain_state_.reset();
+		next_chain_ = boost::unique_future<std::shared_ptr<decoder_chain>>();
 	}
 };
 
+std::wstring get_filter(const std::vector<std::wstring>& params)
+{
+	auto filter_str = get_param(L"FILTER", params, L""); 	
+		
+	boost::replace_all(filter_str, L"DEINTERLACE", L"YADIF=0:-1");
+	boost::replace_all(filter_str, L"DEINTERLACE_BOB", L"YADIF=1:-1");
+
+	return filter_str;
+}
+
 safe_ptr<core::frame_producer> create_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::vector<std::wstring>& params)
 {		
-	auto filename = probe_stem(env::media_folder() + L"\\" + params.at(0));
+	auto filename = find_media_file(params.at(0));
 
 	if(filename.empty())
 		return core::frame_producer::empty();
@@ -319,12 +670,59 @@ safe_ptr<core::frame_producer> create_producer(const safe_ptr<core::frame_factor
 	auto loop		= boost::range::find(params, L"LOOP") != params.end();
 	auto start		= get_param(L"SEEK", params, static_cast<uint32_t>(0));
 	auto length		= get_param(L"LENGTH", params, std::numeric_limits<uint32_t>::max());
-	auto filter_str = get_param(L"FILTER", params, L""); 	
-		
-	boost::replace_all(filter_str, L"DEINTERLACE", L"YADIF=0:-1");
-	boost::replace_all(filter_str, L"DEINTERLACE_BOB", L"YADIF=1:-1");
+	auto filter_str = get_filter(params);
+
+	auto create_decoder = [=](bool loop) -> safe_ptr<core::frame_producer>
+	{
+		return create_producer_destroy_proxy(make_safe<ffmpeg_producer>(frame_factory, filename, filter_str, loop, start, length));
+	};
+
+	if(is_frame_cache_enabled())
+	{
+		auto key = get_frame_cache_key(filename, frame_factory, filter_str);
+		if(find_cached_clip(key, -1))
+			return create_cached_producer(key, create_decoder, loop, start, length);
+	}
+	
+	return create_decoder(loop);
+}
+
+void warm_producer_cache(const safe_ptr<core::frame_factory>& frame_factory, const std::vector<std::wstring>& params)
+{
+	if(!is_frame_cache_enabled())
+		BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("Frame cache is disabled."));
+
+	auto filename = find_media_file(params.at(0));
+
+	if(filename.empty())
+		BOOST_THROW_EXCEPTION(file_not_found() << msg_info(narrow(params.at(0))));
+
+	auto filter_str = get_filter(params);
 	
-	return create_producer_destroy_proxy(make_safe<ffmpeg_producer>(frame_factory, filename, filter_str, loop, start, length));
+	if(find_cached_clip(get_frame_cache_key(filename, frame_factory, filter_str), core::frame_producer::NO_HINT))
+		return;
+
+	// Plays the clip once as fast as it decodes, the producer hands its recording to the cache at the end.
+	// Layers with other hints record their own entry the first time they play the clip.
+	warm_frame_cache([=]
+	{
+		ffmpeg_producer producer(frame_factory, filename, filter_str, false, 0, std::numeric_limits<uint32_t>::max());
+		while(producer.recording_)
+			producer.receive(core::frame_producer::OFFLINE_HINT);
+	});
+}
+
+void evict_producer_cache(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& clip)
+{
+	if(clip.empty())
+	{
+		evict_cached_clips(L"", frame_factory.get());
+		return;
+	}
+
+	auto filename = find_media_file(clip);
+	if(!filename.empty())
+		evict_cached_clips(filename, frame_factory.get());
 }
 
 }}
\ No newline at end of file
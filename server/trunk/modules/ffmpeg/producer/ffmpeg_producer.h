@@ -39,4 +39,10 @@ namespace ffmpeg {
 
 safe_ptr<core::frame_producer> create_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::vector<std::wstring>& params);
 
+// Decodes a clip into the frame cache in the background, see frame_cache.h. params are the same as for create_producer.
+void warm_producer_cache(const safe_ptr<core::frame_factory>& frame_factory, const std::vector<std::wstring>& params);
+
+// Evicts a clip from the frame cache of the channel owning frame_factory, or every clip of it if empty.
+void evict_producer_cache(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& clip);
+
 }}
\ No newline at end of file
@@ -25,6 +25,8 @@
 
 #include "parallel_yadif.h"
 
+#include "../util/util.h"
+
 #include "../../ffmpeg_error.h"
 
 #include <common/exception/exceptions.h>
@@ -108,13 +110,12 @@ struct filter::implementation
 	std::shared_ptr<AVFilterGraph>	graph_;	
 	AVFilterContext*				buffersink_ctx_;
 	AVFilterContext*				buffersrc_ctx_;
-	std::shared_ptr<void>			parallel_yadif_ctx_;
+	std::vector<std::shared_ptr<void>>	parallel_yadif_ctxs_;
 	std::vector<PixelFormat>		pix_fmts_;
 	std::queue<safe_ptr<AVFrame>>	bypass_;
 		
 	implementation(const std::wstring& filters, const std::vector<PixelFormat>& pix_fmts) 
 		: filters_(filters)
-		, parallel_yadif_ctx_(nullptr)
 		, pix_fmts_(pix_fmts)
 	{
 		if(pix_fmts_.empty())
@@ -129,7 +130,13 @@ struct filter::implementation
 				(PIX_FMT_ARGB)
 				(PIX_FMT_RGBA)
 				(PIX_FMT_ABGR)
-				(PIX_FMT_GRAY8);
+				(PIX_FMT_GRAY8)
+				(PIX_FMT_YUV444P10)
+				(PIX_FMT_YUV422P10)
+				(PIX_FMT_YUV420P10)
+				(PIX_FMT_YUV444P16)
+				(PIX_FMT_YUV422P16)
+				(PIX_FMT_YUV420P16);
 		}
 		
 		pix_fmts_.push_back(PIX_FMT_NONE);
@@ -233,10 +240,11 @@ struct filter::implementation
 					THROW_ON_ERROR2(avfilter_graph_config(graph_.get(), NULL), "[filter]");	
 					
 					BOOST_FOREACH(auto filter_ctx, boost::make_iterator_range(graph_->filters, graph_->filters + graph_->filter_count) | yadif_filter)						
-						parallel_yadif_ctx_ = make_parallel_yadif(filter_ctx);						
+						parallel_yadif_ctxs_.push_back(make_parallel_yadif(filter_ctx));						
 				}
 				catch(...)
 				{
+					parallel_yadif_ctxs_.clear();
 					graph_ = nullptr;
 					throw;
 				}
@@ -297,6 +305,8 @@ struct filter::implementation
 				frame->key_frame			= picref->video->key_frame;
 				frame->pict_type			= picref->video->pict_type;
 				frame->sample_aspect_ratio	= picref->video->sample_aspect_ratio;
+
+				mark_persistent_frame(*frame); // The picref is held until the frame is released.
 					
 				return frame;				
 			}
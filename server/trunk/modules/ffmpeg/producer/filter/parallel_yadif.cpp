@@ -19,6 +19,7 @@
 * Author: Robert Nagy, ronag89@gmail.com
 */
 
+
 #include "../../StdAfx.h"
 
 #include "parallel_yadif.h"
@@ -38,9 +39,13 @@ extern "C"
 #endif
 
 #include <tbb/parallel_for.h>
-#include <tbb/concurrent_queue.h>
 
-#include <boost/thread/once.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <intrin.h>
+
+#include <map>
+#include <vector>
 
 typedef struct {
     int mode;
@@ -57,9 +62,20 @@ typedef struct {
     //const AVPixFmtDescriptor *csp;
 } YADIFContext;
 
+namespace caspar { namespace ffmpeg {
+
+typedef void (*filter_line_func)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode);
+
+// yadif calls filter_line once per missing line, from the end_frame of its input pad or the request_frame of its 
+// output pad (the second field in bob mode). Both are wrapped so that the lines of a frame are collected for the 
+// filter instance being run, and filtered in parallel as soon as the last line of the frame has arrived, i.e. before 
+// yadif passes the frame downstream. 
+// The number of lines per frame is learned from the first frame of each field parity, which is filtered serially, 
+// so that nothing depends on the frame height or on how this version of yadif walks the planes.
+
 struct parallel_yadif_context
 {
-	struct arg
+	struct line
 	{
 		uint8_t *dst;
 		uint8_t *prev;
@@ -72,90 +88,167 @@ struct parallel_yadif_context
 		int mode;
 	};
 
-	arg	args[1080];
-	int	index;
-	int last_index;
+	std::vector<line>	lines;
+	size_t				nb_lines[2];	// Per field parity, 0 until learned.
+	int					field;			// Field parity of the current frame, -1 before its first line.
+	size_t				learned_lines;
+	bool				learning;
 
-	parallel_yadif_context() : index(0){}
+	parallel_yadif_context() 
+		: field(-1)
+		, learned_lines(0)
+		, learning(false)
+	{
+		nb_lines[0] = nb_lines[1] = 0;
+	}
 };
 
-void (*org_yadif_filter_line)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode) = 0;
+filter_line_func				g_org_filter_line		= nullptr; // The same for every instance, data race is not a problem.
+void							(*g_org_end_frame)(AVFilterLink* link) = nullptr;
+int								(*g_org_request_frame)(AVFilterLink* link) = nullptr;
 
-void parallel_yadif_filter_line(parallel_yadif_context& ctx, uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode)
+boost::mutex																g_contexts_mutex;
+std::map<AVFilterContext*, std::shared_ptr<parallel_yadif_context>>			g_contexts;
+__declspec(thread) parallel_yadif_context*									g_current_context = nullptr;
+
+void filter_lines(parallel_yadif_context& ctx)
 {
-	parallel_yadif_context::arg arg = {dst, prev, cur, next, w, prefs, mrefs, parity, mode};
-	ctx.args[ctx.index++] = arg;
+	auto& lines = ctx.lines;
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, lines.size()), [&](const tbb::blocked_range<size_t>& r)
+	{
+		for(auto n = r.begin(); n != r.end(); ++n)
+			g_org_filter_line(lines[n].dst, lines[n].prev, lines[n].cur, lines[n].next, lines[n].w, lines[n].prefs, lines[n].mrefs, lines[n].parity, lines[n].mode);
+
+#if defined(_M_IX86)
+		_mm_empty(); // The line kernels may use mmx registers, yadif only clears them on its own thread.
+#endif
+	});
+
+	lines.clear();
+}
+
+void end_of_frame(parallel_yadif_context& ctx)
+{
+	if(ctx.learning && ctx.field >= 0)
+		ctx.nb_lines[ctx.field] = ctx.learned_lines;
 	
-	if(ctx.index == ctx.last_index)
-	{		
-		tbb::parallel_for(tbb::blocked_range<size_t>(0, ctx.index), [=](const tbb::blocked_range<size_t>& r)
-		{
-			for(auto n = r.begin(); n != r.end(); ++n)
-				org_yadif_filter_line(ctx.args[n].dst, ctx.args[n].prev, ctx.args[n].cur, ctx.args[n].next, ctx.args[n].w, ctx.args[n].prefs, ctx.args[n].mrefs, ctx.args[n].parity, ctx.args[n].mode);
-		});
-		ctx.index = 0;
+	if(!ctx.lines.empty()) 
+	{
+		// More or fewer lines than learned, e.g. after a change of parity handling. Relearn.
+		filter_lines(ctx);
+		ctx.nb_lines[ctx.field] = 0;
 	}
+
+	ctx.field			= -1;
+	ctx.learned_lines	= 0;
+	ctx.learning		= false;
 }
 
-namespace caspar { namespace ffmpeg {
-	
-tbb::concurrent_bounded_queue<decltype(org_yadif_filter_line)> parallel_line_func_pool;
-std::array<parallel_yadif_context, 18> ctxs;
+void parallel_filter_line(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode)
+{
+	auto ctx = g_current_context;
+	if(!ctx)
+	{
+		g_org_filter_line(dst, prev, cur, next, w, prefs, mrefs, parity, mode);
+		return;
+	}
+
+	if(ctx->field < 0)
+	{
+		ctx->field	  = mrefs > 0 ? 0 : 1; // mrefs is only positive on the top line of a plane.
+		ctx->learning = ctx->nb_lines[ctx->field] == 0;
+	}
 
-#define RENAME(a) f ## a
+	if(ctx->learning)
+	{
+		++ctx->learned_lines;
+		g_org_filter_line(dst, prev, cur, next, w, prefs, mrefs, parity, mode);
+		return;
+	}
 
-#define ff(x) \
-void RENAME(x)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode) \
-{\
-	parallel_yadif_filter_line(ctxs[x], dst, prev, cur, next, w, prefs, mrefs, parity, mode);\
-}
+	const parallel_yadif_context::line line = {dst, prev, cur, next, w, prefs, mrefs, parity, mode};
+	ctx->lines.push_back(line);
 
-ff(0); ff(1); ff(2); ff(3); ff(4); ff(5); ff(6); ff(7); ff(8); ff(9); ff(10); ff(11); ff(12); ff(13); ff(14); ff(15); ff(16); ff(17);
+	if(ctx->lines.size() == ctx->nb_lines[ctx->field])
+	{
+		filter_lines(*ctx);
+		ctx->field = -1;
+	}
+}
 
-void (*fs[])(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next, int w, int prefs, int mrefs, int parity, int mode) = 
-{f0, f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13, f14, f15, f16, f17};
+// Makes an instance current while yadif runs on this thread.
+class frame_scope
+{
+	parallel_yadif_context*					prev_context_;
+	std::shared_ptr<parallel_yadif_context>	context_;
+public:
+	frame_scope(AVFilterContext* filter_ctx)
+		: prev_context_(g_current_context)
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(g_contexts_mutex);
+			auto it = g_contexts.find(filter_ctx);
+			if(it != g_contexts.end())
+				context_ = it->second;
+		}
+		g_current_context = context_.get();
+	}
 
+	~frame_scope()
+	{
+		if(context_)
+			end_of_frame(*context_);
+		g_current_context = prev_context_;
+	}
+};
 
-void init_pool()
+void parallel_end_frame(AVFilterLink* link)
 {
-	for(int n = 0; n < sizeof(fs)/sizeof(fs[0]); ++n)
-		parallel_line_func_pool.push(fs[n]);
+	frame_scope scope(link->dst);
+	g_org_end_frame(link);
 }
 
-void return_parallel_yadif(void* func)
+int parallel_request_frame(AVFilterLink* link)
 {
-	if(func != nullptr)
-		parallel_line_func_pool.push(reinterpret_cast<decltype(fs[0])>(func));
+	frame_scope scope(link->src);
+	return g_org_request_frame(link);
 }
 
 std::shared_ptr<void> make_parallel_yadif(AVFilterContext* ctx)
 {
-	static boost::once_flag flag = BOOST_ONCE_INIT;
-	boost::call_once(&init_pool, flag);
-
 	YADIFContext* yadif = (YADIFContext*)ctx->priv;
-	org_yadif_filter_line = yadif->filter_line; // Data race is not a problem.
-	
-	decltype(org_yadif_filter_line) func = nullptr;
-	if(!parallel_line_func_pool.try_pop(func))	
-		CASPAR_LOG(warning) << "Not enough scalable-yadif context instances. Running non-scalable";
-	else
-	{
-		int index = 0;
-		while(index < sizeof(fs)/sizeof(fs[0]) && fs[index] != func)
-			++index;
 
-		ctxs[index].last_index = 0;
-		for (int y = 0; y < ctx->inputs[0]->h; y++)
-		{
-            if ((y ^ yadif->parity) & 1)
-				++ctxs[index].last_index;
-		}
+	if(ctx->input_count < 1 || ctx->output_count < 1 || !ctx->input_pads[0].end_frame || !ctx->output_pads[0].request_frame)
+	{
+		CASPAR_LOG(warning) << "Unexpected yadif filter layout. Running non-scalable";
+		return nullptr;
+	}
 
-		yadif->filter_line = func;
+	// Pads are copied into each filter instance, so only this instance is affected.
+	if(yadif->filter_line != parallel_filter_line)
+		g_org_filter_line	= yadif->filter_line; 
+	if(ctx->input_pads[0].end_frame != parallel_end_frame)
+		g_org_end_frame		= ctx->input_pads[0].end_frame;
+	if(ctx->output_pads[0].request_frame != parallel_request_frame)
+		g_org_request_frame	= ctx->output_pads[0].request_frame;
+	
+	auto context = std::make_shared<parallel_yadif_context>();
+	{
+		boost::lock_guard<boost::mutex> lock(g_contexts_mutex);
+		g_contexts[ctx] = context;
 	}
 
-	return std::shared_ptr<void>(func, return_parallel_yadif);
+	yadif->filter_line					= parallel_filter_line;
+	ctx->input_pads[0].end_frame		= parallel_end_frame;
+	ctx->output_pads[0].request_frame	= parallel_request_frame;
+
+	// Without a registered context the wrappers fall back to the original functions.
+	return std::shared_ptr<void>(context.get(), [ctx](void*)
+	{
+		boost::lock_guard<boost::mutex> lock(g_contexts_mutex);
+		g_contexts.erase(ctx);
+	});
 }
 
-}}
\ No newline at end of file
+}}
@@ -27,6 +27,7 @@ struct AVFilterContext;
 
 namespace caspar { namespace ffmpeg {
 	
+// Filters the lines of each frame of a configured yadif instance in parallel, until the returned handle is released.
 std::shared_ptr<void> make_parallel_yadif(AVFilterContext* ctx);
 
 }}
\ No newline at end of file
@@ -0,0 +1,386 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../stdafx.h"
+
+#include "frame_cache.h"
+
+#include <common/concurrency/executor.h>
+#include <common/env.h>
+#include <common/exception/exceptions.h>
+#include <common/log/log.h>
+
+#include <core/producer/frame_producer.h>
+#include <core/producer/frame/basic_frame.h>
+#include <core/producer/frame/frame_factory.h>
+#include <core/video_format.h>
+
+#include <tbb/atomic.h>
+#include <tbb/spin_mutex.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/regex.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <sstream>
+
+namespace caspar { namespace ffmpeg {
+
+struct cache_entry
+{
+	std::wstring					key;
+	const core::frame_factory*		frame_factory;	// Channel holding the frames.
+	std::shared_ptr<cached_clip>	clip;
+};
+
+boost::mutex				g_cache_mutex;
+std::list<cache_entry>		g_cache;		// Most recently used first.
+size_t						g_cache_size = 0;
+std::unique_ptr<executor>	g_warm_executor;
+
+bool is_frame_cache_enabled()
+{
+	return get_frame_cache_budget() > 0;
+}
+
+size_t get_frame_cache_budget()
+{
+	return std::min(env::properties().get(L"configuration.ffmpeg.frame-cache.size", 0u), 4095u) * 1024 * 1024;
+}
+
+size_t get_frame_cache_max_frames(double fps)
+{
+	return static_cast<size_t>(env::properties().get(L"configuration.ffmpeg.frame-cache.max-duration", 10.0) * fps);
+}
+
+std::wstring get_frame_cache_key(const std::wstring& filename, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter)
+{
+	std::wstringstream key;
+	key << filename << L"|" << boost::filesystem::last_write_time(boost::filesystem::wpath(filename)) << L"|" 
+		<< frame_factory->get_video_format_desc().name << L"|" << frame_factory.get() << L"|" << filter;
+	return key.str();
+}
+
+std::shared_ptr<cached_clip> find_cached_clip(const std::wstring& key, int hints)
+{
+	boost::lock_guard<boost::mutex> lock(g_cache_mutex);
+
+	auto it = std::find_if(g_cache.begin(), g_cache.end(), [&](const cache_entry& entry)
+	{
+		return entry.key == key && (hints < 0 || entry.clip->hints == hints);
+	});
+	if(it == g_cache.end())
+		return nullptr;
+
+	g_cache.splice(g_cache.begin(), g_cache, it);
+	return it->clip;
+}
+
+void insert_cached_clip(const std::wstring& key, const safe_ptr<core::frame_factory>& frame_factory, const std::shared_ptr<cached_clip>& clip)
+{
+	const auto budget = get_frame_cache_budget();
+	if(clip->frames.empty() || clip->size > budget)
+		return;
+
+	boost::lock_guard<boost::mutex> lock(g_cache_mutex);
+	
+	auto it = std::find_if(g_cache.begin(), g_cache.end(), [&](const cache_entry& entry)
+	{
+		return entry.key == key && entry.clip->hints == clip->hints;
+	});
+	if(it != g_cache.end())
+	{
+		g_cache_size -= it->clip->size;
+		g_cache.erase(it);
+	}
+
+	const cache_entry entry = {key, frame_factory.get(), clip};
+	g_cache.push_front(entry);
+	g_cache_size += clip->size;
+	
+	while(g_cache_size > budget)
+	{
+		CASPAR_LOG(debug) << L"[frame_cache] Evicted " << g_cache.back().clip->filename << L".";
+		g_cache_size -= g_cache.back().clip->size;
+		g_cache.pop_back();
+	}
+
+	CASPAR_LOG(info) << L"[frame_cache] Cached " << clip->filename << L" (" << clip->frames.size() << L" frames, " << clip->size/(1024*1024) << L" MB). " 
+					 << g_cache_size/(1024*1024) << L"/" << budget/(1024*1024) << L" MB used.";
+}
+
+void evict_cached_clips(const std::wstring& filename, const core::frame_factory* frame_factory)
+{
+	std::list<cache_entry> evicted; // Frames are released outside of the lock.
+
+	boost::lock_guard<boost::mutex> lock(g_cache_mutex);
+
+	for(auto it = g_cache.begin(); it != g_cache.end();)
+	{
+		auto next = std::next(it);
+		if((filename.empty() || boost::iequals(it->clip->filename, filename)) && (!frame_factory || it->frame_factory == frame_factory))
+		{
+			g_cache_size -= it->clip->size;
+			evicted.splice(evicted.end(), g_cache, it);
+		}
+		it = next;
+	}
+}
+
+void warm_frame_cache(const std::function<void()>& task)
+{
+	boost::lock_guard<boost::mutex> lock(g_cache_mutex);
+
+	if(!g_warm_executor)
+	{
+		g_warm_executor.reset(new executor(L"frame_cache"));
+		g_warm_executor->set_priority_class(below_normal_priority_class);
+	}
+
+	g_warm_executor->post([=]
+	{
+		try
+		{
+			task();
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+	});
+}
+
+void uninit_frame_cache()
+{
+	std::unique_ptr<executor> warm_executor;
+	{
+		boost::lock_guard<boost::mutex> lock(g_cache_mutex);
+		warm_executor = std::move(g_warm_executor);
+	}
+
+	if(warm_executor)
+	{
+		warm_executor->clear();
+		warm_executor.reset(); // Waits for a clip which is being decoded.
+	}
+
+	evict_cached_clips(L"", nullptr);
+}
+
+struct cached_producer : public core::frame_producer
+{
+	const std::wstring												key_;
+	const std::function<safe_ptr<core::frame_producer>(bool)>		create_decoder_;
+	const uint32_t													first_;
+	const uint32_t													length_;
+	tbb::atomic<bool>												loop_;
+	tbb::atomic<int64_t>											seek_target_;	// Negative when there is nothing to seek to.
+
+	std::shared_ptr<cached_clip>									clip_;			// An entry of any hints until the first receive.
+	int																hints_;			// Hints clip_ was looked up for, negative before the first receive.
+	uint32_t														start_;
+	uint32_t														end_;
+	uint32_t														position_;
+	int64_t															frame_number_;
+	safe_ptr<core::basic_frame>										last_frame_;
+
+	mutable tbb::spin_mutex											decoder_mutex_;
+	std::shared_ptr<core::frame_producer>							decoder_;		// Plays the clip when nothing matches the hints.
+
+	cached_producer(const std::wstring& key, const std::shared_ptr<cached_clip>& clip, const std::function<safe_ptr<core::frame_producer>(bool)>& create_decoder, bool loop, uint32_t start, uint32_t length)
+		: key_(key)
+		, create_decoder_(create_decoder)
+		, first_(start)
+		, length_(length)
+		, hints_(-1)
+		, position_(0)
+		, frame_number_(0)
+		, last_frame_(core::basic_frame::empty())
+	{
+		loop_		 = loop;
+		seek_target_ = -1;
+		set_clip(clip);
+		position_	 = start_;
+	}
+
+	void set_clip(const std::shared_ptr<cached_clip>& clip)
+	{
+		clip_	= clip;
+		start_	= std::min(first_, static_cast<uint32_t>(clip->frames.size()));
+		end_	= static_cast<uint32_t>(std::min<uint64_t>(clip->frames.size(), static_cast<uint64_t>(start_) + length_));
+	}
+
+	std::shared_ptr<core::frame_producer> decoder() const
+	{
+		tbb::spin_mutex::scoped_lock lock(decoder_mutex_);
+		return decoder_;
+	}
+
+	// frame_producer
+
+	virtual safe_ptr<core::basic_frame> receive(int hints) override
+	{
+		auto decoder = this->decoder();
+		if(decoder)
+			return decoder->receive(hints);
+
+		const int decode_hints = hints & ~core::frame_producer::OFFLINE_HINT;
+		if(decode_hints != hints_)
+		{
+			auto clip = find_cached_clip(key_, decode_hints);
+			if(clip)
+				set_clip(clip);
+			else if(hints_ < 0)
+				return start_decoder()->receive(hints);
+			else // The decoder can't take over mid clip, keep going with what was cached.
+				CASPAR_LOG(warning) << print() << L" Hints changed while playing, cached frames are used as decoded.";
+			hints_ = decode_hints;
+		}
+
+		const auto target = seek_target_.fetch_and_store(-1);
+		if(target >= 0)
+			position_ = std::min(std::max(static_cast<uint32_t>(target), start_), end_);
+
+		if(position_ >= end_)
+		{
+			if(!loop_ || start_ >= end_)
+				return last_frame();
+			position_ = start_;
+		}
+
+		++frame_number_;
+
+		return last_frame_ = clip_->frames[position_++];
+	}
+
+	virtual safe_ptr<core::basic_frame> last_frame() const override
+	{
+		auto decoder = this->decoder();
+		if(decoder)
+			return decoder->last_frame();
+
+		return disable_audio(last_frame_);
+	}
+
+	virtual uint32_t nb_frames() const override
+	{
+		auto decoder = this->decoder();
+		if(decoder)
+			return decoder->nb_frames();
+
+		return loop_ ? std::numeric_limits<uint32_t>::max() : end_ - start_;
+	}
+
+	virtual boost::unique_future<std::wstring> call(const std::wstring& param) override
+	{
+		auto decoder = this->decoder();
+		if(decoder)
+			return decoder->call(param);
+
+		static const boost::wregex loop_exp(L"LOOP\\s*(?<VALUE>\\d?)?", boost::regex::icase);
+		static const boost::wregex seek_exp(L"SEEK\\s+(?<VALUE>\\d+)", boost::regex::icase);
+		
+		std::wstring result;
+
+		boost::wsmatch what;
+		if(boost::regex_match(param, what, loop_exp))
+		{
+			if(!what["VALUE"].str().empty())
+				loop_ = boost::lexical_cast<bool>(what["VALUE"].str());
+			result = boost::lexical_cast<std::wstring>(static_cast<bool>(loop_));
+		}
+		else if(boost::regex_match(param, what, seek_exp))
+			seek_target_ = boost::lexical_cast<uint32_t>(what["VALUE"].str());
+		else
+			BOOST_THROW_EXCEPTION(invalid_argument());
+
+		boost::promise<std::wstring> promise;
+		promise.set_value(result);
+		return promise.get_future();
+	}
+				
+	virtual std::wstring print() const override
+	{
+		auto decoder = this->decoder();
+		if(decoder)
+			return decoder->print();
+
+		return L"ffmpeg[" + boost::filesystem::wpath(clip_->filename).filename() + L"|cached|" 
+						  + boost::lexical_cast<std::wstring>(position_) + L"/" + boost::lexical_cast<std::wstring>(clip_->frames.size()) + L"]";
+	}
+
+	virtual boost::property_tree::wptree info() const override
+	{
+		auto decoder = this->decoder();
+		if(decoder)
+			return decoder->info();
+
+		boost::property_tree::wptree info;
+		info.add(L"type",				L"ffmpeg-producer");
+		info.add(L"filename",			clip_->filename);
+		info.add(L"cached",				true);
+		info.add(L"width",				clip_->width);
+		info.add(L"height",				clip_->height);
+		info.add(L"progressive",		clip_->progressive);
+		info.add(L"fps",				clip_->fps);
+		info.add(L"loop",				static_cast<bool>(loop_));
+		info.add(L"frame-number",		frame_number_);
+		info.add(L"nb-frames",			loop_ ? -1 : static_cast<int64_t>(nb_frames()));
+		info.add(L"file-frame-number",	position_);
+		info.add(L"file-nb-frames",		clip_->frames.size());
+		return info;
+	}
+
+	// cached_producer
+
+	safe_ptr<core::frame_producer> start_decoder()
+	{
+		CASPAR_LOG(debug) << print() << L" Not cached with these hints, decoding.";
+
+		safe_ptr<core::frame_producer> decoder = create_decoder_(loop_);
+		
+		const auto target = seek_target_.fetch_and_store(-1);
+		if(target >= 0)
+			decoder->call(L"SEEK " + boost::lexical_cast<std::wstring>(target));
+
+		tbb::spin_mutex::scoped_lock lock(decoder_mutex_);
+		decoder_ = decoder;
+		return decoder;
+	}
+};
+
+safe_ptr<core::frame_producer> create_cached_producer(const std::wstring& key, const std::function<safe_ptr<core::frame_producer>(bool)>& create_decoder, bool loop, uint32_t start, uint32_t length)
+{
+	auto clip = find_cached_clip(key, -1);
+	if(!clip)
+		return create_decoder(loop);
+
+	return make_safe<cached_producer>(key, clip, create_decoder, loop, start, length);
+}
+
+}}
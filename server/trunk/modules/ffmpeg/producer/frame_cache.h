@@ -0,0 +1,87 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace caspar {
+
+namespace core {
+
+class basic_frame;
+struct frame_factory;
+struct frame_producer;
+
+}
+
+namespace ffmpeg {
+
+// A fully decoded clip. Its frames are immutable and shared by every producer playing it.
+struct cached_clip
+{
+	std::wstring								filename;
+	std::vector<safe_ptr<core::basic_frame>>	frames;
+	double										fps;
+	size_t										width;
+	size_t										height;
+	bool										progressive;
+	int											hints;	// Producer hints (ALPHA_HINT, DEINTERLACE_HINT) every frame was decoded with.
+	size_t										size;	// Estimated bytes held by the frames.
+
+	cached_clip() 
+		: fps(0.0)
+		, width(0)
+		, height(0)
+		, progressive(true)
+		, hints(0)
+		, size(0)
+	{
+	}
+};
+
+// LRU cache of decoded clips, for stingers and other short clips which are replayed all day. It is disabled unless 
+// <ffmpeg><frame-cache><size> (MB) is set. Clips longer than <max-duration> seconds are never cached.
+// The frames live in the buffers of the channel which decoded them, so entries are per channel. A clip decoded with
+// other producer hints has different pixels, so entries are also per hints.
+
+bool							is_frame_cache_enabled();
+size_t							get_frame_cache_budget();								// Bytes.
+size_t							get_frame_cache_max_frames(double fps);
+
+std::wstring					get_frame_cache_key(const std::wstring& filename, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter);
+std::shared_ptr<cached_clip>	find_cached_clip(const std::wstring& key, int hints);		// hints < 0 finds the most recently used entry of any hints.
+void							insert_cached_clip(const std::wstring& key, const safe_ptr<core::frame_factory>& frame_factory, const std::shared_ptr<cached_clip>& clip);
+void							evict_cached_clips(const std::wstring& filename, const core::frame_factory* frame_factory);	// Empty filename for every clip, nullptr for every channel.
+void							warm_frame_cache(const std::function<void()>& task);	// Runs task on the low priority warming thread.
+void							uninit_frame_cache();									// Waits for warming and releases every frame.
+
+// Plays the entry of key which matches the hints of the first receive. Without one it hands over to the producer
+// returned by create_decoder(loop).
+safe_ptr<core::frame_producer>	create_cached_producer(const std::wstring& key, const std::function<safe_ptr<core::frame_producer>(bool)>& create_decoder, bool loop, uint32_t start, uint32_t length);
+
+}}
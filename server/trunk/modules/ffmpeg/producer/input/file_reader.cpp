@@ -0,0 +1,339 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "file_reader.h"
+
+#include <common/concurrency/executor.h>
+#include <common/exception/exceptions.h>
+#include <common/log/log.h>
+
+#include <tbb/cache_aligned_allocator.h>
+
+#include <boost/exception/errinfo_file_name.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/timer.hpp>
+
+#include <windows.h>
+
+#include <cstring>
+#include <map>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable : 4244)
+#endif
+extern "C" 
+{
+	#define __STDC_CONSTANT_MACROS
+	#define __STDC_LIMIT_MACROS
+	#include <libavformat/avformat.h>
+	#include <libavformat/avio.h>
+}
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+static const size_t BLOCK_SIZE		 = 1024 * 1024;	// Reads start at multiples of this, which keeps them sector aligned.
+static const size_t AVIO_BUFFER_SIZE = 64 * 1024;
+
+namespace caspar { namespace ffmpeg {
+	
+struct file_reader::implementation : boost::noncopyable
+{
+	// Blocks are read with overlapped io, the completions run on the io threads of the system thread pool which are 
+	// shared by every file in the process.
+	struct block : boost::noncopyable
+	{
+		OVERLAPPED													overlapped;
+		implementation* const										owner;
+		const int64_t												index;
+		std::vector<uint8_t, tbb::cache_aligned_allocator<uint8_t>>	data;
+		size_t														size;
+		bool														ready;
+		bool														failed;
+		boost::timer												timer;
+		std::shared_ptr<block>										in_flight; // Keeps the block alive until its read has completed.
+
+		block(implementation* owner, int64_t index, size_t capacity) 
+			: owner(owner)
+			, index(index)
+			, data(capacity)
+			, size(0)
+			, ready(false)
+			, failed(false)
+		{
+		}
+	};
+
+	const std::wstring							filename_;
+	const std::shared_ptr<void>					handle_;
+	const int64_t								file_size_;
+
+	mutable boost::mutex						mutex_;
+	boost::condition_variable					cond_;
+	std::map<int64_t, std::shared_ptr<block>>	blocks_;
+	size_t										pending_; // Reads in flight.
+	int64_t										position_;
+	size_t										read_ahead_;
+	double										latency_;
+	double										wait_time_;
+
+	const std::shared_ptr<AVIOContext>			context_;
+
+	implementation(const std::wstring& filename) 
+		: filename_(filename)
+		, handle_(open(filename))
+		, file_size_(get_size(handle_.get(), filename))
+		, pending_(0)
+		, position_(0)
+		, read_ahead_(4)
+		, latency_(0.0)
+		, wait_time_(0.0)
+		, context_(avio_alloc_context(static_cast<unsigned char*>(av_malloc(AVIO_BUFFER_SIZE)), AVIO_BUFFER_SIZE, 0, this, &read_packet, nullptr, &seek), [](AVIOContext* context)
+		{
+			if(!context)
+				return;
+			av_free(context->buffer); // avio may have replaced the buffer we gave it.
+			av_free(context);
+		})
+	{
+		if(!context_)
+			BOOST_THROW_EXCEPTION(bad_alloc() << msg_info("avio_alloc_context"));
+
+		if(!BindIoCompletionCallback(handle_.get(), &on_read_completed, 0))
+			BOOST_THROW_EXCEPTION(file_read_error() << msg_info("Could not bind file to the io thread pool.") << boost::errinfo_file_name(narrow(filename)));
+	}
+
+	~implementation()
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+
+		CancelIoEx(handle_.get(), nullptr);
+		while(pending_ > 0) // Completions refer to this.
+			cond_.wait(lock);
+	}
+
+	static std::shared_ptr<void> open(const std::wstring& filename)
+	{
+		// Sequential scan is the read-ahead hint of Win32, the file cache is kept so that loops and replays are cheap.
+		auto handle = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN | FILE_FLAG_OVERLAPPED, nullptr);
+		if(handle == INVALID_HANDLE_VALUE)
+			BOOST_THROW_EXCEPTION(file_not_found() << msg_info("Could not open file.") << boost::errinfo_file_name(narrow(filename)));
+
+		return std::shared_ptr<void>(handle, CloseHandle);
+	}
+
+	static int64_t get_size(HANDLE handle, const std::wstring& filename)
+	{
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(handle, &size))
+			BOOST_THROW_EXCEPTION(file_read_error() << msg_info("Could not read file size.") << boost::errinfo_file_name(narrow(filename)));
+
+		return size.QuadPart;
+	}
+
+	static int read_packet(void* opaque, uint8_t* buf, int buf_size)
+	{
+		return static_cast<implementation*>(opaque)->read(buf, buf_size);
+	}
+
+	static int64_t seek(void* opaque, int64_t offset, int whence)
+	{
+		return static_cast<implementation*>(opaque)->do_seek(offset, whence);
+	}
+
+	int read(uint8_t* buf, int buf_size)
+	{
+		boost::unique_lock<boost::mutex> lock(mutex_);
+
+		if(position_ >= file_size_)
+			return 0;
+
+		const auto index = position_ / BLOCK_SIZE;
+
+		// Drop whatever is outside of the window, e.g. after a seek.
+		for(auto it = blocks_.begin(); it != blocks_.end();)
+		{
+			if(it->first < index - 1 || it->first > index + static_cast<int64_t>(read_ahead_))
+			{
+				if(!it->second->ready)
+					CancelIoEx(handle_.get(), &it->second->overlapped);
+				it = blocks_.erase(it);
+			}
+			else
+				++it;
+		}
+
+		for(auto n = index; n <= index + static_cast<int64_t>(read_ahead_) && n*static_cast<int64_t>(BLOCK_SIZE) < file_size_; ++n)
+			request(n);
+
+		auto current = blocks_[index];
+		if(!current->ready)
+		{
+			boost::timer wait_timer;
+			blocking_scope blocking;
+			while(!current->ready)
+				cond_.wait(lock);
+			wait_time_ += wait_timer.elapsed();
+		}
+
+		if(current->failed)
+			return AVERROR(EIO);
+
+		const auto offset = static_cast<size_t>(position_ - index*BLOCK_SIZE);
+		if(offset >= current->size) // Not the end of the file, see the check above.
+			return AVERROR(EIO);
+
+		const auto count = std::min(static_cast<size_t>(buf_size), current->size - offset);
+		std::memcpy(buf, current->data.data() + offset, count);
+		position_ += count;
+
+		return static_cast<int>(count);
+	}
+
+	int64_t do_seek(int64_t offset, int whence)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		if(whence & AVSEEK_SIZE)
+			return file_size_;
+
+		switch(whence & ~AVSEEK_FORCE)
+		{
+		case SEEK_SET:	position_ = offset;					break;
+		case SEEK_CUR:	position_ = position_ + offset;		break;
+		case SEEK_END:	position_ = file_size_ + offset;	break;
+		default:		return -1;
+		}
+
+		return position_;
+	}
+
+	void request(int64_t index) // lock must be held
+	{
+		if(blocks_.find(index) != blocks_.end())
+			return;
+
+		auto new_block = std::make_shared<block>(this, index, static_cast<size_t>(std::min<int64_t>(BLOCK_SIZE, file_size_ - index*BLOCK_SIZE)));
+		blocks_[index] = new_block;
+
+		begin_read(new_block);
+	}
+
+	void begin_read(const std::shared_ptr<block>& target) // lock must be held
+	{
+		const auto position = target->index*static_cast<int64_t>(BLOCK_SIZE) + static_cast<int64_t>(target->size);
+
+		std::memset(&target->overlapped, 0, sizeof(target->overlapped));
+		target->overlapped.Offset	  = static_cast<DWORD>(position & 0xFFFFFFFF);
+		target->overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+		target->in_flight			  = target;
+		++pending_;
+
+		// Reads which fail right away queue no completion.
+		if(!ReadFile(handle_.get(), target->data.data() + target->size, static_cast<DWORD>(target->data.size() - target->size), nullptr, &target->overlapped) && GetLastError() != ERROR_IO_PENDING)
+			end_read(*target, GetLastError(), 0);
+	}
+
+	static void CALLBACK on_read_completed(DWORD error, DWORD count, LPOVERLAPPED overlapped)
+	{
+		auto& target = *CONTAINING_RECORD(overlapped, block, overlapped);
+
+		boost::lock_guard<boost::mutex> lock(target.owner->mutex_);
+		target.owner->end_read(target, error, count);
+	}
+
+	void end_read(block& target, DWORD error, DWORD count) // lock must be held
+	{
+		auto self = std::move(target.in_flight); // Released when we return.
+		--pending_;
+
+		const bool succeeded = error == ERROR_SUCCESS || error == ERROR_HANDLE_EOF;
+		if(succeeded)
+			target.size += count;
+
+		// Reads may return less than requested, e.g. from network shares, the rest of the block is requested until the file ends.
+		if(error == ERROR_SUCCESS && count > 0 && target.size < target.data.size())
+		{
+			begin_read(self);
+			return;
+		}
+
+		target.failed = !succeeded || target.size < target.data.size();
+		target.ready  = true;
+		cond_.notify_all();
+
+		if(error == ERROR_OPERATION_ABORTED) // Left the window or the reader is being destroyed.
+			return;
+		
+		latency_ = std::max(target.timer.elapsed(), latency_*0.95);
+
+		if(!succeeded)
+			CASPAR_LOG(warning) << print() << L" Failed to read block " << target.index << L". Error: " << error;
+		else if(target.failed)
+			CASPAR_LOG(warning) << print() << L" Block " << target.index << L" ended " << target.data.size() - target.size << L" bytes early, the file has been truncated.";
+	}
+
+	void set_read_ahead(size_t blocks)
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		read_ahead_ = std::max<size_t>(blocks, 1);
+	}
+
+	size_t get_read_ahead() const
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		return read_ahead_;
+	}
+
+	double latency() const
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		return latency_;
+	}
+
+	double take_wait_time()
+	{
+		boost::lock_guard<boost::mutex> lock(mutex_);
+		auto result = wait_time_;
+		wait_time_ = 0.0;
+		return result;
+	}
+
+	std::wstring print() const
+	{
+		return L"file_reader[" + filename_ + L"]";
+	}
+};
+
+file_reader::file_reader(const std::wstring& filename) : impl_(new implementation(filename)){}
+AVIOContext* file_reader::context(){return impl_->context_.get();}
+void file_reader::read_ahead(size_t blocks){impl_->set_read_ahead(blocks);}
+size_t file_reader::read_ahead() const{return impl_->get_read_ahead();}
+size_t file_reader::block_size() const{return BLOCK_SIZE;}
+double file_reader::latency() const{return impl_->latency();}
+double file_reader::take_wait_time(){return impl_->take_wait_time();}
+
+}}
@@ -0,0 +1,54 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <boost/noncopyable.hpp>
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+struct AVIOContext;
+
+namespace caspar { namespace ffmpeg {
+
+// avio layer for local and network files. Reads are done in large block aligned chunks with overlapped io ahead of the 
+// demuxer, and the time the demuxer spends waiting for storage is measured.
+class file_reader : boost::noncopyable
+{
+public:
+	explicit file_reader(const std::wstring& filename);
+
+	AVIOContext* context(); // Valid for the lifetime of the reader.
+
+	void	read_ahead(size_t blocks);
+	size_t	read_ahead() const;
+	size_t	block_size() const;
+
+	double	latency() const;		// Recent peak time to read one block, in seconds.
+	double	take_wait_time();		// Seconds the demuxer has been blocked on storage since the last call.
+private:
+	struct implementation;
+	std::shared_ptr<implementation> impl_;
+};
+
+}}
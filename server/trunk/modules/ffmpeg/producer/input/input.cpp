@@ -22,6 +22,8 @@
 #include "../../stdafx.h"
 
 #include "input.h"
+#include "file_reader.h"
+#include "seek_index.h"
 
 #include "../util/util.h"
 #include "../../ffmpeg_error.h"
@@ -41,6 +43,9 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <boost/timer.hpp>
+
+#include <cmath>
 
 #if defined(_MSC_VER)
 #pragma warning (push)
@@ -56,9 +61,15 @@ extern "C"
 #pragma warning (pop)
 #endif
 
-static const size_t MAX_BUFFER_COUNT = 100;
-static const size_t MIN_BUFFER_COUNT = 50;
-static const size_t MAX_BUFFER_SIZE  = 64 * 1000000;
+// The buffer holds enough packets to ride out storage stalls, sized from the bitrate and the measured read latency.
+static const double MIN_BUFFER_DURATION		= 1.0;		// Seconds.
+static const double MAX_BUFFER_DURATION		= 8.0;
+static const double LATENCY_FACTOR			= 8.0;		// Seconds of buffer per second of read latency.
+static const size_t MIN_BUFFER_FRAMES		= 16;		// Keeps frame threaded decoders fed.
+static const size_t MIN_BUFFER_SIZE			= 4   * 1000000;
+static const size_t MAX_BUFFER_SIZE			= 256 * 1000000;
+static const size_t DEFAULT_BUFFER_SIZE		= 64  * 1000000;
+static const size_t MAX_READ_AHEAD			= 32;		// Blocks.
 
 namespace caspar { namespace ffmpeg {
 		
@@ -66,8 +77,10 @@ struct input::implementation : boost::noncopyable
 {		
 	const safe_ptr<diagnostics::graph>							graph_;
 
+	const std::shared_ptr<file_reader>							reader_; // Null for urls and devices.
 	const safe_ptr<AVFormatContext>								format_context_; // Destroy this last
 	const int													default_stream_index_;
+	const std::shared_ptr<seek_index>							index_;
 			
 	const std::wstring											filename_;
 	const uint32_t												start_;		
@@ -77,21 +90,42 @@ struct input::implementation : boost::noncopyable
 	
 	tbb::concurrent_bounded_queue<std::shared_ptr<AVPacket>>	buffer_;
 	tbb::atomic<size_t>											buffer_size_;
+
+	const double												fps_;
+	uint64_t													read_bytes_;
+	uint64_t													read_packets_;
+	uint64_t													read_frames_;
+	boost::timer												io_timer_;
+
+	tbb::atomic<size_t>											max_buffer_size_;
+	tbb::atomic<size_t>											max_buffer_count_;
+	tbb::atomic<size_t>											min_buffer_count_;
+
+	mutable boost::mutex										wait_mutex_;
+	mutable boost::condition_variable							wait_cond_;
 		
 	executor													executor_;
 	
 	explicit implementation(const safe_ptr<diagnostics::graph> graph, const std::wstring& filename, bool loop, uint32_t start, uint32_t length) 
 		: graph_(graph)
-		, format_context_(open_input(filename))		
+		, reader_(create_reader(filename))
+		, format_context_(reader_ ? open_input(filename, make_safe_ptr(reader_)) : open_input(filename))		
 		, default_stream_index_(av_find_default_stream_index(format_context_.get()))
+		, index_(reader_ ? std::shared_ptr<seek_index>(get_seek_index(filename)) : nullptr)
 		, filename_(filename)
 		, start_(start)
 		, length_(length)
 		, frame_number_(0)
+		, fps_(read_fps(*format_context_, 25.0))
+		, read_bytes_(0)
+		, read_packets_(0)
+		, read_frames_(0)
 		, executor_(print())
 	{		
 		loop_			= loop;
 		buffer_size_	= 0;
+		
+		update_limits();
 
 		if(start_ > 0)			
 			queued_seek(start_);
@@ -99,9 +133,18 @@ struct input::implementation : boost::noncopyable
 		graph_->set_color("seek", diagnostics::color(1.0f, 0.5f, 0.0f));	
 		graph_->set_color("buffer-count", diagnostics::color(0.7f, 0.4f, 0.4f));
 		graph_->set_color("buffer-size", diagnostics::color(1.0f, 1.0f, 0.0f));	
+		graph_->set_color("io-wait", diagnostics::color(0.3f, 0.6f, 1.0f));
 
 		tick();
 	}
+
+	static std::shared_ptr<file_reader> create_reader(const std::wstring& filename)
+	{
+		if(!boost::filesystem::is_regular_file(boost::filesystem::wpath(filename)))
+			return nullptr;
+
+		return std::make_shared<file_reader>(filename);
+	}
 	
 	bool try_pop(std::shared_ptr<AVPacket>& packet)
 	{
@@ -114,12 +157,31 @@ struct input::implementation : boost::noncopyable
 			tick();
 		}
 
-		graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/MAX_BUFFER_SIZE);
-		graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/MAX_BUFFER_COUNT));
+		graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/max_buffer_size_);
+		graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/max_buffer_count_));
 		
 		return result;
 	}
 
+	void wait(uint32_t timeout) const
+	{
+		blocking_scope blocking;
+
+		boost::unique_lock<boost::mutex> lock(wait_mutex_);
+		wait_cond_.timed_wait(lock, boost::posix_time::milliseconds(timeout), [&]
+		{
+			return !buffer_.empty() || !executor_.is_running();
+		});
+	}
+
+	void notify_waiters()
+	{
+		{
+			boost::lock_guard<boost::mutex> lock(wait_mutex_); // Orders the change before a waiter checks it.
+		}
+		wait_cond_.notify_all();
+	}
+
 	void seek(uint32_t target)
 	{
 		executor_.begin_invoke([=]
@@ -129,6 +191,7 @@ struct input::implementation : boost::noncopyable
 				buffer_size_ -= packet->size;
 
 			queued_seek(target);
+			notify_waiters();
 
 			tick();
 		}, high_priority);
@@ -141,7 +204,38 @@ struct input::implementation : boost::noncopyable
 	
 	bool full() const
 	{
-		return (buffer_size_ > MAX_BUFFER_SIZE || buffer_.size() > MAX_BUFFER_COUNT) && buffer_.size() > MIN_BUFFER_COUNT;
+		return (buffer_size_ > max_buffer_size_ || buffer_.size() > max_buffer_count_) && buffer_.size() > min_buffer_count_;
+	}
+
+	void update_limits()
+	{
+		const double latency  = reader_ ? reader_->latency() : 0.0;
+		const double duration = std::min(MAX_BUFFER_DURATION, MIN_BUFFER_DURATION + LATENCY_FACTOR*latency);
+
+		// Prefer the measured rates, container bitrates are often missing or wrong.
+		double byte_rate = format_context_->bit_rate / 8.0;
+		if(read_frames_ > 0)
+			byte_rate = static_cast<double>(read_bytes_)/static_cast<double>(read_frames_)*fps_;
+
+		const double packets_per_frame = read_frames_ > 0 ? static_cast<double>(read_packets_)/static_cast<double>(read_frames_) : static_cast<double>(format_context_->nb_streams);
+
+		max_buffer_size_  = byte_rate > 0.0 ? std::max(MIN_BUFFER_SIZE, std::min(MAX_BUFFER_SIZE, static_cast<size_t>(byte_rate*duration))) : DEFAULT_BUFFER_SIZE;
+		min_buffer_count_ = std::max<size_t>(1, static_cast<size_t>(std::ceil(packets_per_frame*MIN_BUFFER_FRAMES)));
+		max_buffer_count_ = std::max<size_t>(min_buffer_count_, static_cast<size_t>(std::ceil(packets_per_frame*fps_*duration)));
+
+		if(reader_)
+		{
+			// Keep twice the bytes that arrive during one read in flight.
+			const auto read_ahead = static_cast<size_t>(std::ceil(byte_rate*latency*2.0/reader_->block_size())) + 1;
+			reader_->read_ahead(std::max<size_t>(2, std::min(MAX_READ_AHEAD, read_ahead)));
+
+			const auto elapsed = io_timer_.elapsed();
+			if(elapsed > 0.1)
+			{
+				graph_->set_value("io-wait", reader_->take_wait_time()/elapsed);
+				io_timer_.restart();
+			}
+		}
 	}
 
 	void tick()
@@ -149,8 +243,10 @@ struct input::implementation : boost::noncopyable
 		if(!executor_.is_running())
 			return;
 		
-		executor_.begin_invoke([this]
+		executor_.post([this]
 		{			
+			update_limits();
+
 			if(full())
 				return;
 
@@ -178,7 +274,12 @@ struct input::implementation : boost::noncopyable
 					THROW_ON_ERROR(ret, "av_read_frame", print());
 
 					if(packet->stream_index == default_stream_index_)
+					{
 						++frame_number_;
+						++read_frames_;
+					}
+					++read_packets_;
+					read_bytes_ += packet->size;
 
 					THROW_ON_ERROR2(av_dup_packet(packet.get()), print());
 				
@@ -195,8 +296,8 @@ struct input::implementation : boost::noncopyable
 					buffer_.try_push(packet);
 					buffer_size_ += packet->size;
 				
-					graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/MAX_BUFFER_SIZE);
-					graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/MAX_BUFFER_COUNT));
+					graph_->set_value("buffer-size", (static_cast<double>(buffer_size_)+0.001)/max_buffer_size_);
+					graph_->set_value("buffer-count", (static_cast<double>(buffer_.size()+0.001)/max_buffer_count_));
 				}	
 		
 				tick();		
@@ -206,6 +307,8 @@ struct input::implementation : boost::noncopyable
 				CASPAR_LOG_CURRENT_EXCEPTION();
 				executor_.stop();
 			}
+
+			notify_waiters();
 		});
 	}	
 			
@@ -228,15 +331,33 @@ struct input::implementation : boost::noncopyable
 		
 		auto stream = format_context_->streams[default_stream_index_];
 		auto codec  = stream->codec;
-		auto fixed_target = (target*stream->time_base.den*codec->time_base.num)/(stream->time_base.num*codec->time_base.den)*codec->ticks_per_frame;
-		
-		THROW_ON_ERROR2(avformat_seek_file(format_context_.get(), default_stream_index_, std::numeric_limits<int64_t>::min(), fixed_target, std::numeric_limits<int64_t>::max(), 0), print());		
 		
 		auto flush_packet	= create_packet();
 		flush_packet->data	= nullptr;
 		flush_packet->size	= 0;
 		flush_packet->pos	= target;
 
+		if(index_ && target > 0) // The start of the file needs no index, the first seek elsewhere requests it.
+			index_->request();
+
+		auto point = index_ && index_->stream_index() == default_stream_index_ ? index_->find(target) : boost::none;
+		if(point && (point->pos >= 0 || point->dts != AV_NOPTS_VALUE))
+		{
+			// Jump straight to the keyframe, the decoders drop the frames before the target (flush_packet->pts).
+			if(point->pos >= 0 && stream->nb_index_entries == 0 && !(format_context_->iformat->flags & AVFMT_NO_BYTE_SEEK))
+				THROW_ON_ERROR2(av_seek_frame(format_context_.get(), default_stream_index_, point->pos, AVSEEK_FLAG_BYTE), print());	
+			else
+				THROW_ON_ERROR2(avformat_seek_file(format_context_.get(), default_stream_index_, std::numeric_limits<int64_t>::min(), point->dts, point->dts, 0), print());	
+
+			flush_packet->pts = av_rescale_q(point->pts, stream->time_base, AV_TIME_BASE_Q);
+		}
+		else
+		{
+			auto fixed_target = (target*stream->time_base.den*codec->time_base.num)/(stream->time_base.num*codec->time_base.den)*codec->ticks_per_frame;
+		
+			THROW_ON_ERROR2(avformat_seek_file(format_context_.get(), default_stream_index_, std::numeric_limits<int64_t>::min(), fixed_target, std::numeric_limits<int64_t>::max(), 0), print());		
+		}
+
 		buffer_.push(flush_packet);
 	}	
 
@@ -253,8 +374,10 @@ struct input::implementation : boost::noncopyable
 
 input::input(const safe_ptr<diagnostics::graph>& graph, const std::wstring& filename, bool loop, uint32_t start, uint32_t length) 
 	: impl_(new implementation(graph, filename, loop, start, length)){}
-bool input::eof() const {return !impl_->executor_.is_running();}
+bool input::eof() const {return !impl_->executor_.is_running() && impl_->buffer_.empty();}
+uint32_t input::nb_frames() const{return impl_->index_ && impl_->index_->stream_index() == impl_->default_stream_index_ ? impl_->index_->nb_frames() : 0;}
 bool input::try_pop(std::shared_ptr<AVPacket>& packet){return impl_->try_pop(packet);}
+void input::wait(uint32_t timeout) const{impl_->wait(timeout);}
 safe_ptr<AVFormatContext> input::context(){return impl_->format_context_;}
 void input::loop(bool value){impl_->loop_ = value;}
 bool input::loop() const{return impl_->loop_;}
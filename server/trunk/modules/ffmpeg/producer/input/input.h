@@ -49,12 +49,15 @@ public:
 
 	bool try_pop(std::shared_ptr<AVPacket>& packet);
 	bool eof() const;
+	void wait(uint32_t timeout) const; // Blocks until a packet can be popped or the input has ended, at most timeout milliseconds.
 
 	void loop(bool value);
 	bool loop() const;
 
 	void seek(uint32_t target);
 
+	uint32_t nb_frames() const; // Exact number of frames once the file is indexed, otherwise 0.
+
 	safe_ptr<AVFormatContext> context();
 private:
 	struct implementation;
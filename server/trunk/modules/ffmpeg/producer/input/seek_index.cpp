@@ -0,0 +1,349 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#include "../../stdafx.h"
+
+#include "seek_index.h"
+
+#include "../util/util.h"
+
+#include <common/concurrency/executor.h>
+#include <common/env.h>
+#include <common/exception/exceptions.h>
+#include <common/log/log.h>
+
+#include <tbb/atomic.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/timer.hpp>
+
+#include <windows.h>
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable : 4244)
+#endif
+extern "C" 
+{
+	#define __STDC_CONSTANT_MACROS
+	#define __STDC_LIMIT_MACROS
+	#include <libavformat/avformat.h>
+}
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+namespace caspar { namespace ffmpeg {
+
+static const char		INDEX_MAGIC[4]	= {'C', 'I', 'D', 'X'};
+static const uint32_t	INDEX_VERSION	= 1;
+	
+struct seek_index::implementation : boost::noncopyable
+{
+	struct keyframe
+	{
+		int64_t pos;
+		int64_t pts;
+		int64_t dts;
+	};
+
+	const std::wstring		filename_;
+	const std::wstring		index_filename_;
+	tbb::atomic<bool>		ready_;
+	tbb::atomic<bool>		requested_;
+	tbb::atomic<bool>		abort_;
+	
+	// Written once by the executor before ready_ is set, read only after that.
+	int						stream_index_;
+	std::vector<keyframe>	keyframes_;	// Sorted by pts.
+	std::vector<int64_t>	frames_;	// Presentation timestamps in display order.
+
+	std::unique_ptr<executor> executor_; // Created by the first request.
+
+	implementation(const std::wstring& filename) 
+		: filename_(filename)
+		, index_filename_(get_index_filename(filename))
+		, stream_index_(-1)
+	{
+		ready_		= false;
+		requested_	= false;
+		abort_		= false;
+
+		try
+		{
+			ready_ = load(); // Saved indexes are cheap to load, files are only scanned on request.
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+		}
+	}
+
+	void request()
+	{
+		if(ready_ || requested_.fetch_and_store(true))
+			return;
+
+		// Scanning a file takes a while, it gets a thread of its own rather than holding one of the executor pool.
+		executor_.reset(new executor(L"seek_index[" + filename_ + L"]", dedicated_thread));
+		executor_->set_priority_class(below_normal_priority_class);
+		executor_->begin_invoke([this]
+		{
+			try
+			{
+				boost::timer timer;
+				if(!build())
+					return;
+				CASPAR_LOG(info) << print() << L" Indexed " << frames_.size() << L" frames in " << timer.elapsed() << L" s.";
+				save();
+				ready_ = true;
+			}
+			catch(...)
+			{
+				CASPAR_LOG_CURRENT_EXCEPTION();
+				CASPAR_LOG(warning) << print() << L" Failed to index, seeking will be keyframe accurate.";
+			}
+		});
+	}
+
+	~implementation()
+	{
+		abort_ = true;
+	}
+
+	static std::wstring get_index_filename(const std::wstring& filename)
+	{
+		auto path = boost::filesystem::wpath(filename);
+
+		std::wstringstream str;
+		str << env::data_folder() << L"seek-index\\" << path.filename() << L"-" << std::hex << std::hash<std::wstring>()(boost::to_lower_copy(path.file_string())) << L".idx";
+		return str.str();
+	}
+
+	// Lowers the io and memory priority of the indexing thread, so that the reads of playing producers go first.
+	struct background_mode : boost::noncopyable
+	{
+		background_mode()	{SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);}
+		~background_mode()	{SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);}
+	};
+
+	bool build()
+	{
+		background_mode mode;
+
+		auto context = open_input(filename_);
+
+		const int index = av_find_default_stream_index(context.get());
+		if(index < 0 || context->streams[index]->codec->codec_type != AVMEDIA_TYPE_VIDEO)
+			return false;
+
+		for(unsigned int n = 0; n < context->nb_streams; ++n)
+		{
+			if(static_cast<int>(n) != index)
+				context->streams[n]->discard = AVDISCARD_ALL;
+		}
+
+		std::vector<keyframe> keyframes;
+		std::vector<int64_t>  frames;
+
+		AVPacket packet;
+		av_init_packet(&packet);
+		while(!abort_ && av_read_frame(context.get(), &packet) >= 0)
+		{
+			const keyframe entry = {packet.pos, packet.pts != AV_NOPTS_VALUE ? packet.pts : packet.dts, packet.dts != AV_NOPTS_VALUE ? packet.dts : packet.pts};
+			const bool is_key	 = (packet.flags & AV_PKT_FLAG_KEY) != 0;
+			const bool is_index	 = packet.stream_index == index;
+			av_free_packet(&packet);
+
+			if(!is_index)
+				continue;
+
+			if(entry.pts == AV_NOPTS_VALUE)
+			{
+				CASPAR_LOG(info) << print() << L" Stream has no timestamps, not indexed.";
+				return false;
+			}
+
+			frames.push_back(entry.pts);
+			if(is_key)
+				keyframes.push_back(entry);
+		}
+
+		if(abort_ || keyframes.empty())
+			return false;
+
+		std::sort(frames.begin(), frames.end());
+		std::stable_sort(keyframes.begin(), keyframes.end(), [](const keyframe& lhs, const keyframe& rhs){return lhs.pts < rhs.pts;});
+
+		stream_index_ = index;
+		keyframes_.swap(keyframes);
+		frames_.swap(frames);
+
+		return true;
+	}
+
+	template<typename T>
+	static void write(std::ofstream& file, const T& value)
+	{
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	static bool read(std::ifstream& file, T& value)
+	{
+		return file.read(reinterpret_cast<char*>(&value), sizeof(T)).good();
+	}
+
+	void save()
+	{
+		try
+		{
+			boost::filesystem::create_directories(boost::filesystem::wpath(index_filename_).parent_path());
+
+			const auto temp_filename = index_filename_ + L".tmp";
+			{
+				std::ofstream file(temp_filename.c_str(), std::ios::binary | std::ios::trunc);
+				file.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+				write(file, INDEX_VERSION);
+				write(file, static_cast<uint64_t>(boost::filesystem::file_size(filename_)));
+				write(file, static_cast<int64_t>(boost::filesystem::last_write_time(filename_)));
+				write(file, static_cast<int32_t>(stream_index_));
+				write(file, static_cast<uint32_t>(keyframes_.size()));
+				write(file, static_cast<uint32_t>(frames_.size()));
+				file.write(reinterpret_cast<const char*>(keyframes_.data()), keyframes_.size()*sizeof(keyframe));
+				file.write(reinterpret_cast<const char*>(frames_.data()), frames_.size()*sizeof(int64_t));
+				if(!file)
+					BOOST_THROW_EXCEPTION(io_error() << msg_info("Could not write index."));
+			}
+
+			boost::filesystem::remove(index_filename_);
+			boost::filesystem::rename(temp_filename, index_filename_);
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(warning) << print() << L" Failed to save index to " << index_filename_ << L".";
+		}
+	}
+
+	bool load()
+	{
+		if(!boost::filesystem::exists(index_filename_))
+			return false;
+
+		std::ifstream file(index_filename_.c_str(), std::ios::binary);
+
+		char		magic[4];
+		uint32_t	version;
+		uint64_t	file_size;
+		int64_t		write_time;
+		int32_t		stream_index;
+		uint32_t	nb_keyframes;
+		uint32_t	nb_frames;
+		if(!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), INDEX_MAGIC) || 
+		   !read(file, version)		 || version != INDEX_VERSION ||
+		   !read(file, file_size)	 || file_size != boost::filesystem::file_size(filename_) ||
+		   !read(file, write_time)	 || write_time != static_cast<int64_t>(boost::filesystem::last_write_time(filename_)) ||
+		   !read(file, stream_index) || !read(file, nb_keyframes) || !read(file, nb_frames) || nb_keyframes == 0)
+		{
+			CASPAR_LOG(debug) << print() << L" Index is stale, rebuilding.";
+			return false;
+		}
+
+		std::vector<keyframe> keyframes(nb_keyframes);
+		std::vector<int64_t>  frames(nb_frames);
+		if(!file.read(reinterpret_cast<char*>(keyframes.data()), keyframes.size()*sizeof(keyframe)) ||
+		   !file.read(reinterpret_cast<char*>(frames.data()), frames.size()*sizeof(int64_t)))
+			return false;
+
+		stream_index_ = stream_index;
+		keyframes_.swap(keyframes);
+		frames_.swap(frames);
+
+		return true;
+	}
+
+	boost::optional<seek_point> find(uint32_t frame) const
+	{
+		if(!ready_ || frame >= frames_.size())
+			return boost::none;
+
+		const auto target = frames_[frame];
+
+		// The last keyframe which is presented at or before the target. Leading frames of an open gop thereby 
+		// start from the previous gop.
+		const keyframe key = {-1, target, target};
+		auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), key, [](const keyframe& lhs, const keyframe& rhs){return lhs.pts < rhs.pts;});
+		if(it != keyframes_.begin())
+			--it;
+
+		const seek_point point = {it->pos, it->dts, target};
+		return point;
+	}
+
+	std::wstring print() const
+	{
+		return L"seek_index[" + filename_ + L"]";
+	}
+};
+
+seek_index::seek_index(const std::wstring& filename) : impl_(new implementation(filename)){}
+void seek_index::request(){impl_->request();}
+bool seek_index::ready() const{return impl_->ready_;}
+int seek_index::stream_index() const{return impl_->ready_ ? impl_->stream_index_ : -1;}
+uint32_t seek_index::nb_frames() const{return impl_->ready_ ? static_cast<uint32_t>(impl_->frames_.size()) : 0;}
+boost::optional<seek_index::seek_point> seek_index::find(uint32_t frame) const{return impl_->find(frame);}
+
+boost::mutex										g_index_mutex;
+std::map<std::wstring, std::weak_ptr<seek_index>>	g_indexes;
+
+safe_ptr<seek_index> get_seek_index(const std::wstring& filename)
+{
+	boost::lock_guard<boost::mutex> lock(g_index_mutex);
+
+	for(auto it = g_indexes.begin(); it != g_indexes.end();)
+	{
+		if(it->second.expired())
+			it = g_indexes.erase(it);
+		else
+			++it;
+	}
+
+	auto index = g_indexes[filename].lock();
+	if(!index)
+	{
+		index = std::make_shared<seek_index>(filename);
+		g_indexes[filename] = index;
+	}
+
+	return make_safe_ptr(index);
+}
+
+}}
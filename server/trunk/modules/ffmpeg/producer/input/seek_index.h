@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace caspar { namespace ffmpeg {
+
+// Index of the video packets of a file, used for frame accurate seeking. It is built in the background once requested, 
+// e.g. by the first seek into the file, and cached in the data folder until the file changes.
+class seek_index : boost::noncopyable
+{
+public:
+	struct seek_point
+	{
+		int64_t	pos;	// Byte offset of the keyframe to start decoding from, -1 if unknown.
+		int64_t	dts;	// Decode timestamp of the keyframe.
+		int64_t	pts;	// Presentation timestamp of the requested frame.
+	};
+
+	explicit seek_index(const std::wstring& filename); // Loads a cached index if there is one.
+
+	void		request();				// Starts building the index unless it is loaded or already being built.
+	bool		ready() const;
+	int			stream_index() const;	// The indexed stream, -1 until ready.
+	uint32_t	nb_frames() const;		// 0 until ready.
+
+	boost::optional<seek_point> find(uint32_t frame) const; // Empty until ready or if frame is out of range. Timestamps are in the stream time base.
+private:
+	struct implementation;
+	std::shared_ptr<implementation> impl_;
+};
+
+// Indexes are shared between producers of the same file.
+safe_ptr<seek_index> get_seek_index(const std::wstring& filename);
+
+}}
@@ -0,0 +1,241 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "../stdafx.h"
+
+#include "media_library.h"
+
+#include "util/util.h"
+
+#include <common/env.h>
+#include <common/exception/exceptions.h>
+
+#include <core/video_format.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <iomanip>
+#include <sstream>
+
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable : 4244)
+#endif
+extern "C" 
+{
+	#include <libavcodec/avcodec.h>
+	#include <libavformat/avformat.h>
+	#include <libavutil/audioconvert.h>
+	#include <libavutil/pixdesc.h>
+}
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+namespace caspar { namespace ffmpeg {
+
+boost::mutex					g_library_mutex;
+std::shared_ptr<file_index>		g_library;
+
+void init_media_library()
+{
+	auto path	  = env::properties().get(L"configuration.media-index.path", env::data_folder());
+	auto interval = env::properties().get(L"configuration.media-index.rescan-interval", 300.0);
+	auto threads  = env::properties().get(L"configuration.media-index.probe-threads", 2u);
+
+	auto library = std::make_shared<file_index>(env::media_folder(), (boost::filesystem::wpath(path) / L"media.index").file_string(), get_media_type, interval, probe_media, threads);
+
+	boost::lock_guard<boost::mutex> lock(g_library_mutex);
+	g_library = library;
+}
+
+void uninit_media_library()
+{
+	std::shared_ptr<file_index> library; // Stopped outside of the lock.
+
+	boost::lock_guard<boost::mutex> lock(g_library_mutex);
+	std::swap(library, g_library);
+}
+
+safe_ptr<file_index> get_media_library()
+{
+	boost::lock_guard<boost::mutex> lock(g_library_mutex);
+
+	if(!g_library)
+		BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("Media library is not initialized."));
+
+	return make_safe_ptr(g_library);
+}
+
+std::wstring get_media_type(const boost::filesystem::wpath& path)
+{
+	auto extension = boost::to_upper_copy(path.extension());
+
+	if(extension == L".TGA" || extension == L".COL" || extension == L".PNG" || extension == L".JPEG" || extension == L".JPG" ||
+	   extension == L".GIF" || extension == L".BMP")
+		return L"STILL";
+
+	if(extension == L".WAV" || extension == L".MP3")
+		return L"AUDIO";
+
+	if(extension == L".SWF" || extension == L".CT" || extension == L".DV" || extension == L".MOV" || extension == L".MPG" || 
+	   extension == L".AVI" || extension == L".MP4" || extension == L".FLV" || extension == L".STGA" || is_valid_file(path.file_string()))
+		return L"MOVIE";
+
+	return L"";
+}
+
+std::wstring find_media_file(const std::wstring& name)
+{
+	auto library = get_media_library();
+	if(library->is_ready())
+	{
+		auto candidates = library->find(name);
+		for(auto it = candidates.begin(); it != candidates.end(); ++it)
+		{
+			auto is_valid = it->is_probed ? it->metadata.count(L"format") > 0 : is_valid_file(it->path);
+			if(is_valid && boost::filesystem::exists(it->path))
+				return it->path;
+		}
+	}
+
+	// Not indexed yet.
+	return probe_stem(env::media_folder() + L"\\" + name);
+}
+
+std::wstring probe_field_order(AVFormatContext& context, int index)
+{
+	auto codec	 = context.streams[index]->codec;
+	auto decoder = avcodec_find_decoder(codec->codec_id);
+	if(!decoder || avcodec_open(codec, decoder) < 0)
+		return L"unknown";
+
+	std::shared_ptr<AVCodecContext> close_codec(codec, avcodec_close);
+	std::shared_ptr<AVFrame>		frame(avcodec_alloc_frame(), av_free);
+
+	// The field order is only known from decoded frames.
+	for(int n = 0; n < 256; ++n)
+	{
+		auto packet = create_packet();
+		if(av_read_frame(&context, packet.get()) < 0)
+			break;
+
+		int frame_finished = 0;
+		if(packet->stream_index == index && avcodec_decode_video2(codec, frame.get(), &frame_finished, packet.get()) >= 0 && frame_finished)
+			return core::field_mode::print(get_mode(*frame));
+	}
+
+	return L"unknown";
+}
+
+std::map<std::wstring, std::wstring> probe_media(const boost::filesystem::wpath& path)
+{
+	std::map<std::wstring, std::wstring> metadata;
+
+	if(!is_valid_file(path.file_string()))
+		return metadata;
+
+	auto context = open_input(path.file_string());
+
+	std::string format = context->iformat->name;
+	metadata[L"format"] = widen(format.substr(0, format.find(','))); // Demuxers may list several names.
+
+	if(context->duration != AV_NOPTS_VALUE)
+	{
+		std::wostringstream duration;
+		duration << std::fixed << std::setprecision(3) << static_cast<double>(context->duration)/AV_TIME_BASE;
+		metadata[L"duration"] = duration.str();
+	}
+
+	auto video_index = av_find_best_stream(context.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+	if(video_index >= 0)
+	{
+		auto stream	 = context->streams[video_index];
+		auto codec	 = stream->codec;
+		auto decoder = avcodec_find_decoder(codec->codec_id);
+
+		std::wostringstream fps;
+		fps << std::fixed << std::setprecision(2) << read_fps(*context, 0.0);
+
+		metadata[L"codec"]	= decoder ? widen(std::string(decoder->name)) : L"unknown";
+		metadata[L"width"]	= boost::lexical_cast<std::wstring>(codec->width);
+		metadata[L"height"] = boost::lexical_cast<std::wstring>(codec->height);
+		metadata[L"fps"]	= fps.str();
+		metadata[L"frames"]	= boost::lexical_cast<std::wstring>(stream->nb_frames);
+
+		if(codec->pix_fmt >= 0 && codec->pix_fmt < PIX_FMT_NB)
+		{
+			const auto components = av_pix_fmt_descriptors[codec->pix_fmt].nb_components;
+			metadata[L"alpha"] = components == 2 || components == 4 ? L"1" : L"0";
+		}
+
+		metadata[L"field-order"] = probe_field_order(*context, video_index);
+	}
+
+	auto audio_index = av_find_best_stream(context.get(), AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+	if(audio_index >= 0)
+	{
+		auto codec	 = context->streams[audio_index]->codec;
+		auto decoder = avcodec_find_decoder(codec->codec_id);
+
+		char layout[64] = {};
+		av_get_channel_layout_string(layout, sizeof(layout), codec->channels, codec->channel_layout);
+
+		metadata[L"audio-codec"]	= decoder ? widen(std::string(decoder->name)) : L"unknown";
+		metadata[L"audio-channels"] = boost::lexical_cast<std::wstring>(codec->channels);
+		metadata[L"audio-layout"]	= widen(std::string(layout));
+		metadata[L"sample-rate"]	= boost::lexical_cast<std::wstring>(codec->sample_rate);
+	}
+
+	return metadata;
+}
+
+boost::optional<file_index::entry> find_probed_media(const std::wstring& path)
+{
+	std::shared_ptr<file_index> library;
+	{
+		boost::lock_guard<boost::mutex> lock(g_library_mutex);
+		library = g_library;
+	}
+
+	if(!library || !library->is_ready())
+		return boost::none;
+
+	try
+	{
+		auto media = library->find_path(path);
+		if(media && media->is_probed && 
+		   media->size == boost::filesystem::file_size(boost::filesystem::wpath(path)) && 
+		   media->write_time == boost::filesystem::last_write_time(boost::filesystem::wpath(path)))
+			return media;
+	}
+	catch(...)
+	{
+		// Not a local file.
+	}
+
+	return boost::none;
+}
+
+}}
@@ -0,0 +1,50 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <common/memory/safe_ptr.h>
+#include <common/utility/file_index.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
+
+#include <map>
+#include <string>
+
+namespace caspar { namespace ffmpeg {
+
+// The index of the media folder, see common/utility/file_index.h. CLS and CINF are answered from it and clips are resolved
+// through it. It is saved to <media-index><path>, the data folder by default. New and changed clips are probed on
+// <media-index><probe-threads> background threads, see probe_media for the metadata.
+
+void					init_media_library();
+void					uninit_media_library();
+safe_ptr<file_index>	get_media_library();
+
+std::wstring			get_media_type(const boost::filesystem::wpath& path);	// MOVIE, AUDIO, STILL or empty for other files.
+std::wstring			find_media_file(const std::wstring& name);				// Full path of a clip ffmpeg can open, or empty.
+
+std::map<std::wstring, std::wstring>	probe_media(const boost::filesystem::wpath& path);
+boost::optional<file_index::entry>		find_probed_media(const std::wstring& path);	// Unless the file changed since it was probed. Never waits.
+
+}}
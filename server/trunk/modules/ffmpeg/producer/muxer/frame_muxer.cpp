@@ -66,6 +66,7 @@ namespace caspar { namespace ffmpeg {
 	
 struct frame_muxer::implementation : boost::noncopyable
 {	
+	const void*										tag_;
 	std::queue<std::queue<safe_ptr<write_frame>>>	video_streams_;
 	std::queue<core::audio_buffer>					audio_streams_;
 	std::queue<safe_ptr<basic_frame>>				frame_buffer_;
@@ -83,8 +84,9 @@ struct frame_muxer::implementation : boost::noncopyable
 	const std::wstring								filter_str_;
 	bool											force_deinterlacing_;
 		
-	implementation(double in_fps, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter_str)
-		: display_mode_(display_mode::invalid)
+	implementation(double in_fps, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter_str, const void* tag)
+		: tag_(tag ? tag : this)
+		, display_mode_(display_mode::invalid)
 		, in_fps_(in_fps)
 		, format_desc_(frame_factory->get_video_format_desc())
 		, auto_transcode_(env::properties().get(L"configuration.auto-transcode", true))
@@ -113,7 +115,7 @@ struct frame_muxer::implementation : boost::noncopyable
 		}
 		else if(video_frame == empty_video())
 		{
-			video_streams_.back().push(make_safe<core::write_frame>(this));
+			video_streams_.back().push(make_safe<core::write_frame>(tag_));
 			display_mode_ = display_mode::simple;
 		}
 		else
@@ -142,7 +144,7 @@ struct frame_muxer::implementation : boost::noncopyable
 				if(video_frame->format == PIX_FMT_GRAY8 && format == CASPAR_PIX_FMT_LUMA)
 					av_frame->format = format;
 
-				video_streams_.back().push(make_write_frame(this, av_frame, frame_factory_, hints));
+				video_streams_.back().push(make_write_frame(tag_, av_frame, frame_factory_, hints));
 			}
 		}
 
@@ -268,6 +270,18 @@ struct frame_muxer::implementation : boost::noncopyable
 		return frame_buffer_.empty() ? nullptr : poll();
 	}
 	
+	core::audio_buffer take_audio()
+	{
+		core::audio_buffer samples;
+		while(!audio_streams_.empty())
+		{
+			boost::range::push_back(samples, audio_streams_.front());
+			audio_streams_.pop();
+		}
+		audio_streams_.push(core::audio_buffer());
+		return samples;
+	}
+
 	safe_ptr<core::write_frame> pop_video()
 	{
 		auto frame = video_streams_.front().front();
@@ -343,7 +357,7 @@ struct frame_muxer::implementation : boost::noncopyable
 				filter_.push(frame);
 				auto av_frame = filter_.poll();
 				if(av_frame)							
-					video_streams_.back().push(make_write_frame(this, make_safe_ptr(av_frame), frame_factory_, 0));
+					video_streams_.back().push(make_write_frame(tag_, make_safe_ptr(av_frame), frame_factory_, 0));
 			}
 			filter_ = filter(filter_str);
 			CASPAR_LOG(info) << L"[frame_muxer] " << display_mode::print(display_mode_) << L" " << print_mode(frame->width, frame->height, in_fps_, frame->interlaced_frame > 0);
@@ -373,13 +387,14 @@ struct frame_muxer::implementation : boost::noncopyable
 	}
 };
 
-frame_muxer::frame_muxer(double in_fps, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter)
-	: impl_(new implementation(in_fps, frame_factory, filter)){}
+frame_muxer::frame_muxer(double in_fps, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter, const void* tag)
+	: impl_(new implementation(in_fps, frame_factory, filter, tag)){}
 void frame_muxer::push(const std::shared_ptr<AVFrame>& video_frame, int hints){impl_->push(video_frame, hints);}
 void frame_muxer::push(const std::shared_ptr<core::audio_buffer>& audio_samples){return impl_->push(audio_samples);}
 std::shared_ptr<basic_frame> frame_muxer::poll(){return impl_->poll();}
 uint32_t frame_muxer::calc_nb_frames(uint32_t nb_frames) const {return impl_->calc_nb_frames(nb_frames);}
 bool frame_muxer::video_ready() const{return impl_->video_ready();}
 bool frame_muxer::audio_ready() const{return impl_->audio_ready();}
+core::audio_buffer frame_muxer::take_audio(){return impl_->take_audio();}
 
 }}
\ No newline at end of file
@@ -48,7 +48,7 @@ namespace ffmpeg {
 class frame_muxer : boost::noncopyable
 {
 public:
-	frame_muxer(double in_fps, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter = L"");
+	frame_muxer(double in_fps, const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filter = L"", const void* tag = nullptr); // Frames are tagged with tag, or the muxer if null.
 	
 	void push(const std::shared_ptr<AVFrame>& video_frame, int hints = 0);
 	void push(const std::shared_ptr<core::audio_buffer>& audio_samples);
@@ -57,6 +57,7 @@ public:
 	bool audio_ready() const;
 
 	std::shared_ptr<core::basic_frame> poll();
+	core::audio_buffer take_audio(); // Removes the samples which have not been muxed into a frame yet.
 
 	uint32_t calc_nb_frames(uint32_t nb_frames) const;
 private:
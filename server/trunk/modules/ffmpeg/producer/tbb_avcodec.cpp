@@ -47,7 +47,10 @@ extern "C"
 #endif
 
 namespace caspar {
-		
+
+static int					dummy_opaque; // Marks contexts which are threaded by the tbb executor below rather than by ffmpeg.
+static tbb::atomic<int>		frame_threaded_decoders;
+
 int thread_execute(AVCodecContext* s, int (*func)(AVCodecContext *c2, void *arg2), void* arg, int* ret, int count, int size)
 {
 	tbb::parallel_for(0, count, 1, [&](int i)
@@ -62,21 +65,18 @@ int thread_execute(AVCodecContext* s, int (*func)(AVCodecContext *c2, void *arg2
 
 int thread_execute2(AVCodecContext* s, int (*func)(AVCodecContext* c2, void* arg2, int, int), void* arg, int* ret, int count)
 {	
-	tbb::atomic<int> counter;   
-    counter = 0;   
+	// ffmpeg indexes per thread state with threadnr, so it has to stay below thread_count no matter how many 
+	// workers the scheduler has. Split the jobs into at most thread_count ranges and let each range be a "thread".
+	const int ranges = std::max(1, std::min(count, s->thread_count));
 
-	CASPAR_VERIFY(tbb::tbb_thread::hardware_concurrency() < 16);
-	// Note: this will probably only work when tbb::task_scheduler_init::num_threads() < 16.
-    tbb::parallel_for(tbb::blocked_range<int>(0, count, 2), [&](const tbb::blocked_range<int> &r)    
+    tbb::parallel_for(0, ranges, 1, [&](int threadnr)    
     {   
-        int threadnr = counter++;   
-        for(int jobnr = r.begin(); jobnr != r.end(); ++jobnr)
+        for(int jobnr = count*threadnr/ranges; jobnr != count*(threadnr+1)/ranges; ++jobnr)
         {   
             int r = func(s, arg, jobnr, threadnr);   
             if (ret)   
                 ret[jobnr] = r;   
         }
-        --counter;
     });   
 
     return 0;  
@@ -85,7 +85,6 @@ int thread_execute2(AVCodecContext* s, int (*func)(AVCodecContext* c2, void* arg
 void thread_init(AVCodecContext* s)
 {
 	static const size_t MAX_THREADS = 16; // See mpegvideo.h
-	static int dummy_opaque;
 
     s->active_thread_type = FF_THREAD_SLICE;
 	s->thread_opaque	  = &dummy_opaque; 
@@ -98,7 +97,7 @@ void thread_init(AVCodecContext* s)
 
 void thread_free(AVCodecContext* s)
 {
-	if(!s->thread_opaque)
+	if(s->thread_opaque != &dummy_opaque)
 		return;
 
 	s->thread_opaque = nullptr;
@@ -106,26 +105,67 @@ void thread_free(AVCodecContext* s)
 	CASPAR_LOG(info) << "Released ffmpeg tbb context.";
 }
 
+int get_frame_threads()
+{
+	// Every frame thread adds one frame of decoding delay and keeps its own reference frames, so more than 16 is not worth it.
+	static const int MAX_FRAME_THREADS = 16;
+
+	const int configured = env::properties().get(L"configuration.ffmpeg.frame-threads", 0);
+	if(configured > 0)
+		return configured;
+
+	// Share the machine between the frame threaded decoders which are currently open, including this one.
+	const int cores = std::max(1, static_cast<int>(tbb::tbb_thread::hardware_concurrency()));
+	return std::max(2, std::min(MAX_FRAME_THREADS, cores / (frame_threaded_decoders + 1)));
+}
+
 int tbb_avcodec_open(AVCodecContext* avctx, AVCodec* codec)
 {
 	CodecID supported_codecs[] = {CODEC_ID_MPEG2VIDEO, CODEC_ID_PRORES, CODEC_ID_FFV1};
 
-	avctx->thread_count = 1;
+	const auto threading = env::properties().get(L"configuration.ffmpeg.decoder-threading", std::wstring(L"auto"));
+		
 	// Some codecs don't like to have multiple multithreaded decoding instances. Only enable for those we know work.
-	if(std::find(std::begin(supported_codecs), std::end(supported_codecs), codec->id) != std::end(supported_codecs) && 
-	  (codec->capabilities & CODEC_CAP_SLICE_THREADS) && 
-	  (avctx->thread_type & FF_THREAD_SLICE)) 
+	const bool slice_threads = std::find(std::begin(supported_codecs), std::end(supported_codecs), codec->id) != std::end(supported_codecs) && 
+							   (codec->capabilities & CODEC_CAP_SLICE_THREADS) && 
+							   (avctx->thread_type & FF_THREAD_SLICE);
+
+	// Frame threading is done by ffmpeg's own threads, long-GOP codecs such as h264 only scale this way.
+	const bool frame_threads = (codec->capabilities & CODEC_CAP_FRAME_THREADS) && 
+							   (avctx->thread_type & FF_THREAD_FRAME);
+
+	avctx->thread_count = 1;
+
+	if(threading != L"none")
 	{
-		thread_init(avctx);
-	}	
-	// ff_thread_init will not be executed since thread_opaque != nullptr || thread_count == 1.
-	return avcodec_open(avctx, codec); 
+		if(frame_threads && (threading == L"frame" || (threading != L"slice" && !slice_threads)))
+		{
+			avctx->thread_type  = FF_THREAD_FRAME;
+			avctx->thread_count = get_frame_threads();
+		}
+		else if(slice_threads)
+			thread_init(avctx);
+	}
+
+	// ff_thread_init will not be executed since thread_opaque != nullptr || thread_count == 1, unless frame threading was selected.
+	int result = avcodec_open(avctx, codec); 
+	
+	if(result >= 0 && avctx->thread_opaque != &dummy_opaque && avctx->active_thread_type == FF_THREAD_FRAME)
+	{
+		++frame_threaded_decoders;
+		CASPAR_LOG(info) << "Initialized ffmpeg frame threading with " << avctx->thread_count << " threads.";
+	}
+
+	return result;
 }
 
 int tbb_avcodec_close(AVCodecContext* avctx)
 {
+	if(avctx->thread_opaque != &dummy_opaque && avctx->active_thread_type == FF_THREAD_FRAME)
+		--frame_threaded_decoders;
+
 	thread_free(avctx);
-	// ff_thread_free will not be executed since thread_opaque == nullptr.
+	// ff_thread_free will not be executed since thread_opaque == nullptr, unless ffmpeg owns the threads.
 	return avcodec_close(avctx); 
 }
 
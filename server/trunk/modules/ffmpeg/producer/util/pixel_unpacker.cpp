@@ -0,0 +1,195 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "../../stdafx.h"
+
+#include "pixel_unpacker.h"
+
+#include <common/memory/simd.h>
+
+#include <tbb/parallel_for.h>
+
+#include <intrin.h>
+
+namespace caspar { namespace ffmpeg {
+
+namespace {
+
+// luma_offset is 0 for yuyv (luma in the even bytes) and 1 for uyvy (luma in the odd bytes).
+template<int luma_offset>
+void unpack_packed422_row(uint8_t* y, uint8_t* cb, uint8_t* cr, const uint8_t* src, size_t width)
+{
+	const auto low_bytes = _mm_set1_epi16(0x00FF);
+
+	size_t x = 0;
+	for(; x + 16 <= width; x += 16)
+	{
+		const auto v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x*2));
+		const auto v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x*2 + 16));
+
+		// Move the wanted byte of each word to the top, then down to the bottom.
+		const auto y0 = _mm_srli_epi16(_mm_slli_epi16(v0, 8*(1-luma_offset)), 8);
+		const auto y1 = _mm_srli_epi16(_mm_slli_epi16(v1, 8*(1-luma_offset)), 8);
+		const auto c0 = _mm_srli_epi16(_mm_slli_epi16(v0, 8*luma_offset), 8);
+		const auto c1 = _mm_srli_epi16(_mm_slli_epi16(v1, 8*luma_offset), 8);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y + x), _mm_packus_epi16(y0, y1));
+
+		// cb cr cb cr ... => cb... cr...
+		const auto c = _mm_packus_epi16(c0, c1);
+		const auto b = _mm_and_si128(c, low_bytes);
+		const auto r = _mm_srli_epi16(c, 8);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(cb + x/2), _mm_packus_epi16(b, b));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(cr + x/2), _mm_packus_epi16(r, r));
+	}
+
+	for(; x < width; x += 2)
+	{
+		const uint8_t* p = src + x*2;
+
+		y[x]	 = p[luma_offset];
+		cb[x/2]  = p[1-luma_offset];
+		cr[x/2]  = p[3-luma_offset];
+		if(x+1 < width)
+			y[x+1] = p[2+luma_offset];
+	}
+}
+
+template<int luma_offset>
+void unpack_packed422(uint8_t* y, uint8_t* cb, uint8_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* src, size_t src_linesize, size_t width, size_t height)
+{
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, height), [&](const tbb::blocked_range<size_t>& r)
+	{
+		for(auto line = r.begin(); line != r.end(); ++line)
+			unpack_packed422_row<luma_offset>(y + line*y_linesize, cb + line*c_linesize, cr + line*c_linesize, src + line*src_linesize, width);
+	});
+}
+
+// Each 16 bytes hold 6 pixels in four little endian words of three 10-bit samples:
+// cb0 y0 cr0 | y1 cb1 y2 | cr1 y3 cb2 | y4 cr2 y5
+// Unpacks the group starting at pixel x, the last group of a line may be partial.
+void unpack_v210_group(uint16_t* y, uint16_t* cb, uint16_t* cr, const uint8_t* src, size_t x, size_t width)
+{
+	const uint32_t* w = reinterpret_cast<const uint32_t*>(src);
+		
+	const uint32_t samples[12] = 
+	{
+		w[0] & 0x3FF, (w[0] >> 10) & 0x3FF, (w[0] >> 20) & 0x3FF,
+		w[1] & 0x3FF, (w[1] >> 10) & 0x3FF, (w[1] >> 20) & 0x3FF,
+		w[2] & 0x3FF, (w[2] >> 10) & 0x3FF, (w[2] >> 20) & 0x3FF,
+		w[3] & 0x3FF, (w[3] >> 10) & 0x3FF, (w[3] >> 20) & 0x3FF
+	};
+
+	static const int y_index[6]	 = {1, 3, 5, 7, 9, 11};
+	static const int cb_index[3] = {0, 4, 8};
+	static const int cr_index[3] = {2, 6, 10};
+
+	for(size_t n = 0; n < 6 && x + n < width; ++n)
+		y[x+n] = static_cast<uint16_t>(samples[y_index[n]]);
+	for(size_t n = 0; n < 3 && x + n*2 < width; ++n)
+	{
+		cb[x/2+n] = static_cast<uint16_t>(samples[cb_index[n]]);
+		cr[x/2+n] = static_cast<uint16_t>(samples[cr_index[n]]);
+	}
+}
+
+void unpack_v210_row_scalar(uint16_t* y, uint16_t* cb, uint16_t* cr, const uint8_t* src, size_t width)
+{
+	for(size_t x = 0; x < width; x += 6, src += 16)
+		unpack_v210_group(y, cb, cr, src, x, width);
+}
+
+// The three samples of each word are masked out into 32-bit lanes and packed to words, 
+// then two pshufb per plane pick them in order: 
+// ab = a0 a1 a2 a3 b0 b1 b2 b3, cc = c0 c1 c2 c3 c0 c1 c2 c3
+// y  = b0 a1 c1 b2 a3 c3, cb = a0 b1 c2, cr = c0 a2 b3
+void unpack_v210_row_ssse3(uint16_t* y, uint16_t* cb, uint16_t* cr, const uint8_t* src, size_t width)
+{
+	const char z = -128; // pshufb zeroes the byte.
+
+	const auto mask	 = _mm_set1_epi32(0x3FF);
+	const auto y_ab	 = _mm_setr_epi8(8, 9,  2, 3,  z, z,  12, 13, 6, 7,  z, z,  z, z,  z, z);
+	const auto y_cc	 = _mm_setr_epi8(z, z,  z, z,  2, 3,  z, z,   z, z,  6, 7,  z, z,  z, z);
+	const auto c_ab	 = _mm_setr_epi8(0, 1,  10, 11, z, z, z, z,   z, z,  4, 5,  14, 15, z, z);
+	const auto c_cc	 = _mm_setr_epi8(z, z,  z, z,  4, 5,  z, z,   0, 1,  z, z,  z, z,  z, z);
+
+	size_t x = 0;
+	for(; x + 8 <= width; x += 6, src += 16) // Stores 8 luma and 4+4 chroma samples of which 6 and 3+3 are valid.
+	{
+		const auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+
+		const auto a = _mm_and_si128(v, mask);
+		const auto b = _mm_and_si128(_mm_srli_epi32(v, 10), mask);
+		const auto c = _mm_and_si128(_mm_srli_epi32(v, 20), mask);
+
+		const auto ab = _mm_packs_epi32(a, b);
+		const auto cc = _mm_packs_epi32(c, c);
+
+		const auto luma	  = _mm_or_si128(_mm_shuffle_epi8(ab, y_ab), _mm_shuffle_epi8(cc, y_cc));
+		const auto chroma = _mm_or_si128(_mm_shuffle_epi8(ab, c_ab), _mm_shuffle_epi8(cc, c_cc));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(y + x), luma);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(cb + x/2), chroma);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(cr + x/2), _mm_unpackhi_epi64(chroma, chroma));
+	}
+
+	for(; x < width; x += 6, src += 16)
+		unpack_v210_group(y, cb, cr, src, x, width);
+}
+
+}
+
+}
+
+void unpack_uyvy422(uint8_t* y, uint8_t* cb, uint8_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* src, size_t src_linesize, size_t width, size_t height)
+{
+	unpack_packed422<1>(y, cb, cr, y_linesize, c_linesize, src, src_linesize, width, height);
+}
+
+void unpack_yuyv422(uint8_t* y, uint8_t* cb, uint8_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* src, size_t src_linesize, size_t width, size_t height)
+{
+	unpack_packed422<0>(y, cb, cr, y_linesize, c_linesize, src, src_linesize, width, height);
+}
+
+size_t get_v210_stride(size_t width)
+{
+	return (width + 47) / 48 * 128;
+}
+
+void unpack_v210(uint16_t* y, uint16_t* cb, uint16_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* src, size_t src_linesize, size_t width, size_t height)
+{
+	static const auto unpack_v210_row = simd::get_level() >= simd::ssse3_level ? unpack_v210_row_ssse3 : unpack_v210_row_scalar;
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, height), [&](const tbb::blocked_range<size_t>& r)
+	{
+		for(auto line = r.begin(); line != r.end(); ++line)
+		{
+			unpack_v210_row(reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(y) + line*y_linesize),
+							reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(cb) + line*c_linesize),
+							reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(cr) + line*c_linesize),
+							src + line*src_linesize, width);
+		}
+	});
+}
+
+}}
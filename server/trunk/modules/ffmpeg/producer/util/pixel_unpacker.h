@@ -0,0 +1,40 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace caspar { namespace ffmpeg {
+
+// Unpackers from packed 4:2:2 to planar 4:2:2, the lines are unpacked in parallel.
+// uyvy and yuyv use SSE2, v210 uses SSSE3 when the cpu has it.
+// Line sizes are in bytes, chroma planes are (width+1)/2 samples wide.
+
+void unpack_uyvy422(uint8_t* y, uint8_t* cb, uint8_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* src, size_t src_linesize, size_t width, size_t height);
+void unpack_yuyv422(uint8_t* y, uint8_t* cb, uint8_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* src, size_t src_linesize, size_t width, size_t height);
+
+size_t get_v210_stride(size_t width); // Bytes per line, lines are padded to 48 pixels (128 bytes).
+void unpack_v210(uint16_t* y, uint16_t* cb, uint16_t* cr, size_t y_linesize, size_t c_linesize, const uint8_t* src, size_t src_linesize, size_t width, size_t height);
+
+}}
@@ -24,26 +24,32 @@
 #include "util.h"
 
 #include "flv.h"
+#include "pixel_unpacker.h"
 
 #include "../tbb_avcodec.h"
+#include "../media_library.h"
+#include "../input/file_reader.h"
 #include "../../ffmpeg_error.h"
 
-#include <tbb/concurrent_unordered_map.h>
-#include <tbb/concurrent_queue.h>
-
 #include <core/producer/frame/frame_transform.h>
 #include <core/producer/frame/frame_factory.h>
 #include <core/producer/frame_producer.h>
 #include <core/mixer/write_frame.h>
+#include <core/mixer/cpu/cpu_buffer.h>
 
 #include <common/exception/exceptions.h>
 #include <common/utility/assert.h>
 #include <common/memory/memcpy.h>
 
 #include <tbb/parallel_for.h>
+#include <tbb/task_scheduler_init.h>
 
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <algorithm>
+#include <list>
 
 #if defined(_MSC_VER)
 #pragma warning (push)
@@ -54,6 +60,8 @@ extern "C"
 	#include <libswscale/swscale.h>
 	#include <libavcodec/avcodec.h>
 	#include <libavformat/avformat.h>
+	#include <libavutil/pixdesc.h>
+	#include <libavutil/imgutils.h>
 }
 #if defined(_MSC_VER)
 #pragma warning (pop)
@@ -109,10 +117,40 @@ core::pixel_format::type get_pixel_format(PixelFormat pix_fmt)
 	case PIX_FMT_YUV411P:		return core::pixel_format::ycbcr;
 	case PIX_FMT_YUV410P:		return core::pixel_format::ycbcr;
 	case PIX_FMT_YUVA420P:		return core::pixel_format::ycbcra;
+	case PIX_FMT_GRAY16:		return core::pixel_format::gray;
+	case PIX_FMT_RGBA64:		return core::pixel_format::rgba;
+	case PIX_FMT_YUV420P9:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV422P9:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV444P9:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV420P10:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV422P10:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV444P10:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV420P16:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV422P16:		return core::pixel_format::ycbcr;
+	case PIX_FMT_YUV444P16:		return core::pixel_format::ycbcr;
 	default:					return core::pixel_format::invalid;
 	}
 }
 
+static size_t get_pixel_depth(PixelFormat pix_fmt)
+{
+	switch(pix_fmt)
+	{
+	case PIX_FMT_YUV420P9:
+	case PIX_FMT_YUV422P9:
+	case PIX_FMT_YUV444P9:		return 9;
+	case PIX_FMT_YUV420P10:
+	case PIX_FMT_YUV422P10:
+	case PIX_FMT_YUV444P10:		return 10;
+	case PIX_FMT_GRAY16:
+	case PIX_FMT_RGBA64:
+	case PIX_FMT_YUV420P16:
+	case PIX_FMT_YUV422P16:
+	case PIX_FMT_YUV444P16:		return 16;
+	default:					return 8;
+	}
+}
+
 core::pixel_format_desc get_pixel_format_desc(PixelFormat pix_fmt, size_t width, size_t height)
 {
 	// Get linesizes
@@ -121,13 +159,17 @@ core::pixel_format_desc get_pixel_format_desc(PixelFormat pix_fmt, size_t width,
 
 	core::pixel_format_desc desc;
 	desc.pix_fmt = get_pixel_format(pix_fmt);
+
+	// Deep formats are passed through as 16-bit words.
+	const auto depth = get_pixel_depth(pix_fmt);
+	const auto bytes = depth > 8 ? 2 : 1;
 		
 	switch(desc.pix_fmt)
 	{
 	case core::pixel_format::gray:
 	case core::pixel_format::luma:
 		{
-			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[0], height, 1));						
+			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[0]/bytes, height, 1, depth));						
 			return desc;
 		}
 	case core::pixel_format::bgra:
@@ -135,7 +177,7 @@ core::pixel_format_desc get_pixel_format_desc(PixelFormat pix_fmt, size_t width,
 	case core::pixel_format::rgba:
 	case core::pixel_format::abgr:
 		{
-			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[0]/4, height, 4));						
+			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[0]/(4*bytes), height, 4, depth));						
 			return desc;
 		}
 	case core::pixel_format::ycbcr:
@@ -145,12 +187,12 @@ core::pixel_format_desc get_pixel_format_desc(PixelFormat pix_fmt, size_t width,
 			size_t size2 = dummy_pict.data[2] - dummy_pict.data[1];
 			size_t h2 = size2/dummy_pict.linesize[1];			
 
-			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[0], height, 1));
-			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[1], h2, 1));
-			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[2], h2, 1));
+			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[0]/bytes, height, 1, depth));
+			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[1]/bytes, h2, 1, depth));
+			desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[2]/bytes, h2, 1, depth));
 
 			if(desc.pix_fmt == core::pixel_format::ycbcra)						
-				desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[3], height, 1));	
+				desc.planes.push_back(core::pixel_format_desc::plane(dummy_pict.linesize[3]/bytes, height, 1, depth));	
 			return desc;
 		}		
 	default:		
@@ -161,6 +203,9 @@ core::pixel_format_desc get_pixel_format_desc(PixelFormat pix_fmt, size_t width,
 
 int make_alpha_format(int format)
 {
+	if(get_pixel_depth(static_cast<PixelFormat>(format)) > 8)
+		return format;
+
 	switch(get_pixel_format(static_cast<PixelFormat>(format)))
 	{
 	case core::pixel_format::ycbcr:
@@ -171,10 +216,243 @@ int make_alpha_format(int format)
 	}
 }
 
+// Idle software scaling contexts, least recently used last. Bounded so that contexts for resolutions and formats 
+// which are no longer played are freed.
+class sws_context_pool
+{
+	static const size_t MAX_IDLE_CONTEXTS = 64;
+
+	struct entry
+	{
+		int64_t						key;
+		std::shared_ptr<SwsContext>	context;
+	};
+
+	boost::mutex		mutex_;
+	std::list<entry>	idle_;
+
+	static int64_t make_key(int width, int height, PixelFormat pix_fmt, PixelFormat target_pix_fmt)
+	{
+		return ((static_cast<int64_t>(width)		  & 0xFFFF) << 48) | 
+			   ((static_cast<int64_t>(height)		  & 0xFFFF) << 32) | 
+			   ((static_cast<int64_t>(pix_fmt)		  & 0xFFFF) << 16) | 
+			   ((static_cast<int64_t>(target_pix_fmt) & 0xFFFF) <<  0);
+	}
+public:
+	std::shared_ptr<SwsContext> acquire(int width, int height, PixelFormat pix_fmt, PixelFormat target_pix_fmt)
+	{
+		const auto key = make_key(width, height, pix_fmt, target_pix_fmt);
+		{
+			boost::lock_guard<boost::mutex> lock(mutex_);
+
+			auto it = std::find_if(idle_.begin(), idle_.end(), [&](const entry& e){return e.key == key;});
+			if(it != idle_.end())
+			{
+				auto context = it->context;
+				idle_.erase(it);
+				return context;
+			}
+		}
+
+		std::shared_ptr<SwsContext> context(sws_getContext(width, height, pix_fmt, width, height, target_pix_fmt, SWS_BILINEAR, nullptr, nullptr, nullptr), sws_freeContext);
+		if(!context)
+		{
+			BOOST_THROW_EXCEPTION(operation_failed() << msg_info("Could not create software scaling context.") << 
+									boost::errinfo_api_function("sws_getContext"));
+		}	
+
+		return context;
+	}
+
+	void release(int width, int height, PixelFormat pix_fmt, PixelFormat target_pix_fmt, const std::shared_ptr<SwsContext>& context)
+	{
+		const entry e = {make_key(width, height, pix_fmt, target_pix_fmt), context};
+		
+		std::shared_ptr<SwsContext> evicted; // Freed outside of the lock.
+
+		boost::lock_guard<boost::mutex> lock(mutex_);
+
+		idle_.push_front(e);
+		if(idle_.size() > MAX_IDLE_CONTEXTS)
+		{
+			evicted = idle_.back().context;
+			idle_.pop_back();
+		}
+	}
+};
+
+sws_context_pool g_sws_contexts;
+
+// Converts horizontal slices of at least MIN_SLICE_HEIGHT lines in parallel, one scaling context per slice height.
+void convert_sliced(const AVFrame& src, PixelFormat pix_fmt, AVFrame& dst, PixelFormat target_pix_fmt, int width, int height)
+{
+	static const int MIN_SLICE_HEIGHT = 32;
+	static const int SLICE_ALIGNMENT  = 16; // Keeps slices on whole chroma lines for any vertical subsampling.
+
+	const auto& src_desc = av_pix_fmt_descriptors[pix_fmt];
+	const auto& dst_desc = av_pix_fmt_descriptors[target_pix_fmt];
+	
+	int slice_height = height;
+	if(!(src_desc.flags & PIX_FMT_PAL))
+	{
+		const int max_slices = std::max(1, std::min(tbb::task_scheduler_init::default_num_threads(), height / MIN_SLICE_HEIGHT));
+		slice_height = std::min(height, (height/max_slices + SLICE_ALIGNMENT - 1) / SLICE_ALIGNMENT * SLICE_ALIGNMENT);
+	}
+
+	const int slice_count = (height + slice_height - 1) / slice_height;
+
+	tbb::parallel_for<int>(0, slice_count, [&](int n)
+	{
+		const int y = n*slice_height;
+		const int h = std::min(slice_height, height - y);
+
+		const uint8_t*	src_data[4] = {};
+		uint8_t*		dst_data[4] = {};
+		for(int p = 0; p < 4; ++p)
+		{
+			const bool is_chroma = p == 1 || p == 2;
+			if(src.data[p])
+				src_data[p] = src.data[p] + (y >> (is_chroma ? src_desc.log2_chroma_h : 0)) * src.linesize[p];
+			if(dst.data[p])
+				dst_data[p] = dst.data[p] + (y >> (is_chroma ? dst_desc.log2_chroma_h : 0)) * dst.linesize[p];
+		}
+
+		// Palettes are never sliced.
+		if(src_desc.flags & PIX_FMT_PAL)
+			src_data[1] = src.data[1];
+
+		auto context = g_sws_contexts.acquire(width, h, pix_fmt, target_pix_fmt);
+		sws_scale(context.get(), src_data, src.linesize, 0, h, dst_data, dst.linesize);	
+		g_sws_contexts.release(width, h, pix_fmt, target_pix_fmt, context);
+	});
+}
+
+static const int g_persistent_tag = 0;
+
+void mark_persistent_frame(AVFrame& frame)
+{
+	frame.opaque = const_cast<int*>(&g_persistent_tag);
+}
+
+bool is_persistent_frame(const AVFrame& frame)
+{
+	return frame.opaque == &g_persistent_tag;
+}
+
+// Mirrors avcodec_default_get_buffer, but allocates every plane as a pooled cpu_buffer owned by AVFrame::opaque.
+static int get_shared_buffer(AVCodecContext* context, AVFrame* pic)
+{
+	if(context->pix_fmt < 0 || context->pix_fmt >= PIX_FMT_NB || (av_pix_fmt_descriptors[context->pix_fmt].flags & PIX_FMT_HWACCEL))
+		return avcodec_default_get_buffer(context, pic);
+
+	try
+	{
+		const auto& desc = av_pix_fmt_descriptors[context->pix_fmt];
+
+		int width  = context->width;
+		int height = context->height;
+		int stride_align[4];
+		avcodec_align_dimensions2(context, &width, &height, stride_align);
+
+		const int edge = (context->flags & CODEC_FLAG_EMU_EDGE) ? 0 : static_cast<int>(avcodec_get_edge_width());
+		width  += edge*2;
+		height += edge*2;
+
+		int linesize[4] = {};
+		int unaligned = 0;
+		do
+		{
+			// Widen until every line is aligned, same as the default allocator.
+			THROW_ON_ERROR2(av_image_fill_linesizes(linesize, context->pix_fmt, width), "[get_shared_buffer]");
+			width += width & ~(width-1);
+
+			unaligned = 0;
+			for(int n = 0; n < 4; ++n)
+				unaligned |= linesize[n] % stride_align[n];
+		}
+		while(unaligned);
+
+		uint8_t* offsets[4] = {};
+		const int size = THROW_ON_ERROR2(av_image_fill_pointers(offsets, context->pix_fmt, height, nullptr, linesize), "[get_shared_buffer]");
+
+		auto buffers = std::make_shared<std::vector<safe_ptr<core::cpu_buffer>>>();
+		for(int n = 0; n < 4 && (n == 0 || offsets[n]); ++n)
+		{
+			const int begin		 = static_cast<int>(offsets[n] - offsets[0]);
+			const int end		 = n < 3 && offsets[n+1] ? static_cast<int>(offsets[n+1] - offsets[0]) : size;
+			const bool is_chroma = n == 1 || n == 2;
+			const int h_shift	 = is_chroma ? desc.log2_chroma_w : 0;
+			const int v_shift	 = is_chroma ? desc.log2_chroma_h : 0;
+			const int pixel_size = desc.comp[0].step_minus1 + 1;
+
+			int edge_offset = 0;
+			if(edge > 0 && offsets[2])
+			{
+				edge_offset = (linesize[n]*edge >> v_shift) + (pixel_size*edge >> h_shift);
+				edge_offset = (edge_offset + stride_align[n] - 1) / stride_align[n] * stride_align[n];
+			}
+
+			auto buffer = core::cpu_buffer::create(end - begin + 16);
+			pic->base[n]	 = buffer->data();
+			pic->data[n]	 = buffer->data() + edge_offset;
+			pic->linesize[n] = linesize[n];
+			buffers->push_back(buffer);
+		}
+
+		pic->type			  = FF_BUFFER_TYPE_USER;
+		pic->age			  = 256*256*256*64;
+		pic->opaque			  = new std::shared_ptr<void>(buffers);
+		pic->reordered_opaque = context->reordered_opaque;
+		pic->pkt_pts		  = context->pkt ? context->pkt->pts : AV_NOPTS_VALUE;
+
+		return 0;
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		return AVERROR(ENOMEM);
+	}
+}
+
+static void release_shared_buffer(AVCodecContext* context, AVFrame* pic)
+{
+	if(pic->type != FF_BUFFER_TYPE_USER)
+	{
+		avcodec_default_release_buffer(context, pic);
+		return;
+	}
+
+	delete static_cast<std::shared_ptr<void>*>(pic->opaque);
+	pic->opaque = nullptr;
+
+	for(int n = 0; n < 4; ++n)
+	{
+		pic->base[n] = nullptr;
+		pic->data[n] = nullptr;
+	}
+}
+
+void enable_shared_buffers(AVCodecContext& context)
+{
+	context.get_buffer			  = get_shared_buffer;
+	context.release_buffer		  = release_shared_buffer;
+	context.thread_safe_callbacks = 1;
+}
+
+std::shared_ptr<AVFrame> share_decoded_frame(const AVCodecContext& context, const std::shared_ptr<AVFrame>& decoded_frame)
+{
+	if(context.get_buffer != get_shared_buffer || decoded_frame->type != FF_BUFFER_TYPE_USER || !decoded_frame->opaque)
+		return decoded_frame;
+
+	// The decoder recycles its own AVFrame, the buffers are kept alive by the returned frame instead.
+	std::shared_ptr<void> buffers = *static_cast<std::shared_ptr<void>*>(decoded_frame->opaque);
+	mark_persistent_frame(*decoded_frame);
+
+	return std::shared_ptr<AVFrame>(decoded_frame.get(), [decoded_frame, buffers](AVFrame*){});
+}
+
 safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVFrame>& decoded_frame, const safe_ptr<core::frame_factory>& frame_factory, int hints)
 {			
-	static tbb::concurrent_unordered_map<int64_t, tbb::concurrent_queue<std::shared_ptr<SwsContext>>> sws_contexts_;
-	
 	if(decoded_frame->width < 1 || decoded_frame->height < 1)
 		return make_safe<core::write_frame>(tag);
 
@@ -198,41 +476,14 @@ safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVF
 			target_pix_fmt = PIX_FMT_YUV422P;
 		else if(pix_fmt == PIX_FMT_UYYVYY411)
 			target_pix_fmt = PIX_FMT_YUV411P;
-		else if(pix_fmt == PIX_FMT_YUV420P10)
-			target_pix_fmt = PIX_FMT_YUV420P;
-		else if(pix_fmt == PIX_FMT_YUV422P10)
-			target_pix_fmt = PIX_FMT_YUV422P;
-		else if(pix_fmt == PIX_FMT_YUV444P10)
-			target_pix_fmt = PIX_FMT_YUV444P;
 		
 		auto target_desc = get_pixel_format_desc(target_pix_fmt, width, height);
 
 		write = frame_factory->create_frame(tag, target_desc);
 		write->set_type(get_mode(*decoded_frame));
 
-		std::shared_ptr<SwsContext> sws_context;
-
 		//CASPAR_LOG(warning) << "Hardware accelerated color transform not supported.";
-		
-		int64_t key = ((static_cast<int64_t>(width)			 << 32) & 0xFFFF00000000) | 
-					  ((static_cast<int64_t>(height)		 << 16) & 0xFFFF0000) | 
-					  ((static_cast<int64_t>(pix_fmt)		 <<  8) & 0xFF00) | 
-					  ((static_cast<int64_t>(target_pix_fmt) <<  0) & 0xFF);
-			
-		auto& pool = sws_contexts_[key];
-						
-		if(!pool.try_pop(sws_context))
-		{
-			double param;
-			sws_context.reset(sws_getContext(width, height, pix_fmt, width, height, target_pix_fmt, SWS_BILINEAR, nullptr, nullptr, &param), sws_freeContext);
-		}
-			
-		if(!sws_context)
-		{
-			BOOST_THROW_EXCEPTION(operation_failed() << msg_info("Could not create software scaling context.") << 
-									boost::errinfo_api_function("sws_getContext"));
-		}	
-		
+				
 		safe_ptr<AVFrame> av_frame(avcodec_alloc_frame(), av_free);	
 		avcodec_get_frame_defaults(av_frame.get());			
 		if(target_pix_fmt == PIX_FMT_BGRA)
@@ -251,12 +502,41 @@ safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVF
 			}
 		}
 
-		sws_scale(sws_context.get(), decoded_frame->data, decoded_frame->linesize, 0, height, av_frame->data, av_frame->linesize);	
-		pool.push(sws_context);
+		if(pix_fmt == PIX_FMT_UYVY422)
+		{
+			unpack_uyvy422(av_frame->data[0], av_frame->data[1], av_frame->data[2], av_frame->linesize[0], av_frame->linesize[1], 
+						   decoded_frame->data[0], decoded_frame->linesize[0], width, height);
+		}
+		else if(pix_fmt == PIX_FMT_YUYV422)
+		{
+			unpack_yuyv422(av_frame->data[0], av_frame->data[1], av_frame->data[2], av_frame->linesize[0], av_frame->linesize[1], 
+						   decoded_frame->data[0], decoded_frame->linesize[0], width, height);
+		}
+		else
+			convert_sliced(*decoded_frame, pix_fmt, *av_frame, target_pix_fmt, width, height);
 
 		write->commit();		
 	}
-	else
+	else if(is_persistent_frame(*decoded_frame))
+	{
+		// Planes are read in place with the decoder's line padding, the frame keeps them alive.
+		auto wrapped_desc = desc;
+		std::vector<uint8_t*> planes;
+		for(size_t n = 0; n < wrapped_desc.planes.size() && decoded_frame->linesize[n] > 0; ++n)
+		{
+			wrapped_desc.planes[n].linesize = static_cast<size_t>(decoded_frame->linesize[n]);
+			wrapped_desc.planes[n].size		= wrapped_desc.planes[n].linesize*wrapped_desc.planes[n].height;
+			planes.push_back(decoded_frame->data[n]);
+		}
+
+		if(planes.size() == wrapped_desc.planes.size())
+			write = frame_factory->wrap_frame(tag, wrapped_desc, planes, std::shared_ptr<AVFrame>(decoded_frame));
+
+		if(write)
+			write->set_type(get_mode(*decoded_frame));
+	}
+
+	if(!write)
 	{
 		write = frame_factory->create_frame(tag, desc);
 		write->set_type(get_mode(*decoded_frame));
@@ -271,7 +551,7 @@ safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVF
 			CASPAR_ASSERT(decoded);
 			CASPAR_ASSERT(write->image_data(n).begin());
 
-			if(decoded_linesize != static_cast<int>(plane.width))
+			if(decoded_linesize != static_cast<int>(plane.linesize))
 			{
 				// Copy line by line since ffmpeg sometimes pads each line.
 				tbb::parallel_for<size_t>(0, desc.planes[n].height, [&](size_t y)
@@ -390,7 +670,7 @@ double read_fps(AVFormatContext& context, double fail_value)
 	return fail_value;	
 }
 
-void fix_meta_data(AVFormatContext& context)
+void fix_meta_data(AVFormatContext& context, const boost::optional<file_index::entry>& media)
 {
 	auto video_index = av_find_best_stream(&context, AVMEDIA_TYPE_VIDEO, -1, -1, 0, 0);
 
@@ -403,9 +683,14 @@ void fix_meta_data(AVFormatContext& context)
 		{
 			try
 			{
-				auto meta = read_flv_meta_info(context.filename);
-				double fps = boost::lexical_cast<double>(meta["framerate"]);
-				video_stream->nb_frames = static_cast<int64_t>(boost::lexical_cast<double>(meta["duration"])*fps);
+				if(media && media->metadata.count(L"frames"))
+					video_stream->nb_frames = boost::lexical_cast<int64_t>(media->metadata.find(L"frames")->second);
+				else
+				{
+					auto meta = read_flv_meta_info(context.filename);
+					double fps = boost::lexical_cast<double>(meta["framerate"]);
+					video_stream->nb_frames = static_cast<int64_t>(boost::lexical_cast<double>(meta["duration"])*fps);
+				}
 			}
 			catch(...){}
 		}
@@ -434,24 +719,57 @@ safe_ptr<AVPacket> create_packet()
 	return packet;
 }
 
-safe_ptr<AVCodecContext> open_codec(AVFormatContext& context, enum AVMediaType type, int& index)
+safe_ptr<AVCodecContext> open_codec(AVFormatContext& context, enum AVMediaType type, int& index, bool share_buffers)
 {	
 	AVCodec* decoder;
 	index = THROW_ON_ERROR2(av_find_best_stream(&context, type, -1, -1, &decoder, 0), "");
 	//if(strcmp(decoder->name, "prores") == 0 && decoder->next && strcmp(decoder->next->name, "prores_lgpl") == 0)
 	//	decoder = decoder->next;
 
+	if(share_buffers && type == AVMEDIA_TYPE_VIDEO && decoder && (decoder->capabilities & CODEC_CAP_DR1))
+		enable_shared_buffers(*context.streams[index]->codec);
+
 	THROW_ON_ERROR2(tbb_avcodec_open(context.streams[index]->codec, decoder), "");
 	return safe_ptr<AVCodecContext>(context.streams[index]->codec, tbb_avcodec_close);
 }
 
+// Files probed by the media library skip format probing and reading of flv meta data.
+AVInputFormat* get_probed_format(const boost::optional<file_index::entry>& media)
+{
+	if(!media || !media->metadata.count(L"format"))
+		return nullptr;
+
+	return av_find_input_format(narrow(media->metadata.find(L"format")->second).c_str());
+}
+
 safe_ptr<AVFormatContext> open_input(const std::wstring& filename)
 {
+	auto media = find_probed_media(filename);
+
 	AVFormatContext* weak_context = nullptr;
-	THROW_ON_ERROR2(avformat_open_input(&weak_context, narrow(filename).c_str(), nullptr, nullptr), filename);
+	THROW_ON_ERROR2(avformat_open_input(&weak_context, narrow(filename).c_str(), get_probed_format(media), nullptr), filename);
 	safe_ptr<AVFormatContext> context(weak_context, av_close_input_file);			
 	THROW_ON_ERROR2(avformat_find_stream_info(weak_context, nullptr), filename);
-	fix_meta_data(*context);
+	fix_meta_data(*context, media);
+	return context;
+}
+
+safe_ptr<AVFormatContext> open_input(const std::wstring& filename, const safe_ptr<file_reader>& reader)
+{
+	AVFormatContext* weak_context = avformat_alloc_context();
+	if(!weak_context)
+		BOOST_THROW_EXCEPTION(bad_alloc() << msg_info("avformat_alloc_context"));
+
+	auto media = find_probed_media(filename);
+
+	weak_context->pb = reader->context(); // Custom io, avformat won't close it.
+	THROW_ON_ERROR2(avformat_open_input(&weak_context, narrow(filename).c_str(), get_probed_format(media), nullptr), filename);
+	safe_ptr<AVFormatContext> context(weak_context, [reader](AVFormatContext* context)
+	{
+		av_close_input_file(context);
+	});
+	THROW_ON_ERROR2(avformat_find_stream_info(weak_context, nullptr), filename);
+	fix_meta_data(*context, media);
 	return context;
 }
 
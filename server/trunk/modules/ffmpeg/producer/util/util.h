@@ -45,6 +45,8 @@ struct frame_factory;
 }
 
 namespace ffmpeg {
+
+class file_reader;
 		
 std::shared_ptr<core::audio_buffer> flush_audio();
 std::shared_ptr<core::audio_buffer> empty_audio();
@@ -59,10 +61,19 @@ core::field_mode::type		get_mode(const AVFrame& frame);
 int							make_alpha_format(int format); // NOTE: Be careful about CASPAR_PIX_FMT_LUMA, change it to PIX_FMT_GRAY8 if you want to use the frame inside some ffmpeg function.
 safe_ptr<core::write_frame> make_write_frame(const void* tag, const safe_ptr<AVFrame>& decoded_frame, const safe_ptr<core::frame_factory>& frame_factory, int hints);
 
+// Frames whose image data stays valid for as long as the AVFrame is referenced can be wrapped by make_write_frame instead of copied.
+void						mark_persistent_frame(AVFrame& frame);
+bool						is_persistent_frame(const AVFrame& frame);
+
+// Decodes direct rendering capable video into refcounted buffers, which share_decoded_frame hands out with the decoded frame.
+void						enable_shared_buffers(AVCodecContext& context);
+std::shared_ptr<AVFrame>	share_decoded_frame(const AVCodecContext& context, const std::shared_ptr<AVFrame>& decoded_frame);
+
 safe_ptr<AVPacket> create_packet();
 
-safe_ptr<AVCodecContext> open_codec(AVFormatContext& context,  enum AVMediaType type, int& index);
+safe_ptr<AVCodecContext> open_codec(AVFormatContext& context,  enum AVMediaType type, int& index, bool share_buffers = false); // share_buffers => enable_shared_buffers if supported.
 safe_ptr<AVFormatContext> open_input(const std::wstring& filename);
+safe_ptr<AVFormatContext> open_input(const std::wstring& filename, const safe_ptr<file_reader>& reader); // The context keeps the reader alive.
 
 bool is_sane_fps(AVRational time_base);
 AVRational fix_time_base(AVRational time_base);
@@ -24,6 +24,7 @@
 #include "video_decoder.h"
 
 #include "../util/util.h"
+#include "../util/pixel_unpacker.h"
 
 #include "../../ffmpeg_error.h"
 
@@ -63,14 +64,19 @@ struct video_decoder::implementation : boost::noncopyable
 	const size_t							height_;
 	bool									is_progressive_;
 
+	const AVRational						time_base_;
+	int64_t									skip_until_; // Frames presented before this (AV_TIME_BASE_Q) are dropped after an exact seek.
+
 	tbb::atomic<size_t>						file_frame_number_;
 
 public:
-	explicit implementation(const safe_ptr<AVFormatContext>& context) 
-		: codec_context_(open_codec(*context, AVMEDIA_TYPE_VIDEO, index_))
+	explicit implementation(const safe_ptr<AVFormatContext>& context, bool share_buffers) 
+		: codec_context_(open_codec(*context, AVMEDIA_TYPE_VIDEO, index_, share_buffers))
 		, nb_frames_(static_cast<uint32_t>(context->streams[index_]->nb_frames))
 		, width_(codec_context_->width)
 		, height_(codec_context_->height)
+		, time_base_(context->streams[index_]->time_base)
+		, skip_until_(AV_NOPTS_VALUE)
 	{
 		file_frame_number_ = 0;
 	}
@@ -93,7 +99,8 @@ public:
 					
 		if(packet->data == nullptr)
 		{			
-			if(codec_context_->codec->capabilities & CODEC_CAP_DELAY)
+			// Delayed and frame threaded decoders hold frames back until they are drained with null packets.
+			if((codec_context_->codec->capabilities & CODEC_CAP_DELAY) || (codec_context_->active_thread_type & FF_THREAD_FRAME))
 			{
 				auto video = decode(*packet);
 				if(video)
@@ -102,6 +109,7 @@ public:
 					
 			packets_.pop();
 			file_frame_number_ = static_cast<size_t>(packet->pos);
+			skip_until_		   = packet->pts;
 			avcodec_flush_buffers(codec_context_.get());
 			return flush_video();	
 		}
@@ -112,6 +120,9 @@ public:
 
 	std::shared_ptr<AVFrame> decode(AVPacket& pkt)
 	{
+		if(codec_context_->codec_id == CODEC_ID_V210 && pkt.size >= static_cast<int>(get_v210_stride(width_)*height_))
+			return handle_decoded(unpack_v210_packet(pkt));
+
 		std::shared_ptr<AVFrame> decoded_frame(avcodec_alloc_frame(), av_free);
 
 		int frame_finished = 0;
@@ -124,6 +135,52 @@ public:
 		if(frame_finished == 0)	
 			return nullptr;
 
+		return handle_decoded(share_decoded_frame(*codec_context_, decoded_frame));
+	}
+
+	// v210 is unpacked with SIMD straight to 10-bit planes, ffmpeg's decoder is scalar and widens to 16 bits.
+	std::shared_ptr<AVFrame> unpack_v210_packet(const AVPacket& pkt)
+	{
+		std::shared_ptr<AVFrame> frame(avcodec_alloc_frame(), [](AVFrame* p)
+		{
+			avpicture_free(reinterpret_cast<AVPicture*>(p));
+			av_free(p);
+		});
+		avcodec_get_frame_defaults(frame.get());
+		
+		THROW_ON_ERROR2(avpicture_alloc(reinterpret_cast<AVPicture*>(frame.get()), PIX_FMT_YUV422P10, static_cast<int>(width_), static_cast<int>(height_)), "[video_decocer]");
+
+		unpack_v210(reinterpret_cast<uint16_t*>(frame->data[0]), reinterpret_cast<uint16_t*>(frame->data[1]), reinterpret_cast<uint16_t*>(frame->data[2]), 
+					frame->linesize[0], frame->linesize[1], pkt.data, get_v210_stride(width_), width_, height_);
+
+		frame->format				 = PIX_FMT_YUV422P10;
+		frame->width				 = static_cast<int>(width_);
+		frame->height				 = static_cast<int>(height_);
+		frame->key_frame			 = 1;
+		frame->pict_type			 = AV_PICTURE_TYPE_I;
+		frame->pkt_pts				 = pkt.pts;
+		frame->pkt_dts				 = pkt.dts;
+		frame->best_effort_timestamp = pkt.pts;
+		frame->pkt_pos				 = pkt.pos;
+		
+		mark_persistent_frame(*frame);
+
+		return frame;
+	}
+
+	std::shared_ptr<AVFrame> handle_decoded(const std::shared_ptr<AVFrame>& decoded_frame)
+	{
+		if(skip_until_ != AV_NOPTS_VALUE)
+		{
+			const auto pts = decoded_frame->pkt_pts != AV_NOPTS_VALUE ? decoded_frame->pkt_pts : decoded_frame->best_effort_timestamp;
+			
+			// Allow a millisecond of rounding from the time base conversions.
+			if(pts != AV_NOPTS_VALUE && av_rescale_q(pts, time_base_, AV_TIME_BASE_Q) + 1000 < skip_until_)
+				return nullptr;
+
+			skip_until_ = AV_NOPTS_VALUE;
+		}
+
 		is_progressive_ = !decoded_frame->interlaced_frame;
 
 		if(decoded_frame->repeat_pict > 0)
@@ -136,7 +193,8 @@ public:
 	
 	bool ready() const
 	{
-		return packets_.size() >= 8;
+		// Frame threading only returns a frame once every thread has been fed a packet.
+		return packets_.size() >= std::max<size_t>(8, codec_context_->thread_count);
 	}
 
 	uint32_t nb_frames() const
@@ -150,7 +208,7 @@ public:
 	}
 };
 
-video_decoder::video_decoder(const safe_ptr<AVFormatContext>& context) : impl_(new implementation(context)){}
+video_decoder::video_decoder(const safe_ptr<AVFormatContext>& context, bool share_buffers) : impl_(new implementation(context, share_buffers)){}
 void video_decoder::push(const std::shared_ptr<AVPacket>& packet){impl_->push(packet);}
 std::shared_ptr<AVFrame> video_decoder::poll(){return impl_->poll();}
 bool video_decoder::ready() const{return impl_->ready();}
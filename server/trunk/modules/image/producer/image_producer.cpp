@@ -21,6 +21,7 @@
 
 #include "image_producer.h"
 
+#include "../util/image_cache.h"
 #include "../util/image_loader.h"
 
 #include <core/video_format.h>
@@ -29,12 +30,14 @@
 #include <core/producer/frame/frame_factory.h>
 #include <core/mixer/write_frame.h>
 
+#include <common/concurrency/executor.h>
 #include <common/env.h>
 #include <common/log/log.h>
 
 #include <boost/assign.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/property_tree/ptree.hpp>
+#include <boost/thread/future.hpp>
 
 #include <algorithm>
 
@@ -42,32 +45,68 @@ using namespace boost::assign;
 
 namespace caspar { namespace image {
 
+safe_ptr<core::basic_frame> load_frame(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename, const void* tag, bool premultiply_with_alpha)
+{
+	auto bitmap = load_cached_image(filename);
+		
+	core::pixel_format_desc desc;
+	desc.pix_fmt = core::pixel_format::bgra;
+	desc.planes.push_back(core::pixel_format_desc::plane(FreeImage_GetWidth(bitmap.get()), FreeImage_GetHeight(bitmap.get()), 4));
+	auto frame = frame_factory->create_frame(tag, desc);
+
+	write_bgra(bitmap.get(), frame->image_data().begin(), premultiply_with_alpha);
+	frame->commit();
+	return frame;
+}
+
 struct image_producer : public core::frame_producer
 {	
-	const std::wstring filename_;
-	safe_ptr<core::basic_frame> frame_;
+	const std::wstring										filename_;
+	safe_ptr<core::basic_frame>								frame_;
+	boost::unique_future<std::shared_ptr<core::basic_frame>>	loading_;
 	
-	explicit image_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename) 
+	explicit image_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename, bool premultiply_with_alpha, bool wait) 
 		: filename_(filename)
 		, frame_(core::basic_frame::empty())	
 	{
-		auto bitmap = load_image(filename_);
-		FreeImage_FlipVertical(bitmap.get());
-		
-		core::pixel_format_desc desc;
-		desc.pix_fmt = core::pixel_format::bgra;
-		desc.planes.push_back(core::pixel_format_desc::plane(FreeImage_GetWidth(bitmap.get()), FreeImage_GetHeight(bitmap.get()), 4));
-		auto frame = frame_factory->create_frame(this, desc);
-
-		std::copy_n(FreeImage_GetBits(bitmap.get()), frame->image_data().size(), frame->image_data().begin());
-		frame->commit();
-		frame_ = std::move(frame);
+		validate_image(filename); // Fails the command here rather than later on the decoder.
+
+		const void* tag = this;
+		loading_ = get_decode_executor().begin_invoke([=]() -> std::shared_ptr<core::basic_frame>
+		{
+			return load_frame(frame_factory, filename, tag, premultiply_with_alpha);
+		});
+
+		if(wait)
+		{
+			frame_ = make_safe_ptr(loading_.get());
+			loading_ = boost::unique_future<std::shared_ptr<core::basic_frame>>();
+		}
+	}
+
+	void poll_loading()
+	{
+		if(!loading_.is_ready())
+			return;
+
+		try
+		{
+			frame_ = make_safe_ptr(loading_.get());
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(error) << print() << L" Failed to load image.";
+		}
+
+		loading_ = boost::unique_future<std::shared_ptr<core::basic_frame>>();
 	}
 	
 	// frame_producer
 
 	virtual safe_ptr<core::basic_frame> receive(int) override
 	{
+		poll_loading();
 		return frame_;
 	}
 		
@@ -103,8 +142,11 @@ safe_ptr<core::frame_producer> create_producer(const safe_ptr<core::frame_factor
 	if(ext == extensions.end())
 		return core::frame_producer::empty();
 
+	const bool premultiply_with_alpha = std::find(params.begin(), params.end(), L"PREMULTIPLY") != params.end();
+	const bool wait					  = std::find(params.begin(), params.end(), L"WAIT") != params.end();
+
 	return create_producer_print_proxy(
-			make_safe<image_producer>(frame_factory, filename + L"." + *ext));
+			make_safe<image_producer>(frame_factory, filename + L"." + *ext, premultiply_with_alpha, wait));
 }
 
 
@@ -91,7 +91,6 @@ struct image_scroll_producer : public core::frame_producer
 		start_offset_y_ = 0;
 
 		auto bitmap = load_image(filename_);
-		FreeImage_FlipVertical(bitmap.get());
 
 		width_  = FreeImage_GetWidth(bitmap.get());
 		height_ = FreeImage_GetHeight(bitmap.get());
@@ -136,12 +135,13 @@ struct image_scroll_producer : public core::frame_producer
 				start_offset_x_ = format_desc_.width - (width_ % format_desc_.width) + width_ + format_desc_.width;
 		}
 
-		auto bytes = FreeImage_GetBits(bitmap.get());
 		int count = width_*height_*4;
-		image_view<bgra_pixel> original_view(bytes, width_, height_);
+		boost::scoped_array<uint8_t> image(new uint8_t[count]);
+		write_bgra(bitmap.get(), image.get(), premultiply_with_alpha);
+		bitmap.reset();
 
-		if (premultiply_with_alpha)
-			premultiply(original_view);
+		auto bytes = image.get();
+		image_view<bgra_pixel> original_view(bytes, width_, height_);
 
 		boost::scoped_array<uint8_t> blurred_copy;
 
@@ -161,7 +161,7 @@ struct image_scroll_producer : public core::frame_producer
 			tweener_t blur_tweener = get_tweener(L"easeInQuad");
 			blur(original_view, blurred_view, angle, motion_blur_px, blur_tweener);
 			bytes = blurred_copy.get();
-			bitmap.reset();
+			image.reset();
 		}
 
 		if (vertical)
@@ -0,0 +1,390 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "image_sequence_producer.h"
+
+#include "../util/image_loader.h"
+
+#include <core/video_format.h>
+
+#include <core/producer/frame/basic_frame.h>
+#include <core/producer/frame/frame_factory.h>
+#include <core/mixer/write_frame.h>
+
+#include <common/concurrency/executor.h>
+#include <common/diagnostics/graph.h>
+#include <common/env.h>
+#include <common/exception/exceptions.h>
+#include <common/log/log.h>
+#include <common/utility/param.h>
+
+#include <tbb/atomic.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/assign.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/range/algorithm/find.hpp>
+#include <boost/regex.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread.hpp>
+#include <boost/timer.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <iterator>
+#include <limits>
+#include <map>
+
+using namespace boost::assign;
+
+namespace caspar { namespace image {
+
+// Returns the files of the sequence ordered by frame number, gaps in the numbering are skipped.
+std::vector<std::wstring> find_sequence_files(const std::wstring& pattern)
+{
+	static const std::vector<std::wstring> extensions = list_of(L"png")(L"tga")(L"bmp")(L"jpg")(L"jpeg")(L"tiff")(L"tif");
+	static const boost::wregex pattern_exp(L"(?<PREFIX>[^%]*)%0?(?<WIDTH>\\d*)d(?<SUFFIX>[^%]*)", boost::regex::icase);
+
+	boost::wsmatch what;
+	if(!boost::regex_match(pattern, what, pattern_exp))
+		return std::vector<std::wstring>();
+
+	const auto prefix	 = what["PREFIX"].str();
+	const auto suffix	 = what["SUFFIX"].str();
+	const auto width	 = what["WIDTH"].str().empty() ? 1 : boost::lexical_cast<size_t>(what["WIDTH"].str());
+	const auto separator = prefix.find_last_of(L"/\\");
+	const auto folder	 = env::media_folder() + L"\\" + (separator == std::wstring::npos ? L"" : prefix.substr(0, separator + 1));
+	const auto stem		 = separator == std::wstring::npos ? prefix : prefix.substr(separator + 1);
+	
+	if(!boost::filesystem::is_directory(boost::filesystem::wpath(folder)))
+		return std::vector<std::wstring>();
+
+	std::map<uint32_t, std::wstring> files;
+	for(auto it = boost::filesystem::wdirectory_iterator(boost::filesystem::wpath(folder)); it != boost::filesystem::wdirectory_iterator(); ++it)
+	{
+		const auto name = it->path().filename();
+		if(name.size() <= stem.size() || !boost::istarts_with(name, stem))
+			continue;
+
+		const auto digits_end = std::find_if(name.begin() + stem.size(), name.end(), [](wchar_t c){return c < L'0' || c > L'9';});
+		const auto digits	  = std::wstring(name.begin() + stem.size(), digits_end);
+		const auto rest		  = std::wstring(digits_end, name.end());
+		if(digits.size() < width || digits.size() > 9)
+			continue;
+
+		// Without an extension in the pattern any still format is accepted.
+		const bool match = boost::iequals(rest, suffix) || (suffix.find(L'.') == std::wstring::npos && std::any_of(extensions.begin(), extensions.end(), [&](const std::wstring& ext)
+			{
+				return boost::iequals(rest, suffix + L"." + ext);
+			}));
+
+		if(match && boost::filesystem::is_regular_file(it->path()))
+			files.insert(std::make_pair(boost::lexical_cast<uint32_t>(digits), it->path().file_string()));
+	}
+
+	std::vector<std::wstring> result;
+	std::transform(files.begin(), files.end(), std::back_inserter(result), [](const std::pair<const uint32_t, std::wstring>& file){return file.second;});
+	return result;
+}
+
+// A 1080p png takes roughly 40 ms to decode on one core, enough workers are started to keep up with the channel.
+size_t get_sequence_threads(const core::video_format_desc& format_desc)
+{
+	const auto configured = env::properties().get(L"configuration.image.sequence-threads", 0u);
+	if(configured > 0)
+		return configured;
+
+	const auto pixels = static_cast<double>(format_desc.width*format_desc.height)/(1920.0*1080.0);
+	const auto needed = static_cast<size_t>(std::ceil(format_desc.fps * pixels * 0.04));
+	return std::max<size_t>(2, std::min<size_t>(needed, boost::thread::hardware_concurrency()));
+}
+
+safe_ptr<core::basic_frame> decode_frame(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& filename, const void* tag, bool premultiply_with_alpha)
+{
+	auto bitmap = load_image(filename);
+		
+	core::pixel_format_desc desc;
+	desc.pix_fmt = core::pixel_format::bgra;
+	desc.planes.push_back(core::pixel_format_desc::plane(FreeImage_GetWidth(bitmap.get()), FreeImage_GetHeight(bitmap.get()), 4));
+	auto frame = frame_factory->create_frame(tag, desc);
+
+	write_bgra(bitmap.get(), frame->image_data().begin(), premultiply_with_alpha);
+	frame->commit();
+	return frame;
+}
+
+struct image_sequence_producer : public core::frame_producer
+{	
+	typedef boost::shared_future<std::shared_ptr<core::basic_frame>> frame_future;
+
+	static const uint32_t NO_SEEK = 0xFFFFFFFF;
+
+	const std::wstring								pattern_;
+	const std::vector<std::wstring>				files_;
+	const safe_ptr<core::frame_factory>				frame_factory_;
+	const core::video_format_desc					format_desc_;
+	
+	const safe_ptr<diagnostics::graph>				graph_;
+	boost::timer									frame_timer_;
+
+	const uint32_t									start_;
+	const uint32_t									end_;
+	const size_t									read_ahead_;
+	const bool										premultiply_with_alpha_;
+	tbb::atomic<bool>								loop_;
+	tbb::atomic<uint32_t>							seek_;			// Applied by the next receive, NO_SEEK if none.
+
+	uint32_t										next_;			// Index of the next file to decode.
+	std::deque<std::pair<uint32_t, frame_future>>	window_;		// Frames being decoded, in play order.
+
+	safe_ptr<core::basic_frame>						last_frame_;
+	int64_t											frame_number_;
+	uint32_t										file_frame_number_;
+
+	tbb::atomic<uint32_t>							generation_;	// Bumped on seek, queued decodes of older generations are skipped.
+	std::vector<std::shared_ptr<executor>>			workers_;		// Declared last, joined before the members the decodes use are destroyed.
+	size_t											next_worker_;
+	
+	explicit image_sequence_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::wstring& pattern, const std::vector<std::wstring>& files, bool loop, uint32_t start, uint32_t length, size_t read_ahead, bool premultiply_with_alpha) 
+		: pattern_(pattern)
+		, files_(files)
+		, frame_factory_(frame_factory)
+		, format_desc_(frame_factory->get_video_format_desc())
+		, start_(std::min(start, static_cast<uint32_t>(files.size())))
+		, end_(static_cast<uint32_t>(std::min<uint64_t>(static_cast<uint64_t>(start_) + length, files.size())))
+		, read_ahead_(std::max(read_ahead, get_sequence_threads(format_desc_) * 2))
+		, premultiply_with_alpha_(premultiply_with_alpha)
+		, next_(start_)
+		, last_frame_(core::basic_frame::empty())
+		, frame_number_(0)
+		, file_frame_number_(start_)
+		, next_worker_(0)
+	{
+		loop_		= loop;
+		seek_		= NO_SEEK;
+		generation_ = 0;
+
+		const auto threads = get_sequence_threads(format_desc_);
+		for(size_t n = 0; n < threads; ++n)
+		{
+			workers_.push_back(std::make_shared<executor>(print() + L" decoder", dedicated_thread));
+		}
+
+		graph_->set_color("frame-time", diagnostics::color(0.1f, 1.0f, 0.1f));
+		graph_->set_color("buffer-count", diagnostics::color(0.7f, 0.4f, 0.4f));
+		graph_->set_color("underflow", diagnostics::color(0.6f, 0.3f, 0.9f));	
+		graph_->set_color("seek", diagnostics::color(1.0f, 0.5f, 0.0f));	
+		graph_->set_text(print());
+		diagnostics::register_graph(graph_);
+
+		CASPAR_LOG(info) << print() << L" " << files_.size() << L" files, " << threads << L" decoders.";
+
+		read_ahead();
+	}
+
+	~image_sequence_producer()
+	{
+		cancel_decodes();
+	}
+	
+	// frame_producer
+
+	virtual safe_ptr<core::basic_frame> receive(int hints) override
+	{
+		frame_timer_.restart();
+
+		const uint32_t seek = seek_.fetch_and_store(NO_SEEK);
+		if(seek != NO_SEEK)
+		{
+			cancel_decodes();
+			next_ = std::max(start_, std::min(seek, end_ > 0 ? end_ - 1 : 0));
+			graph_->set_tag("seek");
+		}
+
+		read_ahead();
+
+		// Offline channels have no deadline, wait for the decoders instead of underflowing.
+		if((hints & core::frame_producer::OFFLINE_HINT) && !window_.empty())
+			window_.front().second.wait();
+
+		graph_->set_value("frame-time", frame_timer_.elapsed()*format_desc_.fps*0.5);
+		graph_->set_value("buffer-count", (static_cast<double>(count_ready_frames())+0.001)/read_ahead_);
+
+		if(window_.empty())
+			return last_frame();
+
+		if(!window_.front().second.is_ready())
+		{
+			graph_->set_tag("underflow");	
+			return core::basic_frame::late();			
+		}
+
+		auto entry = window_.front();
+		window_.pop_front();
+		read_ahead();
+
+		try
+		{
+			last_frame_ = make_safe_ptr(entry.second.get());
+		}
+		catch(...)
+		{
+			CASPAR_LOG_CURRENT_EXCEPTION();
+			CASPAR_LOG(warning) << print() << L" Failed to decode " << files_[entry.first] << L", repeating the previous frame.";
+		}
+
+		++frame_number_;
+		file_frame_number_ = entry.first;
+
+		graph_->set_text(print());
+
+		return last_frame_;
+	}
+		
+	virtual safe_ptr<core::basic_frame> last_frame() const override
+	{
+		return last_frame_;
+	}
+
+	virtual uint32_t nb_frames() const override
+	{
+		if(loop_)
+			return std::numeric_limits<uint32_t>::max();
+
+		return end_ - start_;
+	}
+	
+	virtual boost::unique_future<std::wstring> call(const std::wstring& param) override
+	{
+		boost::promise<std::wstring> promise;
+		promise.set_value(do_call(param));
+		return promise.get_future();
+	}
+
+	virtual std::wstring print() const override
+	{
+		return L"image_sequence_producer[" + pattern_ + L"|" + boost::lexical_cast<std::wstring>(file_frame_number_) + L"/" + boost::lexical_cast<std::wstring>(files_.size()) + L"]";
+	}
+
+	virtual boost::property_tree::wptree info() const override
+	{
+		boost::property_tree::wptree info;
+		info.add(L"type",				L"image-sequence-producer");
+		info.add(L"filename",			pattern_);
+		info.add(L"loop",				static_cast<bool>(loop_));
+		info.add(L"frame-number",		frame_number_);
+		auto nb_frames2 = nb_frames();
+		info.add(L"nb-frames",			nb_frames2 == std::numeric_limits<uint32_t>::max() ? -1 : static_cast<int64_t>(nb_frames2));
+		info.add(L"file-frame-number",	file_frame_number_);
+		info.add(L"file-nb-frames",		files_.size());
+		info.add(L"read-ahead",			read_ahead_);
+		info.add(L"decoders",			workers_.size());
+		return info;
+	}
+
+	// image_sequence_producer
+
+	void read_ahead()
+	{
+		while(window_.size() < read_ahead_)
+		{
+			if(next_ >= end_)
+			{
+				if(!loop_ || start_ >= end_)
+					break;
+				next_ = start_;
+			}
+
+			const auto index	  = next_;
+			const auto generation = static_cast<uint32_t>(generation_);
+			auto& worker		  = *workers_[next_worker_++ % workers_.size()];
+			frame_future frame(worker.begin_invoke([=]() -> std::shared_ptr<core::basic_frame>
+			{
+				if(generation != generation_)
+					return nullptr;
+				return decode_frame(frame_factory_, files_[index], this, premultiply_with_alpha_);
+			}));
+
+			window_.push_back(std::make_pair(next_++, frame));
+		}
+	}
+
+	// Drops the window, queued decodes are removed and those already popped see the new generation.
+	void cancel_decodes()
+	{
+		++generation_;
+		BOOST_FOREACH(auto& worker, workers_)
+			worker->clear();
+		window_.clear();
+	}
+
+	size_t count_ready_frames() const
+	{
+		return std::find_if(window_.begin(), window_.end(), [](const std::pair<uint32_t, frame_future>& entry){return !entry.second.is_ready();}) - window_.begin();
+	}
+
+	std::wstring do_call(const std::wstring& param)
+	{
+		static const boost::wregex loop_exp(L"LOOP\\s*(?<VALUE>\\d?)?", boost::regex::icase);
+		static const boost::wregex seek_exp(L"SEEK\\s+(?<VALUE>\\d+)", boost::regex::icase);
+		
+		boost::wsmatch what;
+		if(boost::regex_match(param, what, loop_exp))
+		{
+			if(!what["VALUE"].str().empty())
+				loop_ = boost::lexical_cast<bool>(what["VALUE"].str());
+			return boost::lexical_cast<std::wstring>(static_cast<bool>(loop_));
+		}
+		if(boost::regex_match(param, what, seek_exp))
+		{
+			seek_ = std::min(boost::lexical_cast<uint32_t>(what["VALUE"].str()), NO_SEEK - 1);
+			return L"";
+		}
+
+		BOOST_THROW_EXCEPTION(invalid_argument());
+	}
+};
+
+safe_ptr<core::frame_producer> create_sequence_producer(const safe_ptr<core::frame_factory>& frame_factory, const std::vector<std::wstring>& params)
+{
+	if(params.empty() || params[0].find(L'%') == std::wstring::npos)
+		return core::frame_producer::empty();
+
+	auto files = find_sequence_files(params[0]);
+	if(files.empty())
+		return core::frame_producer::empty();
+	
+	auto loop		= boost::range::find(params, L"LOOP") != params.end();
+	auto start		= get_param(L"SEEK", params, static_cast<uint32_t>(0));
+	auto length		= get_param(L"LENGTH", params, std::numeric_limits<uint32_t>::max());
+	auto read_ahead	= get_param(L"READ-AHEAD", params, env::properties().get(L"configuration.image.sequence-read-ahead", 8u));
+	auto premultiply_with_alpha = boost::range::find(params, L"PREMULTIPLY") != params.end();
+
+	return create_producer_destroy_proxy(
+			make_safe<image_sequence_producer>(frame_factory, params[0], files, loop, start, length, read_ahead, premultiply_with_alpha));
+}
+
+}}
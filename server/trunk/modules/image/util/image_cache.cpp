@@ -0,0 +1,141 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#include "image_cache.h"
+#include "image_loader.h"
+
+#include <common/concurrency/executor.h>
+#include <common/env.h>
+#include <common/log/log.h>
+
+#include <tbb/atomic.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <sstream>
+#include <vector>
+
+namespace caspar { namespace image {
+
+struct cache_entry
+{
+	std::wstring				key;
+	std::shared_ptr<FIBITMAP>	bitmap;
+	size_t						size;
+};
+
+boost::mutex								g_cache_mutex;
+std::list<cache_entry>						g_cache;		// Most recently used first.
+size_t										g_cache_size = 0;
+
+// Pixel format load_image decodes to, 24 or 32 bpp bgr(a) rows bottom-up. Change it if load_image changes.
+const wchar_t* const						DECODED_FORMAT = L"bgr(a)-bottom-up";
+
+boost::once_flag							g_decoders_once = BOOST_ONCE_INIT;
+std::vector<std::shared_ptr<executor>>		g_decoders;
+tbb::atomic<unsigned int>					g_next_decoder;
+
+size_t get_image_cache_budget()
+{
+	return std::min(env::properties().get(L"configuration.image.cache-size", 256u), 4095u) * 1024 * 1024;
+}
+
+std::shared_ptr<FIBITMAP> find_cached_image(const std::wstring& key)
+{
+	boost::lock_guard<boost::mutex> lock(g_cache_mutex);
+
+	auto it = std::find_if(g_cache.begin(), g_cache.end(), [&](const cache_entry& entry){return entry.key == key;});
+	if(it == g_cache.end())
+		return nullptr;
+
+	g_cache.splice(g_cache.begin(), g_cache, it);
+	return it->bitmap;
+}
+
+void insert_cached_image(const std::wstring& key, const std::shared_ptr<FIBITMAP>& bitmap)
+{
+	const auto budget = get_image_cache_budget();
+	const auto size	  = static_cast<size_t>(FreeImage_GetPitch(bitmap.get())) * FreeImage_GetHeight(bitmap.get());
+	if(size > budget)
+		return;
+
+	std::list<cache_entry> evicted; // Bitmaps are released outside of the lock.
+
+	boost::lock_guard<boost::mutex> lock(g_cache_mutex);
+	
+	auto it = std::find_if(g_cache.begin(), g_cache.end(), [&](const cache_entry& entry){return entry.key == key;});
+	if(it != g_cache.end())
+		return;
+
+	const cache_entry entry = {key, bitmap, size};
+	g_cache.push_front(entry);
+	g_cache_size += size;
+	
+	while(g_cache_size > budget)
+	{
+		g_cache_size -= g_cache.back().size;
+		evicted.splice(evicted.begin(), g_cache, std::prev(g_cache.end()));
+	}
+}
+
+std::shared_ptr<FIBITMAP> load_cached_image(const std::wstring& filename)
+{
+	std::wstringstream key;
+	if(boost::filesystem::exists(boost::filesystem::wpath(filename)))
+	{
+		key << filename << L"|" << boost::filesystem::last_write_time(boost::filesystem::wpath(filename)) << L"|" << DECODED_FORMAT;
+
+		auto bitmap = find_cached_image(key.str());
+		if(bitmap)
+			return bitmap;
+	}
+
+	auto bitmap = load_image(filename);
+	insert_cached_image(key.str(), bitmap);
+
+	return bitmap;
+}
+
+void init_decoders()
+{
+	const auto count = std::max(env::properties().get(L"configuration.image.decode-threads", 2u), 1u);
+	for(unsigned int n = 0; n < count; ++n)
+	{
+		auto decoder = std::make_shared<executor>(L"image_decoder");
+		decoder->set_priority_class(below_normal_priority_class);
+		g_decoders.push_back(decoder);
+	}
+	g_next_decoder = 0;
+}
+
+executor& get_decode_executor()
+{
+	boost::call_once(g_decoders_once, init_decoders);
+	return *g_decoders[g_next_decoder++ % g_decoders.size()];
+}
+
+}}
@@ -0,0 +1,43 @@
+/*
+* Copyright (c) 2011 Sveriges Television AB <info@casparcg.com>
+*
+* This file is part of CasparCG (www.casparcg.com).
+*
+* CasparCG is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* CasparCG is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with CasparCG. If not, see <http://www.gnu.org/licenses/>.
+*
+* Author: Robert Nagy, ronag89@gmail.com
+*/
+
+
+#pragma once
+
+#include <FreeImage.h>
+
+#include <memory>
+#include <string>
+
+namespace caspar { 
+
+class executor;
+	
+namespace image {
+
+// Loads an image as returned by load_image, from the cache when the file has not changed. Use write_bgra to copy it to a frame.
+// Up to <image><cache-size> MB of decoded images are kept. The returned bitmap is shared and must not be modified.
+std::shared_ptr<FIBITMAP> load_cached_image(const std::wstring& filename);
+
+// Returns one of <image><decode-threads> below normal priority executors, round robin.
+executor& get_decode_executor();
+
+}}
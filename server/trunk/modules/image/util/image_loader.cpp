@@ -31,24 +31,46 @@
 #include <boost/exception/errinfo_file_name.hpp>
 #include <boost/filesystem.hpp>
 
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+
 namespace caspar { namespace image {
 
-std::shared_ptr<FIBITMAP> load_image(const std::string& filename)
+FREE_IMAGE_FORMAT get_image_format(const std::string& filename)
 {
 	if(!boost::filesystem::exists(filename))
 		BOOST_THROW_EXCEPTION(file_not_found() << boost::errinfo_file_name(filename));
 
+	if(boost::filesystem::file_size(filename) == 0)
+		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Empty image file.") << boost::errinfo_file_name(filename));
+
 	FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
-	fif = FreeImage_GetFileType(filename.c_str(), 0);
+	fif = FreeImage_GetFileType(filename.c_str(), 0); // From the signature in the header.
 	if(fif == FIF_UNKNOWN) 
-		fif = FreeImage_GetFIFFromFilename(filename.c_str());
+		fif = FreeImage_GetFIFFromFilename(filename.c_str()); // Formats without a signature, e.g. targa.
 		
 	if(fif == FIF_UNKNOWN || !FreeImage_FIFSupportsReading(fif)) 
-		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Unsupported image format."));
+		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Unsupported image format.") << boost::errinfo_file_name(filename));
+
+	return fif;
+}
+
+void validate_image(const std::wstring& filename)
+{
+	get_image_format(narrow(filename));
+}
+
+std::shared_ptr<FIBITMAP> load_image(const std::string& filename)
+{
+	const auto fif = get_image_format(filename);
 		
 	auto bitmap = std::shared_ptr<FIBITMAP>(FreeImage_Load(fif, filename.c_str(), 0), FreeImage_Unload);
 		  
-	if(FreeImage_GetBPP(bitmap.get()) != 32)
+	if(!bitmap)
+		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Failed to decode image.") << boost::errinfo_file_name(filename));
+
+	if(FreeImage_GetBPP(bitmap.get()) != 32 && FreeImage_GetBPP(bitmap.get()) != 24)
 	{
 		bitmap = std::shared_ptr<FIBITMAP>(FreeImage_ConvertTo32Bits(bitmap.get()), FreeImage_Unload);
 		if(!bitmap)
@@ -63,4 +85,52 @@ std::shared_ptr<FIBITMAP> load_image(const std::wstring& filename)
 	return load_image(narrow(filename));
 }
 
+void write_bgra(FIBITMAP* bitmap, uint8_t* dest, bool premultiply_with_alpha)
+{
+	const int width	 = static_cast<int>(FreeImage_GetWidth(bitmap));
+	const int height = static_cast<int>(FreeImage_GetHeight(bitmap));
+	const int bpp	 = static_cast<int>(FreeImage_GetBPP(bitmap));
+
+	if(bpp != 24 && bpp != 32)
+		BOOST_THROW_EXCEPTION(invalid_argument() << msg_info("Unsupported image format."));
+
+	tbb::parallel_for(tbb::blocked_range<int>(0, height), [&](const tbb::blocked_range<int>& r)
+	{
+		for(int y = r.begin(); y != r.end(); ++y)
+		{
+			auto src = FreeImage_GetScanLine(bitmap, height - 1 - y);
+			auto dst = dest + y * width * 4;
+
+			if(bpp == 24)
+			{
+				for(int x = 0; x < width; ++x, src += 3, dst += 4)
+				{
+					dst[0] = src[0];
+					dst[1] = src[1];
+					dst[2] = src[2];
+					dst[3] = 255;
+				}
+			}
+			else if(!premultiply_with_alpha)
+				std::copy_n(src, width * 4, dst);
+			else
+			{
+				for(int x = 0; x < width; ++x, src += 4, dst += 4)
+				{
+					const int alpha = src[3];
+					if(alpha == 255) // Performance optimization
+						*reinterpret_cast<uint32_t*>(dst) = *reinterpret_cast<const uint32_t*>(src);
+					else
+					{
+						dst[0] = static_cast<uint8_t>(src[0] * alpha / 255);
+						dst[1] = static_cast<uint8_t>(src[1] * alpha / 255);
+						dst[2] = static_cast<uint8_t>(src[2] * alpha / 255);
+						dst[3] = static_cast<uint8_t>(alpha);
+					}
+				}
+			}
+		}
+	});
+}
+
 }}
\ No newline at end of file
@@ -23,12 +23,21 @@
 
 #include <FreeImage.h>
 
+#include <cstdint>
 #include <memory>
 #include <string>
 
 namespace caspar { namespace image {
 
+// Returns 24 or 32 bpp bitmaps as decoded, other depths are converted to 32 bpp. Rows are stored bottom-up.
 std::shared_ptr<FIBITMAP> load_image(const std::string& filename);
 std::shared_ptr<FIBITMAP> load_image(const std::wstring& filename);
 
+// Throws what load_image would for missing, empty or unsupported files, from the header alone without decoding.
+void validate_image(const std::wstring& filename);
+
+// Writes the bitmap to dest as width * height top-down bgra pixels in a single pass, 
+// optionally premultiplying the color channels with alpha on the way.
+void write_bgra(FIBITMAP* bitmap, uint8_t* dest, bool premultiply_with_alpha = false);
+
 }}
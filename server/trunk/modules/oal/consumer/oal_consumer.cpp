@@ -104,7 +104,12 @@ public:
 	
 	virtual boost::unique_future<bool> send(const safe_ptr<core::read_frame>& frame) override
 	{
-		auto buffer = std::make_shared<audio_buffer_16>(core::audio_32_to_16(frame->audio_data()));
+		// Monitors the first two channels.
+		std::shared_ptr<audio_buffer_16> buffer;
+		if(format_desc_.audio_channels != 2)
+			buffer = std::make_shared<audio_buffer_16>(core::audio_32_to_16(core::audio_remap_channels(frame->audio_data(), format_desc_.audio_channels, 2)));
+		else
+			buffer = std::make_shared<audio_buffer_16>(core::audio_32_to_16(frame->audio_data()));
 
 		if (!input_.try_push(buffer))
 			graph_->set_tag("dropped-frame");
@@ -414,7 +414,7 @@ public:
 		if(ptr)
 		{
 			if(config_.key_only)
-				fast_memshfl(reinterpret_cast<char*>(ptr), av_frame->data[0], image_data_size, 0x0F0F0F0F, 0x0B0B0B0B, 0x07070707, 0x03030303);
+				fast_memshfl_key(reinterpret_cast<char*>(ptr), av_frame->data[0], image_data_size);
 			else
 				fast_memcpy(reinterpret_cast<char*>(ptr), av_frame->data[0], image_data_size);
 
@@ -140,7 +140,7 @@ struct silverlight_producer : public core::frame_producer
 	executor executor_;
 public:
 
-	silverlight_producer(const safe_ptr<core::frame_factory>& frame_factory) : executor_(L"silverlight")
+	silverlight_producer(const safe_ptr<core::frame_factory>& frame_factory) : executor_(L"silverlight", dedicated_thread)
 	{
 		executor_.invoke([=]
 		{
@@ -32,8 +32,10 @@
 
 #include <common/log/log.h>
 #include <common/diagnostics/graph.h>
+#include <common/diagnostics/trace.h>
 #include <common/os/windows/current_version.h>
 #include <common/os/windows/system_info.h>
+#include <common/utility/file_index.h>
 #include <common/utility/string.h>
 #include <common/utility/utf8conv.h>
 
@@ -55,6 +57,8 @@
 #include <modules/flash/util/swf.h>
 #include <modules/flash/producer/flash_producer.h>
 #include <modules/flash/producer/cg_producer.h>
+#include <modules/ffmpeg/producer/ffmpeg_producer.h>
+#include <modules/ffmpeg/producer/media_library.h>
 #include <modules/ffmpeg/producer/util/util.h>
 #include <modules/image/image.h>
 #include <modules/ogl/ogl.h>
@@ -74,6 +78,7 @@
 #include <boost/regex.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/locale.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/range/algorithm/copy.hpp>
 
@@ -175,93 +180,89 @@ std::wstring read_file(const boost::filesystem::wpath& file)
 	return read_latin1_file(file);
 }
 
-std::wstring MediaInfo(const boost::filesystem::wpath& path)
+std::wstring FormatWriteTime(std::time_t write_time)
 {
-	if(boost::filesystem::is_regular_file(path))
-	{
-		std::wstring clipttype = TEXT(" N/A ");
-		std::wstring extension = boost::to_upper_copy(path.extension());
-		if(extension == TEXT(".TGA") || extension == TEXT(".COL") || extension == L".PNG" || extension == L".JPEG" || extension == L".JPG" ||
-			extension == L"GIF" || extension == L"BMP")
-			clipttype = TEXT(" STILL ");
-		else if(extension == TEXT(".WAV") || extension == TEXT(".MP3"))
-			clipttype = TEXT(" AUDIO ");
-		else if(extension == TEXT(".SWF") || extension == TEXT(".CT") || 
-			    extension == TEXT(".DV") || extension == TEXT(".MOV") || 
-				extension == TEXT(".MPG") || extension == TEXT(".AVI") || 
-				extension == TEXT(".MP4") || extension == TEXT(".FLV") || 
-				extension == TEXT(".STGA") || 
-				caspar::ffmpeg::is_valid_file(path.file_string()))
-			clipttype = TEXT(" MOVIE ");
-
-		if(clipttype != TEXT(" N/A "))
-		{		
-			auto is_not_digit = [](char c){ return std::isdigit(c) == 0; };
-
-			auto relativePath = boost::filesystem::wpath(path.file_string().substr(env::media_folder().size()-1, path.file_string().size()));
-
-			auto writeTimeStr = boost::posix_time::to_iso_string(boost::posix_time::from_time_t(boost::filesystem::last_write_time(path)));
-			writeTimeStr.erase(std::remove_if(writeTimeStr.begin(), writeTimeStr.end(), is_not_digit), writeTimeStr.end());
-			auto writeTimeWStr = std::wstring(writeTimeStr.begin(), writeTimeStr.end());
-
-			auto sizeStr = boost::lexical_cast<std::wstring>(boost::filesystem::file_size(path));
-			sizeStr.erase(std::remove_if(sizeStr.begin(), sizeStr.end(), is_not_digit), sizeStr.end());
-			auto sizeWStr = std::wstring(sizeStr.begin(), sizeStr.end());
-				
-			auto str = relativePath.replace_extension(TEXT("")).external_file_string();
-			if(str[0] == '\\' || str[0] == '/')
-				str = std::wstring(str.begin() + 1, str.end());
+	auto writeTimeStr = boost::posix_time::to_iso_string(boost::posix_time::from_time_t(write_time));
+	writeTimeStr.erase(std::remove_if(writeTimeStr.begin(), writeTimeStr.end(), [](char c){ return std::isdigit(c) == 0;}), writeTimeStr.end());
+	return std::wstring(writeTimeStr.begin(), writeTimeStr.end());
+}
 
-			return std::wstring() + TEXT("\"") + str +
-					+ TEXT("\" ") + clipttype +
-					+ TEXT(" ") + sizeStr +
-					+ TEXT(" ") + writeTimeWStr +
-					+ TEXT("\r\n"); 	
-		}	
-	}
-	return L"";
+std::wstring MediaInfo(const file_index::entry& media)
+{
+	// Probed metadata follows as KEY=VALUE, e.g. FIELD-ORDER=UPPER.
+	std::wstring metadata;
+	for(auto it = media.metadata.begin(); it != media.metadata.end(); ++it)
+		metadata += L" " + boost::to_upper_copy(it->first) + L"=" + boost::replace_all_copy(it->second, L" ", L"_");
+
+	return std::wstring() + TEXT("\"") + media.name +
+			+ TEXT("\"  ") + media.type +
+			+ TEXT("  ") + boost::lexical_cast<std::wstring>(media.size) +
+			+ TEXT(" ") + FormatWriteTime(media.write_time) +
+			+ metadata +
+			+ TEXT("\r\n"); 	
 }
 
-std::wstring ListMedia()
+std::wstring ListMedia(size_t offset, size_t count)
 {	
+	auto media = ffmpeg::get_media_library()->entries();
+
 	std::wstringstream replyString;
-	for (boost::filesystem::wrecursive_directory_iterator itr(env::media_folder()), end; itr != end; ++itr)	
-		replyString << MediaInfo(itr->path());
+	for(size_t n = offset; n < media.size() && n - offset < count; ++n)
+		replyString << MediaInfo(media[n]);
 	
 	return boost::to_upper_copy(replyString.str());
 }
 
-std::wstring ListTemplates() 
+boost::mutex					g_template_index_mutex;
+std::shared_ptr<file_index>		g_template_index;
+
+void init_template_index()
 {
-	std::wstringstream replyString;
+	auto path	  = env::properties().get(L"configuration.media-index.path", env::data_folder());
+	auto interval = env::properties().get(L"configuration.media-index.rescan-interval", 300.0);
 
-	for (boost::filesystem::wrecursive_directory_iterator itr(env::template_folder()), end; itr != end; ++itr)
-	{		
-		if(boost::filesystem::is_regular_file(itr->path()) && (itr->path().extension() == L".ft" || itr->path().extension() == L".ct"))
-		{
-			auto relativePath = boost::filesystem::wpath(itr->path().file_string().substr(env::template_folder().size()-1, itr->path().file_string().size()));
+	auto index = std::make_shared<file_index>(env::template_folder(), (boost::filesystem::wpath(path) / L"templates.index").file_string(), [](const boost::filesystem::wpath& file) -> std::wstring
+	{
+		return file.extension() == L".ft" || file.extension() == L".ct" ? L"TEMPLATE" : L"";
+	}, interval);
 
-			auto writeTimeStr = boost::posix_time::to_iso_string(boost::posix_time::from_time_t(boost::filesystem::last_write_time(itr->path())));
-			writeTimeStr.erase(std::remove_if(writeTimeStr.begin(), writeTimeStr.end(), [](char c){ return std::isdigit(c) == 0;}), writeTimeStr.end());
-			auto writeTimeWStr = std::wstring(writeTimeStr.begin(), writeTimeStr.end());
+	boost::lock_guard<boost::mutex> lock(g_template_index_mutex);
+	g_template_index = index;
+}
 
-			auto sizeStr = boost::lexical_cast<std::string>(boost::filesystem::file_size(itr->path()));
-			sizeStr.erase(std::remove_if(sizeStr.begin(), sizeStr.end(), [](char c){ return std::isdigit(c) == 0;}), sizeStr.end());
+void uninit_template_index()
+{
+	std::shared_ptr<file_index> index; // Stopped outside of the lock.
 
-			auto sizeWStr = std::wstring(sizeStr.begin(), sizeStr.end());
+	boost::lock_guard<boost::mutex> lock(g_template_index_mutex);
+	std::swap(index, g_template_index);
+}
 
-			std::wstring dir = relativePath.parent_path().external_directory_string();
-			std::wstring file = boost::to_upper_copy(relativePath.filename());
-			relativePath = boost::filesystem::wpath(dir + L"/" + file);
-						
-			auto str = relativePath.replace_extension(TEXT("")).external_file_string();
-			boost::trim_if(str, boost::is_any_of("\\/"));
+safe_ptr<file_index> GetTemplateIndex()
+{
+	boost::lock_guard<boost::mutex> lock(g_template_index_mutex);
 
-			replyString << TEXT("\"") << str
-						<< TEXT("\" ") << sizeWStr
-						<< TEXT(" ") << writeTimeWStr
-						<< TEXT("\r\n");		
-		}
+	if(!g_template_index)
+		BOOST_THROW_EXCEPTION(invalid_operation() << msg_info("Template index is not initialized."));
+
+	return make_safe_ptr(g_template_index);
+}
+
+std::wstring ListTemplates() 
+{
+	auto templates = GetTemplateIndex()->entries();
+
+	std::wstringstream replyString;
+	for(auto it = templates.begin(); it != templates.end(); ++it)
+	{		
+		auto relativePath = boost::filesystem::wpath(it->name);
+		auto str		  = (relativePath.parent_path() / boost::to_upper_copy(relativePath.filename())).external_file_string();
+		boost::trim_if(str, boost::is_any_of("\\/"));
+
+		replyString << TEXT("\"") << str
+					<< TEXT("\" ") << it->size
+					<< TEXT(" ") << FormatWriteTime(it->write_time)
+					<< TEXT("\r\n");		
 	}
 	return replyString.str();
 }
@@ -293,6 +294,15 @@ bool DiagnosticsCommand::DoExecute()
 {	
 	try
 	{
+		if(!_parameters.empty() && boost::iequals(_parameters[0], L"TRACE"))
+		{
+			auto filename = env::log_folder() + L"trace_" + widen(boost::posix_time::to_iso_string(boost::posix_time::second_clock::local_time())) + L".json";
+			diagnostics::write_trace(filename);
+			
+			SetReplyString(TEXT("201 DIAG OK\r\n") + filename + TEXT("\r\n"));
+			return true;
+		}
+
 		diagnostics::show_graphs(true);
 
 		SetReplyString(TEXT("202 DIAG OK\r\n"));
@@ -401,6 +411,37 @@ bool CallCommand::DoExecute()
 	}
 }
 
+bool CacheCommand::DoExecute()
+{	
+	try
+	{
+		auto what = _parameters.at(0);
+
+		if(what == L"CLEAR")
+			ffmpeg::evict_producer_cache(GetChannel()->mixer(), L"");
+		else if(what == L"REMOVE")
+			ffmpeg::evict_producer_cache(GetChannel()->mixer(), _parameters.at(1));
+		else
+			ffmpeg::warm_producer_cache(GetChannel()->mixer(), _parameters);
+		
+		SetReplyString(TEXT("202 CACHE OK\r\n"));
+
+		return true;
+	}
+	catch(file_not_found&)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		SetReplyString(TEXT("404 CACHE ERROR\r\n"));
+		return false;
+	}
+	catch(...)
+	{
+		CASPAR_LOG_CURRENT_EXCEPTION();
+		SetReplyString(TEXT("502 CACHE FAILED\r\n"));
+		return false;
+	}
+}
+
 // UGLY HACK
 tbb::concurrent_unordered_map<int, std::vector<stage::transform_tuple_t>> deferred_transforms;
 
@@ -571,6 +612,43 @@ bool MixerCommand::DoExecute()
 				return transform;
 			}, duration, tween));
 		}
+		else if(_parameters[0] == L"ROUTING")
+		{
+			// MIXER 1-10 ROUTING 1+3:0.707 2+3:0.707
+			// Output channel n is the sum of the source channels listed in parameter n, each with an optional gain. 0 is silence and no parameters resets the routing.
+			audio_matrix routing;
+			if(_parameters.size() > 1)
+			{
+				if(_parameters.size() - 1 > max_audio_channels)
+					BOOST_THROW_EXCEPTION(out_of_range() << msg_info("Too many output channels."));
+
+				std::fill(routing.gains.begin(), routing.gains.end(), 0.0f);
+				for(size_t output = 0; output + 1 < _parameters.size(); ++output)
+				{
+					std::vector<std::wstring> sources;
+					boost::split(sources, _parameters[output + 1], boost::is_any_of(L"+"));
+					BOOST_FOREACH(auto& source, sources)
+					{
+						std::vector<std::wstring> parts;
+						boost::split(parts, source, boost::is_any_of(L":"));
+
+						auto index = boost::lexical_cast<int>(parts.at(0));
+						auto gain  = parts.size() > 1 ? boost::lexical_cast<float>(parts[1]) : 1.0f;
+						if(index < 0 || index > max_audio_channels)
+							BOOST_THROW_EXCEPTION(out_of_range() << msg_info("Invalid source channel."));
+						if(index > 0)
+							routing.gains[output*max_audio_channels + index - 1] += gain;
+					}
+				}
+			}
+
+			auto audio_routing = make_audio_routing(routing);
+			transforms.push_back(stage::transform_tuple_t(GetLayerIndex(), [=](frame_transform transform) -> frame_transform
+			{
+				transform.audio_routing = audio_routing;
+				return transform;
+			}, 0, L"linear"));
+		}
 		else if(_parameters[0] == L"CLEAR")
 		{
 			int layer = GetLayerIndex(std::numeric_limits<int>::max());
@@ -1425,14 +1503,15 @@ bool CinfCommand::DoExecute()
 	
 	try
 	{
+		auto library = ffmpeg::get_media_library();
+
+		auto media = library->find(_parameters.at(0));
+		if(media.empty())
+			media = library->find_file_name(_parameters.at(0));
+
 		std::wstring info;
-		for (boost::filesystem::wrecursive_directory_iterator itr(env::media_folder()), end; itr != end; ++itr)
-		{
-			auto path = itr->path();
-			auto file = path.replace_extension(L"").filename();
-			if(boost::iequals(file, _parameters.at(0)))
-				info += MediaInfo(itr->path()) + L"\r\n";
-		}
+		for(auto it = media.begin(); it != media.end(); ++it)
+			info += MediaInfo(*it) + L"\r\n";
 
 		if(info.empty())
 		{
@@ -1606,9 +1685,25 @@ bool ClsCommand::DoExecute()
 		tga = still
 		col = still
 	*/
+	size_t offset = 0;
+	size_t count  = static_cast<size_t>(-1);
+
+	try
+	{
+		if(_parameters.size() > 0)
+			offset = boost::lexical_cast<size_t>(_parameters[0]);
+		if(_parameters.size() > 1)
+			count = boost::lexical_cast<size_t>(_parameters[1]);
+	}
+	catch(boost::bad_lexical_cast&)
+	{
+		SetReplyString(TEXT("403 CLS ERROR\r\n"));
+		return false;
+	}
+
 	std::wstringstream replyString;
 	replyString << TEXT("200 CLS OK\r\n");
-	replyString << ListMedia();
+	replyString << ListMedia(offset, count);
 	replyString << TEXT("\r\n");
 	SetReplyString(boost::to_upper_copy(replyString.str()));
 	return true;
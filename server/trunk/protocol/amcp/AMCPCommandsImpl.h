@@ -27,9 +27,14 @@
 
 namespace caspar { namespace protocol {
 	
-std::wstring ListMedia();
+std::wstring ListMedia(size_t offset = 0, size_t count = static_cast<size_t>(-1));
 std::wstring ListTemplates();
 
+// The index of the template folder which TLS is answered from, started with the server so that the first scan is 
+// done before it is needed.
+void init_template_index();
+void uninit_template_index();
+
 namespace amcp {
 	
 class ChannelGridCommand : public AMCPCommandBase<false, AddToQueue, 0>
@@ -55,6 +60,12 @@ class MixerCommand : public AMCPCommandBase<true, AddToQueue, 1>
 	std::wstring print() const { return L"MixerCommand";}
 	bool DoExecute();
 };
+
+class CacheCommand : public AMCPCommandBase<true, AddToQueue, 1>
+{
+	std::wstring print() const { return L"CacheCommand";}
+	bool DoExecute();
+};
 	
 class AddCommand : public AMCPCommandBase<true, AddToQueue, 1>
 {
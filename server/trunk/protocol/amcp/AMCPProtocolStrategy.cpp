@@ -303,6 +303,7 @@ AMCPCommandPtr AMCPProtocolStrategy::CommandFactory(const std::wstring& str)
 	else if(s == TEXT("DIAG"))			return std::make_shared<DiagnosticsCommand>();
 	else if(s == TEXT("CHANNEL_GRID"))	return std::make_shared<ChannelGridCommand>();
 	else if(s == TEXT("CALL"))			return std::make_shared<CallCommand>();
+	else if(s == TEXT("CACHE"))			return std::make_shared<CacheCommand>();
 	else if(s == TEXT("SWAP"))			return std::make_shared<SwapCommand>();
 	else if(s == TEXT("LOAD"))			return std::make_shared<LoadCommand>();
 	else if(s == TEXT("LOADBG"))		return std::make_shared<LoadbgCommand>();
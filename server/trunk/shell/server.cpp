@@ -23,6 +23,7 @@
 #include "server.h"
 
 #include <common/env.h>
+#include <common/concurrency/executor.h>
 #include <common/exception/exceptions.h>
 #include <common/utility/string.h>
 
@@ -47,6 +48,7 @@
 #include <modules/ffmpeg/consumer/ffmpeg_consumer.h>
 
 #include <protocol/amcp/AMCPProtocolStrategy.h>
+#include <protocol/amcp/AMCPCommandsImpl.h>
 #include <protocol/cii/CIIProtocolStrategy.h>
 #include <protocol/CLK/CLKProtocolStrategy.h>
 #include <protocol/util/AsyncEventServer.h>
@@ -64,15 +66,18 @@ using namespace protocol;
 
 struct server::implementation : boost::noncopyable
 {
-	safe_ptr<ogl_device>						ogl_;
+	std::shared_ptr<ogl_device>					ogl_; // Created on demand by the first gpu channel.
 	std::vector<safe_ptr<IO::AsyncEventServer>> async_servers_;	
 	std::vector<safe_ptr<video_channel>>		channels_;
 
 	implementation()		
-		: ogl_(ogl_device::create())
 	{			
+		set_executor_pool_size(env::properties().get(L"configuration.executor-threads", 0u));
+
 		ffmpeg::init();
 		CASPAR_LOG(info) << L"Initialized ffmpeg module.";
+
+		init_template_index();
 							  
 		bluefish::init();	  
 		CASPAR_LOG(info) << L"Initialized bluefish module.";
@@ -102,6 +107,7 @@ struct server::implementation : boost::noncopyable
 	~implementation()
 	{		
 		ffmpeg::uninit();
+		uninit_template_index();
 
 		async_servers_.clear();
 		channels_.clear();
@@ -115,8 +121,27 @@ struct server::implementation : boost::noncopyable
 			auto format_desc = video_format_desc::get(widen(xml_channel.second.get(L"video-mode", L"PAL")));		
 			if(format_desc.format == video_format::invalid)
 				BOOST_THROW_EXCEPTION(caspar_exception() << msg_info("Invalid video-mode."));
+
+			format_desc = with_audio_channels(format_desc, xml_channel.second.get(L"audio-channels", 2u));
 			
-			channels_.push_back(make_safe<video_channel>(channels_.size()+1, format_desc, ogl_));
+			auto image_mixer = xml_channel.second.get(L"image-mixer", L"gpu");
+			std::shared_ptr<ogl_device> ogl;
+			if(image_mixer == L"gpu")
+				ogl = get_ogl_device();
+			else if(image_mixer != L"cpu")
+				BOOST_THROW_EXCEPTION(caspar_exception() << msg_info("Invalid image-mixer."));
+
+			channels_.push_back(make_safe<video_channel>(channels_.size()+1, format_desc, ogl));
+
+			auto clock = xml_channel.second.get(L"clock", L"realtime");
+			if(clock == L"offline")
+				channels_.back()->set_offline(true);
+			else if(clock != L"realtime")
+				BOOST_THROW_EXCEPTION(caspar_exception() << msg_info("Invalid clock."));
+
+			auto image_depth = xml_channel.second.get(L"image-depth", 8u);
+			if(image_depth != 8)
+				channels_.back()->set_image_depth(image_depth);
 			
 			BOOST_FOREACH(auto& xml_consumer, xml_channel.second.get_child(L"consumers"))
 			{
@@ -147,6 +172,13 @@ struct server::implementation : boost::noncopyable
 		if(env::properties().get(L"configuration.channel-grid", false))
 			channels_.push_back(make_safe<video_channel>(channels_.size()+1, core::video_format_desc::get(core::video_format::x576p2500), ogl_));
 	}
+
+	std::shared_ptr<ogl_device> get_ogl_device()
+	{
+		if(!ogl_)
+			ogl_ = ogl_device::create();
+		return ogl_;
+	}
 		
 	void setup_controllers(const boost::property_tree::wptree& pt)
 	{		